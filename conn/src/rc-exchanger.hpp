@@ -24,9 +24,6 @@ enum NoRoles {};
 // Todo: generic over container + unsigned requirement?
 template <typename ProcId, typename Role = internal::NoRoles>
 class RcConnectionExchanger {
- private:
-  static auto constexpr RetryTime = std::chrono::milliseconds(20);
-
  public:
   RcConnectionExchanger(ProcId my_id, std::vector<ProcId> remote_ids,
                         ctrl::ControlBlock& cb)
@@ -82,6 +79,9 @@ class RcConnectionExchanger {
     auto info_for_remote_party = rc.remoteInfo();
     store.set(name.str(), info_for_remote_party.serialize());
     LOGGER_INFO(logger, "Publishing qp {}", name.str());
+
+    // The remote party's qp is fetched along with the others when connecting.
+    store.prefetch(remoteName(proc_id, prefix));
   }
 
   void announceAll(memstore::MemoryStore& store, std::string const& prefix) {
@@ -101,28 +101,28 @@ class RcConnectionExchanger {
     }
     auto& rc = rcit->second;
 
-    std::stringstream name;
-    name << prefix << "-" << proc_id << remote_roles_str << "-for-" << my_id
-         << my_role_str;
+    auto const name = remoteName(proc_id, prefix);
 
     std::string ret_val;
-    if (!store.get(name.str(), ret_val)) {
-      LOGGER_DEBUG(logger, "Could not retrieve key {}", name.str());
+    if (!store.get(name, ret_val)) {
+      LOGGER_DEBUG(logger, "Could not retrieve key {}", name);
 
-      throw std::runtime_error("Cannot connect to remote qp " + name.str());
+      throw std::runtime_error("Cannot connect to remote qp " + name);
     }
 
     auto remote_rc = RemoteConnection::fromStr(ret_val);
 
     rc.init(rights);
     rc.connect(remote_rc, proc_id);
-    LOGGER_INFO(logger, "Connected to qp {} with rights {}", name.str(),
-                rights);
+    LOGGER_INFO(logger, "Connected to qp {} with rights {}", name, rights);
   }
 
   void connectAll(memstore::MemoryStore& store, std::string const& prefix,
                   ctrl::ControlBlock::MemoryRights rights =
                       ctrl::ControlBlock::LOCAL_READ) {
+    for (auto pid : remote_ids) {
+      store.prefetch(remoteName(pid, prefix));
+    }
     for (auto pid : remote_ids) {
       connect(pid, store, prefix, rights);
     }
@@ -137,30 +137,12 @@ class RcConnectionExchanger {
 
   void waitReady(ProcId proc_id, memstore::MemoryStore& store,
                  std::string const& prefix, std::string const& reason) {
-    auto packed_reason = "ready(" + reason + ")";
-    std::stringstream name;
-    name << prefix << "-" << proc_id << remote_roles_str << "-"
-         << packed_reason;
-
-    auto key = name.str();
-    std::string value;
-
-    while (!store.get(key, value)) {
-      std::this_thread::sleep_for(RetryTime);
-    }
-
-    if (value != packed_reason) {
-      throw std::runtime_error("Ready announcement of message `" + key +
-                               "` does not contain the value `" +
-                               packed_reason + "`");
-    }
+    waitReadyOf({proc_id}, store, prefix, reason);
   }
 
   void waitReadyAll(memstore::MemoryStore& store, std::string const& prefix,
                     std::string const& reason) {
-    for (auto pid : remote_ids) {
-      waitReady(pid, store, prefix, reason);
-    }
+    waitReadyOf(remote_ids, store, prefix, reason);
   }
 
   std::map<ProcId, ReliableConnection>& connections() {
@@ -208,6 +190,35 @@ class RcConnectionExchanger {
   ReliableConnection& loopback() { return *loopback_; }
 
  private:
+  std::string remoteName(ProcId proc_id, std::string const& prefix) const {
+    std::stringstream name;
+    name << prefix << "-" << proc_id << remote_roles_str << "-for-" << my_id
+         << my_role_str;
+    return name.str();
+  }
+
+  // Polls the ready announcements of all the `proc_ids` at once.
+  void waitReadyOf(std::vector<ProcId> const& proc_ids,
+                   memstore::MemoryStore& store, std::string const& prefix,
+                   std::string const& reason) {
+    auto packed_reason = "ready(" + reason + ")";
+    std::vector<std::string> keys;
+    for (auto proc_id : proc_ids) {
+      std::stringstream name;
+      name << prefix << "-" << proc_id << remote_roles_str << "-"
+           << packed_reason;
+      keys.push_back(name.str());
+    }
+
+    for (auto const& [key, value] : store.waitForAll(keys)) {
+      if (value != packed_reason) {
+        throw std::runtime_error("Ready announcement of message `" + key +
+                                 "` does not contain the value `" +
+                                 packed_reason + "`");
+      }
+    }
+  }
+
   void checkIds() const {
     if (remote_ids.empty()) {
       throw std::runtime_error("No remote Ids exist!");
@@ -4,7 +4,6 @@
 #include <dory/shared/branching.hpp>
 
 #include "rc.hpp"
-#include "wr-builder.hpp"
 
 // namespace dory {
 //   /**
@@ -229,6 +228,24 @@ void ReliableConnection::connect(RemoteConnection const &rc,
   wr->wr.rdma.rkey = rconn.rci.rkey;
 
   wr_cached = deleted_unique_ptr<struct ibv_send_wr>(wr, wrDeleter);
+
+  initSendRing();
+}
+
+void ReliableConnection::initSendRing() {
+  send_ring.assign(WrDepth, {});
+  send_ring_sg.assign(WrDepth, {});
+  nb_staged = 0;
+
+  for (size_t i = 0; i < send_ring.size(); i++) {
+    auto &sg = send_ring_sg[i];
+    sg.lkey = mr.lkey;
+
+    auto &wr = send_ring[i];
+    wr.sg_list = &sg;
+    wr.num_sge = 1;
+    wr.wr.rdma.rkey = rconn.rci.rkey;
+  }
 }
 
 bool ReliableConnection::needsReset() {
@@ -338,27 +355,67 @@ bool ReliableConnection::postSendSingle(RdmaReq req, uint64_t req_id, void *buf,
                                         uint32_t len, uint32_t lkey,
                                         uintptr_t remote_addr,
                                         bool const signaled /*= true*/) {
-  // TODO(Kristian): if not used concurrently, we could reuse the same wr
-  struct ibv_send_wr wr;
-  struct ibv_sge sg;
+  // Goes through the ring so that previously staged WRs are posted first.
+  return stage(req, req_id, buf, len, lkey, remote_addr, signaled) &&
+         postBatch();
+}
+
+void ReliableConnection::fillWr(ibv_send_wr &wr, RdmaReq req, uint64_t req_id,
+                                void *buf, uint32_t len, uint32_t lkey,
+                                uintptr_t remote_addr, bool signaled) const {
+  wr.sg_list->addr = reinterpret_cast<uintptr_t>(buf);
+  wr.sg_list->length = len;
+  wr.sg_list->lkey = lkey;
+
+  wr.wr_id = req_id;
+  wr.opcode = static_cast<enum ibv_wr_opcode>(req);
+  wr.send_flags = signaled ? IBV_SEND_SIGNALED : 0;
 
   // Offset-based MRs are DM ones (0 is not a valid MM address). DM WRs cannot
   // be inlined (doesn't make any sense).
-  bool const inlinable = mr.addr != 0;
-
-  SendWrBuilder()
-      .req(req)
-      .signaled(signaled)
-      .reqId(req_id)
-      .buf(buf)
-      .len(len)
-      .lkey(lkey)
-      .remoteAddr(remote_addr)
-      .rkey(rconn.rci.rkey)
-      .inlinable(inlinable)
-      .build(wr, sg);
+  if (req == RdmaWrite && mr.addr != 0 && len <= MaxInlining) {
+    wr.send_flags |= IBV_SEND_INLINE;
+  }
 
-  return postSend(wr);
+  wr.wr.rdma.remote_addr = remote_addr;
+}
+
+bool ReliableConnection::stage(RdmaReq req, uint64_t req_id, void *buf,
+                               uint32_t len, uint32_t lkey,
+                               uintptr_t remote_addr, bool signaled) {
+  if (unlikely(nb_staged == send_ring.size()) && !postBatch()) {
+    return false;
+  }
+
+  auto &wr = send_ring[nb_staged];
+  fillWr(wr, req, req_id, buf, len, lkey, remote_addr, signaled);
+  wr.next = nullptr;
+  if (nb_staged > 0) {
+    send_ring[nb_staged - 1].next = &wr;
+  }
+  nb_staged++;
+
+  return true;
+}
+
+bool ReliableConnection::postBatch() {
+  if (nb_staged == 0) {
+    return true;
+  }
+  nb_staged = 0;
+  return postSend(send_ring.front());
+}
+
+bool ReliableConnection::postSendMany(RdmaReq req, RdmaOp const *ops,
+                                      size_t number) {
+  for (size_t r = 0; r < number; r++) {
+    auto const &op = ops[r];
+    if (!stage(req, op.req_id, op.buf, op.len, op.remote_addr, op.signaled)) {
+      return false;
+    }
+  }
+
+  return postBatch();
 }
 
 bool ReliableConnection::postSendSingleCas(uint64_t req_id, void *buf,
@@ -409,8 +466,10 @@ bool ReliableConnection::postSendSingleSend(
 
 bool ReliableConnection::postRecvMany(uint64_t base_req_id, void **bufs,
                                       size_t number, uint32_t len) {
-  recv_wr_cached.reserve(number);
-  recv_sg_cached.reserve(number);
+  if (recv_wr_cached.size() < number) {
+    recv_wr_cached.resize(number);
+    recv_sg_cached.resize(number);
+  }
 
   for (size_t r = 0; r < number; r++) {
     auto &sg = recv_sg_cached[r];
@@ -134,6 +134,51 @@ class ReliableConnection {
                          uint64_t expected, uint64_t swap,
                          bool signaled = true);
 
+  struct RdmaOp {
+    uint64_t req_id;
+    void *buf;
+    uint32_t len;
+    uintptr_t remote_addr;
+    bool signaled;
+  };
+
+  /**
+   * @brief Posts `number` RDMA requests of the same kind as a single chain of
+   *        WRs, i.e., with a single doorbell.
+   *
+   * NOT THREAD-SAFE AS IT REUSES PRE-ALLOCATED WRs.
+   *
+   * The buffers must lie within the MR given at construction time.
+   * Requests already staged via `stage` are posted first.
+   */
+  bool postSendMany(RdmaReq req, RdmaOp const *ops, size_t number);
+
+  /**
+   * @brief Fills the next WR of the pre-initialized ring of the connection.
+   *        Staged WRs are posted by `postBatch` as a single chain of WRs,
+   *        i.e., with a single doorbell. When all the `WrDepth` WRs of the
+   *        ring are staged, they are posted before staging the new one.
+   *
+   * NOT THREAD-SAFE AS IT REUSES PRE-ALLOCATED WRs.
+   *
+   * The buffer must lie within the MR given at construction time.
+   * @return false if posting the full ring failed
+   */
+  bool stage(RdmaReq req, uint64_t req_id, void *buf, uint32_t len,
+             uintptr_t remote_addr, bool signaled = true) {
+    return stage(req, req_id, buf, len, mr.lkey, remote_addr, signaled);
+  }
+
+  bool stage(RdmaReq req, uint64_t req_id, void *buf, uint32_t len,
+             uint32_t lkey, uintptr_t remote_addr, bool signaled = true);
+
+  /**
+   * @brief Posts all the staged WRs with a single doorbell.
+   */
+  bool postBatch();
+
+  size_t staged() const { return nb_staged; }
+
   /**
    * @brief Posts a send request.
    *
@@ -171,6 +216,13 @@ class ReliableConnection {
  private:
   bool postSend(ibv_send_wr &wr);
 
+  void initSendRing();
+
+  // Sets the per-request fields of a pre-initialized WR.
+  void fillWr(ibv_send_wr &wr, RdmaReq req, uint64_t req_id, void *buf,
+              uint32_t len, uint32_t lkey, uintptr_t remote_addr,
+              bool signaled) const;
+
   static void wrDeleter(struct ibv_send_wr *wr) { free(wr); }
 
   static size_t roundUp(size_t numToRound, size_t multiple) {
@@ -201,6 +253,11 @@ class ReliableConnection {
   ctrl::ControlBlock::MemoryRights init_rights;
   deleted_unique_ptr<struct ibv_send_wr> wr_cached;
 
+  // Ring of WRs (and their SGE) whose constant fields (sg_list, lkey, rkey)
+  // are filled when connecting. Vectors' buffers survive moves.
+  std::vector<struct ibv_send_wr> send_ring;
+  std::vector<struct ibv_sge> send_ring_sg;
+  size_t nb_staged = 0;
   std::vector<struct ibv_recv_wr> recv_wr_cached;
   std::vector<struct ibv_sge> recv_sg_cached;
 
@@ -19,9 +19,6 @@ namespace dory::conn {
 // Todo: generic over container + unsigned requirement?
 template <typename ProcId>
 class UdConnectionExchanger {
- private:
-  static auto constexpr RetryTime = std::chrono::milliseconds(20);
-
  public:
   UdConnectionExchanger(memstore::MemoryStore& store, ctrl::ControlBlock& cb,
                         std::string pd_name,
@@ -40,22 +37,25 @@ class UdConnectionExchanger {
   }
 
   void connect(ProcId proc_id, std::string const& prefix) {
-    std::stringstream name;
-    name << prefix << "-" << proc_id << "-ud";
+    auto const name = udName(proc_id, prefix);
 
     std::string serialized_ud;
-    if (!store.get(name.str(), serialized_ud)) {
-      LOGGER_DEBUG(logger, "Could not retrieve key {}", name.str());
+    if (!store.get(name, serialized_ud)) {
+      LOGGER_DEBUG(logger, "Could not retrieve key {}", name);
 
-      throw std::runtime_error("Cannot connect to remote qp " + name.str());
+      throw std::runtime_error("Cannot connect to remote qp " + name);
     }
 
     udcs.emplace(proc_id, UnreliableDatagramConnection{cb, pd_name, shared_ud,
                                                        serialized_ud});
-    LOGGER_INFO(logger, "Connected ud with {}", name.str());
+    LOGGER_INFO(logger, "Connected ud with {}", name);
   }
 
   void connectAll(std::vector<ProcId> remote_ids, std::string const& prefix) {
+    // Fetch all the uds in a single round trip.
+    for (auto pid : remote_ids) {
+      store.prefetch(udName(pid, prefix));
+    }
     for (auto pid : remote_ids) {
       connect(pid, prefix);
     }
@@ -70,34 +70,37 @@ class UdConnectionExchanger {
 
   void waitReady(ProcId proc_id, std::string const& prefix,
                  std::string const& reason) {
-    auto packed_reason = "ready(" + reason + ")";
-    std::stringstream name;
-    name << prefix << "-" << proc_id << "-ud-" << packed_reason;
-
-    auto key = name.str();
-    std::string value;
-
-    while (!store.get(key, value)) {
-      std::this_thread::sleep_for(RetryTime);
-    }
-
-    if (value != packed_reason) {
-      throw std::runtime_error("Ready announcement of message `" + key +
-                               "` does not contain the value `" +
-                               packed_reason + "`");
-    }
+    waitReadyAll({proc_id}, prefix, reason);
   }
 
   void waitReadyAll(std::vector<ProcId> const& remote_ids,
                     std::string const& prefix, std::string const& reason) {
+    auto packed_reason = "ready(" + reason + ")";
+    std::vector<std::string> keys;
     for (auto pid : remote_ids) {
-      waitReady(pid, prefix, reason);
+      std::stringstream name;
+      name << prefix << "-" << pid << "-ud-" << packed_reason;
+      keys.push_back(name.str());
+    }
+
+    for (auto const& [key, value] : store.waitForAll(keys)) {
+      if (value != packed_reason) {
+        throw std::runtime_error("Ready announcement of message `" + key +
+                                 "` does not contain the value `" +
+                                 packed_reason + "`");
+      }
     }
   }
 
   std::map<ProcId, UnreliableDatagramConnection>& connections() { return udcs; }
 
  private:
+  static std::string udName(ProcId proc_id, std::string const& prefix) {
+    std::stringstream name;
+    name << prefix << "-" << proc_id << "-ud";
+    return name.str();
+  }
+
   memstore::MemoryStore& store;
   ctrl::ControlBlock& cb;
   std::string pd_name;
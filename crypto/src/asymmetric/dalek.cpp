@@ -103,18 +103,16 @@ std::map<int, pub_key> get_public_keys(std::string const &prefix,
                                        std::vector<int> const &remote_ids) {
   std::map<int, pub_key> remote_keys;
 
+  // Wait for all the keys at once: they are then served from the cache.
+  std::vector<std::string> memkeys;
   for (int pid : remote_ids) {
-    auto memkey = prefix + std::to_string(pid);
-    while (true) {
-      try {
-        remote_keys.insert(
-            std::pair<int, pub_key>(pid, get_public_key(memkey)));
-        break;
-      } catch (...) {
-        logger->info("{} not pushlished yet", memkey);
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-      }
-    }
+    memkeys.push_back(prefix + std::to_string(pid));
+  }
+  dory::memstore::MemoryStore::getInstance().waitForAll(memkeys);
+
+  for (int pid : remote_ids) {
+    remote_keys.insert(std::pair<int, pub_key>(
+        pid, get_public_key(prefix + std::to_string(pid))));
   }
 
   return remote_keys;
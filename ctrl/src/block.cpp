@@ -1,10 +1,227 @@
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
 #include <cstring>
+#include <fstream>
+#include <sstream>
 #include <stdexcept>
 
 #include "block.hpp"
 #include "device.hpp"
 
 namespace dory::ctrl {
+namespace {
+size_t constexpr PageSize = 4096;
+size_t constexpr HugePage2MB = size_t{1} << 21;
+size_t constexpr HugePage1GB = size_t{1} << 30;
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+int constexpr MapHuge2MB = 21 << MAP_HUGE_SHIFT;
+int constexpr MapHuge1GB = 30 << MAP_HUGE_SHIFT;
+
+// From <numaif.h>, so as not to depend on libnuma.
+int constexpr MpolPreferred = 1;
+unsigned long constexpr MpolFNode = 1 << 0;
+unsigned long constexpr MpolFAddr = 1 << 1;
+
+size_t roundUp(size_t const value, size_t const to) {
+  return (value + to - 1) / to * to;
+}
+
+std::shared_ptr<uint8_t> unmapOnRelease(void *const addr, size_t const length) {
+  return std::shared_ptr<uint8_t>(
+      static_cast<uint8_t *>(addr),
+      [length](uint8_t *const ptr) { munmap(ptr, length); });
+}
+
+/**
+ * Maps `length` bytes on hugetlbfs pages, which only succeeds if the system
+ * has enough of them reserved (see /proc/sys/vm/nr_hugepages).
+ */
+std::shared_ptr<uint8_t> mapHugetlb(size_t const length,
+                                    size_t const page_size) {
+  auto const size_flag = page_size == HugePage1GB ? MapHuge1GB : MapHuge2MB;
+  auto *const addr =
+      mmap(nullptr, length, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flag, -1, 0);
+  if (addr == MAP_FAILED) {
+    return nullptr;
+  }
+  return unmapOnRelease(addr, length);
+}
+
+/**
+ * Maps `length` bytes aligned to `alignment` on regular pages. If `thp`, the
+ * kernel is advised to back them by transparent hugepages, which it may
+ * refuse.
+ */
+std::shared_ptr<uint8_t> mapAligned(size_t const length, size_t alignment,
+                                    bool const thp, bool &advised) {
+  alignment = std::max(alignment, PageSize);
+  auto const padded = length + alignment - PageSize;
+  auto *const raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) {
+    throw std::runtime_error("Could not map " + std::to_string(length) +
+                             " bytes: " + std::strerror(errno));
+  }
+
+  // Trim the padding around the aligned range.
+  auto const start = reinterpret_cast<uintptr_t>(raw);
+  auto const aligned = roundUp(start, alignment);
+  auto const end = aligned + length;
+  if (aligned > start) {
+    munmap(raw, aligned - start);
+  }
+  if (start + padded > end) {
+    munmap(reinterpret_cast<void *>(end), start + padded - end);
+  }
+
+  auto *const addr = reinterpret_cast<void *>(aligned);
+  advised = thp && madvise(addr, length, MADV_HUGEPAGE) == 0;
+  return unmapOnRelease(addr, length);
+}
+
+/**
+ * Whether the kernel backed the mapping that contains `addr` by transparent
+ * hugepages.
+ */
+bool backedByThp(void const *const addr) {
+  std::ifstream smaps("/proc/self/smaps");
+  auto const target = reinterpret_cast<uintptr_t>(addr);
+  std::string line;
+  bool in_mapping = false;
+  while (std::getline(smaps, line)) {
+    // Mappings start with `start-end`, their fields with `Name:`.
+    auto const first_space = line.find(' ');
+    if (first_space != std::string::npos && line[first_space - 1] != ':') {
+      // The kernel may have merged the mapping with adjacent ones.
+      uintptr_t start = 0;
+      uintptr_t end = 0;
+      char dash;
+      std::istringstream(line) >> std::hex >> start >> dash >> end;
+      in_mapping = start <= target && target < end;
+      continue;
+    }
+    if (in_mapping && line.rfind("AnonHugePages:", 0) == 0) {
+      return std::stoul(line.substr(sizeof("AnonHugePages:") - 1)) > 0;
+    }
+  }
+  return false;
+}
+
+/**
+ * Asks the kernel to place the pages of the range on `numa_node`. This is
+ * only a preference: allocation does not fail if the node is full.
+ */
+bool preferNumaNode(void *const addr, size_t const length,
+                    int const numa_node) {
+  auto constexpr Bits = sizeof(unsigned long) * CHAR_BIT;
+  std::vector<unsigned long> mask(static_cast<size_t>(numa_node) / Bits + 1);
+  mask[static_cast<size_t>(numa_node) / Bits] |=
+      1UL << (static_cast<size_t>(numa_node) % Bits);
+  return syscall(SYS_mbind, addr, length, MpolPreferred, mask.data(),
+                 mask.size() * Bits + 1, 0) == 0;
+}
+
+int numaNodeOf(void *const addr) {
+  int node = ControlBlock::AnyNumaNode;
+  if (syscall(SYS_get_mempolicy, &node, nullptr, 0, addr,
+              MpolFNode | MpolFAddr) != 0) {
+    return ControlBlock::AnyNumaNode;
+  }
+  return node;
+}
+
+/**
+ * Maps at least `length` bytes on the requested `pages`, or on the next
+ * smaller ones that are available if `fallback`. Sets `pages` and `length`
+ * to what was mapped.
+ */
+std::shared_ptr<uint8_t> mapPages(size_t &length, size_t const alignment,
+                                  ControlBlock::Pages &pages,
+                                  bool const fallback) {
+  using Pages = ControlBlock::Pages;
+  auto const requested = pages;
+  while (true) {
+    switch (pages) {
+      case Pages::Huge1GB:
+      case Pages::Huge2MB: {
+        auto const page_size =
+            pages == Pages::Huge1GB ? HugePage1GB : HugePage2MB;
+        if (alignment <= page_size) {
+          auto const rounded = roundUp(length, page_size);
+          if (auto data = mapHugetlb(rounded, page_size)) {
+            length = rounded;
+            return data;
+          }
+        }
+        break;
+      }
+      case Pages::TransparentHuge: {
+        auto const rounded = roundUp(length, HugePage2MB);
+        bool advised;
+        auto data = mapAligned(rounded, std::max(alignment, HugePage2MB),
+                               true, advised);
+        if (advised) {
+          length = rounded;
+          return data;
+        }
+        break;
+      }
+      default: {
+        length = roundUp(length, PageSize);
+        bool advised;
+        return mapAligned(length, alignment, false, advised);
+      }
+    }
+
+    if (!fallback) {
+      throw std::runtime_error(
+          std::string("Could not map the buffer on ") +
+          ControlBlock::pagesStr(requested) + " pages" +
+          (pages == requested ? "" : " nor smaller ones"));
+    }
+    pages = pages == Pages::Huge1GB   ? Pages::Huge2MB
+            : pages == Pages::Huge2MB ? Pages::TransparentHuge
+                                      : Pages::Normal;
+  }
+}
+}  // namespace
+
+char const *ControlBlock::pagesStr(Pages const pages) {
+  switch (pages) {
+    case Pages::Auto:
+      return "auto";
+    case Pages::Normal:
+      return "normal";
+    case Pages::TransparentHuge:
+      return "thp";
+    case Pages::Huge2MB:
+      return "2mb";
+    case Pages::Huge1GB:
+      return "1gb";
+  }
+  return "unknown";
+}
+
+ControlBlock::Pages ControlBlock::pagesFromStr(std::string const &str) {
+  for (auto const pages : {Pages::Auto, Pages::Normal, Pages::TransparentHuge,
+                           Pages::Huge2MB, Pages::Huge1GB}) {
+    if (str == pagesStr(pages)) {
+      return pages;
+    }
+  }
+  throw std::runtime_error("Unknown pages `" + str +
+                           "` (auto, normal, thp, 2mb or 1gb)");
+}
+
 ControlBlock::ControlBlock(ResolvedPort &resolved_port)
     : resolved_port{resolved_port}, LOGGER_INIT(logger, "CB") {}
 
@@ -43,22 +260,124 @@ deleted_unique_ptr<struct ibv_pd> &ControlBlock::pd(std::string const &name) {
   return pd->second;
 }
 
+void ControlBlock::setAllocationPolicy(AllocationPolicy const &policy) {
+  default_policy = policy;
+}
+
 void ControlBlock::allocateBuffer(std::string const &name, size_t length,
                                   size_t alignment) {
+  allocateBuffer(name, length, alignment, default_policy);
+}
+
+void ControlBlock::allocateBuffer(std::string const &name, size_t length,
+                                  size_t alignment,
+                                  AllocationPolicy const &policy) {
   if (buf_map.find(name) != buf_map.end()) {
     throw std::runtime_error("Already registered buffer named " + name);
   }
 
-  std::shared_ptr<uint8_t> data(allocate_aligned<uint8_t>(alignment, length),
-                                DeleteAligned<uint8_t>());
-  memset(data.get(), 0, length);
+  auto const numa_node = resolveNumaNode(policy.numa_node);
+  auto pages = policy.pages == Pages::Auto ? Pages::Huge2MB : policy.pages;
+
+  // Small buffers share hugepages rather than wasting one each.
+  auto const page_size = pages == Pages::Huge1GB   ? HugePage1GB
+                         : pages == Pages::Normal ? PageSize
+                                                  : HugePage2MB;
+  if (pages != Pages::Normal && length < page_size / 2 &&
+      alignment <= page_size / 2) {
+    auto &arena = arenas[pages];
+    // A chunk that fell back to smaller pages is only shared by the buffers
+    // that accept to fall back.
+    if (arena && (arena->numa_node != numa_node ||
+                  (!policy.fallback && arena->allocation.pages != pages) ||
+                  roundUp(arena->used, alignment) + length >
+                      arena->allocation.length)) {
+      arena.reset();
+    }
+    if (!arena) {
+      size_t chunk_length = page_size;
+      auto chunk = mapPages(chunk_length, page_size, pages, policy.fallback);
+      if (numa_node != AnyNumaNode) {
+        preferNumaNode(chunk.get(), chunk_length, numa_node);
+      }
+      // Touch the pages so that they get allocated (on the right node).
+      memset(chunk.get(), 0, chunk_length);
+      if (pages == Pages::TransparentHuge && !backedByThp(chunk.get())) {
+        pages = Pages::Normal;
+      }
+      auto const chunk_node = numaNodeOf(chunk.get());
+      arena = Arena{std::move(chunk), 0, numa_node,
+                    Allocation{pages, chunk_node, chunk_length}};
+    }
+
+    auto const offset = roundUp(arena->used, alignment);
+    arena->used = offset + length;
+    // The chunk was zeroed when mapped and each range is handed out once.
+    std::shared_ptr<uint8_t> data(arena->chunk, arena->chunk.get() + offset);
+    addBuffer(name, std::move(data), length,
+              Allocation{arena->allocation.pages, arena->allocation.numa_node,
+                         length});
+    return;
+  }
+
+  auto mapped_length = length;
+  auto data = mapPages(mapped_length, alignment, pages, policy.fallback);
+  if (numa_node != AnyNumaNode && !preferNumaNode(data.get(), mapped_length,
+                                                  numa_node)) {
+    LOGGER_WARN(logger, "Could not bind buffer '{}' to NUMA node {}: {}", name,
+                numa_node, std::strerror(errno));
+  }
+  memset(data.get(), 0, mapped_length);
+  if (pages == Pages::TransparentHuge && !backedByThp(data.get())) {
+    pages = Pages::Normal;
+  }
+
+  auto const mapped_node = numaNodeOf(data.get());
+  addBuffer(name, std::move(data), length,
+            Allocation{pages, mapped_node, mapped_length});
+}
 
+ControlBlock::Allocation const &ControlBlock::allocation(
+    std::string const &name) const {
+  auto const it = allocations.find(name);
+  if (it == allocations.end()) {
+    throw std::runtime_error("No buffer exists with name " + name);
+  }
+  return it->second;
+}
+
+void ControlBlock::addBuffer(std::string const &name,
+                             std::shared_ptr<uint8_t> data, size_t length,
+                             Allocation const &allocation) {
   raw_bufs.push_back(std::move(data));
 
   std::pair<size_t, size_t> index_length(raw_bufs.size() - 1, length);
 
   buf_map.insert({name, index_length});
-  LOGGER_INFO(logger, "Buffer '{}' of size {} allocated", name, length);
+  allocations.insert({name, allocation});
+  LOGGER_INFO(logger,
+              "Buffer '{}' of size {} allocated on {} pages (NUMA node {})",
+              name, length, pagesStr(allocation.pages), allocation.numa_node);
+}
+
+int ControlBlock::resolveNumaNode(int const numa_node) {
+  if (numa_node < NicNumaNode) {
+    throw std::runtime_error("Invalid NUMA node " + std::to_string(numa_node));
+  }
+  if (numa_node != NicNumaNode) {
+    return numa_node;
+  }
+  if (!nic_numa_node) {
+    // The kernel reports -1 (i.e., AnyNumaNode) on single-node machines.
+    nic_numa_node = AnyNumaNode;
+    std::ifstream sysfs(std::string("/sys/class/infiniband/") +
+                        resolved_port.device().name() + "/device/numa_node");
+    int node;
+    if (sysfs >> node) {
+      nic_numa_node = std::max(node, AnyNumaNode);
+    }
+  }
+  return *nic_numa_node;
 }
 
 #ifdef DORY_CTRL_DM
@@ -117,12 +436,15 @@ void ControlBlock::allocatePhysicallyLockedBuffer(
       DeleteRedirected<uint8_t, memory::PhysicallyLockedBuffer>(locked_buf));
   memset(data.get(), 0, length);
 
-  raw_bufs.push_back(std::move(data));
-
-  std::pair<size_t, size_t> index_length(raw_bufs.size() - 1, length);
-
-  buf_map.insert({name, index_length});
-  LOGGER_INFO(logger, "Buffer '{}' of size {} allocated", name, length);
+  auto const pages =
+      allocation_pool == memory::PhysicallyLockedBuffer::HUGEPAGE_1GB
+          ? Pages::Huge1GB
+      : allocation_pool == memory::PhysicallyLockedBuffer::NORMAL
+          ? Pages::Normal
+          : Pages::Huge2MB;
+  auto const numa_node = numaNodeOf(data.get());
+  addBuffer(name, std::move(data), length,
+            Allocation{pages, numa_node, length});
 }
 
 void ControlBlock::registerMr(std::string const &name,
@@ -266,13 +588,13 @@ ControlBlock::MemoryRegion ControlBlock::mr(std::string const &name) const {
 //   }
 // }
 
-void ControlBlock::registerCq(std::string const &name) {
+void ControlBlock::registerCq(std::string const &name, int const depth) {
   if (cqs.find(name) != cqs.end()) {
     throw std::runtime_error("Already registered completion queue named " +
                              name);
   }
 
-  auto *cq = ibv_create_cq(resolved_port.device().context(), CqDepth, nullptr,
+  auto *cq = ibv_create_cq(resolved_port.device().context(), depth, nullptr,
                            nullptr, 0);
 
   if (cq == nullptr) {
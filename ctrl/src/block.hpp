@@ -4,6 +4,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -66,6 +67,40 @@ class ControlBlock {
   };
 #endif
 
+  /**
+   * Pages backing the buffers. Hugepages reduce the number of translations
+   * that the NIC has to cache (MTT/IOTLB) for large registered buffers.
+   *
+   * Buffers of less than half a (huge)page are packed into hugepages shared
+   * with the other small buffers of the same kind of pages. `Auto` stands for
+   * 2MiB hugepages.
+   **/
+  enum class Pages { Auto, Normal, TransparentHuge, Huge2MB, Huge1GB };
+
+  static int constexpr AnyNumaNode = -1;
+  static int constexpr NicNumaNode = -2;
+
+  struct AllocationPolicy {
+    Pages pages = Pages::Auto;
+    // A NUMA node, `AnyNumaNode` or `NicNumaNode` for the node of the NIC.
+    int numa_node = NicNumaNode;
+    // Whether to fall back to smaller pages when hugepages are unavailable.
+    bool fallback = true;
+  };
+
+  /**
+   * What a buffer actually got. `pages` is never `Auto` and `numa_node` is
+   * `AnyNumaNode` if the kernel could not tell.
+   **/
+  struct Allocation {
+    Pages pages;
+    int numa_node;
+    size_t length;
+  };
+
+  static char const *pagesStr(Pages pages);
+  static Pages pagesFromStr(std::string const &str);
+
   static int constexpr CqDepth = 512;
 
   ControlBlock(ResolvedPort &resolved_port);
@@ -74,7 +109,16 @@ class ControlBlock {
 
   deleted_unique_ptr<struct ibv_pd> &pd(std::string const &name);
 
+  /**
+   * Policy of the buffers allocated without an explicit one.
+   **/
+  void setAllocationPolicy(AllocationPolicy const &policy);
+  AllocationPolicy const &allocationPolicy() const { return default_policy; }
+
   void allocateBuffer(std::string const &name, size_t length, size_t alignment);
+  void allocateBuffer(std::string const &name, size_t length, size_t alignment,
+                      AllocationPolicy const &policy);
+  Allocation const &allocation(std::string const &name) const;
   void allocatePhysicallyLockedBuffer(
       std::string const &name, size_t length,
       memory::PhysicallyLockedBuffer::AllocationPool allocation_pool);
@@ -104,7 +148,7 @@ class ControlBlock {
   // void withdrawMrRight(std::string name) const;
   MemoryRegion mr(std::string const &name) const;
 
-  void registerCq(std::string const &name);
+  void registerCq(std::string const &name, int depth = CqDepth);
   deleted_unique_ptr<struct ibv_cq> &cq(std::string const &name);
 
   uint8_t port() const;
@@ -114,8 +158,25 @@ class ControlBlock {
                          std::vector<struct ibv_wc> &entries);
 
  private:
+  // Hugepages shared by the small buffers, per kind of pages requested.
+  struct Arena {
+    std::shared_ptr<uint8_t> chunk;
+    size_t used;
+    int numa_node;  // As requested.
+    Allocation allocation;
+  };
+
+  int resolveNumaNode(int numa_node);
+  void addBuffer(std::string const &name, std::shared_ptr<uint8_t> data,
+                 size_t length, Allocation const &allocation);
+
   ResolvedPort resolved_port;
 
+  AllocationPolicy default_policy;
+  std::optional<int> nic_numa_node;
+  std::map<Pages, std::optional<Arena>> arenas;
+  std::map<std::string, Allocation> allocations;
+
   std::map<std::string, deleted_unique_ptr<struct ibv_pd>> pds;
 
   // std::unique_ptr is semantically more suitable, but it is not polymorphic
@@ -0,0 +1,414 @@
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#include "internal/backend.hpp"
+
+namespace dory::memstore::internal {
+std::vector<std::string> Backend::addMany(KeyValues const &kvs) {
+  std::vector<std::string> keys;
+  keys.reserve(kvs.size());
+  for (auto const &[key, value] : kvs) {
+    keys.push_back(key);
+  }
+  std::vector<std::string> existing;
+  for (auto const &[key, value] : getMany(keys)) {
+    existing.push_back(key);
+  }
+  if (!existing.empty()) {
+    return existing;
+  }
+  for (auto const &[key, value] : kvs) {
+    if (!add(key, value)) {
+      existing.push_back(key);
+    }
+  }
+  return existing;
+}
+
+std::map<std::string, std::string> Backend::getMany(
+    std::vector<std::string> const &keys) {
+  std::map<std::string, std::string> found;
+  for (auto const &key : keys) {
+    if (auto value = get(key)) {
+      found.emplace(key, std::move(*value));
+    }
+  }
+  return found;
+}
+
+void Backend::await(std::chrono::nanoseconds const max) {
+  std::this_thread::sleep_for(max);
+}
+
+//// Memcached ////
+MemcachedBackend::MemcachedBackend(std::string const &ip, uint16_t const port)
+    : memc(memcached_create(nullptr), memcached_free) {
+  if (memc.get() == nullptr) {
+    throw std::runtime_error("Failed to create memcached handle");
+  }
+
+  memcached_return_t rc;
+
+  deleted_unique_ptr<memcached_server_st> servers(
+      memcached_server_list_append(nullptr, ip.c_str(), port, &rc),
+      memcached_server_list_free);
+
+  auto push_ret = memcached_server_push(memc.get(), servers.get());
+  if (push_ret != MEMCACHED_SUCCESS) {
+    throw std::runtime_error(
+        "Could not add memcached server in the MemoryStore: " +
+        error(push_ret));
+  }
+
+  rc =
+      memcached_behavior_set(memc.get(), MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, 1);
+
+  if (rc != MEMCACHED_SUCCESS) {
+    throw std::runtime_error("Could not switch to the binary protocol: " +
+                             error(rc));
+  }
+
+  // Registry operations are tiny: do not let Nagle delay them.
+  memcached_behavior_set(memc.get(), MEMCACHED_BEHAVIOR_TCP_NODELAY, 1);
+}
+
+bool MemcachedBackend::add(std::string const &key, std::string const &value) {
+  auto const rc =
+      memcached_add(memc.get(), key.c_str(), key.length(), value.c_str(),
+                    value.length(), static_cast<time_t>(0),
+                    static_cast<uint32_t>(0));
+  if (rc == MEMCACHED_SUCCESS) {
+    return true;
+  }
+  if (rc == MEMCACHED_NOTSTORED || rc == MEMCACHED_DATA_EXISTS) {
+    return false;
+  }
+  throw std::runtime_error("Failed to set to the store the (K, V) = (" + key +
+                           ", " + value + ") (" + error(rc) + ")");
+}
+
+std::vector<std::string> MemcachedBackend::addMany(KeyValues const &kvs) {
+  std::vector<std::string> keys;
+  keys.reserve(kvs.size());
+  for (auto const &[key, value] : kvs) {
+    keys.push_back(key);
+  }
+
+  std::vector<std::string> existing;
+  for (auto const &[key, value] : getMany(keys)) {
+    existing.push_back(key);
+  }
+  if (!existing.empty()) {
+    return existing;
+  }
+
+  // Pipeline the writes: buffered requests only hit the wire when flushed and
+  // do not wait for individual replies.
+  memcached_behavior_set(memc.get(), MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 1);
+  for (auto const &[key, value] : kvs) {
+    auto const rc =
+        memcached_add(memc.get(), key.c_str(), key.length(), value.c_str(),
+                      value.length(), static_cast<time_t>(0),
+                      static_cast<uint32_t>(0));
+    if (rc != MEMCACHED_SUCCESS && rc != MEMCACHED_BUFFERED) {
+      memcached_behavior_set(memc.get(), MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 0);
+      throw std::runtime_error("Failed to set to the store the K = " + key +
+                               " (" + error(rc) + ")");
+    }
+  }
+  auto const rc = memcached_flush_buffers(memc.get());
+  memcached_behavior_set(memc.get(), MEMCACHED_BEHAVIOR_BUFFER_REQUESTS, 0);
+  if (rc != MEMCACHED_SUCCESS) {
+    throw std::runtime_error("Failed to flush the writes to the store (" +
+                             error(rc) + ")");
+  }
+
+  // As buffered writes are not acknowledged, read them back. A mismatch means
+  // that another process added the same key concurrently.
+  auto const stored = getMany(keys);
+  for (auto const &[key, value] : kvs) {
+    auto const it = stored.find(key);
+    if (it == stored.end()) {
+      throw std::runtime_error("Failed to set to the store the K = " + key);
+    }
+    if (it->second != value) {
+      existing.push_back(key);
+    }
+  }
+  return existing;
+}
+
+std::optional<std::string> MemcachedBackend::get(std::string const &key) {
+  memcached_return_t rc;
+  size_t value_length;
+  uint32_t flags;
+
+  char *ret_value = memcached_get(memc.get(), key.c_str(), key.length(),
+                                  &value_length, &flags, &rc);
+  deleted_unique_ptr<char> ret_value_uniq(ret_value, free);
+
+  if (rc == MEMCACHED_SUCCESS) {
+    return std::string(ret_value, value_length);
+  }
+  if (rc == MEMCACHED_NOTFOUND) {
+    return std::nullopt;
+  }
+  throw std::runtime_error("Failed to get from the store the K = " + key +
+                           " (" + error(rc) + ")");
+}
+
+std::map<std::string, std::string> MemcachedBackend::getMany(
+    std::vector<std::string> const &keys) {
+  std::map<std::string, std::string> found;
+  if (keys.empty()) {
+    return found;
+  }
+
+  std::vector<char const *> raw_keys;
+  std::vector<size_t> lengths;
+  raw_keys.reserve(keys.size());
+  lengths.reserve(keys.size());
+  for (auto const &key : keys) {
+    raw_keys.push_back(key.c_str());
+    lengths.push_back(key.length());
+  }
+
+  auto rc =
+      memcached_mget(memc.get(), raw_keys.data(), lengths.data(), keys.size());
+  if (rc != MEMCACHED_SUCCESS) {
+    throw std::runtime_error("Failed to get " + std::to_string(keys.size()) +
+                             " keys from the store (" + error(rc) + ")");
+  }
+
+  while (true) {
+    deleted_unique_ptr<memcached_result_st> result(
+        memcached_fetch_result(memc.get(), nullptr, &rc),
+        memcached_result_free);
+    if (result == nullptr) {
+      break;
+    }
+    if (rc != MEMCACHED_SUCCESS) {
+      continue;
+    }
+    found.emplace(std::string(memcached_result_key_value(result.get()),
+                              memcached_result_key_length(result.get())),
+                  std::string(memcached_result_value(result.get()),
+                              memcached_result_length(result.get())));
+  }
+
+  if (rc != MEMCACHED_END && rc != MEMCACHED_SUCCESS &&
+      rc != MEMCACHED_NOTFOUND) {
+    throw std::runtime_error("Failed to get " + std::to_string(keys.size()) +
+                             " keys from the store (" + error(rc) + ")");
+  }
+  return found;
+}
+
+std::optional<uint64_t> MemcachedBackend::increment(std::string const &key,
+                                                    uint64_t const delta,
+                                                    uint64_t const initial) {
+  uint64_t ret_val = 0;
+  time_t const expiration_time = 0;
+
+  auto const rc = memcached_increment_with_initial(
+      memc.get(), key.c_str(), key.size(), delta, initial, expiration_time,
+      &ret_val);
+
+  if (rc == MEMCACHED_SUCCESS) {
+    return ret_val;
+  }
+  if (rc == MEMCACHED_NOTSTORED) {
+    return std::nullopt;
+  }
+  throw std::runtime_error("Failed to atomically increment: " + error(rc));
+}
+
+std::string MemcachedBackend::error(memcached_return_t const rc) const {
+  return std::string(memcached_strerror(memc.get(), rc));
+}
+
+//// File ////
+FileBackend::FileBackend(std::string const &directory) : directory{directory} {
+  if (::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+    throw std::runtime_error("Could not create the registry directory " +
+                             directory + ": " + std::strerror(errno));
+  }
+}
+
+bool FileBackend::add(std::string const &key, std::string const &value) {
+  static std::atomic<uint64_t> tmp_id{0};
+  auto const tmp = directory + "/.tmp-" + std::to_string(::getpid()) + "-" +
+                   std::to_string(tmp_id++);
+
+  auto const fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Could not create " + tmp + ": " +
+                             std::strerror(errno));
+  }
+  auto const written = ::write(fd, value.data(), value.size());
+  ::close(fd);
+  if (written != static_cast<ssize_t>(value.size())) {
+    ::unlink(tmp.c_str());
+    throw std::runtime_error("Could not write " + tmp);
+  }
+
+  // Linking publishes the complete value atomically and fails if the key
+  // already exists.
+  auto const linked = ::link(tmp.c_str(), path(key).c_str());
+  auto const link_errno = errno;
+  ::unlink(tmp.c_str());
+  if (linked == 0) {
+    return true;
+  }
+  if (link_errno == EEXIST) {
+    return false;
+  }
+  throw std::runtime_error("Could not store the K = " + key + ": " +
+                           std::strerror(link_errno));
+}
+
+std::optional<std::string> FileBackend::get(std::string const &key) {
+  auto const fd = ::open(path(key).c_str(), O_RDONLY);
+  if (fd < 0) {
+    if (errno == ENOENT) {
+      return std::nullopt;
+    }
+    throw std::runtime_error("Failed to get from the store the K = " + key +
+                             " (" + std::strerror(errno) + ")");
+  }
+  std::string value;
+  char buf[4096];
+  ssize_t n;
+  while ((n = ::read(fd, buf, sizeof(buf))) > 0) {
+    value.append(buf, static_cast<size_t>(n));
+  }
+  ::close(fd);
+  if (n < 0) {
+    throw std::runtime_error("Failed to read from the store the K = " + key);
+  }
+  return value;
+}
+
+std::optional<uint64_t> FileBackend::increment(std::string const &key,
+                                               uint64_t const delta,
+                                               uint64_t const initial) {
+  auto const fd = ::open(path(key).c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0 || ::flock(fd, LOCK_EX) != 0) {
+    auto const err = errno;
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    throw std::runtime_error("Failed to atomically increment: " +
+                             std::string(std::strerror(err)));
+  }
+
+  char buf[32];
+  auto const n = ::pread(fd, buf, sizeof(buf) - 1, 0);
+  uint64_t value = initial;
+  if (n > 0) {
+    buf[n] = '\0';
+    value = std::stoull(buf) + delta;
+  }
+  auto const str = std::to_string(value);
+  auto const ok = ::pwrite(fd, str.data(), str.size(), 0) ==
+                      static_cast<ssize_t>(str.size()) &&
+                  ::ftruncate(fd, static_cast<off_t>(str.size())) == 0;
+  ::close(fd);  // Releases the lock.
+  if (!ok) {
+    throw std::runtime_error("Failed to atomically increment " + key);
+  }
+  return value;
+}
+
+std::string FileBackend::path(std::string const &key) const {
+  // Escape whatever could be interpreted by the filesystem.
+  static char constexpr Hex[] = "0123456789abcdef";
+  std::string escaped;
+  escaped.reserve(key.size());
+  for (auto const c : key) {
+    auto const u = static_cast<unsigned char>(c);
+    if (std::isalnum(u) || c == '-' || c == '_' || c == '(' || c == ')' ||
+        c == ':' || (c == '.' && !escaped.empty())) {
+      escaped.push_back(c);
+    } else {
+      escaped.push_back('%');
+      escaped.push_back(Hex[u >> 4]);
+      escaped.push_back(Hex[u & 0xf]);
+    }
+  }
+  return directory + "/" + escaped;
+}
+
+//// Local ////
+namespace {
+struct LocalState {
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::unordered_map<std::string, std::string> kvs;
+};
+
+LocalState &localState() {
+  static LocalState state;
+  return state;
+}
+}  // namespace
+
+bool LocalBackend::add(std::string const &key, std::string const &value) {
+  auto &state = localState();
+  {
+    std::scoped_lock lock(state.mutex);
+    if (!state.kvs.emplace(key, value).second) {
+      return false;
+    }
+  }
+  state.changed.notify_all();
+  return true;
+}
+
+std::optional<std::string> LocalBackend::get(std::string const &key) {
+  auto &state = localState();
+  std::scoped_lock lock(state.mutex);
+  auto const it = state.kvs.find(key);
+  if (it == state.kvs.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+std::optional<uint64_t> LocalBackend::increment(std::string const &key,
+                                                uint64_t const delta,
+                                                uint64_t const initial) {
+  auto &state = localState();
+  uint64_t value = initial;
+  {
+    std::scoped_lock lock(state.mutex);
+    auto [it, inserted] = state.kvs.try_emplace(key, std::to_string(initial));
+    if (!inserted) {
+      value = std::stoull(it->second) + delta;
+      it->second = std::to_string(value);
+    }
+  }
+  if (delta != 0) {
+    state.changed.notify_all();
+  }
+  return value;
+}
+
+void LocalBackend::await(std::chrono::nanoseconds const max) {
+  auto &state = localState();
+  std::unique_lock lock(state.mutex);
+  state.changed.wait_for(lock, max);
+}
+}  // namespace dory::memstore::internal
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <dory/extern/memcached.hpp>
+#include <dory/shared/pointer-wrapper.hpp>
+
+namespace dory::memstore::internal {
+/**
+ * Storage behind the MemoryStore. Keys are only ever added, never modified,
+ * except for counters which are atomically incremented.
+ */
+class Backend {
+ public:
+  using KeyValues = std::vector<std::pair<std::string, std::string>>;
+
+  virtual ~Backend() = default;
+
+  /**
+   * Stores `value` under `key` unless `key` already exists.
+   * @return false if `key` already existed
+   * @throw `runtime_error`
+   */
+  virtual bool add(std::string const &key, std::string const &value) = 0;
+
+  /**
+   * Stores all the (K, V) pairs, unless one of the keys already exists.
+   * @return the keys that already existed, in which case nothing is stored
+   * @throw `runtime_error`
+   */
+  virtual std::vector<std::string> addMany(KeyValues const &kvs);
+
+  /**
+   * @return the value stored under `key`, if any
+   * @throw `runtime_error`
+   */
+  virtual std::optional<std::string> get(std::string const &key) = 0;
+
+  /**
+   * @return the (K, V) pairs of the `keys` that exist
+   * @throw `runtime_error`
+   */
+  virtual std::map<std::string, std::string> getMany(
+      std::vector<std::string> const &keys);
+
+  /**
+   * Atomically adds `delta` to the counter `key`, which is created with
+   * `initial` if it does not exist.
+   * @return the new value of the counter, or nothing if the operation should
+   *         be retried
+   * @throw `runtime_error`
+   */
+  virtual std::optional<uint64_t> increment(std::string const &key,
+                                            uint64_t delta,
+                                            uint64_t initial) = 0;
+
+  /**
+   * Waits for at most `max`, or less if the backend can tell that a key
+   * changed in the meantime.
+   */
+  virtual void await(std::chrono::nanoseconds max);
+};
+
+/**
+ * Registry shared by all hosts through a memcached server.
+ */
+class MemcachedBackend : public Backend {
+ public:
+  MemcachedBackend(std::string const &ip, uint16_t port);
+
+  bool add(std::string const &key, std::string const &value) override;
+  std::vector<std::string> addMany(KeyValues const &kvs) override;
+  std::optional<std::string> get(std::string const &key) override;
+  std::map<std::string, std::string> getMany(
+      std::vector<std::string> const &keys) override;
+  std::optional<uint64_t> increment(std::string const &key, uint64_t delta,
+                                    uint64_t initial) override;
+
+ private:
+  std::string error(memcached_return_t rc) const;
+
+  deleted_unique_ptr<memcached_st> memc;
+};
+
+/**
+ * Registry shared by the processes of a single host through a directory (e.g.,
+ * in /dev/shm), with one file per key.
+ */
+class FileBackend : public Backend {
+ public:
+  FileBackend(std::string const &directory);
+
+  bool add(std::string const &key, std::string const &value) override;
+  std::optional<std::string> get(std::string const &key) override;
+  std::optional<uint64_t> increment(std::string const &key, uint64_t delta,
+                                    uint64_t initial) override;
+
+ private:
+  std::string path(std::string const &key) const;
+
+  std::string directory;
+};
+
+/**
+ * Registry shared by the threads of the process, e.g., to run tests in a
+ * single process. All the instances share the same keys.
+ */
+class LocalBackend : public Backend {
+ public:
+  bool add(std::string const &key, std::string const &value) override;
+  std::optional<std::string> get(std::string const &key) override;
+  std::optional<uint64_t> increment(std::string const &key, uint64_t delta,
+                                    uint64_t initial) override;
+  void await(std::chrono::nanoseconds max) override;
+};
+}  // namespace dory::memstore::internal
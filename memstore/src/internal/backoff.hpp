@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "backend.hpp"
+
+namespace dory::memstore::internal {
+/**
+ * Paces the polling of the registry: the first polls are issued back to back,
+ * as peers usually show up within a few round trips, then the delay between
+ * polls doubles up to `max`.
+ */
+class Backoff {
+ public:
+  Backoff(std::chrono::nanoseconds const min = std::chrono::microseconds(50),
+          std::chrono::nanoseconds const max = std::chrono::milliseconds(5))
+      : delay{min}, max{max} {}
+
+  void wait(Backend &backend) {
+    if (spins < Spins) {
+      spins++;
+      std::this_thread::yield();
+      return;
+    }
+    backend.await(delay);
+    delay = std::min(delay * 2, max);
+  }
+
+ private:
+  static unsigned constexpr Spins = 8;
+
+  unsigned spins = 0;
+  std::chrono::nanoseconds delay;
+  std::chrono::nanoseconds const max;
+};
+}  // namespace dory::memstore::internal
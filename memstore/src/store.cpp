@@ -4,36 +4,11 @@
 #include <stdexcept>
 #include <thread>
 
+#include "internal/backoff.hpp"
 #include "store.hpp"
 
 namespace dory::memstore {
-MemoryStore::MemoryStore() : memc(memcached_create(nullptr), memcached_free) {
-  if (memc.get() == nullptr) {
-    throw std::runtime_error("Failed to create memcached handle");
-  }
-
-  auto [ip, port] = ipPortFromEnvVar(RegIPName);
-  memcached_return_t rc;
-
-  deleted_unique_ptr<memcached_server_st> servers(
-      memcached_server_list_append(nullptr, ip.c_str(), port, &rc),
-      memcached_server_list_free);
-
-  auto push_ret = memcached_server_push(memc.get(), servers.get());
-  if (push_ret != MEMCACHED_SUCCESS) {
-    throw std::runtime_error(
-        "Could not add memcached server in the MemoryStore: " +
-        std::string(memcached_strerror(memc.get(), push_ret)));
-  }
-
-  rc =
-      memcached_behavior_set(memc.get(), MEMCACHED_BEHAVIOR_BINARY_PROTOCOL, 1);
-
-  if (rc != MEMCACHED_SUCCESS) {
-    throw std::runtime_error("Could not switch to the binary protocol: " +
-                             std::string(memcached_strerror(memc.get(), rc)));
-  }
-}
+MemoryStore::MemoryStore() : backend{backendFromEnv()} {}
 
 MemoryStore::MemoryStore(std::string const &prefix_) : MemoryStore() {
   prefix = prefix_;
@@ -44,24 +19,41 @@ void MemoryStore::set(std::string const &key, std::string const &value) {
     throw std::runtime_error("Empty key or value");
   }
 
-  // Check if key already exists. This error indicates a potential for naming
-  // collision when announcing RDMA resources.
-  std::string dummy;
-  if (get(key, dummy)) {
+  if (batching) {
+    // Check if key already exists in the batch. The store is checked for all
+    // the keys at once when the batch is committed.
+    if (!batch_index.try_emplace(key, batch.size()).second) {
+      throw std::runtime_error("Trying to set key `" + key +
+                               "` that already exists");
+    }
+    batch.emplace_back(key, value);
+    return;
+  }
+
+  // Adding fails if the key already exists. This error indicates a potential
+  // for naming collision when announcing RDMA resources.
+  if (!backend->add(prefix + key, value)) {
     throw std::runtime_error("Trying to set key `" + key +
                              "` that already exists");
   }
+}
 
-  memcached_return_t rc;
-  std::string prefixed_key = prefix + key;
-  rc = memcached_set(memc.get(), prefixed_key.c_str(), prefixed_key.length(),
-                     value.c_str(), value.length(), static_cast<time_t>(0),
-                     static_cast<uint32_t>(0));
+void MemoryStore::setMany(
+    std::vector<std::pair<std::string, std::string>> const &kvs) {
+  internal::Backend::KeyValues prefixed;
+  prefixed.reserve(kvs.size());
+  for (auto const &[key, value] : kvs) {
+    if (key.length() == 0 || value.length() == 0) {
+      throw std::runtime_error("Empty key or value");
+    }
+    prefixed.emplace_back(prefix + key, value);
+  }
 
-  if (rc != MEMCACHED_SUCCESS) {
-    throw std::runtime_error(
-        "Failed to set to the store the (K, V) = (" + key + ", " + value +
-        ") (" + std::string(memcached_strerror(memc.get(), rc)) + ")");
+  auto const existing = backend->addMany(prefixed);
+  if (!existing.empty()) {
+    throw std::runtime_error("Trying to set key `" +
+                             existing.front().substr(prefix.length()) +
+                             "` that already exists");
   }
 }
 
@@ -70,57 +62,133 @@ bool MemoryStore::get(std::string const &key, std::string &value) {
     throw std::runtime_error("Empty key");
   }
 
-  memcached_return_t rc;
-  size_t value_length;
-  uint32_t flags;
-
-  std::string prefixed_key = prefix + key;
-  char *ret_value =
-      memcached_get(memc.get(), prefixed_key.c_str(), prefixed_key.length(),
-                    &value_length, &flags, &rc);
-  deleted_unique_ptr<char> ret_value_uniq(ret_value, free);
+  if (batching) {
+    auto const it = batch_index.find(key);
+    if (it != batch_index.end()) {
+      value += batch[it->second].second;
+      return true;
+    }
+  }
 
-  if (rc == MEMCACHED_SUCCESS) {
-    std::string ret(ret_value, value_length);
-    value += ret;
+  auto cached = cache.find(key);
+  if (cached == cache.end() && prefetching.count(key) != 0) {
+    getMany({});
+    cached = cache.find(key);
+  }
+  if (cached != cache.end()) {
+    value += cached->second;
     return true;
   }
-  if (rc == MEMCACHED_NOTFOUND) {
+
+  auto ret = backend->get(prefix + key);
+  if (!ret) {
     return false;
   }
-  throw std::runtime_error(
-      "Failed to get from the store the K = " + key + " (" +
-      std::string(memcached_strerror(memc.get(), rc)) + ")");
-  // Never reached
-  return false;
+  value += *ret;
+  return true;
+}
+
+std::map<std::string, std::string> MemoryStore::getMany(
+    std::vector<std::string> const &keys) {
+  // Piggyback the prefetched keys on the request.
+  std::vector<std::string> prefixed;
+  prefixed.reserve(keys.size() + prefetching.size());
+  for (auto const &key : keys) {
+    if (key.length() == 0) {
+      throw std::runtime_error("Empty key");
+    }
+    if (cache.find(key) == cache.end()) {
+      prefixed.push_back(prefix + key);
+    }
+  }
+  for (auto const &key : prefetching) {
+    prefixed.push_back(prefix + key);
+  }
+
+  for (auto &[key, value] : backend->getMany(prefixed)) {
+    auto unprefixed = key.substr(prefix.length());
+    prefetching.erase(unprefixed);
+    cache.emplace(std::move(unprefixed), std::move(value));
+  }
+
+  std::map<std::string, std::string> found;
+  for (auto const &key : keys) {
+    auto const it = cache.find(key);
+    if (it != cache.end()) {
+      found.emplace(key, it->second);
+    }
+  }
+  return found;
+}
+
+std::map<std::string, std::string> MemoryStore::waitForAll(
+    std::vector<std::string> const &keys) {
+  internal::Backoff backoff;
+  while (true) {
+    auto found = getMany(keys);
+    if (found.size() == keys.size()) {
+      return found;
+    }
+    backoff.wait(*backend);
+  }
+}
+
+void MemoryStore::prefetch(std::string const &key) {
+  if (cache.find(key) == cache.end()) {
+    prefetching.insert(key);
+  }
+}
+
+void MemoryStore::beginBatch() {
+  if (batching) {
+    throw std::logic_error("A batch is already ongoing");
+  }
+  batching = true;
+}
+
+void MemoryStore::commitBatch() {
+  if (!batching) {
+    throw std::logic_error("No ongoing batch to commit");
+  }
+  flushBatch();
+  batching = false;
+}
+
+void MemoryStore::flushBatch() {
+  if (batch.empty()) {
+    return;
+  }
+  // The pending writes are dropped even if they fail, as retrying them would
+  // fail again.
+  auto const pending = std::move(batch);
+  batch.clear();
+  batch_index.clear();
+  setMany(pending);
 }
 
 void MemoryStore::barrier(std::string const &key, size_t const wait_for) {
+  // Peers that pass the barrier expect our writes to be visible.
+  flushBatch();
+
   uint64_t ret_val = 0;
 
   uint64_t const initial_val = 1;
   uint64_t incr_val = 1;
-  time_t const expiration_time = 0;
+  internal::Backoff backoff;
 
   while (ret_val < wait_for) {
-    auto const rc = memcached_increment_with_initial(
-        memc.get(), key.c_str(), key.size(), incr_val, initial_val,
-        expiration_time, &ret_val);
-
-    if (rc != MEMCACHED_SUCCESS) {
-      if (rc == MEMCACHED_NOTSTORED) {
-        std::this_thread::sleep_for(RetryTime);
-        continue;
-      }
-
-      throw std::runtime_error("Failed to atomically increment: " +
-                               std::string(memcached_strerror(memc.get(), rc)));
+    auto const ret = backend->increment(key, incr_val, initial_val);
+
+    if (!ret) {
+      backoff.wait(*backend);
+      continue;
     }
 
+    ret_val = *ret;
     incr_val = 0;
 
     if (ret_val != wait_for) {
-      std::this_thread::sleep_for(RetryTime);
+      backoff.wait(*backend);
     }
   }
 
@@ -132,6 +200,25 @@ void MemoryStore::barrier(std::string const &key, size_t const wait_for) {
   }
 }
 
+std::unique_ptr<internal::Backend> MemoryStore::backendFromEnv() {
+  char const *kind = getenv(RegBackendName);
+  if (kind == nullptr || std::strcmp(kind, "memcached") == 0) {
+    auto [ip, port] = ipPortFromEnvVar(RegIPName);
+    return std::make_unique<internal::MemcachedBackend>(ip, port);
+  }
+  if (std::strcmp(kind, "file") == 0) {
+    char const *dir = getenv(RegDirName);
+    return std::make_unique<internal::FileBackend>(
+        dir != nullptr ? dir : DefaultRegDir);
+  }
+  if (std::strcmp(kind, "local") == 0) {
+    return std::make_unique<internal::LocalBackend>();
+  }
+  throw std::runtime_error("Environment variable " +
+                           std::string(RegBackendName) +
+                           " should be one of memcached, file or local");
+}
+
 std::pair<std::string, uint16_t> MemoryStore::ipPortFromEnvVar(
     char const *const name) {
   char const *env = getenv(name);
@@ -2,17 +2,25 @@
 
 #include <chrono>
 #include <cstdint>
-#include <dory/extern/memcached.hpp>
-#include <dory/shared/pointer-wrapper.hpp>
 #include <functional>
+#include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
+
+#include "internal/backend.hpp"
 
 namespace dory::memstore {
 /**
  * This class acts as a central public registry for all processes.
  * It provides a lazy initialized singleton instance.
+ *
+ * The registry is a memcached server unless `DORY_REGISTRY_BACKEND` selects
+ * a single-host backend: `file` (a directory shared by the processes of the
+ * host, `DORY_REGISTRY_DIR`) or `local` (the threads of the process).
  */
 class MemoryStore {
  public:
@@ -30,12 +38,22 @@ class MemoryStore {
 
   /**
    * Stores the provided string `value` under `key`.
+   * Within a batch, the write is deferred until the batch is committed.
    * @param key
    * @param value
    * @throw `runtime_error`
    */
   void set(std::string const &key, std::string const &value);
 
+  /**
+   * Stores all the provided (K, V) pairs using a constant number of round
+   * trips.
+   * @param kvs
+   * @throw `runtime_error` if a key already exists, in which case no pair is
+   *        stored
+   */
+  void setMany(std::vector<std::pair<std::string, std::string>> const &kvs);
+
   /**
    * Gets the value associated with `key` and appends it to `value`.
    * @param key
@@ -45,10 +63,49 @@ class MemoryStore {
    */
   bool get(std::string const &key, std::string &value);
 
+  /**
+   * Gets the values associated with `keys` in a single round trip.
+   * @param keys
+   * @return the (K, V) pairs of the keys that exist
+   * @throw `runtime_error`
+   */
+  std::map<std::string, std::string> getMany(
+      std::vector<std::string> const &keys);
+
+  /**
+   * Waits for all the `keys` to exist, polling them together.
+   * @param keys
+   * @return the (K, V) pairs of all the keys
+   * @throw `runtime_error`
+   */
+  std::map<std::string, std::string> waitForAll(
+      std::vector<std::string> const &keys);
+
+  /**
+   * Hints that `key` will be read. The next `get` that misses fetches all the
+   * hinted keys at once, so that a sequence of `get`s costs a single round
+   * trip once their keys exist.
+   * @param key
+   */
+  void prefetch(std::string const &key);
+
+  /**
+   * Defers the subsequent `set`s until `commitBatch`, which stores them with
+   * `setMany`. Barriers commit the pending writes before entering.
+   */
+  void beginBatch();
+
+  /**
+   * Stores the writes deferred since `beginBatch` and stops batching.
+   * @throw `runtime_error`
+   */
+  void commitBatch();
+
   /**
    * Atomically increments a value and waits for it to reach `wait_for` before
    * returning. If the key does not exist, it is automatically created and it is
-   * set to 0.
+   * set to 0. The counter is polled back to back first, then with an
+   * exponential backoff.
    * @param key
    * @param wait_for
    * @throw `runtime_error`
@@ -58,13 +115,26 @@ class MemoryStore {
  private:
   MemoryStore();
 
+  void flushBatch();
+
+  static std::unique_ptr<internal::Backend> backendFromEnv();
   static std::pair<std::string, uint16_t> ipPortFromEnvVar(char const *name);
   static auto constexpr RegIPName = "DORY_REGISTRY_IP";
+  static auto constexpr RegBackendName = "DORY_REGISTRY_BACKEND";
+  static auto constexpr RegDirName = "DORY_REGISTRY_DIR";
+  static auto constexpr DefaultRegDir = "/dev/shm/dory-registry";
   static auto constexpr MemcacheDDefaultPort = MEMCACHED_DEFAULT_PORT;  // 11211
-  static auto constexpr RetryTime = std::chrono::milliseconds(20);
 
-  deleted_unique_ptr<memcached_st> memc;
+  std::unique_ptr<internal::Backend> backend;
   std::string prefix;
+
+  // Keys are never modified once set, so values can be cached.
+  std::unordered_map<std::string, std::string> cache;
+  std::unordered_set<std::string> prefetching;
+
+  bool batching = false;
+  std::vector<std::pair<std::string, std::string>> batch;
+  std::unordered_map<std::string, size_t> batch_index;
 };
 }  // namespace dory::memstore
 
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dory/memstore/internal/backend.hpp>
+#include <dory/memstore/store.hpp>
+
+using dory::memstore::MemoryStore;
+
+// All the stores of the process share the in-memory registry of the local
+// backend. Each test uses its own prefix (and barrier keys) to be independent.
+class LocalStoreTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    setenv("DORY_REGISTRY_BACKEND", "local", 1);
+  }
+
+  static std::string prefix() {
+    auto const *const test =
+        ::testing::UnitTest::GetInstance()->current_test_info();
+    return std::string(test->name()) + "-";
+  }
+};
+
+TEST_F(LocalStoreTest, AddOnly) {
+  MemoryStore store(prefix());
+  std::string value;
+  EXPECT_FALSE(store.get("key", value));
+
+  store.set("key", "first");
+  EXPECT_THROW(store.set("key", "second"), std::runtime_error);
+  EXPECT_TRUE(store.get("key", value));
+  EXPECT_EQ(value, "first");
+
+  // Stores of the same prefix share their keys.
+  MemoryStore other(prefix());
+  value.clear();
+  EXPECT_TRUE(other.get("key", value));
+  EXPECT_EQ(value, "first");
+
+  // Nothing is stored if any of the keys already exists.
+  EXPECT_THROW(store.setMany({{"new", "value"}, {"key", "third"}}),
+               std::runtime_error);
+  EXPECT_FALSE(store.get("new", value));
+  store.setMany({{"new", "value"}, {"other", "value"}});
+  EXPECT_EQ(store.getMany({"new", "other", "missing"}),
+            (std::map<std::string, std::string>{{"new", "value"},
+                                                 {"other", "value"}}));
+
+  EXPECT_THROW(store.set("", "value"), std::runtime_error);
+  EXPECT_THROW(store.set("empty", ""), std::runtime_error);
+}
+
+TEST_F(LocalStoreTest, AwaitWakesUpOnAdd) {
+  dory::memstore::internal::LocalBackend backend;
+  auto const start = std::chrono::steady_clock::now();
+  auto waiter = std::async(std::launch::async, [&backend] {
+    backend.await(std::chrono::seconds(30));
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  backend.add(prefix() + "key", "value");
+  waiter.get();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST_F(LocalStoreTest, WaitForAll) {
+  // MemoryStore is not thread-safe: each thread has its own.
+  auto waiter = std::async(std::launch::async, [] {
+    MemoryStore store(prefix());
+    return store.waitForAll({"a", "b"});
+  });
+  MemoryStore store(prefix());
+  store.set("a", "1");
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(waiter.wait_for(std::chrono::milliseconds(0)),
+            std::future_status::timeout);
+  store.set("b", "2");
+  ASSERT_EQ(waiter.wait_for(std::chrono::seconds(5)),
+            std::future_status::ready);
+  EXPECT_EQ(waiter.get(), (std::map<std::string, std::string>{{"a", "1"},
+                                                                {"b", "2"}}));
+}
+
+TEST_F(LocalStoreTest, Batch) {
+  MemoryStore store(prefix());
+  MemoryStore other(prefix());
+  EXPECT_THROW(store.commitBatch(), std::logic_error);
+
+  store.beginBatch();
+  EXPECT_THROW(store.beginBatch(), std::logic_error);
+  store.set("key", "value");
+  EXPECT_THROW(store.set("key", "again"), std::runtime_error);
+
+  // Pending writes are visible to their store only.
+  std::string value;
+  EXPECT_TRUE(store.get("key", value));
+  EXPECT_EQ(value, "value");
+  EXPECT_FALSE(other.get("key", value));
+
+  store.commitBatch();
+  value.clear();
+  EXPECT_TRUE(other.get("key", value));
+  EXPECT_EQ(value, "value");
+}
+
+TEST_F(LocalStoreTest, BatchAcrossBarrier) {
+  size_t constexpr Parties = 4;
+  auto const barrier = prefix() + "barrier";
+  std::vector<std::future<std::map<std::string, std::string>>> parties;
+  for (size_t i = 0; i < Parties; i++) {
+    parties.push_back(std::async(std::launch::async, [i, &barrier] {
+      MemoryStore store(prefix());
+      store.beginBatch();
+      store.set(std::to_string(i), std::to_string(i));
+      // The barrier commits the batch: once past it, all the writes of the
+      // parties are visible without waiting.
+      store.barrier(barrier, Parties);
+      std::map<std::string, std::string> seen;
+      for (size_t j = 0; j < Parties; j++) {
+        std::string value;
+        if (store.get(std::to_string(j), value)) {
+          seen.emplace(std::to_string(j), value);
+        }
+      }
+      store.commitBatch();
+      return seen;
+    }));
+  }
+  for (auto &party : parties) {
+    auto const seen = party.get();
+    EXPECT_EQ(seen.size(), Parties);
+    for (auto const &[key, value] : seen) {
+      EXPECT_EQ(key, value);
+    }
+  }
+}
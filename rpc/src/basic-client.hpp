@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <cerrno>
+#include <climits>
 #include <cstring>
 #include <string>
 #include <utility>
@@ -7,6 +10,7 @@
 
 #include <arpa/inet.h>   //inet_addr
 #include <sys/socket.h>  //socket
+#include <sys/uio.h>     //writev
 #include <unistd.h>
 
 #include <dory/shared/move-indicator.hpp>
@@ -58,6 +62,52 @@ class RpcBasicClient {
     return !(ret >= 0 && ret != static_cast<ssize_t>(len));
   }
 
+  /**
+   * @brief Send all the buffers described by `iov` with as few syscalls as
+   *        possible. `iov` is consumed in the process.
+   *
+   * @return false on error.
+   */
+  bool sendv(struct iovec *iov, size_t iovcnt) const {
+    while (iovcnt > 0) {
+      auto const batch = static_cast<int>(std::min<size_t>(iovcnt, IOV_MAX));
+      auto ret = ::writev(sock, iov, batch);
+      if (ret < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        perror("Writev failed : ");
+        return false;
+      }
+      // Skip what was fully sent and adjust the partially sent buffer.
+      auto sent = static_cast<size_t>(ret);
+      while (iovcnt > 0 && sent >= iov->iov_len) {
+        sent -= iov->iov_len;
+        iov++;
+        iovcnt--;
+      }
+      if (iovcnt > 0) {
+        iov->iov_base = static_cast<char *>(iov->iov_base) + sent;
+        iov->iov_len -= sent;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Receive at most `len` bytes into `buf`, blocking until some are
+   *        available.
+   *
+   * @return the number of bytes received, or -1 on error or disconnection.
+   */
+  ssize_t recvInto(void *buf, size_t len) const {
+    ssize_t ret;
+    do {
+      ret = ::recv(sock, buf, len, 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret > 0 ? ret : -1;
+  }
+
   std::vector<char> recv(size_t len = 512) const {
     std::vector<char> buf(len);
     buf.reserve(len);
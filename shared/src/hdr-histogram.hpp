@@ -0,0 +1,523 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+
+namespace dory {
+
+/**
+ * @brief A High Dynamic Range histogram of non-negative integer values (e.g.,
+ *        latencies in nanoseconds).
+ *
+ * Values in [lowest, highest] are recorded with `significant_figures` decimal
+ * digits of precision, using the bucket layout of HdrHistogram (Gil Tene):
+ * buckets double in size, and each is split into the same number of linear
+ * sub-buckets. Values above `highest` are clamped and counted as overflows.
+ *
+ * Recording is wait-free for a single recording thread: counters are atomics
+ * that are only loaded and stored (no read-modify-write), so that other threads
+ * can read, merge or serialize the histogram while it is being recorded into.
+ * Use one histogram per recording thread and merge them.
+ *
+ * Histograms of the same layout can be merged, including across processes
+ * thanks to their compact binary serialization.
+ */
+class HdrHistogram {
+ public:
+  HdrHistogram(uint64_t const lowest, uint64_t const highest,
+               int const significant_figures)
+      : lowest{lowest},
+        highest{highest},
+        significant_figures{significant_figures} {
+    if (lowest < 1 || highest < 2 * lowest) {
+      throw std::invalid_argument(fmt::format(
+          "Invalid HDR range [{}, {}]: lowest must be >= 1 and highest >= "
+          "2 * lowest.",
+          lowest, highest));
+    }
+    if (significant_figures < 1 || significant_figures > 5) {
+      throw std::invalid_argument(
+          "HDR histograms support 1 to 5 significant figures.");
+    }
+
+    uint64_t const largest_single_unit =
+        2 * static_cast<uint64_t>(std::pow(10, significant_figures));
+    auto const sub_bucket_count_magnitude = static_cast<int>(
+        std::ceil(std::log2(static_cast<double>(largest_single_unit))));
+    sub_bucket_half_count_magnitude =
+        std::max(sub_bucket_count_magnitude, 1) - 1;
+    unit_magnitude = static_cast<int>(std::floor(std::log2(lowest)));
+    sub_bucket_count = int64_t(1) << (sub_bucket_half_count_magnitude + 1);
+    sub_bucket_half_count = sub_bucket_count / 2;
+    sub_bucket_mask = (static_cast<uint64_t>(sub_bucket_count) - 1)
+                      << unit_magnitude;
+
+    // Number of buckets needed to cover `highest`.
+    auto smallest_untrackable = static_cast<uint64_t>(sub_bucket_count)
+                                << unit_magnitude;
+    int buckets = 1;
+    while (smallest_untrackable <= highest) {
+      if (smallest_untrackable > std::numeric_limits<uint64_t>::max() / 2) {
+        buckets++;
+        break;
+      }
+      smallest_untrackable <<= 1;
+      buckets++;
+    }
+    bucket_count = buckets;
+    counts_len = static_cast<size_t>((bucket_count + 1) *
+                                     (sub_bucket_count / 2));
+    counts = std::make_unique<std::atomic<uint64_t>[]>(counts_len);
+    reset();
+  }
+
+  HdrHistogram(HdrHistogram const &other)
+      : HdrHistogram(other.lowest, other.highest, other.significant_figures) {
+    merge(other);
+  }
+
+  HdrHistogram &operator=(HdrHistogram const &other) {
+    if (this != &other) {
+      requireSameLayout(other);
+      reset();
+      merge(other);
+    }
+    return *this;
+  }
+
+  /**
+   * @brief Steal the counts of another histogram, which is left empty (and
+   *        unusable but to be assigned to). Must not race with recordings
+   *        into either histogram.
+   */
+  HdrHistogram(HdrHistogram &&other) noexcept
+      : lowest{other.lowest},
+        highest{other.highest},
+        significant_figures{other.significant_figures},
+        unit_magnitude{other.unit_magnitude},
+        sub_bucket_half_count_magnitude{other.sub_bucket_half_count_magnitude},
+        sub_bucket_count{other.sub_bucket_count},
+        sub_bucket_half_count{other.sub_bucket_half_count},
+        sub_bucket_mask{other.sub_bucket_mask},
+        bucket_count{other.bucket_count},
+        counts_len{other.counts_len},
+        counts{std::move(other.counts)},
+        total{other.total.load(std::memory_order_relaxed)},
+        overflows{other.overflows.load(std::memory_order_relaxed)},
+        sum{other.sum.load(std::memory_order_relaxed)},
+        min{other.min.load(std::memory_order_relaxed)},
+        max{other.max.load(std::memory_order_relaxed)} {
+    other.counts_len = 0;
+    other.reset();
+  }
+
+  HdrHistogram &operator=(HdrHistogram &&other) noexcept {
+    if (this != &other) {
+      lowest = other.lowest;
+      highest = other.highest;
+      significant_figures = other.significant_figures;
+      unit_magnitude = other.unit_magnitude;
+      sub_bucket_half_count_magnitude = other.sub_bucket_half_count_magnitude;
+      sub_bucket_count = other.sub_bucket_count;
+      sub_bucket_half_count = other.sub_bucket_half_count;
+      sub_bucket_mask = other.sub_bucket_mask;
+      bucket_count = other.bucket_count;
+      counts_len = other.counts_len;
+      counts = std::move(other.counts);
+      total.store(other.total.load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+      overflows.store(other.overflows.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+      sum.store(other.sum.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+      min.store(other.min.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+      max.store(other.max.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+      other.counts_len = 0;
+      other.reset();
+    }
+    return *this;
+  }
+
+  /**
+   * @brief Record a value. Must only be called by a single thread at a time.
+   */
+  inline void record(uint64_t value, uint64_t const count = 1) {
+    if (value > highest) {
+      value = highest;
+      bump(overflows, count);
+    }
+    bump(counts[countsIndexFor(value)], count);
+    bump(total, count);
+    if (value < min.load(std::memory_order_relaxed)) {
+      min.store(value, std::memory_order_relaxed);
+    }
+    if (value > max.load(std::memory_order_relaxed)) {
+      max.store(value, std::memory_order_relaxed);
+    }
+    bump(sum, value * count);
+  }
+
+  void reset() {
+    for (size_t i = 0; i < counts_len; i++) {
+      counts[i].store(0, std::memory_order_relaxed);
+    }
+    total.store(0, std::memory_order_relaxed);
+    overflows.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Add the values of another histogram of the same layout. Must not
+   *        race with recordings into this histogram.
+   */
+  void merge(HdrHistogram const &other) {
+    requireSameLayout(other);
+    for (size_t i = 0; i < counts_len; i++) {
+      bump(counts[i], other.counts[i].load(std::memory_order_relaxed));
+    }
+    bump(total, other.totalCount());
+    bump(overflows, other.overflowCount());
+    bump(sum, other.sum.load(std::memory_order_relaxed));
+    min.store(std::min(min.load(std::memory_order_relaxed),
+                       other.min.load(std::memory_order_relaxed)),
+              std::memory_order_relaxed);
+    max.store(std::max(max.load(std::memory_order_relaxed),
+                       other.max.load(std::memory_order_relaxed)),
+              std::memory_order_relaxed);
+  }
+
+  uint64_t totalCount() const { return total.load(std::memory_order_relaxed); }
+
+  uint64_t overflowCount() const {
+    return overflows.load(std::memory_order_relaxed);
+  }
+
+  uint64_t minValue() const {
+    return totalCount() == 0 ? 0 : min.load(std::memory_order_relaxed);
+  }
+
+  uint64_t maxValue() const {
+    return totalCount() == 0 ? 0 : clampedEquivalent(max.load());
+  }
+
+  double mean() const {
+    auto const count = totalCount();
+    return count == 0 ? 0.
+                      : static_cast<double>(sum.load()) /
+                            static_cast<double>(count);
+  }
+
+  uint64_t lowestTrackable() const { return lowest; }
+
+  uint64_t highestTrackable() const { return highest; }
+
+  int significantFigures() const { return significant_figures; }
+
+  /**
+   * @brief The value below which `percentile`% of the values fall (up to the
+   *        precision of the histogram).
+   */
+  uint64_t valueAtPercentile(double const percentile) const {
+    auto const count = totalCount();
+    if (count == 0) {
+      return 0;
+    }
+    auto const clamped = std::min(std::max(percentile, 0.), 100.);
+    auto const target = std::max<uint64_t>(
+        1, static_cast<uint64_t>(
+               std::llround(clamped / 100. * static_cast<double>(count))));
+    uint64_t acc = 0;
+    for (size_t i = 0; i < counts_len; i++) {
+      acc += counts[i].load(std::memory_order_relaxed);
+      if (acc >= target) {
+        return clampedEquivalent(valueFromIndex(i));
+      }
+    }
+    return maxValue();
+  }
+
+  /**
+   * @brief Number of recorded values in [from, to).
+   */
+  uint64_t countBetween(uint64_t const from, uint64_t const to) const {
+    uint64_t acc = 0;
+    forEachBucket([&](uint64_t const low, uint64_t, uint64_t const count) {
+      if (low >= from && low < to) {
+        acc += count;
+      }
+    });
+    return acc;
+  }
+
+  /**
+   * @brief Call `f(lowest, highest, count)` for each non-empty bucket, where
+   *        [lowest, highest] is the range of values it holds.
+   */
+  template <typename F>
+  void forEachBucket(F &&f) const {
+    for (size_t i = 0; i < counts_len; i++) {
+      auto const count = counts[i].load(std::memory_order_relaxed);
+      if (count == 0) {
+        continue;
+      }
+      auto const value = valueFromIndex(i);
+      f(lowestEquivalent(value), highestEquivalent(value), count);
+    }
+  }
+
+  /**
+   * @brief Serialize to a compact binary format: the layout followed by the
+   *        varint-encoded (index delta, count) pairs of non-empty buckets.
+   */
+  std::vector<uint8_t> serialize() const {
+    std::vector<uint8_t> out(Magic, Magic + sizeof(Magic));
+    putVarint(out, Version);
+    putVarint(out, lowest);
+    putVarint(out, highest);
+    putVarint(out, static_cast<uint64_t>(significant_figures));
+    putVarint(out, totalCount());
+    putVarint(out, overflowCount());
+    putVarint(out, sum.load(std::memory_order_relaxed));
+    putVarint(out, min.load(std::memory_order_relaxed));
+    putVarint(out, max.load(std::memory_order_relaxed));
+    size_t previous = 0;
+    for (size_t i = 0; i < counts_len; i++) {
+      auto const count = counts[i].load(std::memory_order_relaxed);
+      if (count == 0) {
+        continue;
+      }
+      putVarint(out, i - previous);
+      putVarint(out, count);
+      previous = i;
+    }
+    return out;
+  }
+
+  static HdrHistogram deserialize(uint8_t const *data, size_t const size) {
+    if (size < sizeof(Magic) || std::memcmp(data, Magic, sizeof(Magic)) != 0) {
+      throw std::runtime_error("Not a serialized HDR histogram.");
+    }
+    size_t pos = sizeof(Magic);
+    if (getVarint(data, size, pos) != Version) {
+      throw std::runtime_error("Unsupported HDR histogram version.");
+    }
+    auto const lowest = getVarint(data, size, pos);
+    auto const highest = getVarint(data, size, pos);
+    auto const figures = static_cast<int>(getVarint(data, size, pos));
+    HdrHistogram histogram(lowest, highest, figures);
+    histogram.total = getVarint(data, size, pos);
+    histogram.overflows = getVarint(data, size, pos);
+    histogram.sum = getVarint(data, size, pos);
+    histogram.min = getVarint(data, size, pos);
+    histogram.max = getVarint(data, size, pos);
+    size_t index = 0;
+    while (pos < size) {
+      index += getVarint(data, size, pos);
+      auto const count = getVarint(data, size, pos);
+      if (index >= histogram.counts_len) {
+        throw std::runtime_error("Corrupted HDR histogram.");
+      }
+      histogram.counts[index] = count;
+    }
+    return histogram;
+  }
+
+  /**
+   * @brief Human/tool-readable dump: summary, percentiles and the non-empty
+   *        buckets as [lowest, highest, count] triples.
+   */
+  std::string toJson() const {
+    std::string json = fmt::format(
+        "{{\"lowest\":{},\"highest\":{},\"significant_figures\":{},"
+        "\"total\":{},\"overflows\":{},\"min\":{},\"max\":{},\"mean\":{:.3f},"
+        "\"percentiles\":{{",
+        lowest, highest, significant_figures, totalCount(), overflowCount(),
+        minValue(), maxValue(), mean());
+    bool first = true;
+    for (auto const p : {50., 90., 95., 99., 99.9, 99.99, 99.999, 100.}) {
+      json += fmt::format("{}\"{}\":{}", first ? "" : ",", p,
+                          valueAtPercentile(p));
+      first = false;
+    }
+    json += "},\"buckets\":[";
+    first = true;
+    forEachBucket([&](uint64_t low, uint64_t high, uint64_t count) {
+      json += fmt::format("{}[{},{},{}]", first ? "" : ",", low, high, count);
+      first = false;
+    });
+    json += "]}";
+    return json;
+  }
+
+  /**
+   * @brief Save to `path`: as JSON if it ends with `.json`, in the binary
+   *        format otherwise.
+   */
+  void save(std::string const &path) const {
+    auto const json =
+        path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    auto const content = json ? toJson() : std::string();
+    auto const binary = json ? std::vector<uint8_t>() : serialize();
+    auto *const file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+      throw std::runtime_error(fmt::format("Cannot open `{}`", path));
+    }
+    auto const written =
+        json ? std::fwrite(content.data(), 1, content.size(), file)
+             : std::fwrite(binary.data(), 1, binary.size(), file);
+    std::fclose(file);
+    if (written != (json ? content.size() : binary.size())) {
+      throw std::runtime_error(fmt::format("Failed to write `{}`", path));
+    }
+  }
+
+  /**
+   * @brief Load a histogram saved in the binary format.
+   */
+  static HdrHistogram load(std::string const &path) {
+    auto *const file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+      throw std::runtime_error(fmt::format("Cannot open `{}`", path));
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t read;
+    while ((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+      data.insert(data.end(), chunk, chunk + read);
+    }
+    std::fclose(file);
+    return deserialize(data.data(), data.size());
+  }
+
+ private:
+  static constexpr uint8_t Magic[4] = {'D', 'H', 'D', 'R'};
+  static uint64_t constexpr Version = 1;
+
+  static inline void bump(std::atomic<uint64_t> &counter,
+                          uint64_t const by) {
+    counter.store(counter.load(std::memory_order_relaxed) + by,
+                  std::memory_order_relaxed);
+  }
+
+  void requireSameLayout(HdrHistogram const &other) const {
+    if (other.lowest != lowest || other.highest != highest ||
+        other.significant_figures != significant_figures) {
+      throw std::invalid_argument(
+          "Cannot merge HDR histograms of different layouts.");
+    }
+  }
+
+  inline int bucketIndex(uint64_t const value) const {
+    auto const pow2ceiling = 64 - __builtin_clzll(value | sub_bucket_mask);
+    return pow2ceiling - unit_magnitude - (sub_bucket_half_count_magnitude + 1);
+  }
+
+  inline int64_t subBucketIndex(uint64_t const value, int const bucket) const {
+    return static_cast<int64_t>(value >> (bucket + unit_magnitude));
+  }
+
+  inline size_t countsIndexFor(uint64_t const value) const {
+    auto const bucket = bucketIndex(value);
+    auto const sub_bucket = subBucketIndex(value, bucket);
+    auto const bucket_base_index = (int64_t(bucket) + 1)
+                                   << sub_bucket_half_count_magnitude;
+    return static_cast<size_t>(bucket_base_index +
+                               (sub_bucket - sub_bucket_half_count));
+  }
+
+  inline uint64_t valueFromIndex(size_t const index) const {
+    auto bucket =
+        static_cast<int64_t>(index >> sub_bucket_half_count_magnitude) - 1;
+    auto const half_mask = static_cast<size_t>(sub_bucket_half_count - 1);
+    auto sub_bucket =
+        static_cast<int64_t>(index & half_mask) + sub_bucket_half_count;
+    if (bucket < 0) {
+      sub_bucket -= sub_bucket_half_count;
+      bucket = 0;
+    }
+    return static_cast<uint64_t>(sub_bucket) << (bucket + unit_magnitude);
+  }
+
+  inline uint64_t sizeOfEquivalentRange(uint64_t const value) const {
+    auto const bucket = bucketIndex(value);
+    auto const sub_bucket = subBucketIndex(value, bucket);
+    auto const adjusted = sub_bucket >= sub_bucket_count ? bucket + 1 : bucket;
+    return uint64_t(1) << (unit_magnitude + adjusted);
+  }
+
+  inline uint64_t lowestEquivalent(uint64_t const value) const {
+    auto const bucket = bucketIndex(value);
+    return static_cast<uint64_t>(subBucketIndex(value, bucket))
+           << (bucket + unit_magnitude);
+  }
+
+  inline uint64_t highestEquivalent(uint64_t const value) const {
+    return lowestEquivalent(value) + sizeOfEquivalentRange(value) - 1;
+  }
+
+  // Overflows are clamped to `highest`, which must be reported as is.
+  inline uint64_t clampedEquivalent(uint64_t const value) const {
+    return std::min(highestEquivalent(value), highest);
+  }
+
+  static void putVarint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80) {
+      out.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+  }
+
+  static uint64_t getVarint(uint8_t const *data, size_t const size,
+                            size_t &pos) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (pos >= size) {
+        throw std::runtime_error("Truncated HDR histogram.");
+      }
+      auto const byte = data[pos++];
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return value;
+      }
+    }
+    throw std::runtime_error("Corrupted HDR histogram.");
+  }
+
+  uint64_t lowest;
+  uint64_t highest;
+  int significant_figures;
+
+  int unit_magnitude;
+  int sub_bucket_half_count_magnitude;
+  int64_t sub_bucket_count;
+  int64_t sub_bucket_half_count;
+  uint64_t sub_bucket_mask;
+  int bucket_count;
+  size_t counts_len;
+
+  std::unique_ptr<std::atomic<uint64_t>[]> counts;
+  std::atomic<uint64_t> total{0};
+  std::atomic<uint64_t> overflows{0};
+  std::atomic<uint64_t> sum{0};
+  std::atomic<uint64_t> min{0};
+  std::atomic<uint64_t> max{0};
+};
+
+}  // namespace dory
@@ -1,123 +1,57 @@
 #pragma once
 
-#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <iostream>
-#include <numeric>
-#include <stdexcept>
-#include <vector>
+#include <string>
 
-#include <fmt/chrono.h>
 #include <fmt/core.h>
 
+#include "hdr-histogram.hpp"
+
 namespace dory {
+/**
+ * @brief Latency percentiles, backed by an HdrHistogram of nanoseconds.
+ *
+ * Recording is lock-free and must be done by a single thread: give each
+ * thread its own profiler and merge them. Measurements above the range are
+ * clamped and counted, they are reported once by `report()`.
+ */
 class LatencyProfiler {
  public:
   using Nano = std::chrono::nanoseconds;
   using Micro = std::chrono::microseconds;
   using Milli = std::chrono::milliseconds;
 
-  struct MeasurementGroup {
-    Nano start;
-    Nano end;
-    Nano granularity;
-    size_t indices;
-    size_t start_idx;
-
-    MeasurementGroup(Nano start, Nano end, Nano granularity)
-        : start{start}, end{end}, granularity{granularity} {
-      indices = static_cast<size_t>((end - start) / granularity);
-
-      if (start + indices * granularity != end) {
-        throw std::runtime_error("Imperfect granularity!");
-      }
-    }
-  };
-
-  LatencyProfiler(size_t const skip_initial_measurements)
-      : skip{skip_initial_measurements} {
-    grp.emplace_back(Nano(0), Nano(1000), Nano(1));
-    grp.emplace_back(Micro(1), Micro(10), Nano(10));
-    grp.emplace_back(Micro(10), Micro(100), Nano(20));
-    grp.emplace_back(Micro(100), Milli(1), Nano(50));
-    grp.emplace_back(Milli(1), Milli(100), Micro(100));
-
-    // TODO(anon): Check for perfect overlap
-
-    // Compute the start_idx for all groups
-    size_t start_idx = 0;
-    for (auto &g : grp) {
-      g.start_idx = start_idx;
-      start_idx += g.indices;
-    }
-
-    // Set the vector size to fit the buckets of all groups
-    freq.resize(start_idx);
-  }
+  LatencyProfiler(size_t const skip_initial_measurements = 0,
+                  Nano const highest = std::chrono::seconds(10),
+                  int const significant_figures = 3)
+      : skip{skip_initial_measurements},
+        hist{1, static_cast<uint64_t>(highest.count()), significant_figures} {}
 
   template <typename Duration>
-  void addMeasurement(Duration const &duration) {
-    auto d = std::chrono::duration_cast<Nano>(duration);
-    auto count = d.count();
-
+  inline void addMeasurement(Duration const &duration) {
     if (measurement_idx++ < skip) {
       return;
     }
-
-    if (duration >= grp.back().end) {
-      fmt::print("Measurement of {} exceeded {}.\n", duration, grp.back().end);
-      return;
-    }
-
-    // Find the right group
-    auto it = std::lower_bound(grp.begin(), grp.end(), d,
-                               [](MeasurementGroup const &g, Nano duration) {
-                                 return g.start <= duration;
-                               });
-
-    auto group_index = static_cast<size_t>(std::distance(grp.begin(), it - 1));
-
-    // Find the index inside the group
-    auto &group = grp.at(group_index);
-    auto freq_index = group.start_idx + static_cast<size_t>((d - group.start) /
-                                                            group.granularity);
-
-    freq.at(freq_index)++;
+    auto const count = std::chrono::duration_cast<Nano>(duration).count();
+    hist.record(count < 0 ? 0 : static_cast<uint64_t>(count));
   }
 
-  Nano percentile(double perc) {
-    auto acc_freq(freq);
-    auto measurents_cnt =
-        std::accumulate(acc_freq.begin(), acc_freq.end(), 0UL);
-
-    std::partial_sum(acc_freq.begin(), acc_freq.end(), acc_freq.begin());
-
-    auto it_freq =
-        std::lower_bound(acc_freq.begin(), acc_freq.end(),
-                         static_cast<double>(measurents_cnt) * perc / 100.0);
-
-    auto freq_idx =
-        static_cast<size_t>(std::distance(acc_freq.begin(), it_freq));
+  /**
+   * @brief Add the measurements of another profiler (e.g., of another thread,
+   *        or loaded from the file of another process).
+   */
+  void merge(LatencyProfiler const &other) { hist.merge(other.hist); }
 
-    // Find the right group
-    auto it =
-        std::lower_bound(grp.begin(), grp.end(), freq_idx,
-                         [](MeasurementGroup const &g, uint64_t freq_idx) {
-                           return g.start_idx <= freq_idx;
-                         });
+  void merge(HdrHistogram const &other) { hist.merge(other); }
 
-    auto group_index = static_cast<size_t>(std::distance(grp.begin(), it - 1));
-
-    // Find the index inside the group
-    auto &group = grp.at(group_index);
-    auto time = group.start + (freq_idx - group.start_idx) * group.granularity;
-
-    return time + group.granularity;
+  Nano percentile(double const perc) const {
+    return Nano(hist.valueAtPercentile(perc));
   }
 
   template <typename Duration>
-  std::string prettyTime(Duration const &d) {
+  std::string prettyTime(Duration const &d) const {
     if (d < Nano(1000)) {
       Nano dd = std::chrono::duration_cast<Nano>(d);
       return std::to_string(dd.count()) + "ns";
@@ -134,24 +68,18 @@ class LatencyProfiler {
     }
   }
 
-  void report(bool detailed = false) {
+  void report(bool const detailed = false) const {
     std::cout << "Skipping " << skip << " initial measurements"
               << "\n";
-
-    uint64_t total = std::accumulate(freq.begin(), freq.end(), 0UL);
-    std::cout << "Total number of measurements: " << total << "\n";
-
-    for (auto &g : grp) {
-      auto meas_cnt = std::accumulate(
-          freq.begin() +
-              static_cast<std::vector<uint64_t>::difference_type>(g.start_idx),
-          freq.begin() + static_cast<std::vector<uint64_t>::difference_type>(
-                             g.start_idx + g.indices),
-          0UL);
-
-      std::cout << "Total number of measurements [" << prettyTime(g.start)
-                << ", " << prettyTime(g.end) << "): " << meas_cnt << "\n";
+    std::cout << "Total number of measurements: " << hist.totalCount() << "\n";
+    if (hist.overflowCount() != 0) {
+      std::cout << "Measurements over "
+                << prettyTime(Nano(hist.highestTrackable()))
+                << " (counted as such): " << hist.overflowCount() << "\n";
     }
+    std::cout << "Min / mean / max (ns): " << hist.minValue() << " / "
+              << static_cast<uint64_t>(hist.mean()) << " / " << hist.maxValue()
+              << "\n";
 
     if (detailed) {
       for (int i = 0; i < 99; i++) {
@@ -159,57 +87,60 @@ class LatencyProfiler {
                   << percentile(static_cast<double>(i)).count() << "\n";
       }
     } else {
-      std::cout << "50th-percentile (ns): " << percentile(50.0).count() << "\n"
-                << "90th-percentile (ns): " << percentile(90.0).count() << "\n"
-                << "95th-percentile (ns): " << percentile(95.0).count() << "\n"
-                << "98th-percentile (ns): " << percentile(98.0).count() << "\n";
+      std::cout << "Mean without extremes (0.5*50th + 0.1*60th + 0.1*70th + "
+                   "0.1*80th + 0.1*90th 0.1*95th)/0.95 "
+                << ((50 * percentile(50.0) + 10 * percentile(60.0) +
+                     10 * percentile(70.0) + 10 * percentile(80.0) +
+                     10 * percentile(90.0) + 5 * percentile(95.0)) /
+                    95)
+                       .count()
+                << "\n";
+      for (auto const p : {50, 60, 70, 80, 90, 95, 98}) {
+        std::cout << p << "th-percentile (ns): "
+                  << percentile(static_cast<double>(p)).count() << "\n";
+      }
+    }
+    for (auto const *const p :
+         {"99", "99.5", "99.9", "99.99", "99.999", "99.9999", "99.99999"}) {
+      std::cout << p << "th-percentile (ns): "
+                << percentile(std::stod(p)).count() << "\n";
     }
-    std::cout << "99th-percentile (ns): " << percentile(99.0).count() << "\n"
-              << "99.5th-percentile (ns): " << percentile(99.5).count() << "\n"
-              << "99.9th-percentile (ns): " << percentile(99.9).count() << "\n"
-              << "99.99th-percentile (ns): " << percentile(99.99).count()
-              << "\n"
-              << "99.999th-percentile (ns): " << percentile(99.999).count()
-              << "\n"
-              << "99.9999th-percentile (ns): " << percentile(99.9999).count()
-              << "\n"
-              << "99.99999th-percentile (ns): " << percentile(99.99999).count()
-              << "\n"
-              << "99.999999th-percentile (ns): "
-              << percentile(99.999999).count() << "\n"
-              << "99.9999999th-percentile (ns): "
-              << percentile(99.9999999).count() << "\n"
-              << "99.99999999th-percentile (ns): "
-              << percentile(99.99999999).count() << "\n"
-              << "99.999999999th-percentile (ns): "
-              << percentile(99.999999999).count() << "\n"
-              << std::endl;
+    std::cout << std::endl;
   }
 
-  void reportBuckets() {
-    for (auto &g : grp) {
-      std::cout << "Reporting detailed data for range (in ns) ["
-                << prettyTime(g.start) << ", " << prettyTime(g.end) << ")"
-                << "\n";
+  void reportOnce() {
+    if (!reported) {
+      report();
+      reported = true;
+    }
+  }
 
-      for (size_t i = 0; i < g.indices; i++) {
-        auto f = freq.at(g.start_idx + i);
-        if (f == 0) {
-          continue;
-        }
+  void reportBuckets() const {
+    std::cout << "Reporting detailed data (in ns)"
+              << "\n";
+    hist.forEachBucket(
+        [](uint64_t const low, uint64_t const high, uint64_t const count) {
+          std::cout << "[" << low << ", " << high + 1 << ") " << count << "\n";
+        });
+    std::cout << std::endl;
+  }
 
-        std::cout << "[" << (g.start + i * g.granularity).count() << ", "
-                  << (g.start + (i + 1) * g.granularity).count() << ") " << f
-                  << "\n";
-      }
-      std::cout << std::endl;
-    }
+  /**
+   * @brief Save the histogram to `path`, as JSON if it ends with `.json`, in
+   *        the binary format of HdrHistogram otherwise.
+   */
+  void save(std::string const &path) const { hist.save(path); }
+
+  size_t measured() const {
+    return skip >= measurement_idx ? 0 : (measurement_idx - skip);
   }
 
+  HdrHistogram const &histogram() const { return hist; }
+
  private:
-  size_t const skip;
+  size_t skip;
   size_t measurement_idx = 0;
-  std::vector<MeasurementGroup> grp;
-  std::vector<uint64_t> freq;
+  bool reported = false;
+  HdrHistogram hist;
 };
 }  // namespace dory
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+/**
+ * Live metrics.
+ *
+ * Counters and gauges live in a fixed-size page that can be backed by a
+ * memory-mapped file (e.g., in /dev/shm). An external process maps the file
+ * read-only and samples the values, without any cooperation of the threads
+ * that update them: updating a metric is a single relaxed atomic operation on
+ * a cache line of its own.
+ */
+namespace dory::metrics {
+
+enum class Kind : uint32_t { Counter, Gauge };
+
+/**
+ * @brief Layout of the metrics page: a header followed by `capacity` slots,
+ *        `size` of which are in use.
+ */
+struct Page {
+  static uint64_t constexpr Magic = 0x53434952544d5944;  // "DYMTRICS"
+  static uint32_t constexpr Version = 1;
+  static size_t constexpr Capacity = 1024;
+  static size_t constexpr MaxNameLength = 47;
+
+  struct alignas(64) Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    // Slots are published by bumping `size` once they are initialized.
+    std::atomic<uint32_t> size;
+    int32_t pid;
+    int64_t started_at_ns;  // Since the UNIX epoch.
+  };
+
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> value;
+    Kind kind;
+    char name[MaxNameLength + 1];
+  };
+
+  static size_t constexpr size(size_t const capacity) {
+    return sizeof(Header) + capacity * sizeof(Slot);
+  }
+};
+
+static_assert(sizeof(Page::Slot) == 64, "Slots should fill a cache line.");
+
+/**
+ * @brief Monotonic counter. Can be incremented from any thread.
+ */
+class Counter {
+ public:
+  Counter(std::atomic<uint64_t> &value) : value{&value} {}
+
+  inline void add(uint64_t const n = 1) {
+    value->fetch_add(n, std::memory_order_relaxed);
+  }
+
+  uint64_t get() const { return value->load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> *value;
+};
+
+/**
+ * @brief Last value of a quantity (e.g., a queue depth or a batch size).
+ */
+class Gauge {
+ public:
+  Gauge(std::atomic<uint64_t> &value) : value{&value} {}
+
+  inline void set(uint64_t const v) {
+    value->store(v, std::memory_order_relaxed);
+  }
+
+  uint64_t get() const { return value->load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> *value;
+};
+
+/**
+ * @brief The metrics of the process.
+ *
+ * Metrics are identified by their name: registering a name twice returns the
+ * same metric, so that instances of an abstraction can share their counters.
+ * Unless `exposeAt` is called before the first metric is registered, the page
+ * is anonymous memory and the metrics are only visible to the process itself.
+ */
+class Registry {
+ public:
+  static Registry &instance() {
+    static Registry registry;
+    return registry;
+  }
+
+  Registry(Registry const &) = delete;
+  Registry &operator=(Registry const &) = delete;
+  Registry(Registry &&) = delete;
+  Registry &operator=(Registry &&) = delete;
+
+  ~Registry() {
+    if (page != nullptr) {
+      ::munmap(page, Page::size(Page::Capacity));
+    }
+  }
+
+  /**
+   * @brief Back the metrics by the file at `path`, which is (re)created.
+   *
+   * @throw std::logic_error if metrics were already registered.
+   */
+  void exposeAt(std::string const &path) {
+    std::scoped_lock lock(mutex);
+    if (page != nullptr) {
+      throw std::logic_error(
+          "Metrics must be exposed before the first one is registered.");
+    }
+    auto const fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error(fmt::format("Could not open {}: {}", path,
+                                           std::strerror(errno)));
+    }
+    auto const size = Page::size(Page::Capacity);
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+      ::close(fd);
+      throw std::runtime_error(fmt::format("Could not resize {}: {}", path,
+                                           std::strerror(errno)));
+    }
+    auto *const addr =
+        ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+      throw std::runtime_error(
+          fmt::format("Could not map {}: {}", path, std::strerror(errno)));
+    }
+    init(addr);
+  }
+
+  Counter counter(std::string const &name) {
+    return Counter(slot(name, Kind::Counter));
+  }
+
+  Gauge gauge(std::string const &name) {
+    return Gauge(slot(name, Kind::Gauge));
+  }
+
+ private:
+  Registry() = default;
+
+  void init(void *const addr) {
+    page = reinterpret_cast<uint8_t *>(addr);
+    auto &h = header();
+    h.magic = Page::Magic;
+    h.version = Page::Version;
+    h.capacity = static_cast<uint32_t>(Page::Capacity);
+    h.pid = static_cast<int32_t>(::getpid());
+    h.started_at_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+    h.size.store(0, std::memory_order_release);
+  }
+
+  std::atomic<uint64_t> &slot(std::string const &name, Kind const kind) {
+    std::scoped_lock lock(mutex);
+    if (page == nullptr) {
+      auto *const addr =
+          ::mmap(nullptr, Page::size(Page::Capacity), PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (addr == MAP_FAILED) {
+        throw std::runtime_error(
+            fmt::format("Could not map the metrics: {}", std::strerror(errno)));
+      }
+      init(addr);
+    }
+    auto const truncated = name.substr(0, Page::MaxNameLength);
+    auto &h = header();
+    auto const size = h.size.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < size; i++) {
+      auto &s = slots()[i];
+      if (truncated == s.name) {
+        if (s.kind != kind) {
+          throw std::logic_error(
+              fmt::format("Metric {} registered with another kind.", name));
+        }
+        return s.value;
+      }
+    }
+    if (size == Page::Capacity) {
+      throw std::runtime_error(
+          fmt::format("No room left to register metric {}.", name));
+    }
+    auto &s = slots()[size];
+    s.value.store(0, std::memory_order_relaxed);
+    s.kind = kind;
+    std::memset(s.name, 0, sizeof(s.name));
+    std::memcpy(s.name, truncated.data(), truncated.size());
+    h.size.store(size + 1, std::memory_order_release);
+    return s.value;
+  }
+
+  Page::Header &header() { return *reinterpret_cast<Page::Header *>(page); }
+
+  Page::Slot *slots() {
+    return reinterpret_cast<Page::Slot *>(page + sizeof(Page::Header));
+  }
+
+  std::mutex mutex;
+  uint8_t *page = nullptr;
+};
+
+/**
+ * @brief Maps the metrics page of another process read-only.
+ */
+class Reader {
+ public:
+  struct Sample {
+    std::string name;
+    Kind kind;
+    uint64_t value;
+  };
+
+  Reader(std::string const &path) : path{path} {
+    auto const fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error(fmt::format("Could not open {}: {}", path,
+                                           std::strerror(errno)));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(Page::Header)) {
+      ::close(fd);
+      throw std::runtime_error(fmt::format("{} is not a metrics page.", path));
+    }
+    length = static_cast<size_t>(st.st_size);
+    auto *const addr = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+      throw std::runtime_error(
+          fmt::format("Could not map {}: {}", path, std::strerror(errno)));
+    }
+    page = reinterpret_cast<uint8_t const *>(addr);
+    auto const &h = header();
+    if (h.magic != Page::Magic || h.version != Page::Version ||
+        length < Page::size(h.capacity)) {
+      ::munmap(const_cast<uint8_t *>(page), length);
+      throw std::runtime_error(fmt::format("{} is not a metrics page.", path));
+    }
+  }
+
+  Reader(Reader const &) = delete;
+  Reader &operator=(Reader const &) = delete;
+
+  Reader(Reader &&o) : path{std::move(o.path)}, page{o.page}, length{o.length} {
+    o.page = nullptr;
+  }
+
+  Reader &operator=(Reader &&) = delete;
+
+  ~Reader() {
+    if (page != nullptr) {
+      ::munmap(const_cast<uint8_t *>(page), length);
+    }
+  }
+
+  std::vector<Sample> sample() const {
+    auto const &h = header();
+    auto const size = std::min(h.size.load(std::memory_order_acquire),
+                               h.capacity);
+    auto const *const slots =
+        reinterpret_cast<Page::Slot const *>(page + sizeof(Page::Header));
+    std::vector<Sample> samples;
+    samples.reserve(size);
+    for (uint32_t i = 0; i < size; i++) {
+      auto const &s = slots[i];
+      samples.push_back({std::string(s.name, strnlen(s.name, sizeof(s.name))),
+                         s.kind, s.value.load(std::memory_order_relaxed)});
+    }
+    return samples;
+  }
+
+  int pid() const { return header().pid; }
+
+  // Whether the process that exposed the metrics is still running.
+  bool alive() const { return ::kill(pid(), 0) == 0 || errno == EPERM; }
+
+  std::string const &file() const { return path; }
+
+ private:
+  Page::Header const &header() const {
+    return *reinterpret_cast<Page::Header const *>(page);
+  }
+
+  std::string path;
+  uint8_t const *page;
+  size_t length;
+};
+
+}  // namespace dory::metrics
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define DORY_HAS_TSC 1
+#endif
+
+namespace dory {
+
+/**
+ * @brief Cheap timestamps for hot paths, read from the TSC.
+ *
+ * Ticks are converted to nanoseconds using a calibration against
+ * std::chrono::steady_clock that is done once per process (it takes ~10ms,
+ * call `calibrate()` at startup to keep it out of measurements). It assumes an
+ * invariant TSC, as provided by all recent x86 CPUs. On other architectures,
+ * ticks are steady_clock nanoseconds.
+ */
+class TscClock {
+ public:
+  using Ticks = uint64_t;
+
+  static inline Ticks now() {
+#ifdef DORY_HAS_TSC
+    return __rdtsc();
+#else
+    return static_cast<Ticks>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+#endif
+  }
+
+  static void calibrate() { calibration(); }
+
+  static inline std::chrono::nanoseconds toDuration(Ticks const ticks) {
+    auto const scaled =
+        (static_cast<unsigned __int128>(ticks) * calibration().mult) >> Shift;
+    return std::chrono::nanoseconds(static_cast<int64_t>(scaled));
+  }
+
+  static inline std::chrono::nanoseconds since(Ticks const start) {
+    return toDuration(now() - start);
+  }
+
+  /**
+   * @brief The tick count at which the steady clock read (or will read) `tp`.
+   */
+  static Ticks fromSteady(std::chrono::steady_clock::time_point const tp) {
+    auto const ticks = now();
+    auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - tp)
+                        .count();
+    auto const delta = static_cast<int64_t>(
+        static_cast<double>(ns) * calibration().ticks_per_ns);
+    return ticks - static_cast<Ticks>(delta);
+  }
+
+  static double ticksPerNanosecond() { return calibration().ticks_per_ns; }
+
+ private:
+  static int constexpr Shift = 32;
+
+  struct Calibration {
+    // Nanoseconds per tick, as a fixed-point number with `Shift` decimal bits.
+    uint64_t mult;
+    double ticks_per_ns;
+  };
+
+  static Calibration const &calibration() {
+    static Calibration const c = measure();
+    return c;
+  }
+
+  static Calibration measure() {
+#ifdef DORY_HAS_TSC
+    auto const steady_start = std::chrono::steady_clock::now();
+    auto const tsc_start = now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    auto const steady_end = std::chrono::steady_clock::now();
+    auto const tsc_end = now();
+    auto const ns =
+        std::chrono::duration<double, std::nano>(steady_end - steady_start)
+            .count();
+    auto const ticks_per_ns = static_cast<double>(tsc_end - tsc_start) / ns;
+    return {static_cast<uint64_t>(static_cast<double>(1ULL << Shift) /
+                                  ticks_per_ns),
+            ticks_per_ns};
+#else
+    return {1ULL << Shift, 1.};
+#endif
+  }
+};
+
+}  // namespace dory
@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <dory/shared/hdr-histogram.hpp>
+
+using dory::HdrHistogram;
+
+static uint64_t constexpr Lowest = 1;
+static uint64_t constexpr Highest = 3600UL * 1000 * 1000 * 1000;  // 1h in ns
+static int constexpr Figures = 3;
+
+TEST(HdrHistogram, Record) {
+  HdrHistogram hist(Lowest, Highest, Figures);
+  EXPECT_EQ(hist.totalCount(), 0);
+  EXPECT_EQ(hist.minValue(), 0);
+  EXPECT_EQ(hist.maxValue(), 0);
+  EXPECT_EQ(hist.valueAtPercentile(50), 0);
+
+  hist.record(1000);
+  hist.record(2000, 3);
+  EXPECT_EQ(hist.totalCount(), 4);
+  EXPECT_EQ(hist.overflowCount(), 0);
+  EXPECT_EQ(hist.minValue(), 1000);
+  EXPECT_EQ(hist.maxValue(), 2000);
+  EXPECT_DOUBLE_EQ(hist.mean(), 7000. / 4);
+  EXPECT_EQ(hist.countBetween(0, 1500), 1);
+  EXPECT_EQ(hist.countBetween(1500, 2500), 3);
+
+  hist.reset();
+  EXPECT_EQ(hist.totalCount(), 0);
+}
+
+TEST(HdrHistogram, Overflows) {
+  HdrHistogram hist(Lowest, 1000, Figures);
+  hist.record(10);
+  hist.record(5000);
+  EXPECT_EQ(hist.totalCount(), 2);
+  EXPECT_EQ(hist.overflowCount(), 1);
+  EXPECT_EQ(hist.maxValue(), 1000);
+  EXPECT_EQ(hist.valueAtPercentile(100), 1000);
+}
+
+TEST(HdrHistogram, Percentiles) {
+  HdrHistogram hist(Lowest, Highest, Figures);
+  for (uint64_t value = 1; value <= 10000; value++) {
+    hist.record(value);
+  }
+  // Up to the precision of 3 significant figures.
+  for (auto const &[percentile, expected] :
+       std::vector<std::pair<double, uint64_t>>{{0, 1},
+                                                {1, 100},
+                                                {50, 5000},
+                                                {90, 9000},
+                                                {99, 9900},
+                                                {99.9, 9990},
+                                                {100, 10000}}) {
+    SCOPED_TRACE(percentile);
+    auto const value = hist.valueAtPercentile(percentile);
+    EXPECT_GE(value, expected);
+    EXPECT_LE(value, expected + expected / 1000);
+  }
+}
+
+TEST(HdrHistogram, BucketBoundaries) {
+  HdrHistogram hist(Lowest, Highest, Figures);
+  // Values are exact below 2048 (the sub-bucket count for 3 figures), then
+  // each bucket doubles the width of its sub-buckets.
+  std::vector<uint64_t> const values = {
+      0,    1,    2047, 2048, 2049, 4095, 4096,
+      4097, 4098, 1000000, 999999999, Highest};
+  for (auto const value : values) {
+    SCOPED_TRACE(value);
+    hist.reset();
+    hist.record(value);
+    uint64_t low = 0;
+    uint64_t high = 0;
+    hist.forEachBucket([&](uint64_t const l, uint64_t const h, uint64_t) {
+      low = l;
+      high = h;
+    });
+    EXPECT_LE(low, value);
+    EXPECT_GE(high, value);
+    // The bucket width is within the precision of 3 significant figures.
+    EXPECT_LE(high - low, value / 1000);
+  }
+
+  hist.reset();
+  hist.record(2047);
+  hist.record(2048);
+  hist.record(2049);
+  EXPECT_EQ(hist.countBetween(2047, 2048), 1);
+  // 2048 and 2049 share a 2-wide sub-bucket.
+  EXPECT_EQ(hist.countBetween(2048, 2050), 2);
+  EXPECT_EQ(hist.valueAtPercentile(100), 2049);
+}
+
+TEST(HdrHistogram, Merge) {
+  HdrHistogram a(Lowest, Highest, Figures);
+  HdrHistogram b(Lowest, Highest, Figures);
+  a.record(10, 2);
+  b.record(1000);
+  b.record(5);
+  a.merge(b);
+  EXPECT_EQ(a.totalCount(), 4);
+  EXPECT_EQ(a.minValue(), 5);
+  EXPECT_EQ(a.maxValue(), 1000);
+  EXPECT_EQ(a.countBetween(10, 11), 2);
+
+  HdrHistogram other_layout(Lowest, Highest, Figures + 1);
+  EXPECT_THROW(a.merge(other_layout), std::invalid_argument);
+}
+
+static void expectEqual(HdrHistogram const &a, HdrHistogram const &b) {
+  EXPECT_EQ(a.lowestTrackable(), b.lowestTrackable());
+  EXPECT_EQ(a.highestTrackable(), b.highestTrackable());
+  EXPECT_EQ(a.significantFigures(), b.significantFigures());
+  EXPECT_EQ(a.totalCount(), b.totalCount());
+  EXPECT_EQ(a.overflowCount(), b.overflowCount());
+  EXPECT_EQ(a.minValue(), b.minValue());
+  EXPECT_EQ(a.maxValue(), b.maxValue());
+  EXPECT_DOUBLE_EQ(a.mean(), b.mean());
+  EXPECT_EQ(a.toJson(), b.toJson());
+}
+
+TEST(HdrHistogram, SerializeRoundTrip) {
+  HdrHistogram hist(Lowest, 1000000, Figures);
+  for (uint64_t value = 1; value < 2000000; value = value * 3 + 1) {
+    hist.record(value, value % 7 + 1);
+  }
+  auto const serialized = hist.serialize();
+  expectEqual(HdrHistogram::deserialize(serialized.data(), serialized.size()),
+              hist);
+
+  auto corrupted = serialized;
+  corrupted[0] = 'X';
+  EXPECT_THROW(HdrHistogram::deserialize(corrupted.data(), corrupted.size()),
+               std::runtime_error);
+  EXPECT_THROW(
+      HdrHistogram::deserialize(serialized.data(), serialized.size() - 1),
+      std::runtime_error);
+}
+
+TEST(HdrHistogram, SaveLoadRoundTrip) {
+  HdrHistogram hist(Lowest, Highest, Figures);
+  hist.record(42);
+  hist.record(123456789, 5);
+  auto const path = ::testing::TempDir() + "hdr-histogram-test.bin";
+  hist.save(path);
+  expectEqual(HdrHistogram::load(path), hist);
+  std::remove(path.c_str());
+
+  EXPECT_THROW(HdrHistogram::load(path), std::runtime_error);
+}
+
+TEST(HdrHistogram, Move) {
+  static_assert(std::is_nothrow_move_constructible_v<HdrHistogram>);
+  static_assert(std::is_nothrow_move_assignable_v<HdrHistogram>);
+
+  HdrHistogram hist(Lowest, Highest, Figures);
+  hist.record(42);
+  hist.record(123456789, 5);
+  HdrHistogram const copy(hist);
+
+  HdrHistogram moved(std::move(hist));
+  expectEqual(moved, copy);
+
+  HdrHistogram assigned(Lowest, 1000, Figures + 1);
+  assigned.record(7);
+  assigned = std::move(moved);
+  expectEqual(assigned, copy);
+  assigned.record(1);
+  EXPECT_EQ(assigned.totalCount(), copy.totalCount() + 1);
+}
@@ -17,6 +17,11 @@ zip -uj binaries.zip build/bin/mu-client
 zip -uj binaries.zip build/bin/mu-server
 zip -uj binaries.zip build/bin/ubft-client
 zip -uj binaries.zip build/bin/ubft-server
+zip -uj binaries.zip build/bin/ubft-replay
+zip -uj binaries.zip build/bin/ubft-latency-merge
+zip -uj binaries.zip build/bin/ubft-metrics
+zip -uj binaries.zip build/bin/ubft-server-tracing
+zip -uj binaries.zip build/bin/ubft-server-tick-profiling
 
 crashconsensus_path=$(ldd build/bin/mu-server | grep libcrashconsensus.so | awk '{ print $3 }')
 zip -uj binaries.zip "$crashconsensus_path"
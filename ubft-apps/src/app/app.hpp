@@ -1,17 +1,109 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <random>
 #include <iterator>
 
+#include <dory/ubft/consensus/types.hpp>
 #include <dory/ubft/rpc/server.hpp>
 
+// A request to execute, pointing into a buffer owned by the caller.
+struct RequestView {
+    uint8_t const *data;
+    size_t size;
+};
+
+// The responses to a batch of requests, stored back to back in a buffer that
+// is reused across batches so that executing requests does not allocate.
+class ResponseArena {
+public:
+    void clear() {
+        used = 0;
+        ends.clear();
+    }
+
+    // Returns where to write the next response, of at most `max_size` bytes.
+    // The pointer is only valid until the next call.
+    uint8_t *reserve(size_t max_size) {
+        if (buffer.size() < used + max_size) {
+            buffer.resize(std::max(2 * buffer.size(), used + max_size));
+        }
+        return buffer.data() + used;
+    }
+
+    // Appends the response written to the reserved space.
+    void commit(size_t size) {
+        used += size;
+        ends.push_back(used);
+    }
+
+    void append(uint8_t const *response, size_t size) {
+        std::copy(response, response + size, reserve(size));
+        commit(size);
+    }
+
+    size_t count() const {
+        return ends.size();
+    }
+
+    uint8_t const *data(size_t i) const {
+        return buffer.data() + begin(i);
+    }
+
+    size_t size(size_t i) const {
+        return ends[i] - begin(i);
+    }
+
+private:
+    size_t begin(size_t i) const {
+        return i == 0 ? 0 : ends[i - 1];
+    }
+
+    std::vector<uint8_t> buffer;
+    std::vector<size_t> ends;
+    size_t used = 0;
+};
+
 class Application {
 public:
     virtual size_t maxRequestSize() const = 0;
     virtual size_t maxResponseSize() const = 0;
     virtual std::vector<uint8_t> const& randomRequest() const = 0;
     virtual void execute(uint8_t const *const request, size_t request_size, std::vector<uint8_t> &response) = 0;
+
+    // Executes the requests in order, as if `execute` was called on each of
+    // them, and appends their responses to `responses`. Applications override
+    // it to write their responses in place and to amortize the cost of
+    // reaching their store over the batch.
+    virtual void executeBatch(std::vector<RequestView> const &requests, ResponseArena &responses) {
+        for (auto const &request : requests) {
+            execute(request.data, request.size, scratch_response);
+            responses.append(scratch_response.data(), scratch_response.size());
+        }
+    }
+
+    // Executes a batch decided by consensus.
+    void executeBatch(dory::ubft::consensus::Batch const &batch, ResponseArena &responses) {
+        batch_requests.clear();
+        for (auto it = batch.requests(); !it.done(); ++it) {
+            auto const request = *it;
+            batch_requests.push_back({request.payload(), request.size()});
+        }
+        executeBatch(batch_requests, responses);
+    }
+
+    virtual ~Application() = default;
+
+    // Whether the request does not modify the state of the application, in
+    // which case it can be served by the replicas without being ordered.
+    virtual bool readOnly(uint8_t const *const /*request*/, size_t /*request_size*/) const {
+        return false;
+    }
+
+private:
+    std::vector<uint8_t> scratch_response;
+    std::vector<RequestView> batch_requests;
 };
 
 template<typename Iter, typename RandomGenerator>
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdlib>
+#include <algorithm>
 
 #include "app.hpp"
 
@@ -31,6 +32,19 @@ public:
         std::copy(request, request + request_size, response.rbegin());
     }
 
+    void executeBatch(std::vector<RequestView> const &requests, ResponseArena &responses) {
+        for (auto const &request : requests) {
+            auto *const response = responses.reserve(request.size);
+            std::reverse_copy(request.data, request.data + request.size, response);
+            responses.commit(request.size);
+        }
+    }
+
+    // Flipping is stateless.
+    bool readOnly(uint8_t const *const, size_t) const {
+        return true;
+    }
+
 private:
     std::vector<uint8_t> random_string(size_t min_length, size_t max_length) {
         const std::string CHARACTERS = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+#include <fmt/core.h>
+
+#include <dory/shared/logger.hpp>
+
+// MICA's helpers redefine the branching macros.
+#pragma push_macro("likely")
+#pragma push_macro("unlikely")
+#undef likely
+#undef unlikely
+#include <dory/third-party/mica/mica.h>
+#pragma pop_macro("unlikely")
+#pragma pop_macro("likely")
+
+#include "app.hpp"
+#include "../kvstores.hpp"
+#include "../workload.hpp"
+
+// An in-process key-value store backed by MICA, HERD's storage engine.
+//
+// Keys of any size are hashed into MICA's 16B keys. Values are stored in
+// fixed-size slots of `value_size` + 1 bytes (their length followed by the
+// padded value), as MICA updates values in place.
+class Herd : public Application {
+public:
+    enum Opcode : uint8_t { Get = 0, Put = 1 };
+    enum Status : uint8_t { Found = 0, NotFound = 1, Stored = 2, Invalid = 3 };
+
+    // Requests: opcode, key length, value length, key, value.
+    struct RequestHeader {
+        uint8_t opcode;
+        uint8_t key_size;
+        uint8_t value_size;
+    };
+
+    // Responses: status, value (for successful GETs).
+    static size_t constexpr ResponseHeaderSize = 1;
+
+    static size_t constexpr MaxValueSize = MICA_MAX_VALUE - 1;
+
+    Herd(bool server, std::string const &config_string) {
+        parse_config(config_string);
+        prepare_requests();
+
+        if (server) {
+            init_store();
+
+            // Preload the store
+            std::vector<RequestView> views;
+            ResponseArena responses;
+            auto const load = [&](std::vector<uint8_t> const &r) {
+                views.push_back({r.data(), r.size()});
+                if (views.size() == MICA_MAX_BATCH_SIZE) {
+                    executeBatch(views, responses);
+                    views.clear();
+                    responses.clear();
+                }
+            };
+            std::vector<std::vector<uint8_t>> load_requests;
+            if (workload) {
+                workload->forEachLoadRequest([&load_requests](std::vector<uint8_t> const &r) {
+                    load_requests.push_back(r);
+                });
+            }
+            for (auto const &r : load_requests) {
+                load(r);
+            }
+            for (auto const &r : prepared_requests) {
+                load(r);
+            }
+            executeBatch(views, responses);
+            LOGGER_INFO(logger, "Preloaded {} requests ({} index evictions)",
+                        load_requests.size() + prepared_requests.size(), kv->num_index_evictions);
+        }
+    }
+
+    ~Herd() {
+        if (kv) {
+            mica_free(&*kv);
+        }
+    }
+
+    Herd(Herd const &) = delete;
+    Herd &operator=(Herd const &) = delete;
+
+    size_t maxRequestSize() const {
+        return sizeof(RequestHeader) + key_size + value_size;
+    }
+
+    size_t maxResponseSize() const {
+        return ResponseHeaderSize + value_size;
+    }
+
+    std::vector<uint8_t> const& randomRequest() const {
+        if (workload) {
+            return workload->next();
+        }
+
+        if (rand() % 100 < get_percentage) {
+            return prepared_requests[prepared_requests_cnt + rand() % prepared_requests_cnt];
+        }
+
+        return prepared_requests[rand() % prepared_requests_cnt];
+    }
+
+    void execute(uint8_t const *const request, size_t request_size, std::vector<uint8_t> &response) {
+        batch_views.assign(1, {request, request_size});
+        batch_responses.clear();
+        executeBatch(batch_views, batch_responses);
+        response.assign(batch_responses.data(0), batch_responses.data(0) + batch_responses.size(0));
+    }
+
+    // Requests are executed by groups of up to MICA_MAX_BATCH_SIZE: MICA first
+    // prefetches the index buckets of the whole group, then their log entries,
+    // so that the cache misses of the group overlap.
+    void executeBatch(std::vector<RequestView> const &requests, ResponseArena &responses) {
+        size_t pending = 0;
+        for (auto const &request : requests) {
+            if (!valid(request.data, request.size)) {
+                // Responses are appended in order.
+                flush(pending, responses);
+                pending = 0;
+                *responses.reserve(1) = Invalid;
+                responses.commit(1);
+                continue;
+            }
+            auto const &header = *reinterpret_cast<RequestHeader const *>(request.data);
+            auto const *const key = request.data + sizeof(RequestHeader);
+            auto const hash = CityHash128(reinterpret_cast<char const *>(key), header.key_size);
+
+            // A request that depends on one of the group must see its effects:
+            // execute the group first.
+            if (conflicts(pending, hash, header.opcode)) {
+                flush(pending, responses);
+                pending = 0;
+            }
+
+            auto &op = ops[pending];
+            auto *const op_key = reinterpret_cast<unsigned long long *>(&op.key);
+            op_key[0] = hash.first;
+            op_key[1] = hash.second;
+            if (header.opcode == Get) {
+                op.opcode = MICA_OP_GET;
+                op.val_len = 0;
+            } else {
+                op.opcode = MICA_OP_PUT;
+                op.val_len = static_cast<uint8_t>(value_size + 1);
+                op.value[0] = header.value_size;
+                auto const *const value = key + header.key_size;
+                std::copy(value, value + header.value_size, op.value + 1);
+                std::fill(op.value + 1 + header.value_size, op.value + 1 + value_size, 0);
+            }
+            op_ptrs[pending] = &op;
+            if (++pending == MICA_MAX_BATCH_SIZE) {
+                flush(pending, responses);
+                pending = 0;
+            }
+        }
+        flush(pending, responses);
+    }
+
+    bool readOnly(uint8_t const *const request, size_t request_size) const {
+        return valid(request, request_size) && reinterpret_cast<RequestHeader const *>(request)->opcode == Get;
+    }
+
+    static std::vector<uint8_t> encodeGet(std::vector<uint8_t> const &key) {
+        std::vector<uint8_t> req(sizeof(RequestHeader) + key.size());
+        auto &header = *reinterpret_cast<RequestHeader *>(req.data());
+        header = {Get, static_cast<uint8_t>(key.size()), 0};
+        std::copy(key.begin(), key.end(), req.begin() + sizeof(RequestHeader));
+        return req;
+    }
+
+    static std::vector<uint8_t> encodePut(std::vector<uint8_t> const &key, size_t value_size) {
+        std::vector<uint8_t> req(sizeof(RequestHeader) + key.size() + value_size);
+        auto &header = *reinterpret_cast<RequestHeader *>(req.data());
+        header = {Put, static_cast<uint8_t>(key.size()), static_cast<uint8_t>(value_size)};
+        auto const value = std::copy(key.begin(), key.end(), req.begin() + sizeof(RequestHeader));
+        // mkrndstr_ipa NUL-terminates the string.
+        std::vector<uint8_t> random(value_size + 1);
+        kvstores::mkrndstr_ipa(static_cast<int>(value_size), random.data());
+        std::copy(random.begin(), random.begin() + static_cast<long>(value_size), value);
+        return req;
+    }
+
+private:
+    bool valid(uint8_t const *const request, size_t request_size) const {
+        if (request_size < sizeof(RequestHeader)) {
+            return false;
+        }
+        auto const &header = *reinterpret_cast<RequestHeader const *>(request);
+        switch (header.opcode) {
+            case Get:
+                return header.value_size == 0 && request_size == sizeof(RequestHeader) + header.key_size;
+            case Put:
+                return header.value_size <= value_size &&
+                       request_size == sizeof(RequestHeader) + header.key_size + header.value_size;
+            default:
+                return false;
+        }
+    }
+
+    bool conflicts(size_t pending, uint128 const &hash, uint8_t opcode) const {
+        for (size_t j = 0; j < pending; j++) {
+            auto const *const op_key = reinterpret_cast<unsigned long long const *>(&ops[j].key);
+            if (op_key[0] == hash.first && op_key[1] == hash.second &&
+                (opcode == Put || ops[j].opcode == MICA_OP_PUT)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void flush(size_t pending, ResponseArena &responses) {
+        if (pending == 0) {
+            return;
+        }
+        mica_batch_op(&*kv, static_cast<int>(pending), op_ptrs.data(), resps.data());
+        for (size_t j = 0; j < pending; j++) {
+            auto const &resp = resps[j];
+            auto *const response = responses.reserve(maxResponseSize());
+            switch (resp.type) {
+                case MICA_RESP_GET_SUCCESS: {
+                    auto const size = resp.val_ptr[0];
+                    response[0] = Found;
+                    std::copy(resp.val_ptr + 1, resp.val_ptr + 1 + size, response + ResponseHeaderSize);
+                    responses.commit(ResponseHeaderSize + size);
+                } break;
+                case MICA_RESP_GET_FAIL:
+                    response[0] = NotFound;
+                    responses.commit(1);
+                    break;
+                default:
+                    response[0] = Stored;
+                    responses.commit(1);
+                    break;
+            }
+        }
+    }
+
+    static size_t next_pow2(size_t x) {
+        size_t p = 1;
+        while (p < x) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    void init_store() {
+        // About one record per 8-slot bucket so that buckets (almost) never
+        // overflow, which would evict records, and a log that holds every
+        // record a few times over before wrapping around.
+        auto const records = std::max(distinct_keys, size_t(1));
+        auto const buckets = std::clamp(next_pow2(records), size_t(1024), size_t(M_16));
+        auto const entry_size = (sizeof(mica_key) + 2 + value_size + 1 + 7) / 8 * 8;
+        auto const log_cap = std::clamp(next_pow2(4 * records * entry_size), size_t(M_16), size_t(M_1024));
+
+        // MICA releases its log with free.
+        auto *const log = static_cast<uint8_t *>(std::aligned_alloc(64, log_cap));
+        if (log == nullptr) {
+            throw std::runtime_error("Failed to allocate MICA's log");
+        }
+        kv.emplace();
+        mica_init(&*kv, 0, static_cast<int>(buckets), static_cast<int>(log_cap), log);
+    }
+
+    // "key_size,value_size,get_percentage,get_success_percentage[,prepared_requests]"
+    // or "key_size,value_size,<workload settings>" (see workload::Spec::parse).
+    void parse_config(std::string const &config_string) {
+        auto const [numbers, settings] = workload::splitConfig(config_string);
+        std::stringstream ss(numbers);
+
+        std::vector<size_t> vec;
+        for (size_t i; ss >> i;) {
+            vec.push_back(i);
+            if (ss.peek() == ',') {
+                ss.ignore();
+            }
+        }
+
+        key_size = vec.at(0);
+        value_size = vec.at(1);
+        if (key_size == 0 || key_size > UINT8_MAX) {
+            throw std::invalid_argument(fmt::format("Herd keys must be 1 to {}B", UINT8_MAX));
+        }
+        if (value_size == 0 || value_size > MaxValueSize) {
+            throw std::invalid_argument(fmt::format("Herd values must be 1 to {}B", MaxValueSize));
+        }
+        if (settings) {
+            workload_spec = workload::Spec::parse(*settings, value_size);
+            return;
+        }
+        get_percentage = static_cast<int>(vec.at(2));
+        get_success_percentage = static_cast<int>(vec.at(3));
+        prepared_requests_cnt = vec.size() > 4 ? vec.at(4) : 1024;
+    }
+
+    // PUTs first so that preloading them makes the GETs hit, except for
+    // `100 - get_success_percentage`% of them.
+    void prepare_requests() {
+        if (workload_spec) {
+            workload.emplace(*workload_spec, key_size, encodeGet, encodePut);
+            distinct_keys = workload_spec->records;
+            return;
+        }
+
+        srand(1023);
+        std::vector<std::vector<uint8_t>> keys;
+
+        size_t unique_keys = prepared_requests_cnt + prepared_requests_cnt * (100 - get_success_percentage) / 100;
+        keys.resize(unique_keys);
+        distinct_keys = unique_keys;
+
+        for (size_t i = 0; i < unique_keys; i++) {
+            keys[i].resize(key_size + 1);
+            kvstores::mkrndstr_ipa(static_cast<int>(key_size), keys[i].data());
+            keys[i].resize(key_size);
+        }
+
+        size_t circular_index = 0;
+
+        for (size_t i = 0; i < prepared_requests_cnt; i++) {
+            prepared_requests.push_back(encodePut(keys[circular_index % unique_keys], value_size));
+            circular_index ++;
+        }
+
+        for (size_t i = 0; i < prepared_requests_cnt; i++) {
+            prepared_requests.push_back(encodeGet(keys[circular_index % unique_keys]));
+            circular_index ++;
+        }
+    }
+
+    size_t key_size;
+    size_t value_size;
+    int get_percentage;
+    int get_success_percentage;
+    size_t prepared_requests_cnt;
+    size_t distinct_keys = 0;
+
+    std::vector<std::vector<uint8_t>> prepared_requests;
+
+    std::optional<workload::Spec> workload_spec;
+    std::optional<workload::Workload> workload;
+
+    std::optional<mica_kv> kv;
+    alignas(64) std::array<mica_op, MICA_MAX_BATCH_SIZE> ops;
+    std::array<mica_op *, MICA_MAX_BATCH_SIZE> op_ptrs;
+    std::array<mica_resp, MICA_MAX_BATCH_SIZE> resps;
+
+    std::vector<RequestView> batch_views;
+    ResponseArena batch_responses;
+
+    LOGGER_DECL_INIT(logger, "Herd");
+};
@@ -3,12 +3,14 @@
 #include <cstdlib>
 #include <chrono>
 #include <algorithm>
+#include <optional>
 
-#include <dory/rpc/basic-client.hpp>
 #include <dory/shared/types.hpp>
 
 #include "app.hpp"
+#include "pipeline.hpp"
 #include "../kvstores.hpp"
+#include "../workload.hpp"
 
 class Memc : public Application {
 public:
@@ -20,17 +22,16 @@ public:
             kvstores::memcached::spawn_memc(memc_port);
             std::this_thread::sleep_for(std::chrono::seconds(2));
 
-            memc_rpc.emplace("127.0.0.1", memc_port);
-            if (!memc_rpc->connect()) {
-                throw std::runtime_error("Failed to connect to the local memc instance");
-            }
-    
+            memc_rpc.emplace("127.0.0.1", memc_port, parsers::memcached);
+
             // Warm up the server
             prepare_requests();
-            for (auto const &r : prepared_requests) {
-                memc_rpc->send(r.data(), r.size());
-                memc_rpc->recv();
+            if (workload) {
+                std::vector<std::vector<uint8_t>> load;
+                workload->forEachLoadRequest([&load](std::vector<uint8_t> const &r) { load.push_back(r); });
+                warmUp(load);
             }
+            warmUp(prepared_requests);
         } else {
             prepare_requests();
         }
@@ -50,6 +51,10 @@ public:
     }
 
     std::vector<uint8_t> const& randomRequest() const {
+        if (workload) {
+            return workload->next();
+        }
+
         if (rand() % 100 < get_percentage) {
             return prepared_requests[rand() % prepared_requests_cnt];
         }
@@ -59,22 +64,38 @@ public:
 
     void execute(uint8_t const *const request, size_t request_size, std::vector<uint8_t> &response) {
         // std::cout << "Request: " << kvstores::buff_repr(request, request + request_size) << std::endl;
+        RequestView const view{request, request_size};
+        memc_rpc->execute(&view, 1, [&response](size_t, uint8_t const *data, size_t size) {
+            response.resize(size);
+            std::copy(data, data + size, response.begin());
+        });
+    }
 
-        memc_rpc->send(request, request_size);
-        auto received = memc_rpc->recv();
+    // Requests are pipelined to the local memc instance.
+    void executeBatch(std::vector<RequestView> const &requests, ResponseArena &responses) {
+        memc_rpc->execute(requests.data(), requests.size(), [&responses](size_t, uint8_t const *data, size_t size) {
+            responses.append(data, size);
+        });
+    }
 
-        if (received.size() > 0) {
-            response.resize(received.size());
-            std::copy(received.begin(), received.end(), response.begin());
-            // std::cout << "Response: " << kvstores::buff_repr(response.begin(), response.end()) << std::endl;
-        } else {
-            throw std::runtime_error("Local memc instance failed to reply");
-        }
+    bool readOnly(uint8_t const *const request, size_t request_size) const {
+        return kvstores::memcached::is_get(request, request_size);
     }
 
 private:
+    void warmUp(std::vector<std::vector<uint8_t>> const &requests) {
+        std::vector<RequestView> views;
+        for (auto const &r : requests) {
+            views.push_back({r.data(), r.size()});
+        }
+        memc_rpc->execute(views.data(), views.size(), [](size_t, uint8_t const *, size_t) {});
+    }
+
+    // "key_size,value_size,get_percentage,get_success_percentage[,prepared_requests]"
+    // or "key_size,value_size,<workload settings>" (see workload::Spec::parse).
     void parse_config(std::string const &config_string) {
-        std::stringstream ss(config_string);
+        auto const [numbers, settings] = workload::splitConfig(config_string);
+        std::stringstream ss(numbers);
 
         std::vector<size_t> vec;
         for (size_t i; ss >> i;) {
@@ -86,12 +107,32 @@ private:
 
         key_size = static_cast<int>(vec.at(0));
         value_size = static_cast<int>(vec.at(1));
+        if (settings) {
+            workload_spec = workload::Spec::parse(*settings, static_cast<size_t>(value_size));
+            return;
+        }
         get_percentage = static_cast<int>(vec.at(2));
         get_success_percentage = static_cast<int>(vec.at(3));
         prepared_requests_cnt = vec.size() > 4 ? vec.at(4) : 1024;
     }
 
     void prepare_requests() {
+        if (workload_spec) {
+            workload.emplace(
+                *workload_spec, static_cast<size_t>(key_size),
+                [](std::vector<uint8_t> const &key) {
+                    std::vector<uint8_t> req(kvstores::memcached::get_buffer_size(static_cast<int>(key.size())));
+                    kvstores::memcached::get(req.data(), key);
+                    return req;
+                },
+                [](std::vector<uint8_t> const &key, size_t value_size) {
+                    std::vector<uint8_t> req(kvstores::memcached::put_buffer_size(static_cast<int>(key.size()), static_cast<int>(value_size)));
+                    kvstores::memcached::put(req.data(), key, static_cast<int>(value_size));
+                    return req;
+                });
+            return;
+        }
+
         srand(1023);
         std::vector<std::vector<uint8_t>> keys;
 
@@ -133,7 +174,10 @@ private:
     size_t prepared_requests_cnt;
     size_t get_end_index;
 
-    dory::Delayed<dory::rpc::RpcBasicClient> memc_rpc;
+    dory::Delayed<PipelinedConnection> memc_rpc;
 
     std::vector<std::vector<uint8_t>> prepared_requests;
+
+    std::optional<workload::Spec> workload_spec;
+    std::optional<workload::Workload> workload;
 };
\ No newline at end of file
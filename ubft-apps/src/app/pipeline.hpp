@@ -0,0 +1,231 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <dory/rpc/basic-client.hpp>
+
+#include "app.hpp"
+
+// Incremental response parsers: given the bytes received so far, they return
+// the length of the first complete response, or nullopt if more are needed.
+namespace parsers {
+inline std::optional<size_t> findCrlf(uint8_t const *data, size_t size, size_t from) {
+    for (size_t i = from; i + 1 < size; i++) {
+        if (data[i] == '\r' && data[i + 1] == '\n') {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+inline long parseInt(uint8_t const *begin, uint8_t const *end) {
+    long value = 0;
+    auto const [ptr, ec] = std::from_chars(reinterpret_cast<char const *>(begin),
+                                           reinterpret_cast<char const *>(end), value);
+    if (ec != std::errc() || ptr != reinterpret_cast<char const *>(end)) {
+        throw std::runtime_error("Invalid integer in a response");
+    }
+    return value;
+}
+
+// Memcached's text protocol: a single status line (e.g., STORED, END,
+// SERVER_ERROR ...), or VALUE blocks terminated by END.
+inline std::optional<size_t> memcachedText(uint8_t const *data, size_t size) {
+    static char const value_prefix[] = "VALUE ";
+    size_t constexpr ValuePrefixLen = sizeof(value_prefix) - 1;
+    size_t pos = 0;
+    while (true) {
+        auto const eol = findCrlf(data, size, pos);
+        if (!eol) {
+            return std::nullopt;
+        }
+        bool const is_value = *eol - pos > ValuePrefixLen &&
+                              std::equal(value_prefix, value_prefix + ValuePrefixLen, data + pos);
+        if (!is_value) {
+            return *eol + 2;
+        }
+        // VALUE <key> <flags> <bytes> [<cas>]
+        size_t field = 0;
+        uint8_t const *bytes_begin = nullptr;
+        uint8_t const *bytes_end = nullptr;
+        for (size_t i = pos; i <= *eol; i++) {
+            if (i == *eol || data[i] == ' ') {
+                if (field == 3) {
+                    bytes_end = data + i;
+                    break;
+                }
+                field++;
+                if (field == 3) {
+                    bytes_begin = data + i + 1;
+                }
+            }
+        }
+        if (bytes_begin == nullptr || bytes_end == nullptr) {
+            throw std::runtime_error("Invalid memcached VALUE line");
+        }
+        pos = *eol + 2 + static_cast<size_t>(parseInt(bytes_begin, bytes_end)) + 2;
+        if (pos > size) {
+            return std::nullopt;
+        }
+    }
+}
+
+// Memcached's binary protocol: a 24B header that carries the body length.
+inline std::optional<size_t> memcachedBinary(uint8_t const *data, size_t size) {
+    size_t constexpr HeaderSize = 24;
+    if (size < HeaderSize) {
+        return std::nullopt;
+    }
+    auto const body = (static_cast<size_t>(data[8]) << 24) | (static_cast<size_t>(data[9]) << 16) |
+                      (static_cast<size_t>(data[10]) << 8) | static_cast<size_t>(data[11]);
+    if (size < HeaderSize + body) {
+        return std::nullopt;
+    }
+    return HeaderSize + body;
+}
+
+inline std::optional<size_t> memcached(uint8_t const *data, size_t size) {
+    uint8_t constexpr BinaryResponseMagic = 0x81;
+    if (size > 0 && data[0] == BinaryResponseMagic) {
+        return memcachedBinary(data, size);
+    }
+    return memcachedText(data, size);
+}
+
+// Redis' RESP: returns the end of the value starting at `pos`.
+inline std::optional<size_t> respValue(uint8_t const *data, size_t size, size_t pos) {
+    if (pos >= size) {
+        return std::nullopt;
+    }
+    auto const eol = findCrlf(data, size, pos + 1);
+    if (!eol) {
+        return std::nullopt;
+    }
+    switch (data[pos]) {
+        case '+':
+        case '-':
+        case ':':
+            return *eol + 2;
+        case '$': {
+            auto const len = parseInt(data + pos + 1, data + *eol);
+            if (len < 0) {  // Null bulk string
+                return *eol + 2;
+            }
+            auto const end = *eol + 2 + static_cast<size_t>(len) + 2;
+            if (end > size) {
+                return std::nullopt;
+            }
+            return end;
+        }
+        case '*': {
+            auto const count = parseInt(data + pos + 1, data + *eol);
+            std::optional<size_t> end = *eol + 2;
+            for (long i = 0; i < count && end; i++) {
+                end = respValue(data, size, *end);
+            }
+            return end;
+        }
+        default:
+            throw std::runtime_error(fmt::format("Invalid RESP type `{}`", static_cast<char>(data[pos])));
+    }
+}
+
+inline std::optional<size_t> resp(uint8_t const *data, size_t size) {
+    return respValue(data, size, 0);
+}
+}  // namespace parsers
+
+// A connection to a local key-value store over which requests are pipelined:
+// they are written with a single writev and their responses are parsed as
+// they arrive, from a buffer that is reused across calls.
+class PipelinedConnection {
+public:
+    using Parser = std::optional<size_t> (*)(uint8_t const *, size_t);
+
+    // Bound the requests in flight so that neither side blocks on a full
+    // socket buffer while the other one is writing: once sent, requests must
+    // fit in the socket buffers (of the default size) even if the store
+    // stopped reading them as its responses are not read yet.
+    static size_t constexpr MaxDepth = 64;
+    static size_t constexpr MaxInflightBytes = 64 * 1024;
+    static size_t constexpr RecvChunk = 64 * 1024;
+
+    PipelinedConnection(std::string const &ip, int port, Parser parser)
+        : client{ip, port}, parser{parser} {
+        if (!client.connect()) {
+            throw std::runtime_error(fmt::format("Failed to connect to {}:{}", ip, port));
+        }
+        rx.resize(RecvChunk);
+    }
+
+    // Executes the requests in order and calls `on_response(i, data, size)`
+    // for each of them. The data is only valid during the call.
+    template <typename OnResponse>
+    void execute(RequestView const *requests, size_t count, OnResponse &&on_response) {
+        for (size_t first = 0, depth = 0; first < count; first += depth) {
+            // At least one request is sent, however big.
+            iov.clear();
+            size_t bytes = 0;
+            for (depth = 0; first + depth < count && depth < MaxDepth; depth++) {
+                auto const &request = requests[first + depth];
+                if (depth > 0 && bytes + request.size > MaxInflightBytes) {
+                    break;
+                }
+                bytes += request.size;
+                iov.push_back({const_cast<uint8_t *>(request.data), request.size});
+            }
+            if (!client.sendv(iov.data(), depth)) {
+                throw std::runtime_error("Failed to send requests to the local KV store");
+            }
+            for (size_t i = 0; i < depth; i++) {
+                auto const size = awaitResponse();
+                on_response(first + i, rx.data() + parsed, size);
+                parsed += size;
+            }
+        }
+    }
+
+private:
+    // Receive until a full response starts at `parsed` and return its size.
+    size_t awaitResponse() {
+        while (true) {
+            if (auto const size = parser(rx.data() + parsed, received - parsed)) {
+                return *size;
+            }
+            // Make room: drop what was parsed, grow if a single response
+            // does not fit.
+            if (parsed > 0) {
+                std::copy(rx.begin() + static_cast<long>(parsed), rx.begin() + static_cast<long>(received),
+                          rx.begin());
+                received -= parsed;
+                parsed = 0;
+            }
+            if (rx.size() - received < RecvChunk / 2) {
+                rx.resize(rx.size() * 2);
+            }
+            auto const ret = client.recvInto(rx.data() + received, rx.size() - received);
+            if (ret < 0) {
+                throw std::runtime_error("The local KV store failed to reply");
+            }
+            received += static_cast<size_t>(ret);
+        }
+    }
+
+    dory::rpc::RpcBasicClient client;
+    Parser parser;
+    std::vector<struct iovec> iov;
+    std::vector<uint8_t> rx;
+    size_t received = 0;
+    size_t parsed = 0;
+};
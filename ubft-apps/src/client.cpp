@@ -4,6 +4,7 @@
 #include <string>
 #include <memory>
 #include <queue>
+#include <thread>
 
 #include <lyra/lyra.hpp>
 
@@ -12,15 +13,22 @@
 
 #include <dory/shared/dynamic-bitset.hpp>
 #include <dory/shared/logger.hpp>
+#include <dory/shared/metrics.hpp>
+#include <dory/shared/pinning.hpp>
 #include <dory/shared/units.hpp>
 
 #include <dory/ubft/types.hpp>
 #include <dory/ubft/rpc/client.hpp>
+#include <dory/ubft/rpc/ud-client.hpp>
 #include <dory/shared/latency.hpp>
+#include <dory/shared/tsc.hpp>
+
+#include "load.hpp"
 
 #include "app/flip.hpp"
 #include "app/memc.hpp"
 #include "app/redis.hpp"
+#include "app/herd.hpp"
 #include "app/liquibook.hpp"
 
 static auto main_logger = dory::std_out_logger("Main");
@@ -41,7 +49,19 @@ int main(int argc, char *argv[]) {
   std::string app_config;
   bool check_flip = false;
   bool fast_path = false;
+  bool read_only_fast_path = false;
+  bool ud_transport = false;
+  double rate = 0;
+  std::string ramp;
+  std::string arrival = "constant";
+  size_t burst_size = 16;
+  size_t threads = 1;
+  int first_core = -1;
   bool dump_all_percentiles = false;
+  std::string latency_file;
+  std::string metrics_file;
+  std::string pages = "auto";
+  int numa_node = dory::ctrl::ControlBlock::NicNumaNode;
 
   cli.add_argument(lyra::help(get_help))
       .add_argument(lyra::opt(local_id, "id")
@@ -65,6 +85,18 @@ int main(int argc, char *argv[]) {
       .add_argument(lyra::opt(dump_all_percentiles)
                         .name("--dump-percentiles")
                         .help("Dump all percentiles"))
+      .add_argument(lyra::opt(latency_file, "path")
+                        .name("--latency-file")
+                        .help("Save the latency histogram, as JSON if `path` ends with .json, in a binary format to merge with other runs otherwise"))
+      .add_argument(lyra::opt(metrics_file, "file")
+                        .name("--metrics")
+                        .help("Expose live metrics in `file` (e.g., under /dev/shm) for ubft-metrics to read"))
+      .add_argument(lyra::opt(pages, "pages")
+                        .name("--pages")
+                        .help("Pages backing the RDMA buffers: auto, normal, thp, 2mb or 1gb (falls back to smaller ones)"))
+      .add_argument(lyra::opt(numa_node, "node")
+                        .name("--numa-node")
+                        .help("NUMA node of the RDMA buffers (-1: any, default: the NIC's)"))
       .add_argument(lyra::opt(app, "application")
                         .required()
                         .name("-a")
@@ -86,6 +118,32 @@ int main(int argc, char *argv[]) {
                         .name("-f")
                         .name("--fast-path")
                         .help("Do not send signed messages"))
+      .add_argument(lyra::opt(read_only_fast_path)
+                        .name("--read-only-fast-path")
+                        .help("Serve read-only requests without ordering them"))
+      .add_argument(lyra::opt(ud_transport)
+                        .name("--ud-transport")
+                        .help("Send requests as datagrams over a single UD QP (fast path only)"))
+      .add_argument(lyra::opt(rate, "req/s")
+                        .name("--rate")
+                        .help("Open loop: issue requests at this rate instead of keeping `window` outstanding"))
+      .add_argument(lyra::opt(ramp, "rate:seconds,...")
+                        .name("--ramp")
+                        .help("Open loop: rate schedule, e.g., 10000:5,20000:5 (overrides --rate)"))
+      .add_argument(lyra::opt(arrival, "process")
+                        .name("--arrival")
+                        .choices("constant", "poisson", "bursty")
+                        .help("Open loop: arrival process"))
+      .add_argument(lyra::opt(burst_size, "burst_size")
+                        .name("--burst-size")
+                        .help("Open loop: requests per burst with --arrival bursty"))
+      .add_argument(lyra::opt(threads, "threads")
+                        .name("-t")
+                        .name("--threads")
+                        .help("Client threads, the i-th one using id `id + i` and sending its own requests"))
+      .add_argument(lyra::opt(first_core, "core")
+                        .name("--first-core")
+                        .help("Pin the i-th client thread to core `core + i`"))
       .add_argument(lyra::opt(check_flip)
                       .name("--check")
                       .help("Check that the responses in the flip application are the inverse of the requests"));
@@ -104,6 +162,13 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+  bool const open_loop = rate > 0 || !ramp.empty();
+
+  if (!metrics_file.empty()) {
+    dory::metrics::Registry::instance().exposeAt(metrics_file);
+    LOGGER_INFO(main_logger, "Exposing metrics in {}", metrics_file);
+  }
+
   //// Initialize the crypto library ////
   dory::ubft::Crypto crypto(local_id, {});
 
@@ -131,57 +196,72 @@ int main(int argc, char *argv[]) {
 
   LOGGER_INFO(main_logger, "Configuring the control block");
   dory::ctrl::ControlBlock cb(resolved_port);
+  dory::ctrl::ControlBlock::AllocationPolicy allocation_policy;
+  allocation_policy.pages = dory::ctrl::ControlBlock::pagesFromStr(pages);
+  allocation_policy.numa_node = numa_node;
+  cb.setAllocationPolicy(allocation_policy);
 
   //// Create Memory Regions and QPs ////
   cb.registerPd("standard");
   cb.registerCq("unused");
 
   //// Application logic ////
-  LOGGER_INFO(main_logger, "Running `{}`", app);
-  std::unique_ptr<Application> chosen_app;
-  if (app == "flip") {
-    chosen_app = std::make_unique<Flip>(false, app_config);
-  } else if (app == "memc") {
-    chosen_app = std::make_unique<Memc>(false, app_config);
-  } else if (app == "redis") {
-    chosen_app = std::make_unique<Redis>(false, app_config);
-  } else if (app == "liquibook") {
-    auto liquibook_app = std::make_unique<Liquibook>(false, app_config);
-    liquibook_app->setClientId(local_id);
-    chosen_app = std::move(liquibook_app);
-  } else {
-    throw std::runtime_error("Unknown application");
+  LOGGER_INFO(main_logger, "Running `{}` from {} client thread(s)", app, threads);
+  // Each client thread has its own id and its own application instance.
+  std::vector<dory::ubft::ProcId> client_ids;
+  std::vector<std::unique_ptr<Application>> apps;
+  for (size_t i = 0; i < threads; i++) {
+    auto const client_id = local_id + static_cast<dory::ubft::ProcId>(i);
+    if (i != 0) {
+      crypto.publishPublicKeyAs(client_id);
+    }
+    client_ids.push_back(client_id);
+    if (app == "flip") {
+      apps.push_back(std::make_unique<Flip>(false, app_config));
+    } else if (app == "memc") {
+      apps.push_back(std::make_unique<Memc>(false, app_config));
+    } else if (app == "redis") {
+      apps.push_back(std::make_unique<Redis>(false, app_config));
+    } else if (app == "herd") {
+      apps.push_back(std::make_unique<Herd>(false, app_config));
+    } else if (app == "liquibook") {
+      auto liquibook_app = std::make_unique<Liquibook>(false, app_config);
+      liquibook_app->setClientId(client_id);
+      apps.push_back(std::move(liquibook_app));
+    } else {
+      throw std::runtime_error("Unknown application");
+    }
   }
 
-  dory::ubft::rpc::Client rpc_client(crypto, thread_pool, cb, local_id, 
-#ifdef UBFT
-    server_ids,
-#else
-    {server_id}, 
-#endif
-  "app", window, chosen_app->maxRequestSize(), chosen_app->maxResponseSize());
-
-  rpc_client.toggleSlowPath(!fast_path);
+  // Sends requests and awaits responses using either RPC client.
+  auto const run = [&](auto &rpc_client, Application &chosen_app, dory::ubft::ProcId const client_id,
+                       dory::LatencyProfiler &latency_profiler) {
+    rpc_client.toggleSlowPath(!fast_path);
   
-  dory::ubft::Buffer response(chosen_app->maxResponseSize());
+    dory::ubft::Buffer response(chosen_app.maxResponseSize());
 
-  dory::LatencyProfiler latency_profiler(0);
-  std::deque<std::chrono::steady_clock::time_point> request_posted_at;
-  std::chrono::steady_clock::time_point proposal_time;
+    // In open-loop mode, requests are timestamped when they were meant to be
+    // sent rather than when they were actually posted, so that queueing
+    // delays are accounted for (i.e., no coordinated omission).
+    // Timestamps are TSC ticks, which are cheaper to read than steady_clock.
+    std::deque<dory::TscClock::Ticks> request_posted_at;
 
-  size_t fulfilled_requests = 0;
-  size_t outstanding_requests = 0;
+    size_t fulfilled_requests = 0;
+    size_t outstanding_requests = 0;
 
-  // Used with the flip application to check the results
-  std::queue<std::vector<uint8_t>> check;
+    // Shared by all client threads.
+    auto issued = dory::metrics::Registry::instance().counter("client.issued");
+    auto completed = dory::metrics::Registry::instance().counter("client.completed");
+    auto backlogged = dory::metrics::Registry::instance().gauge("client.backlog");
 
-  while (fulfilled_requests < requests_to_send) {
-    rpc_client.tick();
-    while (auto const polled = rpc_client.poll(response.data())) {
-      latency_profiler.addMeasurement(std::chrono::steady_clock::now() -
-                                      request_posted_at.front());
+    // Used with the flip application to check the results
+    std::queue<std::vector<uint8_t>> check;
+
+    // Returns the latency of the completed request.
+    auto const complete = [&](size_t const polled) {
+      auto const latency = dory::TscClock::since(request_posted_at.front());
       request_posted_at.pop_front();
-      response.resize(*polled);
+      response.resize(polled);
 
       // std::cout << "Response: " << kvstores::buff_repr(response.cbegin(), response.cend()) << std::endl;
       // std::cout << "Response: " << Liquibook::resp_buff_repr(response.cbegin(), response.cend()) << std::endl;
@@ -189,7 +269,7 @@ int main(int argc, char *argv[]) {
       if (check_flip) {
         auto & original_request = check.front();
 
-        if (*polled != original_request.size()) {
+        if (polled != original_request.size()) {
           throw std::runtime_error("Response size was not the expected one!");
         }
 
@@ -204,10 +284,12 @@ int main(int argc, char *argv[]) {
 
       fulfilled_requests++;
       outstanding_requests--;
-    }
-    while (outstanding_requests < window &&
-           fulfilled_requests + outstanding_requests < requests_to_send) {
-      auto &request = chosen_app->randomRequest();
+      completed.add();
+      return latency;
+    };
+
+    auto const issue = [&](dory::TscClock::Ticks const intended_at) {
+      auto &request = chosen_app.randomRequest();
 
       // std::cout << "Request: " << kvstores::buff_repr(request.begin(), request.end()) << std::endl;
 
@@ -215,14 +297,126 @@ int main(int argc, char *argv[]) {
         check.push(request);
       }
 
-      auto slot = rpc_client.getSlot(request.size());
+      auto const read_only = read_only_fast_path &&
+                             chosen_app.readOnly(request.data(), request.size());
+      auto slot = rpc_client.getSlot(request.size(), read_only);
       std::copy(request.begin(), request.end(), *slot);
       outstanding_requests++;
-      request_posted_at.push_back(std::chrono::steady_clock::now());
+      request_posted_at.push_back(intended_at);
       rpc_client.post();
+      issued.add();
+    };
+
+    if (!open_loop) {
+      while (fulfilled_requests < requests_to_send) {
+        rpc_client.tick();
+        while (auto const polled = rpc_client.poll(response.data())) {
+          latency_profiler.addMeasurement(complete(*polled));
+        }
+        while (outstanding_requests < window &&
+               fulfilled_requests + outstanding_requests < requests_to_send) {
+          issue(dory::TscClock::now());
+        }
+      }
+      return;
     }
+
+    //// Open loop ////
+    auto const schedule = ramp.empty() ? load::RateSchedule(rate) : load::RateSchedule(ramp);
+    load::ArrivalProcess arrivals(load::ArrivalProcess::kindFromString(arrival),
+                                  burst_size, static_cast<uint64_t>(client_id));
+    auto const start = std::chrono::steady_clock::now();
+    load::IntervalReporter reporter(start, fmt::format("C{} ", client_id));
+    // Requests that arrived but could not be posted yet as the window is full.
+    std::deque<std::chrono::steady_clock::time_point> backlog;
+    auto next_arrival = start;
+    size_t arrived = 0;
+    bool arriving = true;
+
+    while (arriving || !backlog.empty() || outstanding_requests > 0) {
+      rpc_client.tick();
+      while (auto const polled = rpc_client.poll(response.data())) {
+        auto const latency = complete(*polled);
+        reporter.completed(latency);
+        latency_profiler.addMeasurement(latency);
+      }
+
+      auto const now = std::chrono::steady_clock::now();
+      auto const current_rate = schedule.rateAt(now - start);
+      if (current_rate == 0) {
+        arriving = false;
+      }
+      while (arriving && next_arrival <= now) {
+        backlog.push_back(next_arrival);
+        next_arrival += arrivals.next(current_rate);
+        if (++arrived == requests_to_send) {
+          arriving = false;
+        }
+      }
+      while (outstanding_requests < window && !backlog.empty()) {
+        issue(dory::TscClock::fromSteady(backlog.front()));
+        backlog.pop_front();
+      }
+      backlogged.set(backlog.size());
+      reporter.maybeReport(now, current_rate, backlog.size());
+    }
+  };
+
+  dory::TscClock::calibrate();
+  std::vector<dory::LatencyProfiler> latency_profilers(threads, dory::LatencyProfiler(0));
+
+  // Clients are built one after the other as the control block is not
+  // thread-safe, then each one is driven by its own thread.
+  auto const run_threads = [&](auto &rpc_clients) {
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; i++) {
+      workers.emplace_back([&, i] {
+        run(*rpc_clients[i], *apps[i], client_ids[i], latency_profilers[i]);
+      });
+      dory::set_thread_name(workers.back(), "client");
+      if (first_core >= 0) {
+        dory::pin_thread_to_core(workers.back(), first_core + static_cast<int>(i));
+      }
+    }
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  };
+
+  if (ud_transport) {
+    std::vector<std::unique_ptr<dory::ubft::rpc::UdClient>> rpc_clients;
+    for (size_t i = 0; i < threads; i++) {
+      rpc_clients.push_back(std::make_unique<dory::ubft::rpc::UdClient>(cb, client_ids[i],
+#ifdef UBFT
+      server_ids,
+#else
+      std::vector<dory::ubft::ProcId>{server_id},
+#endif
+      "app", window, apps[i]->maxRequestSize(), apps[i]->maxResponseSize()));
+    }
+    run_threads(rpc_clients);
+  } else {
+    std::vector<std::unique_ptr<dory::ubft::rpc::Client>> rpc_clients;
+    for (size_t i = 0; i < threads; i++) {
+      rpc_clients.push_back(std::make_unique<dory::ubft::rpc::Client>(crypto, thread_pool, cb, client_ids[i],
+#ifdef UBFT
+      server_ids,
+#else
+      std::vector<dory::ubft::ProcId>{server_id},
+#endif
+      "app", window, apps[i]->maxRequestSize(), apps[i]->maxResponseSize()));
+    }
+    run_threads(rpc_clients);
+  }
+
+  for (size_t i = 1; i < threads; i++) {
+    latency_profilers.front().merge(latency_profilers[i]);
+  }
+  latency_profilers.front().report(dump_all_percentiles);
+  if (!latency_file.empty()) {
+    latency_profilers.front().save(latency_file);
+    LOGGER_INFO(main_logger, "Latency histogram saved to {}", latency_file);
   }
-  latency_profiler.report(dump_all_percentiles);
 
   return 0;
 }
@@ -2,6 +2,7 @@
 
 #include <unistd.h>
 
+#include <algorithm>
 #include <array>
 #include <cctype>
 #include <cstdint>
@@ -240,6 +241,20 @@ static size_t get(void *buffer, std::vector<uint8_t> const& key) {
 
   return cur;
 }
+
+// Whether the request is a single-key get, which does not modify the store.
+inline bool is_get(uint8_t const *const buf, size_t const size) {
+  static char const prefix[] = "get ";
+  size_t const prefix_len = sizeof(prefix) - 1;
+  if (size < prefix_len + 1 + 2 ||
+      !std::equal(prefix, prefix + prefix_len, buf) ||
+      buf[size - 2] != '\r' || buf[size - 1] != '\n') {
+    return false;
+  }
+  return std::none_of(buf + prefix_len, buf + size - 2, [](uint8_t c) {
+    return c == ' ' || c == '\r' || c == '\n';
+  });
+}
 }  // namespace memcached
 
 namespace redis {
@@ -380,5 +395,23 @@ static size_t get(void *buffer, std::vector<uint8_t> const& key) {
 
   return cur;
 }
+
+// Whether the request is exactly `GET <key>`, which does not modify the store.
+inline bool is_get(uint8_t const *const buf, size_t const size) {
+  static char const prefix[] = "*2\r\n$3\r\nGET\r\n$";
+  size_t const prefix_len = sizeof(prefix) - 1;
+  if (size < prefix_len || !std::equal(prefix, prefix + prefix_len, buf)) {
+    return false;
+  }
+  size_t cur = prefix_len;
+  size_t key_size = 0;
+  size_t digits = 0;
+  for (; cur < size && std::isdigit(buf[cur]) && digits < 10; cur++, digits++) {
+    key_size = key_size * 10 + (buf[cur] - '0');
+  }
+  return digits > 0 && size - cur >= 4 && size - cur - 4 == key_size &&
+         buf[cur] == '\r' && buf[cur + 1] == '\n' && buf[size - 2] == '\r' &&
+         buf[size - 1] == '\n';
+}
 }  // namespace redis
 }  // namespace kvstores
@@ -0,0 +1,64 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+#include <lyra/lyra.hpp>
+
+#include <dory/shared/hdr-histogram.hpp>
+
+// Merges the latency histograms saved by `ubft-client --latency-file` and
+// `ubft-replay --latency-file` (in the binary format), e.g., of the clients of
+// a run, and prints the percentiles of the merged distribution.
+int main(int argc, char *argv[]) {
+  //// Parse Arguments ////
+  lyra::cli cli;
+  bool get_help = false;
+  std::vector<std::string> files;
+  std::string output;
+
+  cli.add_argument(lyra::help(get_help))
+      .add_argument(lyra::opt(files, "file")
+                        .required()
+                        .name("-f")
+                        .name("--file")
+                        .help("Binary histogram to merge (can be repeated)"))
+      .add_argument(lyra::opt(output, "path")
+                        .name("-o")
+                        .name("--output")
+                        .help("Save the merged histogram, as JSON if the path "
+                              "ends with .json, in the binary format otherwise"));
+
+  // Parse the program arguments.
+  auto result = cli.parse({argc, argv});
+
+  if (get_help) {
+    std::cout << cli;
+    return 0;
+  }
+
+  if (!result) {
+    std::cerr << "Error in command line: " << result.errorMessage()
+              << std::endl;
+    return 1;
+  }
+
+  auto merged = dory::HdrHistogram::load(files.front());
+  for (size_t i = 1; i < files.size(); i++) {
+    merged.merge(dory::HdrHistogram::load(files[i]));
+  }
+
+  fmt::print("Merged {} histograms: {} values ({} overflows)\n", files.size(),
+             merged.totalCount(), merged.overflowCount());
+  fmt::print("min (ns): {}, mean (ns): {:.1f}, max (ns): {}\n",
+             merged.minValue(), merged.mean(), merged.maxValue());
+  for (auto const p : {50., 90., 95., 99., 99.9, 99.99, 99.999}) {
+    fmt::print("{}th-percentile (ns): {}\n", p, merged.valueAtPercentile(p));
+  }
+
+  if (!output.empty()) {
+    merged.save(output);
+    fmt::print("Merged histogram saved to {}\n", output);
+  }
+  return 0;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <dory/shared/latency.hpp>
+
+// Open-loop load generation: requests arrive according to an arrival process
+// whose rate follows a schedule, independently of when responses come back.
+namespace load {
+using Clock = std::chrono::steady_clock;
+
+class ArrivalProcess {
+ public:
+  enum Kind { Constant, Poisson, Bursty };
+
+  static Kind kindFromString(std::string const &kind) {
+    if (kind == "constant") {
+      return Constant;
+    }
+    if (kind == "poisson") {
+      return Poisson;
+    }
+    if (kind == "bursty") {
+      return Bursty;
+    }
+    throw std::invalid_argument(fmt::format("Unknown arrival process `{}`", kind));
+  }
+
+  ArrivalProcess(Kind const kind, size_t const burst_size, uint64_t const seed)
+      : kind{kind}, burst_size{burst_size == 0 ? 1 : burst_size}, gen{seed} {}
+
+  // Time between the previous arrival and the next one, at `rate` req/s.
+  Clock::duration next(double const rate) {
+    double gap_s = 0;
+    switch (kind) {
+      case Constant:
+        gap_s = 1. / rate;
+        break;
+      case Poisson:
+        gap_s = std::exponential_distribution<double>(rate)(gen);
+        break;
+      case Bursty:
+        // `burst_size` requests arrive at once, bursts are spaced so that
+        // the average rate is preserved.
+        gap_s = (in_burst++ % burst_size == 0)
+                    ? static_cast<double>(burst_size) / rate
+                    : 0.;
+        break;
+    }
+    return std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(gap_s));
+  }
+
+ private:
+  Kind const kind;
+  size_t const burst_size;
+  size_t in_burst = 0;
+  std::mt19937_64 gen;
+};
+
+// A piecewise-constant rate: a list of (req/s, duration) steps, e.g.,
+// "10000:5,20000:5,40000:5" to ramp the throughput up every 5 seconds.
+class RateSchedule {
+ public:
+  using Step = std::pair<double, std::chrono::seconds>;
+
+  // A single step at `rate` that never ends.
+  RateSchedule(double const rate)
+      : steps{{rate, std::chrono::seconds(std::numeric_limits<int32_t>::max())}} {}
+
+  RateSchedule(std::string const &schedule) {
+    std::istringstream stream(schedule);
+    std::string step;
+    while (std::getline(stream, step, ',')) {
+      auto const colon = step.find(':');
+      if (colon == std::string::npos) {
+        throw std::invalid_argument(fmt::format("Invalid ramp step `{}`, expected rate:seconds", step));
+      }
+      auto const rate = std::stod(step.substr(0, colon));
+      auto const seconds = std::stol(step.substr(colon + 1));
+      if (rate <= 0 || seconds <= 0) {
+        throw std::invalid_argument(fmt::format("Invalid ramp step `{}`", step));
+      }
+      steps.emplace_back(rate, std::chrono::seconds(seconds));
+    }
+    if (steps.empty()) {
+      throw std::invalid_argument("Empty ramp schedule");
+    }
+  }
+
+  // The rate at `elapsed` since the start, or 0 once the schedule is over.
+  double rateAt(Clock::duration const elapsed) const {
+    Clock::duration step_end = Clock::duration::zero();
+    for (auto const &[rate, duration] : steps) {
+      step_end += duration;
+      if (elapsed < step_end) {
+        return rate;
+      }
+    }
+    return 0;
+  }
+
+ private:
+  std::vector<Step> steps;
+};
+
+// Latency percentiles of the requests completed during each interval.
+class IntervalReporter {
+ public:
+  IntervalReporter(Clock::time_point const start, std::string const &label = "",
+                   Clock::duration const interval = std::chrono::seconds(1))
+      : start{start}, label{label}, interval{interval}, interval_end{start + interval} {
+    profiler.emplace(0);
+  }
+
+  void completed(Clock::duration const latency) {
+    completions++;
+    profiler->addMeasurement(latency);
+  }
+
+  void maybeReport(Clock::time_point const now, double const offered_rate, size_t const backlog) {
+    if (now < interval_end) {
+      return;
+    }
+    auto const elapsed_s = std::chrono::duration<double>(interval_end - start).count();
+    auto const interval_s = std::chrono::duration<double>(interval).count();
+    auto const us = [this](double const perc) -> double {
+      return std::chrono::duration<double, std::micro>(profiler->percentile(perc)).count();
+    };
+    fmt::print("[{}{:.0f}s] offered: {:.0f} req/s, completed: {:.0f} req/s, backlog: {}, "
+               "p50: {:.1f}us, p90: {:.1f}us, p99: {:.1f}us, p99.9: {:.1f}us, >{}: {}\n",
+               label, elapsed_s, offered_rate, static_cast<double>(completions) / interval_s,
+               backlog, us(50), us(90), us(99), us(99.9),
+               profiler->prettyTime(dory::LatencyProfiler::Nano(profiler->histogram().highestTrackable())),
+               profiler->histogram().overflowCount());
+
+    profiler.emplace(0);
+    completions = 0;
+    interval_end += interval;
+  }
+
+ private:
+  Clock::time_point const start;
+  std::string const label;
+  Clock::duration const interval;
+  Clock::time_point interval_end;
+  std::optional<dory::LatencyProfiler> profiler;
+  size_t completions = 0;
+};
+}  // namespace load
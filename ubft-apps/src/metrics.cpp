@@ -0,0 +1,92 @@
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+#include <lyra/lyra.hpp>
+
+#include <dory/shared/metrics.hpp>
+
+// Samples the metrics exposed by `ubft-server --metrics` and `ubft-client
+// --metrics`. It only maps their pages read-only, so the observed processes
+// are never interrupted.
+int main(int argc, char *argv[]) {
+  //// Parse Arguments ////
+  lyra::cli cli;
+  bool get_help = false;
+  std::vector<std::string> files;
+  size_t interval_ms = 1000;
+  bool once = false;
+
+  cli.add_argument(lyra::help(get_help))
+      .add_argument(lyra::opt(files, "file")
+                        .required()
+                        .name("-f")
+                        .name("--file")
+                        .help("Metrics file to read (can be repeated)"))
+      .add_argument(lyra::opt(interval_ms, "interval_ms")
+                        .name("-i")
+                        .name("--interval")
+                        .help("Sampling interval (ms)"))
+      .add_argument(lyra::opt(once)
+                        .name("--once")
+                        .help("Print the current values and exit"));
+
+  // Parse the program arguments.
+  auto result = cli.parse({argc, argv});
+
+  if (get_help) {
+    std::cout << cli;
+    return 0;
+  }
+
+  if (!result) {
+    std::cerr << "Error in command line: " << result.errorMessage()
+              << std::endl;
+    return 1;
+  }
+
+  std::vector<dory::metrics::Reader> readers;
+  for (auto const &file : files) {
+    readers.emplace_back(file);
+  }
+
+  using Clock = std::chrono::steady_clock;
+  std::vector<std::map<std::string, uint64_t>> previous(readers.size());
+  auto previous_at = Clock::now();
+
+  while (true) {
+    auto const now = Clock::now();
+    auto const elapsed_s = std::chrono::duration<double>(now - previous_at).count();
+    previous_at = now;
+
+    for (size_t r = 0; r < readers.size(); r++) {
+      auto const &reader = readers[r];
+      fmt::print("== {} (pid {}{})\n", reader.file(), reader.pid(),
+                 reader.alive() ? "" : ", exited");
+      for (auto const &sample : reader.sample()) {
+        if (sample.kind == dory::metrics::Kind::Gauge) {
+          fmt::print("  {:<48} {:>16}\n", sample.name, sample.value);
+          continue;
+        }
+        auto const prev_it = previous[r].find(sample.name);
+        if (once || prev_it == previous[r].end() || elapsed_s == 0) {
+          fmt::print("  {:<48} {:>16}\n", sample.name, sample.value);
+        } else {
+          auto const rate = static_cast<double>(sample.value - prev_it->second) / elapsed_s;
+          fmt::print("  {:<48} {:>16} {:>14.1f}/s\n", sample.name, sample.value, rate);
+        }
+        previous[r][sample.name] = sample.value;
+      }
+    }
+
+    if (once) {
+      return 0;
+    }
+    fmt::print("\n");
+    std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+  }
+}
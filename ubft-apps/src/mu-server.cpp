@@ -16,10 +16,37 @@
 #include "app/flip.hpp"
 #include "app/memc.hpp"
 #include "app/redis.hpp"
+#include "app/herd.hpp"
 #include "app/liquibook.hpp"
 
 static auto main_logger = dory::std_out_logger("Init");
 
+// Requests to execute at once, along with their responses. Requests stay
+// valid until executed.
+struct ExecutionBatch {
+  void add(dory::ubft::rpc::Server::Request const &request) {
+    requests.push_back({request.payload(), request.size()});
+    ids.emplace_back(request.clientId(), request.id());
+  }
+
+  void execute(Application &app, dory::ubft::rpc::Server &rpc_server) {
+    if (requests.empty()) {
+      return;
+    }
+    responses.clear();
+    app.executeBatch(requests, responses);
+    for (size_t i = 0; i < ids.size(); i++) {
+      rpc_server.executed(ids[i].first, ids[i].second, responses.data(i), responses.size(i));
+    }
+    requests.clear();
+    ids.clear();
+  }
+
+  std::vector<RequestView> requests;
+  std::vector<std::pair<dory::ubft::ProcId, dory::ubft::RequestId>> ids;
+  ResponseArena responses;
+};
+
 int main(int argc, char* argv[]) {
   //// Parse Arguments ////
   lyra::cli cli;
@@ -117,6 +144,8 @@ int main(int argc, char* argv[]) {
     chosen_app = std::make_unique<Memc>(true, app_config);
   } else if (app == "redis") {
     chosen_app = std::make_unique<Redis>(true, app_config);
+  } else if (app == "herd") {
+    chosen_app = std::make_unique<Herd>(true, app_config);
   } else if (app == "liquibook") {
     chosen_app = std::make_unique<Liquibook>(true, app_config);
   } else {
@@ -139,19 +168,19 @@ int main(int argc, char* argv[]) {
     remote_ids.push_back(id);
   }
 
+  // Requests polled during a tick are executed together once all polled.
+  ExecutionBatch batch;
+
   if (remote_ids.size() == 0) {
     LOGGER_INFO(main_logger, "Running without replication");
 
-    std::vector<uint8_t> response;
-    response.reserve(chosen_app->maxResponseSize());
     while (true) {
       rpc_server.tick();
-      if (auto polled_received = rpc_server.pollReceived()) {
+      while (auto polled_received = rpc_server.pollReceived()) {
           auto& request = polled_received->get();
-          chosen_app->execute(request.payload(), request.size(), response);
-          rpc_server.executed(request.clientId(), request.id(), response.data(),
-                              response.size());
+          batch.add(request);
       }
+      batch.execute(*chosen_app, rpc_server);
     }
 
     return 0;
@@ -177,11 +206,9 @@ int main(int argc, char* argv[]) {
               "Waiting some time to make the consensus engine ready");
   std::this_thread::sleep_for(std::chrono::seconds(5));
 
-  std::vector<uint8_t> response;
-  response.reserve(chosen_app->maxResponseSize());
   while (true) {
     rpc_server.tick();
-    if (auto polled_received = rpc_server.pollReceived()) {
+    while (auto polled_received = rpc_server.pollReceived()) {
         auto& request = polled_received->get();
 
         dory::ProposeError err = consensus.propose(request.payload(), request.size());
@@ -218,11 +245,10 @@ int main(int argc, char* argv[]) {
               fmt::print("Bug in code. You should only handle errors here\n");
           }
         } else {
-          chosen_app->execute(request.payload(), request.size(), response);
-          rpc_server.executed(request.clientId(), request.id(), response.data(),
-                              response.size());
+          batch.add(request);
         }
     }
+    batch.execute(*chosen_app, rpc_server);
   }
 
   return 0;
@@ -0,0 +1,127 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <lyra/lyra.hpp>
+
+#include <dory/shared/latency.hpp>
+#include <dory/shared/logger.hpp>
+#include <dory/shared/tsc.hpp>
+
+#include <dory/ubft/decided-log.hpp>
+
+#include "app/flip.hpp"
+#include "app/memc.hpp"
+#include "app/redis.hpp"
+#include "app/herd.hpp"
+#include "app/liquibook.hpp"
+
+static auto main_logger = dory::std_out_logger("Replay");
+
+// Executes the requests recorded by `ubft-server --record-decisions` without
+// any network or consensus, to benchmark the execution layer alone.
+int main(int argc, char *argv[]) {
+  //// Parse Arguments ////
+  lyra::cli cli;
+  bool get_help = false;
+  std::string log_file;
+  std::string app;
+  std::string app_config;
+  size_t repetitions = 1;
+  bool dump_all_percentiles = false;
+  std::string latency_file;
+
+  cli.add_argument(lyra::help(get_help))
+      .add_argument(lyra::opt(log_file, "file")
+                        .required()
+                        .name("-f")
+                        .name("--file")
+                        .help("Decided log to replay"))
+      .add_argument(lyra::opt(app, "application")
+                        .required()
+                        .name("-a")
+                        .name("--application")
+                        .choices("flip", "memc", "redis", "herd", "liquibook")("Which application to run"))
+      .add_argument(lyra::opt(app_config, "app_config")
+                        .name("-c")
+                        .name("--app-config")
+                        .help("App specific config"))
+      .add_argument(lyra::opt(repetitions, "repetitions")
+                        .name("-r")
+                        .name("--repetitions")
+                        .help("How many times to replay the log"))
+      .add_argument(lyra::opt(dump_all_percentiles)
+                        .name("--dump-percentiles")
+                        .help("Dump all percentiles"))
+      .add_argument(lyra::opt(latency_file, "path")
+                        .name("--latency-file")
+                        .help("Save the latency histogram (JSON if `path` ends with .json, binary otherwise)"));
+
+  // Parse the program arguments.
+  auto result = cli.parse({argc, argv});
+
+  if (get_help) {
+    std::cout << cli;
+    return 0;
+  }
+
+  if (!result) {
+    std::cerr << "Error in command line: " << result.errorMessage()
+              << std::endl;
+    return 1;
+  }
+
+  //// Application logic ////
+  LOGGER_INFO(main_logger, "Replaying `{}` through `{}`", log_file, app);
+  std::unique_ptr<Application> chosen_app;
+  if (app == "flip") {
+    chosen_app = std::make_unique<Flip>(true, app_config);
+  } else if (app == "memc") {
+    chosen_app = std::make_unique<Memc>(true, app_config);
+  } else if (app == "redis") {
+    chosen_app = std::make_unique<Redis>(true, app_config);
+  } else if (app == "herd") {
+    chosen_app = std::make_unique<Herd>(true, app_config);
+  } else if (app == "liquibook") {
+    chosen_app = std::make_unique<Liquibook>(true, app_config);
+  } else {
+    throw std::runtime_error("Unknown application");
+  }
+
+  dory::ubft::DecidedLogReader reader(log_file);
+  LOGGER_INFO(main_logger, "Log of {} bytes opened", reader.bytes());
+
+  std::vector<uint8_t> response;
+  response.reserve(chosen_app->maxResponseSize());
+
+  dory::TscClock::calibrate();
+  dory::LatencyProfiler latency_profiler(0);
+  size_t executed = 0;
+  size_t executed_bytes = 0;
+
+  auto const start = std::chrono::steady_clock::now();
+  for (size_t r = 0; r < repetitions; r++) {
+    reader.rewind();
+    while (auto const entry = reader.next()) {
+      auto const before = dory::TscClock::now();
+      chosen_app->execute(entry->payload, entry->size, response);
+      latency_profiler.addMeasurement(dory::TscClock::since(before));
+      executed++;
+      executed_bytes += entry->size;
+    }
+  }
+  auto const elapsed = std::chrono::steady_clock::now() - start;
+
+  auto const seconds = std::chrono::duration<double>(elapsed).count();
+  LOGGER_INFO(main_logger, "Executed {} requests ({} bytes) in {:.3f}s: {:.0f} req/s",
+              executed, executed_bytes, seconds,
+              seconds > 0 ? static_cast<double>(executed) / seconds : 0.);
+  latency_profiler.report(dump_all_percentiles);
+  if (!latency_file.empty()) {
+    latency_profiler.save(latency_file);
+    LOGGER_INFO(main_logger, "Latency histogram saved to {}", latency_file);
+  }
+
+  return 0;
+}
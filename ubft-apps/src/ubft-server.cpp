@@ -1,3 +1,4 @@
+#include <atomic>
 #include <chrono>
 #include <csignal>
 #include <unistd.h>
@@ -8,14 +9,19 @@
 #include <dory/ctrl/device.hpp>
 
 #include <dory/shared/logger.hpp>
+#include <dory/shared/metrics.hpp>
 #include <dory/shared/units.hpp>
 #include <dory/special/proc-mem.hpp>
 
+#include <dory/ubft/completion-dispatcher.hpp>
 #include <dory/ubft/server-builder.hpp>
+#include <dory/ubft/tick-profiler.hpp>
+#include <dory/ubft/tracing.hpp>
 
 #include "app/flip.hpp"
 #include "app/memc.hpp"
 #include "app/redis.hpp"
+#include "app/herd.hpp"
 #include "app/liquibook.hpp"
 
 
@@ -30,6 +36,10 @@ static void signalHandler(int signum) {
   std::cout << "Process memory consumption (in bytes):\n" << consumption.toString() << std::endl;
 }
 
+static std::atomic<bool> stop_requested{false};
+
+static void stopHandler(int /* signum */) { stop_requested = true; }
+
 int main(int argc, char *argv[]) {
   //// Parse Arguments ////
   lyra::cli cli;
@@ -38,8 +48,23 @@ int main(int argc, char *argv[]) {
   std::vector<dory::ubft::ProcId> server_ids;
   size_t client_window = 16;
   bool optimistic_rpc = false;
+  bool digest_proposals = false;
+  bool digest_responses = false;
+  bool ud_clients = false;
   bool fast_path = false;
+  bool monitor_progress = false;
+  size_t echo_timeout_ms = 5;
+  size_t fast_commit_timeout_ms = 5;
+  size_t decision_timeout_ms = 50;
+  size_t stable_period_ms = 1000;
   bool dump_vm_consumption = false;
+  std::string record_decisions;
+  std::string trace_file;
+  std::string metrics_file;
+  size_t profile_ticks_ms = 0;
+  bool profile_hw_counters = false;
+  std::string pages = "auto";
+  int numa_node = dory::ctrl::ControlBlock::NicNumaNode;
   size_t consensus_window = 256;
   size_t consensus_cb_tail = 128;
   size_t consensus_batch_size = 16;
@@ -74,10 +99,65 @@ int main(int argc, char *argv[]) {
                         .name("-o")
                         .name("--optimistic-rpc")
                         .help("Propose requests without waiting for echoes"))
+      .add_argument(lyra::opt(digest_proposals)
+                        .name("-d")
+                        .name("--digest-proposals")
+                        .help("Reference requests by digest in proposals"))
+      .add_argument(lyra::opt(digest_responses)
+                        .name("--digest-responses")
+                        .help("Only one replica sends the full response"))
+      .add_argument(lyra::opt(ud_clients)
+                        .name("--ud-clients")
+                        .help("Also accept requests from clients over UD"))
       .add_argument(lyra::opt(fast_path)
                         .name("-f")
                         .name("--consensus-fast-path")
                         .help("Enable consensus' fast path"))
+      .add_argument(lyra::opt(monitor_progress)
+                        .name("-m")
+                        .name("--monitor-progress")
+                        .help("Switch paths/leader upon lack of progress"))
+      .add_argument(lyra::opt(echo_timeout_ms, "echo_timeout_ms")
+                        .name("--echo-timeout")
+                        .help("Echo completion timeout (ms)"))
+      .add_argument(lyra::opt(fast_commit_timeout_ms, "fast_commit_timeout_ms")
+                        .name("--fast-commit-timeout")
+                        .help("Fast commit quorum timeout (ms)"))
+      .add_argument(lyra::opt(decision_timeout_ms, "decision_timeout_ms")
+                        .name("--decision-timeout")
+                        .help("Decision timeout (ms)"))
+      .add_argument(lyra::opt(stable_period_ms, "stable_period_ms")
+                        .name("--stable-period")
+                        .help("Stable period before going back to the fast "
+                              "path (ms)"))
+      .add_argument(lyra::opt(record_decisions, "file")
+                        .name("--record-decisions")
+                        .help("Record decided requests to replay them offline"))
+      .add_argument(lyra::opt(trace_file, "file")
+                        .name("--trace")
+                        .help("Export per-request traces (Chrome JSON) upon "
+                              "SIGINT/SIGTERM, requires a TRACING build"))
+      .add_argument(lyra::opt(metrics_file, "file")
+                        .name("--metrics")
+                        .help("Expose live metrics in `file` (e.g., under "
+                              "/dev/shm) for ubft-metrics to read"))
+      .add_argument(lyra::opt(profile_ticks_ms, "period_ms")
+                        .name("--profile-ticks")
+                        .help("Print where the hot loop spends its cycles "
+                              "every `period_ms`, requires a TICK_PROFILING "
+                              "build"))
+      .add_argument(lyra::opt(profile_hw_counters)
+                        .name("--profile-hw-counters")
+                        .help("Also count instructions, LLC and branch misses "
+                              "per tick phase"))
+      .add_argument(lyra::opt(pages, "pages")
+                        .name("--pages")
+                        .help("Pages backing the RDMA buffers: auto, normal, "
+                              "thp, 2mb or 1gb (falls back to smaller ones)"))
+      .add_argument(lyra::opt(numa_node, "node")
+                        .name("--numa-node")
+                        .help("NUMA node of the RDMA buffers (-1: any, "
+                              "default: the NIC's)"))
       .add_argument(lyra::opt(dump_vm_consumption)
                         .name("--dump-vm-consumption")
                         .help("Dump the memory consumption"))
@@ -108,6 +188,27 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+  if (!trace_file.empty()) {
+    if (!dory::ubft::tracing::Enabled) {
+      std::cerr << "--trace requires a build with TRACING defined (e.g., "
+                   "ubft-server-tracing)" << std::endl;
+      return 1;
+    }
+    signal(SIGINT, stopHandler);
+    signal(SIGTERM, stopHandler);
+  }
+
+  if (profile_ticks_ms != 0 && !dory::ubft::tick_profiler::Enabled) {
+    std::cerr << "--profile-ticks requires a build with TICK_PROFILING defined "
+                 "(e.g., ubft-server-tick-profiling)" << std::endl;
+    return 1;
+  }
+
+  if (!metrics_file.empty()) {
+    dory::metrics::Registry::instance().exposeAt(metrics_file);
+    LOGGER_INFO(main_logger, "Exposing metrics in {}", metrics_file);
+  }
+
   if (dump_vm_consumption) {
     signal(SIGUSR1, signalHandler);
     std::cout << "PID" << getpid() << "PID" <<std::endl;
@@ -140,6 +241,10 @@ int main(int argc, char *argv[]) {
 
   LOGGER_INFO(main_logger, "Configuring the control block");
   dory::ctrl::ControlBlock cb(resolved_port);
+  dory::ctrl::ControlBlock::AllocationPolicy allocation_policy;
+  allocation_policy.pages = dory::ctrl::ControlBlock::pagesFromStr(pages);
+  allocation_policy.numa_node = numa_node;
+  cb.setAllocationPolicy(allocation_policy);
 
   //// Create Memory Regions and QPs ////
   cb.registerPd("standard");
@@ -161,12 +266,19 @@ int main(int argc, char *argv[]) {
     chosen_app = std::make_unique<Memc>(true, app_config);
   } else if (app == "redis") {
     chosen_app = std::make_unique<Redis>(true, app_config);
+  } else if (app == "herd") {
+    chosen_app = std::make_unique<Herd>(true, app_config);
   } else if (app == "liquibook") {
     chosen_app = std::make_unique<Liquibook>(true, app_config);
   } else {
     throw std::runtime_error("Unknown application");
   }
 
+  // All the RDMA abstractions of the replica are ticked by this thread: their
+  // send completions go to a single CQ that is polled once per tick.
+  dory::ubft::CompletionDispatcher completions(cb, "server");
+  dory::ubft::CompletionDispatcher::Scope completions_scope(completions);
+
   dory::ubft::ServerBuilder server_builder(
       cb, local_id, server_ids, "app", crypto, thread_pool, chosen_app->maxRequestSize(),
       chosen_app->maxResponseSize(), min_client_id, max_client_id, client_window,
@@ -183,31 +295,78 @@ int main(int argc, char *argv[]) {
   store.barrier("abstractions_initialized", server_ids.size());
 
   server.toggleRpcOptimism(optimistic_rpc);
+  server.toggleDigestProposals(digest_proposals);
+  server.toggleDigestResponses(digest_responses);
+  if (ud_clients) {
+    server.acceptUdClients();
+  }
   server.toggleSlowPath(!fast_path);
+  if (monitor_progress) {
+    dory::ubft::ProgressMonitor::Timeouts timeouts;
+    timeouts.echo = std::chrono::milliseconds(echo_timeout_ms);
+    timeouts.fast_commit = std::chrono::milliseconds(fast_commit_timeout_ms);
+    timeouts.decision = std::chrono::milliseconds(decision_timeout_ms);
+    timeouts.stable = std::chrono::milliseconds(stable_period_ms);
+    server.monitorProgress(timeouts);
+  }
+  if (!record_decisions.empty()) {
+    server.recordDecisions(record_decisions);
+  }
 
   std::array<uint8_t, 1> empty_app_state;
   std::vector<uint8_t> response;
 
   auto const idle = *std::max_element(server_ids.begin(), server_ids.end());
 
+  // Decided batches are executed at once, their responses being written to a
+  // reusable arena.
+  ResponseArena responses;
+
   response.reserve(chosen_app->maxResponseSize());
-  while (true) {
+  if (profile_ticks_ms != 0) {
+    dory::ubft::tick_profiler::enable(std::chrono::milliseconds(profile_ticks_ms),
+                                      profile_hw_counters);
+  }
+  while (!stop_requested) {
+    dory::ubft::tick_profiler::Iteration iteration;
     server.tick();
-    while (auto polled = server.pollToExecute()) {
+    dory::ubft::tick_profiler::Scope execution(dory::ubft::tick_profiler::Phase::Execution);
+    while (auto decided = server.pollBatchToExecute()) {
       while (unlikely(!fast_path && local_id == idle)) {
         // In case of slow path, the last server doesn't react.
         // We wait here so that the client could connect.
         continue;
       }
 
-      auto &[request, should_checkpoint] = *polled;
+      auto &[batch, should_checkpoint] = *decided;
 
-      chosen_app->execute(request.payload(), request.size(), response);
-      server.executed(request, response.data(), response.size());
+      responses.clear();
+      chosen_app->executeBatch(batch, responses);
+      size_t i = 0;
+      for (auto it = batch.requests(); !it.done(); ++it, ++i) {
+        server.executed(*it, responses.data(i), responses.size(i));
+      }
 
       if (should_checkpoint) {
         server.checkpointAppState(empty_app_state.begin(), empty_app_state.end());
       }
     }
+    // Read-only requests are served right away, on top of all the executed
+    // requests.
+    while (auto request = server.pollReadOnly()) {
+      if (unlikely(!chosen_app->readOnly(request->payload(), request->size()))) {
+        LOGGER_WARN(main_logger, "Client {} tagged a mutating request as read-only, dropping it.",
+                    request->clientId());
+        continue;
+      }
+      chosen_app->execute(request->payload(), request->size(), response);
+      server.executedReadOnly(*request, response.data(), response.size());
+    }
+  }
+
+  if (!trace_file.empty()) {
+    LOGGER_INFO(main_logger, "Exporting traces to `{}`", trace_file);
+    dory::ubft::tracing::exportChromeTrace(trace_file, local_id);
   }
+  return 0;
 }
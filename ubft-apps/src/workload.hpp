@@ -0,0 +1,400 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+
+// Skewed, YCSB-style key-value workloads.
+//
+// The whole sequence of operations is generated upfront: each distinct
+// request is encoded once by the application and the trace only stores its
+// index, so that picking the next request costs nothing on the client's hot
+// loop.
+namespace workload {
+enum class Op : uint8_t { Read, Update, Insert, ReadModifyWrite };
+
+enum class KeyDistribution { Uniform, Zipfian, Hotspot, Latest };
+
+// Proportions of each operation, they do not need to sum to 1.
+struct Mix {
+  double read = 1;
+  double update = 0;
+  double insert = 0;
+  double rmw = 0;
+};
+
+struct Spec {
+  Mix mix;
+  KeyDistribution distribution = KeyDistribution::Uniform;
+  double zipf_theta = 0.99;
+  double hot_set_fraction = 0.2;     // Hotspot: fraction of the keys that are
+  double hot_ops_fraction = 0.8;     // hot and of the operations on them.
+  size_t records = 1024;             // Keys loaded before the run.
+  size_t min_value_size = 0;         // Defaults to the max, i.e., fixed.
+  size_t max_value_size = 0;
+  size_t value_size_classes = 8;     // Sizes are quantized to bound the
+                                     // number of distinct requests.
+  size_t trace_length = 1 << 18;
+  uint64_t seed = 1023;
+
+  // Apply one of the YCSB core workloads (a to f). E (short scans) is
+  // approximated with reads as the KV apps do not support scans.
+  void preset(char const workload) {
+    switch (workload) {
+      case 'a':
+        mix = {0.5, 0.5, 0, 0};
+        distribution = KeyDistribution::Zipfian;
+        break;
+      case 'b':
+        mix = {0.95, 0.05, 0, 0};
+        distribution = KeyDistribution::Zipfian;
+        break;
+      case 'c':
+        mix = {1, 0, 0, 0};
+        distribution = KeyDistribution::Zipfian;
+        break;
+      case 'd':
+        mix = {0.95, 0, 0.05, 0};
+        distribution = KeyDistribution::Latest;
+        break;
+      case 'e':
+        mix = {0.95, 0, 0.05, 0};
+        distribution = KeyDistribution::Zipfian;
+        break;
+      case 'f':
+        mix = {0.5, 0, 0, 0.5};
+        distribution = KeyDistribution::Zipfian;
+        break;
+      default:
+        throw std::invalid_argument(
+            fmt::format("Unknown YCSB workload `{}`", workload));
+    }
+  }
+
+  // Parse comma-separated `key=value` settings, e.g.,
+  // "ycsb=b,theta=0.9,records=100000,min_value=16".
+  static Spec parse(std::string const &settings, size_t const max_value_size) {
+    Spec spec;
+    spec.max_value_size = max_value_size;
+    spec.min_value_size = max_value_size;
+
+    std::stringstream ss(settings);
+    std::string setting;
+    while (std::getline(ss, setting, ',')) {
+      auto const eq = setting.find('=');
+      if (eq == std::string::npos) {
+        throw std::invalid_argument(
+            fmt::format("Invalid workload setting `{}`", setting));
+      }
+      auto const key = setting.substr(0, eq);
+      auto const value = setting.substr(eq + 1);
+      if (key == "ycsb") {
+        spec.preset(value.empty() ? ' ' : value.front());
+      } else if (key == "dist") {
+        spec.distribution = distributionFromString(value);
+      } else if (key == "theta") {
+        spec.zipf_theta = std::stod(value);
+      } else if (key == "hot_set") {
+        spec.hot_set_fraction = std::stod(value);
+      } else if (key == "hot_ops") {
+        spec.hot_ops_fraction = std::stod(value);
+      } else if (key == "records") {
+        spec.records = std::stoul(value);
+      } else if (key == "min_value") {
+        spec.min_value_size = std::min(std::stoul(value), max_value_size);
+      } else if (key == "value_classes") {
+        spec.value_size_classes = std::max(std::stoul(value), 1UL);
+      } else if (key == "read") {
+        spec.mix.read = std::stod(value);
+      } else if (key == "update") {
+        spec.mix.update = std::stod(value);
+      } else if (key == "insert") {
+        spec.mix.insert = std::stod(value);
+      } else if (key == "rmw") {
+        spec.mix.rmw = std::stod(value);
+      } else if (key == "trace") {
+        spec.trace_length = std::stoul(value);
+      } else if (key == "seed") {
+        spec.seed = std::stoull(value);
+      } else {
+        throw std::invalid_argument(
+            fmt::format("Unknown workload setting `{}`", key));
+      }
+    }
+    if (spec.zipf_theta <= 0 || spec.zipf_theta >= 1) {
+      throw std::invalid_argument("The zipfian theta must be in (0, 1)");
+    }
+    if (spec.records == 0 || spec.trace_length == 0) {
+      throw std::invalid_argument("Workloads need records and a trace");
+    }
+    return spec;
+  }
+
+  static KeyDistribution distributionFromString(std::string const &dist) {
+    if (dist == "uniform") {
+      return KeyDistribution::Uniform;
+    }
+    if (dist == "zipfian") {
+      return KeyDistribution::Zipfian;
+    }
+    if (dist == "hotspot") {
+      return KeyDistribution::Hotspot;
+    }
+    if (dist == "latest") {
+      return KeyDistribution::Latest;
+    }
+    throw std::invalid_argument(
+        fmt::format("Unknown key distribution `{}`", dist));
+  }
+};
+
+// Splits an app config of the form "<numbers>,<key=value settings>" in its
+// numeric prefix and its (optional) workload settings.
+inline std::pair<std::string, std::optional<std::string>> splitConfig(
+    std::string const &config) {
+  auto const settings = std::find_if(config.begin(), config.end(),
+                                     [](char c) { return std::isalpha(c); });
+  if (settings == config.end()) {
+    return {config, std::nullopt};
+  }
+  return {std::string(config.begin(), settings),
+          std::string(settings, config.end())};
+}
+
+// Zipfian ranks in [0, n) following Gray et al., "Quickly generating
+// billion-record synthetic databases" (as in YCSB). Rank 0 is the most popular.
+class ZipfianGenerator {
+ public:
+  ZipfianGenerator(size_t const n, double const theta)
+      : n{n},
+        theta{theta},
+        alpha{1. / (1. - theta)},
+        zetan{zeta(n, theta)},
+        eta{(1. - std::pow(2. / static_cast<double>(n), 1. - theta)) /
+            (1. - zeta(2, theta) / zetan)} {}
+
+  template <typename Gen>
+  size_t operator()(Gen &gen) {
+    auto const u = std::uniform_real_distribution<double>(0., 1.)(gen);
+    auto const uz = u * zetan;
+    if (uz < 1.) {
+      return 0;
+    }
+    if (uz < 1. + std::pow(0.5, theta)) {
+      return std::min<size_t>(1, n - 1);
+    }
+    auto const rank = static_cast<size_t>(
+        static_cast<double>(n) * std::pow(eta * u - eta + 1., alpha));
+    return std::min(rank, n - 1);
+  }
+
+ private:
+  static double zeta(size_t const n, double const theta) {
+    double sum = 0;
+    for (size_t i = 1; i <= n; i++) {
+      sum += 1. / std::pow(static_cast<double>(i), theta);
+    }
+    return sum;
+  }
+
+  size_t const n;
+  double const theta;
+  double const alpha;
+  double const zetan;
+  double const eta;
+};
+
+// Spreads popular ranks over the key space, as YCSB's scrambled zipfian.
+inline uint64_t fnv1a(uint64_t value) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (int i = 0; i < 8; i++) {
+    hash ^= value & 0xff;
+    hash *= 0x100000001b3ULL;
+    value >>= 8;
+  }
+  return hash;
+}
+
+// Deterministic, printable and unique key of `key_size` bytes for `id`.
+inline std::vector<uint8_t> makeKey(size_t const id, size_t const key_size) {
+  static char const charset[] =
+      "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+  size_t constexpr Base = sizeof(charset) - 1;
+  std::vector<uint8_t> key(key_size);
+  // The id is written in base 62 at the end, the rest is filled with a hash
+  // so that keys do not share long prefixes.
+  size_t rest = id;
+  auto it = key.rbegin();
+  for (; it != key.rend() && (rest != 0 || it == key.rbegin()); ++it) {
+    *it = static_cast<uint8_t>(charset[rest % Base]);
+    rest /= Base;
+  }
+  if (rest != 0) {
+    throw std::invalid_argument(
+        fmt::format("Keys of {}B cannot encode key #{}", key_size, id));
+  }
+  auto hash = fnv1a(id);
+  for (; it != key.rend(); ++it) {
+    *it = static_cast<uint8_t>(charset[hash % Base]);
+    hash = hash / Base + fnv1a(hash);
+  }
+  return key;
+}
+
+class Workload {
+ public:
+  using Request = std::vector<uint8_t>;
+  using EncodeGet = std::function<Request(std::vector<uint8_t> const &key)>;
+  using EncodePut = std::function<Request(std::vector<uint8_t> const &key,
+                                          size_t value_size)>;
+
+  Workload(Spec const &spec, size_t const key_size, EncodeGet encode_get,
+           EncodePut encode_put)
+      : spec{spec},
+        key_size{key_size},
+        encode_get{std::move(encode_get)},
+        encode_put{std::move(encode_put)},
+        gen{spec.seed},
+        zipfian{spec.records, spec.zipf_theta} {
+    generate();
+  }
+
+  // The next request of the trace, which wraps around.
+  Request const &next() const {
+    auto const &request = requests[trace[cursor]];
+    cursor = cursor + 1 == trace.size() ? 0 : cursor + 1;
+    return request;
+  }
+
+  // Requests that store the initial records, to be run before the trace.
+  template <typename Handler>
+  void forEachLoadRequest(Handler &&handler) const {
+    for (size_t key = 0; key < spec.records; key++) {
+      handler(encode_put(makeKey(key, key_size), spec.max_value_size));
+    }
+  }
+
+  size_t distinctRequests() const { return requests.size(); }
+
+ private:
+  void generate() {
+    auto const total = spec.mix.read + spec.mix.update + spec.mix.insert +
+                       spec.mix.rmw;
+    if (total <= 0) {
+      throw std::invalid_argument("Empty operation mix");
+    }
+    std::discrete_distribution<int> pick_op(
+        {spec.mix.read, spec.mix.update, spec.mix.insert, spec.mix.rmw});
+    trace.reserve(spec.trace_length);
+    while (trace.size() < spec.trace_length) {
+      switch (static_cast<Op>(pick_op(gen))) {
+        case Op::Read:
+          trace.push_back(get(chooseKey()));
+          break;
+        case Op::Update:
+          trace.push_back(put(chooseKey(), chooseValueSize()));
+          break;
+        case Op::Insert:
+          trace.push_back(put(inserted++, chooseValueSize()));
+          break;
+        case Op::ReadModifyWrite: {
+          auto const key = chooseKey();
+          trace.push_back(get(key));
+          trace.push_back(put(key, chooseValueSize()));
+        } break;
+      }
+    }
+    index.clear();
+  }
+
+  size_t chooseKey() {
+    switch (spec.distribution) {
+      case KeyDistribution::Uniform:
+        return std::uniform_int_distribution<size_t>(0, inserted - 1)(gen);
+      case KeyDistribution::Zipfian:
+        return fnv1a(zipfian(gen)) % inserted;
+      case KeyDistribution::Hotspot: {
+        auto const hot = std::max<size_t>(
+            1, static_cast<size_t>(spec.hot_set_fraction *
+                                   static_cast<double>(inserted)));
+        std::bernoulli_distribution on_hot(spec.hot_ops_fraction);
+        if (on_hot(gen) || hot == inserted) {
+          return std::uniform_int_distribution<size_t>(0, hot - 1)(gen);
+        }
+        return std::uniform_int_distribution<size_t>(hot, inserted - 1)(gen);
+      }
+      case KeyDistribution::Latest:
+        // The most recently inserted keys are the most popular.
+        return inserted - 1 - std::min(zipfian(gen), inserted - 1);
+    }
+    throw std::logic_error("Unreachable");
+  }
+
+  size_t chooseValueSize() {
+    auto const min = spec.min_value_size;
+    auto const max = spec.max_value_size;
+    if (min >= max || spec.value_size_classes == 1) {
+      return max;
+    }
+    auto const classes = spec.value_size_classes;
+    auto const cls = std::uniform_int_distribution<size_t>(0, classes - 1)(gen);
+    return min + (max - min) * cls / (classes - 1);
+  }
+
+  uint32_t get(size_t const key) {
+    return intern({key, GetTag},
+                  [&] { return encode_get(makeKey(key, key_size)); });
+  }
+
+  uint32_t put(size_t const key, size_t const value_size) {
+    return intern({key, value_size},
+                  [&] { return encode_put(makeKey(key, key_size), value_size); });
+  }
+
+  template <typename Encode>
+  uint32_t intern(std::pair<size_t, size_t> const &what, Encode &&encode) {
+    auto const [it, inserted_now] = index.try_emplace(
+        what, static_cast<uint32_t>(requests.size()));
+    if (inserted_now) {
+      requests.push_back(encode());
+    }
+    return it->second;
+  }
+
+  struct PairHash {
+    size_t operator()(std::pair<size_t, size_t> const &p) const {
+      return fnv1a(p.first) ^ (p.second * 0x9e3779b97f4a7c15ULL);
+    }
+  };
+
+  static size_t constexpr GetTag = static_cast<size_t>(-1);
+
+  Spec const spec;
+  size_t const key_size;
+  EncodeGet encode_get;
+  EncodePut encode_put;
+  std::mt19937_64 gen;
+  ZipfianGenerator zipfian;
+  size_t inserted = spec.records;
+
+  // (key, value size or GetTag) -> index in `requests`. Only used while
+  // generating the trace.
+  std::unordered_map<std::pair<size_t, size_t>, uint32_t, PairHash> index;
+  std::vector<Request> requests;
+  std::vector<uint32_t> trace;
+  mutable size_t cursor = 0;
+};
+}  // namespace workload
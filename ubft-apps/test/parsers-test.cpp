@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../src/app/pipeline.hpp"
+
+using Parser = PipelinedConnection::Parser;
+
+struct Frame {
+    char const *name;
+    std::string bytes;
+};
+
+static std::string memcachedBinaryFrame(std::string const &body) {
+    std::string header(24, '\0');
+    header[0] = static_cast<char>(0x81);
+    header[11] = static_cast<char>(body.size());
+    return header + body;
+}
+
+static std::vector<Frame> const memcachedFrames = {
+    {"stored", "STORED\r\n"},
+    {"miss", "END\r\n"},
+    {"error", "SERVER_ERROR out of memory\r\n"},
+    {"hit", "VALUE k 0 5\r\nhello\r\nEND\r\n"},
+    {"hit with cas", "VALUE key 3 4 42\r\nab\r\n\r\nEND\r\n"},
+    {"multi get", "VALUE a 0 1\r\nx\r\nVALUE b 1 0\r\n\r\nEND\r\n"},
+    {"binary", memcachedBinaryFrame("hello")},
+    {"binary empty", memcachedBinaryFrame("")},
+};
+
+static std::vector<Frame> const respFrames = {
+    {"simple string", "+OK\r\n"},
+    {"error", "-ERR unknown command\r\n"},
+    {"integer", ":-42\r\n"},
+    {"bulk string", "$5\r\nhello\r\n"},
+    {"bulk string with crlf", "$4\r\na\r\nb\r\n"},
+    {"empty bulk string", "$0\r\n\r\n"},
+    {"null bulk string", "$-1\r\n"},
+    {"array", "*2\r\n$3\r\nfoo\r\n:1\r\n"},
+    {"nested array", "*2\r\n*1\r\n+a\r\n$2\r\n\r\n\r\n"},
+    {"empty array", "*0\r\n"},
+    {"null array", "*-1\r\n"},
+};
+
+static std::optional<size_t> parse(Parser parser, std::string const &bytes,
+                                   size_t from, size_t to) {
+    return parser(reinterpret_cast<uint8_t const *>(bytes.data()) + from, to - from);
+}
+
+// Feeds `stream` to `parser` `step` bytes at a time, as PipelinedConnection
+// does, and returns the sizes of the responses parsed.
+static std::vector<size_t> parseStream(Parser parser, std::string const &stream,
+                                       size_t step) {
+    std::vector<size_t> sizes;
+    size_t parsed = 0;
+    for (size_t received = 0; received < stream.size();) {
+        received = std::min(received + step, stream.size());
+        while (auto const size = parse(parser, stream, parsed, received)) {
+            sizes.push_back(*size);
+            parsed += *size;
+        }
+    }
+    EXPECT_EQ(parsed, stream.size());
+    return sizes;
+}
+
+static void expectIncremental(Parser parser, std::vector<Frame> const &frames) {
+    for (auto const &[name, bytes] : frames) {
+        SCOPED_TRACE(name);
+        for (size_t size = 0; size < bytes.size(); size++) {
+            EXPECT_EQ(parse(parser, bytes, 0, size), std::nullopt) << "after " << size << "B";
+        }
+        EXPECT_EQ(parse(parser, bytes, 0, bytes.size()), bytes.size());
+    }
+}
+
+static void expectConcatenated(Parser parser, std::vector<Frame> const &frames) {
+    std::string stream;
+    std::vector<size_t> sizes;
+    for (auto const &frame : frames) {
+        stream += frame.bytes;
+        sizes.push_back(frame.bytes.size());
+    }
+    for (size_t const step : {size_t{1}, size_t{3}, size_t{7}, stream.size()}) {
+        SCOPED_TRACE(step);
+        EXPECT_EQ(parseStream(parser, stream, step), sizes);
+    }
+}
+
+TEST(MemcachedParser, ByteByByte) { expectIncremental(parsers::memcached, memcachedFrames); }
+
+TEST(MemcachedParser, Concatenated) { expectConcatenated(parsers::memcached, memcachedFrames); }
+
+TEST(MemcachedParser, InvalidValueLine) {
+    std::vector<std::string> const invalid = {"VALUE k 0 x\r\n", "VALUE k\r\n"};
+    for (auto const &bytes : invalid) {
+        SCOPED_TRACE(bytes);
+        EXPECT_THROW(parse(parsers::memcached, bytes, 0, bytes.size()), std::runtime_error);
+    }
+}
+
+TEST(RespParser, ByteByByte) { expectIncremental(parsers::resp, respFrames); }
+
+TEST(RespParser, Concatenated) { expectConcatenated(parsers::resp, respFrames); }
+
+TEST(RespParser, InvalidValue) {
+    std::vector<std::string> const invalid = {"!oops\r\n", "$x\r\n", "*1\r\n?\r\n"};
+    for (auto const &bytes : invalid) {
+        SCOPED_TRACE(bytes);
+        EXPECT_THROW(parse(parsers::resp, bytes, 0, bytes.size()), std::runtime_error);
+    }
+}
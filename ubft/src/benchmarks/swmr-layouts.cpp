@@ -0,0 +1,274 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fmt/chrono.h>
+#include <fmt/core.h>
+#include <lyra/lyra.hpp>
+#include <xxhash.h>
+
+#include <dory/ctrl/block.hpp>
+#include <dory/ctrl/device.hpp>
+#include <dory/memstore/store.hpp>
+#include <dory/shared/logger.hpp>
+
+#include "../swmr/host-builder.hpp"
+#include "../swmr/reader-builder.hpp"
+#include "../swmr/reader.hpp"
+#include "../swmr/writer-builder.hpp"
+#include "../swmr/writer.hpp"
+#include "../tail-cb/broadcaster.hpp"
+#include "../tail-cb/receiver.hpp"
+
+using Layout = dory::ubft::swmr::Layout;
+using Host = dory::ubft::swmr::Host;
+using Clock = std::chrono::steady_clock;
+
+static auto main_logger = dory::std_out_logger("Init");
+
+static char const *layoutName(Layout const layout) {
+  return layout == Layout::Seqlock ? "Seqlock" : "DoubleSubslot";
+}
+
+/**
+ * Local cost of validating a READ of each layout, i.e., hashing both
+ * subslots or comparing the fences.
+ */
+static void benchValidation(size_t const value_size, size_t const rounds) {
+  std::vector<uint8_t> hashed(Host::registerSize(value_size), 0);
+  std::vector<uint8_t> seqlock(
+      Host::registerSize(value_size, Layout::Seqlock), 0);
+  uint64_t sink = 0;
+
+  auto start = Clock::now();
+  for (size_t r = 0; r < rounds; r++) {
+    for (size_t subslot = 0; subslot < 2; subslot++) {
+      auto const *const header =
+          hashed.data() + subslot * Host::subslotSize(value_size);
+      sink += XXH3_64bits(header + sizeof(dory::ubft::swmr::Header::Hash),
+                          sizeof(dory::ubft::swmr::Header::Incarnation) +
+                              value_size);
+    }
+    hashed[sizeof(dory::ubft::swmr::Header::Hash)] = static_cast<uint8_t>(r);
+  }
+  std::chrono::nanoseconds const hashed_duration(Clock::now() - start);
+
+  start = Clock::now();
+  for (size_t r = 0; r < rounds; r++) {
+    Host::Fence head;
+    Host::Fence tail;
+    memcpy(&head, seqlock.data(), sizeof(head));
+    memcpy(&tail, seqlock.data() + Host::tailFenceOffset(value_size),
+           sizeof(tail));
+    sink += head == tail;
+    seqlock[0] = static_cast<uint8_t>(r);
+  }
+  std::chrono::nanoseconds const seqlock_duration(Clock::now() - start);
+
+  fmt::print("[Validation] DoubleSubslot: {}, Seqlock: {} (sink: {})\n",
+             hashed_duration / rounds, seqlock_duration / rounds, sink);
+}
+
+/**
+ * This benchmark compares the SWMR register layouts for the registers used by
+ * the slow path of tail_cb::Receiver (i.e., a hash and a signature):
+ * - The bytes moved by a READ.
+ * - The local cost of validating a READ.
+ * - The one-way latency of a ping-pong over SWMR registers hosted by a third
+ *   process.
+ */
+int main(int argc, char *argv[]) {
+  //// Parse Arguments ////
+  lyra::cli cli;
+  bool get_help = false;
+  int local_id;
+
+  int const measurer_id = 1;
+  int const responder_id = 2;
+  int const host_id = 3;
+
+  cli.add_argument(lyra::help(get_help))
+      .add_argument(lyra::opt(local_id, "id")
+                        .required()
+                        .name("-l")
+                        .name("--local-id")
+                        .choices(measurer_id, responder_id, host_id)
+                        .help("ID of the present process"));
+
+  // Parse the program arguments.
+  auto result = cli.parse({argc, argv});
+
+  if (get_help) {
+    std::cout << cli;
+    return 0;
+  }
+
+  if (!result) {
+    std::cerr << "Error in command line: " << result.errorMessage()
+              << std::endl;
+    return 1;
+  }
+
+  size_t const value_size = dory::ubft::tail_cb::Receiver::RegisterValueSize;
+  std::vector<Layout> const layouts = {Layout::DoubleSubslot, Layout::Seqlock};
+
+  if (local_id == measurer_id) {
+    for (auto const layout : layouts) {
+      fmt::print("[{}] Value: {}B, READ: {}B\n", layoutName(layout),
+                 value_size, Host::registerSize(value_size, layout));
+    }
+    benchValidation(value_size, 1024 * 1024);
+  }
+
+  //// Setup RDMA ////
+  LOGGER_INFO(main_logger, "Opening RDMA device ...");
+  auto open_device = std::move(dory::ctrl::Devices().list().back());
+  LOGGER_INFO(main_logger, "Device: {} / {}, {}, {}", open_device.name(),
+              open_device.devName(),
+              dory::ctrl::OpenDevice::typeStr(open_device.nodeType()),
+              dory::ctrl::OpenDevice::typeStr(open_device.transportType()));
+
+  size_t binding_port = 0;
+  LOGGER_INFO(main_logger, "Binding to port {} of opened device {}",
+              binding_port, open_device.name());
+  dory::ctrl::ResolvedPort resolved_port(open_device);
+  auto binded = resolved_port.bindTo(binding_port);
+  if (!binded) {
+    throw std::runtime_error("Couldn't bind the device.");
+  }
+  LOGGER_INFO(main_logger, "Binded successfully (port_id, port_lid) = ({}, {})",
+              +resolved_port.portId(), +resolved_port.portLid());
+
+  LOGGER_INFO(main_logger, "Configuring the control block");
+  dory::ctrl::ControlBlock cb(resolved_port);
+  cb.registerPd("standard");
+
+  //// Create Memory Regions and QPs ////
+  auto &store = dory::memstore::MemoryStore::getInstance();
+
+  size_t const pings = 1024;
+  size_t const experiments = 32;
+  size_t const nb_registers = pings * experiments;
+
+  for (auto const layout : layouts) {
+    auto const ping_id = fmt::format("ping-{}", layoutName(layout));
+    auto const pong_id = fmt::format("pong-{}", layoutName(layout));
+    auto const barrier_id = [&](char const *name) {
+      return fmt::format("{}-{}", name, layoutName(layout));
+    };
+
+    if (local_id == host_id) {
+      dory::ubft::swmr::HostBuilder ping_builder(
+          cb, host_id, measurer_id, {measurer_id, responder_id}, ping_id,
+          nb_registers, value_size, layout);
+      dory::ubft::swmr::HostBuilder pong_builder(
+          cb, host_id, responder_id, {measurer_id, responder_id}, pong_id,
+          nb_registers, value_size, layout);
+
+      ping_builder.announceQps();
+      pong_builder.announceQps();
+      store.barrier(barrier_id("qp_announced"), 3);
+      ping_builder.connectQps();
+      pong_builder.connectQps();
+      store.barrier(barrier_id("qp_connected"), 3);
+
+      // The registers must outlive the experiment.
+      store.barrier(barrier_id("experiment_done"), 3);
+    } else if (local_id == measurer_id) {
+      dory::ubft::swmr::WriterBuilder ping_builder(
+          cb, local_id, host_id, ping_id, nb_registers, value_size, true,
+          layout);
+      dory::ubft::swmr::ReaderBuilder pong_builder(
+          cb, local_id, responder_id, host_id, pong_id, nb_registers,
+          value_size, layout);
+
+      ping_builder.announceQps();
+      pong_builder.announceQps();
+      store.barrier(barrier_id("qp_announced"), 3);
+      ping_builder.connectQps();
+      pong_builder.connectQps();
+      store.barrier(barrier_id("qp_connected"), 3);
+
+      auto ping_writer = ping_builder.build();
+      auto pong_reader = pong_builder.build();
+
+      store.barrier(barrier_id("abstractions_initialized"), 2);
+
+      for (size_t e = 0; e < experiments; e++) {
+        Clock::time_point start = Clock::now();
+        for (size_t p = 0; p < pings; p++) {
+          auto const write_nb = p + e * pings;
+          auto const reg = write_nb % nb_registers;
+          ping_writer.getSlot(reg);
+          ping_writer.write(reg, write_nb + 1);
+
+          auto ponged = false;
+          while (!ponged) {
+            auto const read_handle = *pong_reader.read(reg);
+            dory::ubft::swmr::Reader::PollResult opt_polled;
+            while (!(opt_polled = pong_reader.poll(read_handle))) {
+              ping_writer.tick();
+              pong_reader.tick();
+            }
+            pong_reader.release(read_handle);
+            if (opt_polled->second == reg + 1) {
+              ponged = true;
+            }
+          }
+        }
+        std::chrono::nanoseconds duration(Clock::now() - start);
+        fmt::print("[{}] {} pings in {}, measured one-way latency: {}\n",
+                   layoutName(layout), pings, duration,
+                   duration / pings / 2);
+      }
+      store.barrier(barrier_id("experiment_done"), 3);
+    } else if (local_id == responder_id) {
+      dory::ubft::swmr::ReaderBuilder ping_builder(
+          cb, local_id, measurer_id, host_id, ping_id, nb_registers,
+          value_size, layout);
+      dory::ubft::swmr::WriterBuilder pong_builder(
+          cb, local_id, host_id, pong_id, nb_registers, value_size, true,
+          layout);
+
+      ping_builder.announceQps();
+      pong_builder.announceQps();
+      store.barrier(barrier_id("qp_announced"), 3);
+      ping_builder.connectQps();
+      pong_builder.connectQps();
+      store.barrier(barrier_id("qp_connected"), 3);
+
+      auto ping_reader = ping_builder.build();
+      auto pong_writer = pong_builder.build();
+
+      store.barrier(barrier_id("abstractions_initialized"), 2);
+
+      for (size_t write_nb = 0; write_nb < experiments * pings; write_nb++) {
+        auto const reg = write_nb % nb_registers;
+
+        auto pinged = false;
+        while (!pinged) {
+          auto const read_handle = *ping_reader.read(reg);
+          dory::ubft::swmr::Reader::PollResult polled;
+          while (!(polled = ping_reader.poll(read_handle))) {
+            pong_writer.tick();
+            ping_reader.tick();
+          }
+          ping_reader.release(read_handle);
+          if (polled->second == reg + 1) {
+            pinged = true;
+          }
+        }
+
+        pong_writer.getSlot(reg);
+        pong_writer.write(reg, write_nb + 1);
+      }
+      store.barrier(barrier_id("experiment_done"), 3);
+    }
+  }
+
+  return 0;
+}
@@ -17,6 +17,7 @@
 
 #include <dory/crypto/hash/blake3.hpp>
 #include <dory/shared/branching.hpp>
+#include <dory/shared/metrics.hpp>
 #include <dory/shared/move-indicator.hpp>
 
 namespace dory::ubft {
@@ -121,6 +122,8 @@ class Buffer {
 
   size_t size() const { return dynarray.size() - left_offset; }
 
+  size_t capacity() const { return max_size - left_offset; }
+
   void resize(size_t const size) {
     if (unlikely(size + left_offset > max_size)) {
       throw std::runtime_error(
@@ -174,6 +177,7 @@ class Pool {
       if constexpr (!AllowDelayedBufferAlloc) {
         return std::nullopt;
       }
+      exhaustions.add();
       buffers->emplace_back(buffer_size);
     }
     auto buffer = std::move(buffers->back());
@@ -190,6 +194,7 @@ class Pool {
       if constexpr (!AllowDelayedBufferAlloc) {
         return std::nullopt;
       }
+      exhaustions.add();
       buffers->emplace_back(buffer_size);
     }
     return buffers->back();
@@ -201,6 +206,9 @@ class Pool {
   std::unique_ptr<std::vector<Buffer>> buffers =
       std::make_unique<std::vector<Buffer>>();
   size_t buffer_size;
+  // Takes that found the pool empty and had to allocate a new buffer.
+  metrics::Counter exhaustions =
+      metrics::Registry::instance().counter("buffers.pool_exhaustions");
 };
 
 }  // namespace dory::ubft
@@ -30,6 +30,7 @@
 #include "../tail-p2p/receiver.hpp"
 #include "../tail-p2p/sender.hpp"
 #include "../thread-pool/tail-thread-pool.hpp"
+#include "../tracing.hpp"
 #include "../types.hpp"
 #include "../unsafe-at.hpp"
 #include "certificate.hpp"
@@ -390,7 +391,8 @@ class Certifier {
       auto const index = i;  // structured bindings cannot be captured
       sorted_computed_shares.tryEmplace(index);  // Where to store the share.
       share_computation_task_queue.enqueue(
-          [this, index, buffer = std::move(buffer)]() mutable {
+          [this, index, buffer = std::move(buffer),
+           enqueued = tracing::now()]() mutable {
             auto acc = crypto::hash::blake3_init();
             crypto::hash::blake3_update(acc, identifier);
             crypto::hash::blake3_update(acc, index);
@@ -399,6 +401,9 @@ class Certifier {
             auto sign = crypto.sign(hash.data(), hash.size());
             computed_shares.enqueue(
                 ComputedShare{{index, sign}, std::move(buffer)});
+            tracing::record(tracing::Span::CertifierShare,
+                            static_cast<uint32_t>(crypto.myId()), index,
+                            enqueued);
           });
     }
     queued_share_computations.clear();
@@ -497,10 +502,14 @@ class Certifier {
     auto const &hash = optimistic_find_front(msg_tail, index)->second.hash();
     uat(check_share_task_queues, replica)
         .enqueue(
-            [this, share = std::move(share), replica, hash = hash]() mutable {
-              auto valid =
-                  crypto.verify(share.signature(), hash.data(), hash.size(),
-                                uat(share_receivers, replica).procId());
+            [this, share = std::move(share), replica, hash = hash,
+             enqueued = tracing::now()]() mutable {
+              auto const signer = uat(share_receivers, replica).procId();
+              auto valid = crypto.verify(share.signature(), hash.data(),
+                                         hash.size(), signer);
+              tracing::record(tracing::Span::CertifierShareCheck,
+                              static_cast<uint32_t>(signer), share.msgIndex(),
+                              enqueued);
               verified_shares.enqueue(
                   VerifiedShare{replica, std::move(share), valid});
             });
@@ -0,0 +1,365 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <dory/conn/message-identifier.hpp>
+#include <dory/conn/rc.hpp>
+#include <dory/ctrl/block.hpp>
+#include <dory/shared/branching.hpp>
+
+#include "unsafe-at.hpp"
+
+namespace dory::ubft {
+
+/**
+ * @brief Kind of the abstraction that posted a WR, packed in its `wr_id`.
+ */
+class CompletionKind : public conn::BaseKind<CompletionKind, uint64_t> {
+ public:
+  enum Value : uint64_t {
+    P2pSender = 1,
+    SwmrReader = 2,
+    SwmrWriter = 3,
+    MAX_KIND_VALUE__ = 3
+  };
+
+  constexpr CompletionKind(Value v) { value = v; }
+
+  constexpr char const *toStr() const {
+    switch (value) {
+      case P2pSender:
+        return "CompletionKind::P2pSender";
+      case SwmrReader:
+        return "CompletionKind::SwmrReader";
+      case SwmrWriter:
+        return "CompletionKind::SwmrWriter";
+      default:
+        return "Out of range";
+    }
+  }
+};
+
+class CompletionDispatcher;
+
+/**
+ * @brief Where an RDMA abstraction gets the completions of its WRs from:
+ *        either the send CQ of its own RC (default) or its share of a
+ *        CompletionDispatcher.
+ */
+class Completions {
+ public:
+  Completions() = default;
+
+  /**
+   * @brief The `wr_id` to post so that the WC is routed back to this owner.
+   *        The WCs returned by `poll` carry the original `req_id`.
+   */
+  uint64_t wrId(uint64_t const req_id) const { return prefix | req_id; }
+
+  /**
+   * @brief Fills `wcs` with at most `wcs.size()` completions.
+   */
+  inline bool poll(conn::ReliableConnection &rc,
+                   std::vector<struct ibv_wc> &wcs);
+
+ private:
+  friend class CompletionDispatcher;
+
+  Completions(CompletionDispatcher &dispatcher, uint16_t const owner,
+              uint64_t const prefix)
+      : dispatcher{&dispatcher}, owner{owner}, prefix{prefix} {}
+
+  CompletionDispatcher *dispatcher = nullptr;
+  uint16_t owner = 0;
+  uint64_t prefix = 0;
+};
+
+/**
+ * @brief Routes the WCs of a shared CQ to the inboxes of their owner based on
+ *        their packed `wr_id`, and tracks which owners saw the latest poll.
+ *
+ * Each owner has a fixed inbox that holds as many WCs as it reserved, i.e.,
+ * its maximum number of outstanding signaled WRs.
+ */
+class CompletionRouter {
+ public:
+  using Packer = conn::Packer<CompletionKind, uint16_t, uint64_t>;
+
+  /**
+   * @brief Registers a new owner of WCs, with up to `capacity` outstanding.
+   *
+   * @return the id of the owner, to pack in the `wr_id` of its WRs.
+   */
+  uint16_t subscribe(CompletionKind const kind, size_t const capacity) {
+    if (owners.size() > MaxOwner) {
+      throw std::runtime_error(fmt::format(
+          "Cannot route to more than {} owners.", MaxOwner + 1));
+    }
+    owners.push_back({kind, std::vector<struct ibv_wc>(capacity), 0, 0, 0});
+    return static_cast<uint16_t>(owners.size() - 1);
+  }
+
+  /**
+   * @brief Starts a new poll of the shared CQ.
+   */
+  void newEpoch() { epoch++; }
+
+  /**
+   * @brief Whether `owner` has no WC left and no other owner polled the
+   *        shared CQ since it last looked.
+   */
+  bool needsPoll(uint16_t const owner) const {
+    auto const &o = uat(owners, owner);
+    return o.size == 0 && o.seen_epoch == epoch;
+  }
+
+  /**
+   * @throw `std::runtime_error` if the WC has no owner, does not match the
+   *        kind of its owner or overflows its inbox.
+   */
+  void route(struct ibv_wc wc) {
+    auto const owner = Packer::unpackPid(wc.wr_id);
+    if (unlikely(owner >= owners.size())) {
+      throw std::runtime_error(fmt::format("WC {} has no owner.", wc.wr_id));
+    }
+    auto &o = owners[owner];
+    if (unlikely(Packer::unpackKind(wc.wr_id) != o.kind)) {
+      throw std::runtime_error(fmt::format(
+          "WC {} does not match the kind of its owner ({}).", wc.wr_id,
+          o.kind.toStr()));
+    }
+    if (unlikely(o.size == o.inbox.size())) {
+      throw std::runtime_error(fmt::format(
+          "WC {} overflows the inbox of its owner ({}).", wc.wr_id,
+          o.inbox.size()));
+    }
+    wc.wr_id = Packer::unpackReq(wc.wr_id);
+    o.inbox[(o.head + o.size) % o.inbox.size()] = wc;
+    o.size++;
+  }
+
+  /**
+   * @brief Moves at most `entries.size()` WCs of `owner` to `entries`.
+   */
+  void take(uint16_t const owner, std::vector<struct ibv_wc> &entries) {
+    auto &o = uat(owners, owner);
+    o.seen_epoch = epoch;
+
+    auto const taken = std::min(entries.size(), o.size);
+    for (size_t i = 0; i < taken; i++) {
+      entries[i] = o.inbox[o.head];
+      o.head = (o.head + 1) % o.inbox.size();
+    }
+    o.size -= taken;
+    entries.resize(taken);
+  }
+
+ private:
+  struct Owner {
+    CompletionKind kind;
+    std::vector<struct ibv_wc> inbox;  // Ring of `size` WCs from `head`.
+    size_t head;
+    size_t size;
+    uint64_t seen_epoch;
+  };
+
+  // Owners are identified by the pid field of the Packer, i.e., the 16 bits
+  // of a ProcId minus those of the kind.
+  static size_t constexpr MaxOwner =
+      (size_t(1) << (sizeof(uint16_t) * 8 -
+                     conn::internal::number_of_bits(static_cast<uint64_t>(
+                         CompletionKind::MAX_KIND_VALUE__)))) -
+      1;
+  static_assert(Packer::unpackPid(Packer::pack(
+                    CompletionKind::MAX_KIND_VALUE__,
+                    static_cast<uint16_t>(MaxOwner), 0)) == MaxOwner);
+  static_assert(Packer::unpackPid(Packer::pack(
+                    CompletionKind::MAX_KIND_VALUE__,
+                    static_cast<uint16_t>(MaxOwner + 1), 0)) != MaxOwner + 1);
+
+  std::vector<Owner> owners;
+  uint64_t epoch = 0;
+};
+
+/**
+ * @brief Polls a CQ shared by the RCs of all the abstractions ticked by a
+ *        thread and routes the WCs to their owner based on their packed
+ *        `wr_id`.
+ *
+ * Rather than each owner polling its own CQ on every tick, the first owner
+ * that finds no completion in its inbox polls the shared CQ for everyone, in
+ * batches of `PollBatch`. An owner only triggers a new poll if no other owner
+ * did since it last looked, hence the CQ is polled about once per tick
+ * regardless of the number of connections.
+ *
+ * NOT THREAD-SAFE: all the owners must be ticked by the same thread.
+ *
+ * Builders constructed within a `Scope` bind their RCs to the shared CQ and
+ * build abstractions that subscribe to the dispatcher. Others keep their own
+ * CQ.
+ */
+class CompletionDispatcher {
+ public:
+  using Packer = CompletionRouter::Packer;
+
+  static int constexpr DefaultDepth = 1 << 16;
+  static size_t constexpr PollBatch = 256;
+
+  /**
+   * @brief Makes the builders constructed by this thread use `dispatcher`
+   *        until destruction.
+   */
+  class Scope {
+   public:
+    Scope(CompletionDispatcher &dispatcher) : previous{current_} {
+      current_ = &dispatcher;
+    }
+    ~Scope() { current_ = previous; }
+
+    Scope(Scope const &) = delete;
+    Scope &operator=(Scope const &) = delete;
+
+   private:
+    CompletionDispatcher *const previous;
+  };
+
+  CompletionDispatcher(ctrl::ControlBlock &cb, std::string const &name,
+                       int const depth = DefaultDepth)
+      : cq_name{fmt::format("completion-dispatcher-{}", name)},
+        depth{static_cast<size_t>(depth)} {
+    cb.registerCq(cq_name, depth);
+    cq = cb.cq(cq_name).get();
+    wcs.resize(PollBatch);
+  }
+
+  // Owners hold pointers to the dispatcher.
+  CompletionDispatcher(CompletionDispatcher const &) = delete;
+  CompletionDispatcher &operator=(CompletionDispatcher const &) = delete;
+  CompletionDispatcher(CompletionDispatcher &&) = delete;
+  CompletionDispatcher &operator=(CompletionDispatcher &&) = delete;
+
+  /**
+   * @return the dispatcher of the enclosing `Scope`, if any.
+   */
+  static CompletionDispatcher *current() { return current_; }
+
+  std::string const &cqName() const { return cq_name; }
+
+  /**
+   * @brief Accounts for an RC that can have up to `completions` outstanding
+   *        signaled WRs, as overflowing the shared CQ is fatal.
+   *
+   * @throw `std::runtime_error` if the CQ is not deep enough.
+   */
+  void reserve(size_t const completions) {
+    reserved += completions;
+    if (reserved > depth) {
+      throw std::runtime_error(fmt::format(
+          "CQ {} is too shallow: {} completions reserved, depth is {}.",
+          cq_name, reserved, depth));
+    }
+  }
+
+  /**
+   * @brief Registers a new owner of up to `completions` outstanding WCs, as
+   *        reserved.
+   */
+  Completions subscribe(CompletionKind const kind, size_t const completions) {
+    auto const owner = router.subscribe(kind, completions);
+    return Completions(*this, owner, Packer::pack(kind, owner, 0));
+  }
+
+  /**
+   * @brief Drains the shared CQ into the inboxes of the owners.
+   */
+  bool poll() {
+    router.newEpoch();
+    for (;;) {
+      auto const polled =
+          ibv_poll_cq(cq, static_cast<int>(PollBatch), wcs.data());
+      if (unlikely(polled < 0)) {
+        return false;
+      }
+      for (int i = 0; i < polled; i++) {
+        router.route(wcs[static_cast<size_t>(i)]);
+      }
+      if (static_cast<size_t>(polled) < PollBatch) {
+        return true;
+      }
+    }
+  }
+
+  /**
+   * @brief Moves at most `entries.size()` WCs of `owner` to `entries`,
+   *        polling the shared CQ if needed.
+   */
+  bool take(uint16_t const owner, std::vector<struct ibv_wc> &entries) {
+    if (router.needsPoll(owner) && unlikely(!poll())) {
+      return false;
+    }
+    router.take(owner, entries);
+    return true;
+  }
+
+ private:
+  static inline thread_local CompletionDispatcher *current_ = nullptr;
+
+  std::string const cq_name;
+  size_t const depth;
+  struct ibv_cq *cq;
+  size_t reserved = 0;
+
+  CompletionRouter router;
+  std::vector<struct ibv_wc> wcs;
+};
+
+/**
+ * @brief Captures, at the construction of a builder, the dispatcher of the
+ *        enclosing `CompletionDispatcher::Scope` (if any) that the built
+ *        abstraction will use.
+ */
+class CompletionBinding {
+ public:
+  CompletionBinding() : dispatcher{CompletionDispatcher::current()} {}
+
+  /**
+   * @return the name of the CQ to bind the RC named `uuid` to.
+   */
+  std::string registerCq(ctrl::ControlBlock &cb, std::string const &uuid) {
+    if (dispatcher == nullptr) {
+      cb.registerCq(uuid);
+      return uuid;
+    }
+    reserved = conn::ReliableConnection::WrDepth;
+    dispatcher->reserve(reserved);
+    return dispatcher->cqName();
+  }
+
+  Completions subscribe(CompletionKind const kind) {
+    if (dispatcher == nullptr) {
+      return {};
+    }
+    return dispatcher->subscribe(kind, reserved);
+  }
+
+ private:
+  CompletionDispatcher *const dispatcher;
+  size_t reserved = 0;
+};
+
+bool Completions::poll(conn::ReliableConnection &rc,
+                       std::vector<struct ibv_wc> &wcs) {
+  if (dispatcher == nullptr) {
+    return rc.pollCqIsOk(conn::ReliableConnection::SendCq, wcs);
+  }
+  return dispatcher->take(owner, wcs);
+}
+
+}  // namespace dory::ubft
@@ -5,6 +5,7 @@
 #include <fmt/core.h>
 
 #include <dory/ctrl/block.hpp>
+#include <dory/memstore/store.hpp>
 
 #include "../builder.hpp"
 #include "../certifier/certifier-builder.hpp"
@@ -139,12 +140,22 @@ class ConsensusBuilder : Builder<Consensus> {
           fmt::format("consensus-{}-cb-checkpoint", identifier), window,
           certifier::Certificate::bufferSize(max_cb_checkpoint_size,
                                              replicas.size() / 2 + 1));
+      fetch_senders_builders.emplace_back(
+          cb, local_id, replica, fmt::format("consensus-{}-fetch", identifier),
+          window, internal::FetchMessage::bufferSize(max_request_size));
+      fetch_receivers_builders.emplace_back(
+          cb, local_id, replica, fmt::format("consensus-{}-fetch", identifier),
+          window, internal::FetchMessage::bufferSize(max_request_size));
     }
   }
 
   void announceQps() override {
     announcing();
 
+    // All the qps are published together.
+    auto &store = memstore::MemoryStore::getInstance();
+    store.beginBatch();
+
     for (auto &builder : host_builders) {
       builder.announceQps();
     }
@@ -182,6 +193,16 @@ class ConsensusBuilder : Builder<Consensus> {
     for (auto &builder : cb_checkpoint_receivers_builders) {
       builder.announceQps();
     }
+
+    for (auto &builder : fetch_senders_builders) {
+      builder.announceQps();
+    }
+
+    for (auto &builder : fetch_receivers_builders) {
+      builder.announceQps();
+    }
+
+    store.commitBatch();
   }
 
   void connectQps() override {
@@ -224,6 +245,14 @@ class ConsensusBuilder : Builder<Consensus> {
     for (auto &builder : cb_checkpoint_receivers_builders) {
       builder.connectQps();
     }
+
+    for (auto &builder : fetch_senders_builders) {
+      builder.connectQps();
+    }
+
+    for (auto &builder : fetch_receivers_builders) {
+      builder.connectQps();
+    }
   }
 
   ubft::consensus::Consensus build() override {
@@ -267,13 +296,24 @@ class ConsensusBuilder : Builder<Consensus> {
       cb_checkpoint_receivers.emplace_back(builder.build());
     }
 
+    // Building request fetch senders and receivers
+    std::vector<tail_p2p::AsyncSender> fetch_senders;
+    for (auto &builder : fetch_senders_builders) {
+      fetch_senders.emplace_back(builder.build());
+    }
+    std::vector<tail_p2p::Receiver> fetch_receivers;
+    for (auto &builder : fetch_receivers_builders) {
+      fetch_receivers.emplace_back(builder.build());
+    }
+
     return Consensus(
         thread_pool, cb_broadcaster_builder.build(), std::move(cb_receivers),
         prepare_certifier_builder.build(), std::move(fast_commit_senders),
         std::move(fast_commit_receivers), std::move(vc_state_certifiers),
         checkpoint_certifier_builder.build(),
         std::move(cb_checkpoint_certifiers), std::move(cb_checkpoint_senders),
-        std::move(cb_checkpoint_receivers), crypto.myId(), window,
+        std::move(cb_checkpoint_receivers), std::move(fetch_senders),
+        std::move(fetch_receivers), crypto.myId(), window,
         max_request_size, max_batch_size, client_window);
   }
 
@@ -307,6 +347,9 @@ class ConsensusBuilder : Builder<Consensus> {
   // We need to broadcast our cb checkpoint to all.
   std::vector<tail_p2p::AsyncSenderBuilder> cb_checkpoint_senders_builders;
   std::vector<tail_p2p::ReceiverBuilder> cb_checkpoint_receivers_builders;
+  // We need to fetch the decided requests we never received from clients.
+  std::vector<tail_p2p::AsyncSenderBuilder> fetch_senders_builders;
+  std::vector<tail_p2p::ReceiverBuilder> fetch_receivers_builders;
 };
 
 }  // namespace dory::ubft::consensus
@@ -3,6 +3,7 @@
 #define CB_CHECKPOINTS true
 
 #include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <map>
@@ -21,6 +22,7 @@
 #include <dory/shared/dynamic-bitset.hpp>
 #include <dory/shared/logger.hpp>
 #include <dory/shared/match.hpp>
+#include <dory/shared/metrics.hpp>
 #include <dory/shared/unused-suppressor.hpp>
 #include <dory/third-party/sync/mpmc.hpp>
 
@@ -33,6 +35,7 @@
 #include "../tail-p2p/receiver.hpp"
 #include "../tail-p2p/sender.hpp"
 #include "../thread-pool/tail-thread-pool.hpp"
+#include "../tick-profiler.hpp"
 #include "../types.hpp"
 #include "../unsafe-at.hpp"
 #include "app.hpp"
@@ -97,6 +100,7 @@ class Consensus {
   using SealViewMessage = internal::SealViewMessage;
   using NewViewMessage = internal::NewViewMessage;
   using FastCommitMessage = internal::FastCommitMessage;
+  using FetchMessage = internal::FetchMessage;
   using Certificate = certifier::Certificate;
 
   struct VerifiedCommit {
@@ -116,6 +120,8 @@ class Consensus {
             std::vector<certifier::Certifier> &&cb_checkpoint_certifiers,
             std::vector<tail_p2p::AsyncSender> &&cb_checkpoint_senders,
             std::vector<tail_p2p::Receiver> &&cb_checkpoint_receivers,
+            std::vector<tail_p2p::AsyncSender> &&fetch_senders,
+            std::vector<tail_p2p::Receiver> &&fetch_receivers,
             ProcId const local_id, size_t const window,
             size_t const max_request_size, size_t const max_batch_size,
             size_t const client_window)
@@ -129,6 +135,8 @@ class Consensus {
         cb_checkpoint_certifiers{std::move(cb_checkpoint_certifiers)},
         cb_checkpoint_senders{std::move(cb_checkpoint_senders)},
         cb_checkpoint_receivers{std::move(cb_checkpoint_receivers)},
+        fetch_senders{std::move(fetch_senders)},
+        fetch_receivers{std::move(fetch_receivers)},
         local_id{local_id},
         local_index{this->cb_receivers.size()},  // We're last.
         quorum{(this->cb_receivers.size() + 1) / 2 + 1},
@@ -144,7 +152,9 @@ class Consensus {
             1, CommitMessage::bufferSize(max_proposal_size, quorum)},
         checkpoint_buffer_pool{1, CheckpointMessage::bufferSize(quorum)},
         instance_states{window},
-        request_log{client_window, max_request_size} {
+        request_log{client_window, max_request_size},
+        resolved_batch{max_proposal_size},
+        fetch_buffer{FetchMessage::bufferSize(max_request_size)} {
     // We don't care about promises for checkpoints, we want certificates.
     this->checkpoint_certifier.toggleFastPath(false);
     this->checkpoint_certifier.toggleSlowPath(true);
@@ -194,6 +204,7 @@ class Consensus {
     size_t accepted = 0;
     size_t executed = 0;
     bool triggered_view_change = false;
+    std::optional<std::chrono::steady_clock::time_point> view_change_start;
     LatencyProfiler latency_profiler(fast_path ? 5000 : 100);
     Buffer received_request(request_size);
 
@@ -214,12 +225,19 @@ class Consensus {
 
         // Let's say that the other trigger view change at about the same time.
         if (!triggered_view_change && executed >= *crash_at - 1) {
+          view_change_start = std::chrono::steady_clock::now();
           toggleSlowPath(true);
           changeView();
+          LOGGER_INFO(logger, "[Test] Sealed view {} in {}.",
+                      uat(states, local_index).at_view - 1,
+                      std::chrono::steady_clock::now() - *view_change_start);
           if (leader(uat(states, local_index).at_view) == local_id) {
             while (!canPropose()) {
               tick();
             }
+            LOGGER_INFO(logger, "[Test] Installed view {} as leader in {}.",
+                        uat(states, local_index).at_view,
+                        std::chrono::steady_clock::now() - *view_change_start);
             proposed = this->proposed;  // So that we continue the sequence.
           }
           triggered_view_change = true;
@@ -245,6 +263,13 @@ class Consensus {
 
       tick();
       if (auto opt_decision = pollDecision()) {
+        // Decisions after the seal necessarily belong to the new view.
+        if (unlikely(view_change_start)) {
+          LOGGER_INFO(logger,
+                      "[Test] View change latency (until first decision): {}.",
+                      std::chrono::steady_clock::now() - *view_change_start);
+          view_change_start.reset();
+        }
         auto const &batch = std::get<1>(*opt_decision);
         LOGGER_DEBUG(logger,
                      "[Test] Decided on a batch of size {} for instance {}!",
@@ -347,10 +372,12 @@ class Consensus {
   /**
    * @brief Get a batch where to write the requests.
    *
-   * @param proposal_size
+   * @param batch_size the size of the batch, including its header.
+   * @param format whether the requests will be inlined or referenced by digest.
    * @return std::optional<Batch>
    */
-  std::optional<Batch> getSlot(Size const batch_size) {
+  std::optional<Batch> getSlot(Size const batch_size,
+                               Batch::Format const format = Batch::Inline) {
     if (unlikely(batch_size > max_proposal_size)) {
       throw std::invalid_argument(
           fmt::format("Requested size {} > max proposal size {}.", batch_size,
@@ -367,8 +394,12 @@ class Consensus {
     prepare_buffer.kind = MessageKind::Prepare;
     prepare_buffer.view = uat(states, local_index).at_view;
     prepare_buffer.instance = next_proposal++;
-    return Batch(*reinterpret_cast<Batch::Layout *>(prepare_buffer.data()),
-                 batch_size);
+    Batch batch(*reinterpret_cast<Batch::Layout *>(prepare_buffer.data()),
+                batch_size);
+    if (batch_size >= Batch::headerSize()) {
+      batch.setFormat(format);
+    }
+    return batch;
   }
 
   ProposalResult propose() {
@@ -403,39 +434,80 @@ class Consensus {
   }
 
   void tick() {
+    using tick_profiler::Phase;
+    using tick_profiler::Scope;
     // 1. Base Abstractions
-    cb_broadcaster.tick();
-    for (auto &receiver : cb_receivers) {
-      receiver.tick();
+    {
+      Scope scope(Phase::CbBroadcaster);
+      cb_broadcaster.tick();
+    }
+    {
+      Scope scope(Phase::CbReceivers);
+      for (auto &receiver : cb_receivers) {
+        receiver.tick();
+      }
+    }
+    {
+      Scope scope(Phase::Certifiers);
+      prepare_certifier.tick();
     }
-    prepare_certifier.tick();
-    for (auto &sender : fast_commit_senders) {
-      sender.tickForCorrectness();
+    {
+      Scope scope(Phase::P2pSenders);
+      for (auto &sender : fast_commit_senders) {
+        sender.tickForCorrectness();
+      }
+    }
+    {
+      Scope scope(Phase::Certifiers);
+      for (auto &certifier : cb_checkpoint_certifiers) {
+        certifier.tick();
+      }
     }
-    for (auto &certifier : cb_checkpoint_certifiers) {
-      certifier.tick();
+    {
+      Scope scope(Phase::P2pSenders);
+      for (auto &sender : cb_checkpoint_senders) {
+        sender.tickForCorrectness();
+      }
+      for (auto &sender : fetch_senders) {
+        sender.tickForCorrectness();
+      }
     }
-    for (auto &sender : cb_checkpoint_senders) {
-      sender.tickForCorrectness();
+    {
+      Scope scope(Phase::Certifiers);
+      checkpoint_certifier.tick();
     }
-    checkpoint_certifier.tick();
 
     // 2. Consensus logic
-    pollCheckpointCertificate();
-    broadcastCheckpointCertificate();
-    pollCbs();
-    pollPrepareCertificatePromises();
-    if (unlikely(slow_path_enabled)) {
-      tryCertifyPrepares();
-      pollPrepareCertificates();
-      pollVerifiedCommits();
-      for (auto &certifier : vc_state_certifiers) {
-        certifier.tick();
+    {
+      Scope scope(Phase::ConsensusLogic);
+      pollCheckpointCertificate();
+      broadcastCheckpointCertificate();
+      pollCbs();
+      if (unlikely(recheck_prepares)) {
+        recheck_prepares = false;
+        missing_requests = false;
+        tryCertifyPrepares();
+      }
+      pollPrepareCertificatePromises();
+      if (unlikely(slow_path_enabled)) {
+        tryCertifyPrepares();
+        pollPrepareCertificates();
+        pollVerifiedCommits();
+        for (auto &certifier : vc_state_certifiers) {
+          certifier.tick();
+        }
+        pollVcStateCertificates();
       }
-      pollVcStateCertificates();
     }
-    pollFastCommits();
-    pollCbCheckpointCertificate();
+    {
+      Scope scope(Phase::FastCommits);
+      pollFastCommits();
+    }
+    {
+      Scope scope(Phase::ConsensusLogic);
+      pollCbCheckpointCertificate();
+      pollFetches();
+    }
   }
 
   /**
@@ -444,6 +516,9 @@ class Consensus {
    * @return std::optional<std::tuple<Instance, Batch, bool>>
    *         0. The decided instance.
    *         1. A Batch view of the decided requests, safe until the next tick.
+   *            Requests are always inlined: if the leader referenced them by
+   *            digest, the decision is only returned once all of them have
+   *            been received from the clients or fetched from the replicas.
    *         2. Whether a new checkpoint should be triggered.
    */
   std::optional<std::tuple<Instance, Batch, bool>> pollDecision() {
@@ -458,13 +533,29 @@ class Consensus {
     if (likely(!data.decidable())) {
       return std::nullopt;
     }
+    auto const proposed_batch = data.prepare_message.asBatch();
+    // A decided batch may reference requests we never validated ourselves
+    // (e.g., decided via the others' commits). We fetch them from the others.
+    auto const opt_batch =
+        unlikely(proposed_batch.format() == Batch::Digests)
+            ? request_log.resolve(proposed_batch, resolved_batch)
+            : std::optional<Batch>(proposed_batch);
+    if (unlikely(!opt_batch)) {
+      fetchMissing(proposed_batch);
+      return std::nullopt;
+    }
     data.decided = true;
     auto const decided_instance = next_to_decide++;
     auto const should_checkpoint =
         (decided_instance % (window / 2)) == (window / 2 - 1);
-    auto const batch = data.prepare_message.asBatch();
-    request_log.decided(batch);
-    return std::make_tuple(decided_instance, batch, should_checkpoint);
+    request_log.decided(*opt_batch);
+    if (unlikely(!pending_fetches.empty())) {
+      for (auto it = opt_batch->requests(); !it.done(); ++it) {
+        auto const request = *it;
+        pending_fetches.erase(std::make_pair(request.clientId(), request.id()));
+      }
+    }
+    return std::make_tuple(decided_instance, *opt_batch, should_checkpoint);
   }
 
   void triggerCheckpoint(Instance const last_applied,
@@ -493,6 +584,9 @@ class Consensus {
   }
 
   void toggleSlowPath(bool const enable) {
+    if (enable && !slow_path_enabled) {
+      slow_path_activations.add();
+    }
     slow_path_enabled = enable;
     cb_broadcaster.toggleSlowPath(enable);
     for (auto &receiver : cb_receivers) {
@@ -545,6 +639,29 @@ class Consensus {
     instance_states.clear();
   }
 
+  /**
+   * @brief The leader of the view this replica is in.
+   *
+   */
+  ProcId currentLeader() const {
+    return leader(uat(states, local_index).at_view);
+  }
+
+  /**
+   * @brief Whether the next instance to decide was prepared in the current view
+   *        but could not be decided yet.
+   *
+   */
+  bool awaitingDecision() {
+    return instance_states.find(next_to_decide) != instance_states.end();
+  }
+
+  /**
+   * @brief The number of instances that can be ongoing at once.
+   *
+   */
+  size_t decisionWindow() const { return window; }
+
   bool inline canPropose() const {
     return leader(uat(states, local_index).at_view) == local_id &&
            !ongoing_view_change;
@@ -552,7 +669,18 @@ class Consensus {
 
   bool acceptRequest(ProcId const client_id, RequestId const request_id,
                      uint8_t const *const begin, size_t const size) {
-    return request_log.addRequest(client_id, request_id, begin, size);
+    auto const accepted =
+        request_log.addRequest(client_id, request_id, begin, size);
+    // Some prepares could not be certified as they referenced requests we
+    // hadn't received yet: this one might be what they were waiting for.
+    if (unlikely(missing_requests) && accepted) {
+      recheck_prepares = true;
+    }
+    // No need to fetch it from the others anymore.
+    if (unlikely(!pending_fetches.empty()) && accepted) {
+      pending_fetches.erase(std::make_pair(client_id, request_id));
+    }
+    return accepted;
   }
 
  private:
@@ -561,6 +689,7 @@ class Consensus {
   void pollCbs() {
     for (auto &&[replica, receiver] : hipony::enumerate(cb_receivers)) {
       if (auto polled = receiver.poll()) {
+        tick_profiler::busy();
         handleCbMessage(replica, std::move(*polled));
       }
     }
@@ -740,6 +869,7 @@ class Consensus {
       LOGGER_DEBUG(logger,
                    "[Prepare] Received some batched requests that I never "
                    "received (indirectly) from their clients.");
+      missing_requests = true;
       return;
     }
     auto const from_me = leader(pm.view()) == local_id;
@@ -958,6 +1088,100 @@ class Consensus {
     }
   }
 
+  /**
+   * @brief Ask the other replicas for the requests of a decided batch that we
+   *        never received from their clients.
+   *
+   * The batch being decided, at least one correct replica validated, and thus
+   * stored, each of them. Queries are resent until answered.
+   */
+  void fetchMissing(Batch const &batch) {
+    auto const now = std::chrono::steady_clock::now();
+    request_log.forEachMissing(batch, [&](Batch::Request const &request) {
+      auto const [it, inserted] = pending_fetches.try_emplace(
+          std::make_pair(request.clientId(), request.id()),
+          PendingFetch{request.digest(), request.size(), now});
+      auto &pending = it->second;
+      if (!inserted && pending.digest == request.digest() &&
+          now - pending.sent_at < FetchRetryPeriod) {
+        return;
+      }
+      pending = PendingFetch{request.digest(), request.size(), now};
+      LOGGER_DEBUG(logger, "[Fetch] Querying request {} of client {}.",
+                   request.id(), request.clientId());
+      for (auto &sender : fetch_senders) {
+        auto *slot = sender.getSlot(
+            static_cast<tail_p2p::Size>(FetchMessage::querySize()));
+        auto &query = *reinterpret_cast<FetchMessage *>(slot);
+        query.kind = FetchMessage::Query;
+        query.client_id = request.clientId();
+        query.request_id = request.id();
+        query.digest = request.digest();
+        sender.send();
+      }
+    });
+  }
+
+  /**
+   * @brief Answer the queries of the other replicas with the requests we have
+   *        and store the replies that match the digests we asked for.
+   */
+  void pollFetches() {
+    for (auto &&[from, receiver] : hipony::enumerate(fetch_receivers)) {
+      auto const opt_polled = receiver.poll(fetch_buffer.data());
+      if (likely(!opt_polled)) {
+        continue;
+      }
+      tick_profiler::busy();
+      if (unlikely(*opt_polled < FetchMessage::querySize())) {
+        LOGGER_WARN(logger, "[P2P:{}][Fetch] Message too small.",
+                    uat(ids, from));
+        continue;
+      }
+      auto const &msg =
+          *reinterpret_cast<FetchMessage const *>(fetch_buffer.data());
+      if (msg.kind == FetchMessage::Query) {
+        auto const *const payload =
+            request_log.find(msg.client_id, msg.request_id, msg.digest);
+        if (payload == nullptr) {
+          continue;
+        }
+        auto &sender = uat(fetch_senders, from);
+        auto *slot = sender.getSlot(static_cast<tail_p2p::Size>(
+            FetchMessage::querySize() + payload->size()));
+        auto &reply = *reinterpret_cast<FetchMessage *>(slot);
+        reply.kind = FetchMessage::Reply;
+        reply.client_id = msg.client_id;
+        reply.request_id = msg.request_id;
+        reply.digest = msg.digest;
+        std::copy(payload->cbegin(), payload->cend(), &reply.payload);
+        sender.send();
+        continue;
+      }
+      auto const pending_it =
+          pending_fetches.find(std::make_pair(msg.client_id, msg.request_id));
+      if (pending_it == pending_fetches.end()) {
+        continue;  // Already answered by another replica.
+      }
+      auto const &pending = pending_it->second;
+      if (request_log.find(msg.client_id, msg.request_id, pending.digest) !=
+          nullptr) {
+        pending_fetches.erase(pending_it);
+        continue;  // Received in the meantime.
+      }
+      auto const size = *opt_polled - FetchMessage::querySize();
+      if (unlikely(msg.kind != FetchMessage::Reply || size != pending.size ||
+                   crypto::hash::blake3(&msg.payload, &msg.payload + size) !=
+                       pending.digest)) {
+        LOGGER_WARN(logger, "[P2P:{}][Fetch] Invalid reply.", uat(ids, from));
+        continue;
+      }
+      request_log.addFetched(msg.client_id, msg.request_id, pending.digest,
+                             &msg.payload, size);
+      pending_fetches.erase(pending_it);
+    }
+  }
+
   void pollFastCommits() {
     for (auto &&[from, receiver] : hipony::enumerate(fast_commit_receivers)) {
       FastCommitMessage fcm;
@@ -1041,11 +1265,7 @@ class Consensus {
     }
     auto &replica_state = uat(states, from);
     replica_state.checkpoint = raw_checkpoint;
-    auto &commits = replica_state.commits;
-    auto const prune_below = raw_checkpoint.propose_range.low;
-    while (!commits.empty() && commits.begin()->first < prune_below) {
-      commits.erase(commits.begin());
-    }
+    replica_state.pruneCommits(raw_checkpoint.propose_range.low);
     handleCheckpointCertificate(std::move(certificate));
   }
 
@@ -1154,6 +1374,10 @@ class Consensus {
     LOGGER_DEBUG(logger, "[SealView] Serialized view {}: {} commits.",
                  vc_state.view(), vc_state.nbBroadcastCommits());
     auto const next_view = ++replica_state.at_view;
+    if (from == local_index) {
+      view_changes.add();
+      current_view.set(next_view);
+    }
     state_certifier.acknowledge(
         sealed_view, vc_state.rawBuffer().data(),
         vc_state.rawBuffer().data() + vc_state.rawBuffer().size());
@@ -1355,6 +1579,8 @@ class Consensus {
   std::vector<certifier::Certifier> cb_checkpoint_certifiers;
   std::vector<tail_p2p::AsyncSender> cb_checkpoint_senders;
   std::vector<tail_p2p::Receiver> cb_checkpoint_receivers;
+  std::vector<tail_p2p::AsyncSender> fetch_senders;
+  std::vector<tail_p2p::Receiver> fetch_receivers;
 
   ProcId local_id;
   size_t local_index;
@@ -1406,6 +1632,30 @@ class Consensus {
   std::vector<TailThreadPool::TaskQueue> commit_verification_task_queues;
 
   internal::RequestLog request_log;
+  // Whether some prepare couldn't be certified because of missing requests.
+  bool missing_requests = false;
+  // Whether requests were received since, so that prepares should be retried.
+  bool recheck_prepares = false;
+  // Where digest-referenced batches are inlined upon decision.
+  Buffer resolved_batch;
+
+  // Requests of decided batches that we are fetching from the others.
+  struct PendingFetch {
+    Batch::Digest digest;
+    size_t size;
+    std::chrono::steady_clock::time_point sent_at;
+  };
+  static auto constexpr FetchRetryPeriod = std::chrono::milliseconds(1);
+  std::map<std::pair<ProcId, RequestId>, PendingFetch> pending_fetches;
+  Buffer fetch_buffer;
+
+  metrics::Counter slow_path_activations =
+      metrics::Registry::instance().counter("consensus.slow_path_activations");
+  metrics::Counter view_changes =
+      metrics::Registry::instance().counter("consensus.view_changes");
+  metrics::Gauge current_view =
+      metrics::Registry::instance().gauge("consensus.view");
+
   LOGGER_DECL_INIT(logger, "Consensus");
 };
 
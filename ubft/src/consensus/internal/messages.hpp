@@ -9,6 +9,7 @@
 #include "../../certifier/certificate.hpp"
 #include "../../tail-cb/receiver.hpp"
 #include "../types.hpp"
+#include "requests.hpp"
 #include "serialized-state.hpp"
 
 /**
@@ -231,6 +232,13 @@ struct SealViewMessage : public CbMessage {
   }
 };
 
+/**
+ * @brief Message sent by the new leader with a quorum of certified states.
+ *
+ * Certificates are stored back to back with their actual size, so the size of
+ * the message depends on how many commits the states hold rather than on the
+ * window.
+ */
 struct NewViewMessage : public CbMessage {
   struct Layout {
     MessageKind kind;  // Must always be the first field
@@ -248,22 +256,44 @@ struct NewViewMessage : public CbMessage {
   NewViewMessage(tail_cb::Message &&msg) : CbMessage{std::move(msg)} {}
 
  public:
-  size_t static constexpr bufferSize(
-      size_t const window, size_t const max_proposal_size, size_t const quorum,
-      std::optional<size_t> nb_certificates = std::nullopt) {
+  /**
+   * @brief Upper bound on the size of a NewView message.
+   *
+   */
+  size_t static constexpr bufferSize(size_t const window,
+                                     size_t const max_proposal_size,
+                                     size_t const quorum) {
     return offsetof(Layout, vc_certificates) +
-           nb_certificates.value_or(quorum) *
-               (offsetof(VcCertificateEntry, certificate) +
-                certifier::Certificate::bufferSize(
-                    internal::SerializedState::bufferSize(window,
-                                                          max_proposal_size),
-                    quorum));
+           quorum * entrySize(certifier::Certificate::bufferSize(
+                        internal::SerializedState::bufferSize(
+                            window, max_proposal_size),
+                        quorum));
+  }
+
+  size_t static constexpr entrySize(size_t const certificate_size) {
+    return offsetof(VcCertificateEntry, certificate) + certificate_size;
   }
 
   static std::variant<std::invalid_argument, NewViewMessage> tryFrom(
       tail_cb::Message &&msg, size_t const window,
       size_t const max_proposal_size, size_t const quorum) {
-    if (msg.size() != bufferSize(window, max_proposal_size, quorum)) {
+    if (msg.size() > bufferSize(window, max_proposal_size, quorum)) {
+      return std::invalid_argument("New view is too big.");
+    }
+    // We check that the quorum of entries exactly spans the message.
+    size_t offset = offsetof(Layout, vc_certificates);
+    for (size_t i = 0; i < quorum; i++) {
+      if (offset + entrySize(0) > msg.size()) {
+        return std::invalid_argument("New view is missing certificates.");
+      }
+      auto const &ce =
+          *reinterpret_cast<VcCertificateEntry const *>(msg.data() + offset);
+      if (ce.certificate_size > msg.size() - offset - entrySize(0)) {
+        return std::invalid_argument("New view certificate overflows.");
+      }
+      offset += entrySize(ce.certificate_size);
+    }
+    if (offset != msg.size()) {
       return std::invalid_argument("New view size doesn't match.");
     }
     return NewViewMessage(std::move(msg));
@@ -287,10 +317,17 @@ struct NewViewMessage : public CbMessage {
    *         and the certificate buffer.
    */
   std::pair<ProcId, Buffer> cloneCertificateBuffer(
-      size_t const index, size_t const window, size_t const max_proposal_size,
-      size_t const quorum) const {
-    auto const &ce = *reinterpret_cast<VcCertificateEntry const *>(
-        msg.data() + bufferSize(window, max_proposal_size, quorum, index));
+      size_t const index, size_t const /*window*/,
+      size_t const /*max_proposal_size*/, size_t const /*quorum*/) const {
+    // Entries are variable-length, we have to walk to the index-th one.
+    size_t offset = offsetof(Layout, vc_certificates);
+    for (size_t i = 0; i < index; i++) {
+      offset += entrySize(
+          reinterpret_cast<VcCertificateEntry const *>(msg.data() + offset)
+              ->certificate_size);
+    }
+    auto const &ce =
+        *reinterpret_cast<VcCertificateEntry const *>(msg.data() + offset);
     Buffer buffer(ce.certificate_size);
     std::copy(&ce.certificate, &ce.certificate + ce.certificate_size,
               buffer.data());
@@ -335,8 +372,8 @@ struct NewViewMessage : public CbMessage {
     for (size_t i = 0; i < quorum; i++) {
       auto const ss =
           cloneSerializedState(i, window, max_proposal_size, quorum);
-      for (size_t j = 0; j < ss.nbBroadcastCommits(); j++) {
-        auto const &commit = ss.commit(j);
+      for (auto it = ss.commits(); !it.done(); ++it) {
+        auto const &commit = *it;
         // fmt::print("Scanning serialized state {}, commit.instance {}...\n",
         //            i, commit.instance);
         auto bp_it = best_proposals.find(commit.instance);
@@ -416,4 +453,29 @@ struct FastCommitMessage {
   Instance instance;
 };
 
+/**
+ * @brief Query for (or reply with) the payload of a request that a decided
+ *        batch references by digest but that we never received from its
+ *        client.
+ *
+ * Queries stop at `payload`, replies append the payload of the request.
+ */
+struct FetchMessage {
+  enum Kind : uint8_t { Query = 0, Reply = 1 };
+
+  Kind kind;
+  ProcId client_id;
+  RequestId request_id;
+  Batch::Digest digest;
+  uint8_t payload; /* Fake field where to store the payload */
+
+  static size_t constexpr querySize() {
+    return offsetof(FetchMessage, payload);
+  }
+
+  static size_t constexpr bufferSize(size_t const max_request_size) {
+    return querySize() + max_request_size;
+  }
+};
+
 }  // namespace dory::ubft::consensus::internal
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <optional>
 
 #include <dory/shared/branching.hpp>
 
@@ -20,13 +21,16 @@ namespace dory::ubft::consensus::internal {
  * @brief Stores all the data deduced from what a replica cb-broadcast.
  *        Can serialize a state so that it can be agreed upon.
  *        Pre-allocates buffers so that committing is "free".
+ *        The serialized state is kept up to date as commits are received, so
+ *        that sealing a view only costs a copy (of its actual size).
  *
  */
 class ReplicaState {
  public:
   ReplicaState(size_t const window, size_t const max_proposal_size)
       : checkpoint{0, window, {}},
-        pool{window + 1, BroadcastCommit::size(max_proposal_size)} {}
+        pool{window + 1, BroadcastCommit::size(max_proposal_size)},
+        live_state{window + 1, max_proposal_size} {}
 
   // The view the replica is in, increasing upon SealView message.
   View at_view = 0;
@@ -65,23 +69,49 @@ class ReplicaState {
     }
 
     auto const prev_it = commits.find(instance);
+    auto replaced = false;
     if (unlikely(prev_it != commits.end())) {
       if (unlikely(prev_it->second.view() >= view)) {
         return false;
       } else {
         commits.erase(prev_it);
+        replaced = true;
       }
     }
-    commits.try_emplace(instance, prepare_certificate, std::move(*opt_buffer));
+    auto const& commit =
+        commits
+            .try_emplace(instance, prepare_certificate, std::move(*opt_buffer))
+            .first->second;
+    // Commits only get replaced after a view change, in which case we rebuild
+    // the serialized state rather than punching holes in it.
+    if (unlikely(replaced || !live_state.tryAppend(commit))) {
+      rebuildLiveState();
+    }
     return true;
   }
 
+  /**
+   * @brief Forget about the commits for instances below `instance`.
+   *
+   */
+  void pruneCommits(Instance const instance) {
+    if (commits.empty() || commits.begin()->first >= instance) {
+      return;
+    }
+    while (!commits.empty() && commits.begin()->first < instance) {
+      commits.erase(commits.begin());
+    }
+    live_state.pruneBelow(instance);
+  }
+
   internal::SerializedState const& serializeState() {
-    serialized_state.emplace(at_view, commits);
+    live_state.view() = at_view;
+    serialized_state.emplace(live_state.clone());
     return *serialized_state;
   }
 
-  // The serialized state for the last view change is held.
+  // The serialized state for the last view change is held, as it is being
+  // certified. Sealing views being rare, it is allocated on demand.
   std::optional<internal::SerializedState> serialized_state;
 
   internal::CbCheckpoint const& checkpointCb() {
@@ -94,7 +124,19 @@ class ReplicaState {
   std::optional<internal::CbCheckpoint> cb_checkpoint;
 
  private:
+  void rebuildLiveState() {
+    live_state.clear();
+    for (auto const& [_, commit] : commits) {
+      if (unlikely(!live_state.tryAppend(commit))) {
+        throw std::logic_error("Serialized state cannot fit all commits.");
+      }
+    }
+  }
+
   Pool pool;
+
+  // The serialized state, maintained as commits are received/pruned.
+  internal::SerializedState live_state;
 };
 
 }  // namespace dory::ubft::consensus::internal
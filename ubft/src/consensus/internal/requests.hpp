@@ -3,11 +3,14 @@
 #include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <map>
 #include <optional>
 #include <stdexcept>
 #include <string_view>
+#include <utility>
 #include <vector>
 
+#include <dory/crypto/hash/blake3.hpp>
 #include <dory/shared/branching.hpp>
 #include <dory/shared/logger.hpp>
 
@@ -20,9 +23,16 @@ namespace dory::ubft::consensus::internal {
 /**
  * @brief Batch of requests received from the leader. *Does NOT own the batch.*
  *
+ * A batch either inlines the payload of its requests, or only references them
+ * by digest. In the latter case, replicas resolve the payloads against the
+ * requests they received (indirectly) from the clients via their RequestLog.
  */
 class Batch {
  public:
+  enum Format : uint8_t { Inline = 0, Digests = 1 };
+
+  using Digest = crypto::hash::Blake3Hash;
+
   /**
    * @brief Individual request inside the batch. *Does NOT own the request.*
    *
@@ -75,6 +85,17 @@ class Batch {
       return std::string_view(reinterpret_cast<char const*>(begin()), size());
     }
 
+    /**
+     * @brief Digest of the request, only valid within a Digests batch where it
+     *        replaces the payload.
+     */
+    inline Digest const& digest() const {
+      return *reinterpret_cast<Digest const*>(payload());
+    }
+    inline Digest& digest() {
+      return const_cast<Digest&>(std::as_const(*this).digest());
+    }
+
    private:
     Request::Layout& raw_request;
   };
@@ -89,7 +110,9 @@ class Batch {
         : batch{batch}, end{offsetof(Layout, requests) >= batch.size} {}
 
     inline Iterator& operator++() {
-      offset += Request::bufferSize((**this).size());
+      offset += batch.format() == Digests
+                    ? Request::bufferSize(sizeof(Digest))
+                    : Request::bufferSize((**this).size());
       end = offsetof(Layout, requests) + offset >= batch.size;
       return *this;
     }
@@ -110,17 +133,38 @@ class Batch {
   };
 
   struct Layout {
+    Format format;
     uint8_t requests; /* Fake field where to store the requests */
   };
 
+  static size_t constexpr headerSize() { return offsetof(Layout, requests); }
+
   static size_t bufferSize(size_t const batch_size, size_t const request_size) {
-    return offsetof(Layout, requests) +
-           batch_size * Batch::Request::bufferSize(request_size);
+    return headerSize() + batch_size * Batch::Request::bufferSize(request_size);
+  }
+
+  static size_t digestsBufferSize(size_t const batch_size) {
+    return bufferSize(batch_size, sizeof(Digest));
   }
 
   inline Batch(Layout& raw_batch, size_t const size)
       : raw_batch{raw_batch}, size{size} {}
 
+  /**
+   * @brief Format of the batch. Empty batches (i.e., without a header) are
+   *        considered inline.
+   */
+  inline Format format() const {
+    return size < headerSize() ? Inline : raw_batch.format;
+  }
+
+  inline void setFormat(Format const format) {
+    if (unlikely(size < headerSize())) {
+      throw std::logic_error("Cannot set the format of an empty batch.");
+    }
+    raw_batch.format = format;
+  }
+
   inline const Iterator requests() const { return Iterator(*this); }
 
   inline Iterator requests() { return std::as_const(*this).requests(); }
@@ -161,13 +205,48 @@ class SingleClientRequests {
     return requests.tryEmplace(request_id, std::move(*opt_buffer)).second;
   }
 
-  bool isValid(Batch::Request const& request) const {
+  bool isValid(Batch::Request const& request,
+               Batch::Format const format) const {
     auto const it = requests.find(request.id());
     if (unlikely(it == requests.end())) {
       return false;
     }
-    return std::equal(it->second.cbegin(), it->second.cend(), request.begin(),
-                      request.end());
+    auto const& stored = it->second;
+    if (format == Batch::Digests) {
+      return stored.payload.size() == request.size() &&
+             stored.digest() == request.digest();
+    }
+    return std::equal(stored.payload.cbegin(), stored.payload.cend(),
+                      request.begin(), request.end());
+  }
+
+  /**
+   * @brief Get the payload of a request previously received from the client.
+   *
+   * @return Buffer const* the payload or nullptr if it was never received.
+   */
+  Buffer const* find(RequestId const request_id) const {
+    auto const it = requests.find(request_id);
+    if (unlikely(it == requests.end())) {
+      return nullptr;
+    }
+    return &it->second.payload;
+  }
+
+  /**
+   * @brief Get the payload of a request previously received from the client
+   *        provided that it matches `digest`.
+   *
+   * @return Buffer const* the payload or nullptr if it was never received or
+   *         does not match.
+   */
+  Buffer const* find(RequestId const request_id,
+                     Batch::Digest const& digest) const {
+    auto const it = requests.find(request_id);
+    if (unlikely(it == requests.end() || it->second.digest() != digest)) {
+      return nullptr;
+    }
+    return &it->second.payload;
   }
 
   void decided(Batch::Request const& request) {
@@ -175,9 +254,27 @@ class SingleClientRequests {
   }
 
  private:
+  /**
+   * @brief A request received from the client along with its digest, which is
+   *        only computed if a digest-referenced batch includes the request.
+   */
+  struct StoredRequest {
+    StoredRequest(Buffer&& payload) : payload{std::move(payload)} {}
+
+    Batch::Digest const& digest() const {
+      if (!cached_digest) {
+        cached_digest = crypto::hash::blake3(payload.cbegin(), payload.cend());
+      }
+      return *cached_digest;
+    }
+
+    Buffer payload;
+    mutable std::optional<Batch::Digest> cached_digest;
+  };
+
   size_t window;
   Pool pool;
-  TailMap<RequestId, Buffer> requests;
+  TailMap<RequestId, StoredRequest> requests;
   std::optional<RequestId> accept_below;
 };
 
@@ -221,13 +318,14 @@ class RequestLog {
   }
 
   bool isValid(Batch const& batch) const {
+    auto const format = batch.format();
     for (auto it = batch.requests(); !it.done(); ++it) {
       auto const& request = *it;
       if (unlikely(!clientExists(request.clientId()))) {
         LOGGER_WARN(logger, "Client {} does not exist.", request.clientId());
         return false;
       }
-      if (unlikely(!client(request.clientId())->isValid(request))) {
+      if (unlikely(!client(request.clientId())->isValid(request, format))) {
         LOGGER_DEBUG(logger, "Request {} not valid for client {}.",
                      request.id(), request.clientId());
         return false;
@@ -236,14 +334,105 @@ class RequestLog {
     return true;
   }
 
+  /**
+   * @brief Get the payload of a request, either received from its client or
+   *        fetched from another replica, provided that it matches `digest`.
+   *
+   * @return Buffer const* the payload or nullptr if we don't have it.
+   */
+  Buffer const* find(ProcId const client_id, RequestId const request_id,
+                     Batch::Digest const& digest) const {
+    if (likely(clientExists(client_id))) {
+      if (auto const* payload = client(client_id)->find(request_id, digest)) {
+        return payload;
+      }
+    }
+    auto const it = fetched.find({client_id, request_id});
+    if (it == fetched.end() || it->second.digest != digest) {
+      return nullptr;
+    }
+    return &it->second.payload;
+  }
+
+  /**
+   * @brief Store the payload of a request that a decided batch references but
+   *        that we never received from its client. The caller must have
+   *        checked it against the digest.
+   *
+   * Such requests are kept aside as they may be older than what the client
+   * store accepts. They are dropped once the batch is decided.
+   */
+  void addFetched(ProcId const client_id, RequestId const request_id,
+                  Batch::Digest const& digest, uint8_t const* const begin,
+                  size_t const size) {
+    Buffer payload(size);
+    std::copy(begin, begin + size, payload.data());
+    fetched.insert_or_assign({client_id, request_id},
+                             FetchedRequest{digest, std::move(payload)});
+  }
+
+  /**
+   * @brief Call `f(request)` for every request of a digest-referenced batch
+   *        whose payload we don't have.
+   */
+  template <typename F>
+  void forEachMissing(Batch const& batch, F&& f) const {
+    for (auto it = batch.requests(); !it.done(); ++it) {
+      auto const& request = *it;
+      if (find(request) == nullptr) {
+        f(request);
+      }
+    }
+  }
+
+  /**
+   * @brief Rebuild an inline batch from a batch that references requests by
+   *        digest, using the payloads received from the clients or fetched
+   *        from the other replicas.
+   *
+   * @param batch the digest-referenced batch.
+   * @param resolved the buffer where to write the inline batch.
+   * @return std::optional<Batch> the inline batch (backed by `resolved`), or
+   *         std::nullopt if some request was not received yet.
+   */
+  std::optional<Batch> resolve(Batch const& batch, Buffer& resolved) const {
+    size_t resolved_size = Batch::headerSize();
+    for (auto it = batch.requests(); !it.done(); ++it) {
+      auto const& request = *it;
+      if (unlikely(find(request) == nullptr)) {
+        LOGGER_DEBUG(logger, "Request {} from {} is missing, cannot resolve.",
+                     request.id(), request.clientId());
+        return std::nullopt;
+      }
+      resolved_size += Batch::Request::bufferSize(request.size());
+    }
+    resolved.resize(resolved_size);
+    Batch inlined(*reinterpret_cast<Batch::Layout*>(resolved.data()),
+                  resolved_size);
+    inlined.setFormat(Batch::Inline);
+    auto inlined_it = inlined.requests();
+    for (auto it = batch.requests(); !it.done(); ++it, ++inlined_it) {
+      auto const& request = *it;
+      auto const& payload = *find(request);
+      auto inlined_request = *inlined_it;
+      inlined_request.clientId() = request.clientId();
+      inlined_request.id() = request.id();
+      inlined_request.size() = request.size();
+      std::copy(payload.cbegin(), payload.cend(), inlined_request.begin());
+    }
+    return inlined;
+  }
+
   void decided(Batch const& batch) {
     for (auto it = batch.requests(); !it.done(); ++it) {
       auto const request = *it;
       if (unlikely(!clientExists(request.clientId()))) {
         LOGGER_WARN(logger,
                     "A request was accepted for a client that we didn't know.");
+        addClient(request.clientId());
       }
       client(request.clientId())->decided(request);
+      fetched.erase({request.clientId(), request.id()});
     }
   }
 
@@ -258,10 +447,25 @@ class RequestLog {
   }
 
  private:
+  struct FetchedRequest {
+    Batch::Digest digest;
+    Buffer payload;
+  };
+
+  Buffer const* find(Batch::Request const& request) const {
+    auto const* const payload =
+        find(request.clientId(), request.id(), request.digest());
+    if (unlikely(payload == nullptr || payload->size() != request.size())) {
+      return nullptr;
+    }
+    return payload;
+  }
+
   size_t const client_window;
   size_t const max_request_size;
   std::vector<std::optional<SingleClientRequests>>
       client_requests; /* map from clients' ids to clients' requests */
+  std::map<std::pair<ProcId, RequestId>, FetchedRequest> fetched;
   LOGGER_DECL_INIT(logger, "RequestLog");
 };
 
@@ -1,5 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <dory/shared/branching.hpp>
+
+#include "../../buffer.hpp"
+#include "../../message.hpp"
 #include "../types.hpp"
 #include "broadcast-commit.hpp"
 #include "packing.hpp"
@@ -10,6 +19,11 @@ namespace dory::ubft::consensus::internal {
  * @brief Serialized state of a replica that can be acknowledged/forwarded upon
  *        ViewSeal.
  *
+ * Commits are stored back to back, each entry only taking the space of its own
+ * proposal. The state is meant to be maintained incrementally (as commits are
+ * received and checkpoints prune them) so that it is ready to be certified as
+ * soon as the replica seals its view.
+ *
  */
 struct SerializedState : public dory::ubft::Message {
   using Message::Message;
@@ -18,29 +32,65 @@ struct SerializedState : public dory::ubft::Message {
   struct Layout {
     View view;
     size_t nb_commits;
-    size_t max_proposal_size;
     uint8_t commits;  // Fake field, start of the commit entries.
   };
 #pragma pack(pop)
 
-  // Note: We do not try to compress the commits, we waste space.
+  /**
+   * @brief Iterator over the commit entries of a serialized state.
+   *
+   */
+  class Iterator {
+   public:
+    inline Iterator(SerializedState const& state)
+        : state{state}, remaining{state.nbBroadcastCommits()} {
+      checkBounds();
+    }
+
+    inline Iterator& operator++() {
+      offset += BroadcastCommit::size((**this).proposal_size);
+      remaining--;
+      checkBounds();
+      return *this;
+    }
+
+    inline BroadcastCommit::Layout const& operator*() const {
+      return *reinterpret_cast<BroadcastCommit::Layout const*>(
+          state.rawBuffer().data() + offset);
+    }
+
+    inline bool done() const { return remaining == 0; }
+
+   private:
+    void checkBounds() const {
+      if (unlikely(!done() &&
+                   (offset + BroadcastCommit::size(0) > state.size() ||
+                    offset + BroadcastCommit::size((**this).proposal_size) >
+                        state.size()))) {
+        throw std::logic_error("Malformed serialized state.");
+      }
+    }
+
+    SerializedState const& state;
+    size_t remaining;
+    size_t offset = offsetof(Layout, commits);
+  };
+
+  /**
+   * @brief Upper bound on the size of a serialized state.
+   *
+   */
   size_t static constexpr bufferSize(size_t const nb_commits,
                                      size_t const max_proposal_size) {
     return offsetof(Layout, commits) +
            nb_commits * BroadcastCommit::size(max_proposal_size);
   }
 
-  // Note: allocates a buffer.
-  SerializedState(View const v,
-                  std::map<Instance, BroadcastCommit> const& commits)
-      : dory::ubft::Message(bufferSize(commits.size(), maxSize(commits))) {
-    view() = v;
-    nbBroadcastCommits() = commits.size();
-    maxProposalSize() = maxSize(commits);
-    for (auto const& [index, c] : hipony::enumerate(commits)) {
-      std::copy(c.second.buffer.cbegin(), c.second.buffer.cend(),
-                reinterpret_cast<uint8_t*>(&commit(index)));
-    }
+  // Note: allocates a buffer that can fit up to `max_commits` commits.
+  SerializedState(size_t const max_commits, size_t const max_proposal_size)
+      : dory::ubft::Message(
+            Buffer(bufferSize(max_commits, max_proposal_size))) {
+    clear();
   }
 
   View const& view() const {
@@ -57,38 +107,75 @@ struct SerializedState : public dory::ubft::Message {
     return const_cast<size_t&>(std::as_const(*this).nbBroadcastCommits());
   }
 
-  size_t const& maxProposalSize() const {
-    return reinterpret_cast<Layout const*>(rawBuffer().data())
-        ->max_proposal_size;
-  }
+  inline Iterator commits() const { return Iterator(*this); }
 
-  size_t& maxProposalSize() {
-    return const_cast<size_t&>(std::as_const(*this).maxProposalSize());
-  }
+  size_t size() const { return rawBuffer().size(); }
 
-  BroadcastCommit::Layout const& commit(size_t const index) const {
-    auto const offset = offsetof(Layout, commits) +
-                        index * BroadcastCommit::size(maxProposalSize());
-    return *reinterpret_cast<BroadcastCommit::Layout const*>(
-        rawBuffer().data() + offset);
+  /**
+   * @brief Remove all the commits.
+   *
+   */
+  void clear() {
+    rawBuffer().resize(offsetof(Layout, commits));
+    nbBroadcastCommits() = 0;
   }
 
-  BroadcastCommit::Layout& commit(size_t const index) {
-    return const_cast<BroadcastCommit::Layout&>(
-        std::as_const(*this).commit(index));
+  /**
+   * @brief Append a commit at the end of the state.
+   *
+   * @return false if there was not enough space left.
+   */
+  bool tryAppend(BroadcastCommit const& commit) {
+    auto& buffer = rawBuffer();
+    auto const offset = buffer.size();
+    auto const entry_size = commit.buffer.size();
+    if (unlikely(offset + entry_size > buffer.capacity())) {
+      return false;
+    }
+    buffer.resize(offset + entry_size);
+    std::copy(commit.buffer.cbegin(), commit.buffer.cend(),
+              buffer.data() + offset);
+    nbBroadcastCommits()++;
+    return true;
   }
 
-  size_t size() const { return rawBuffer().size(); }
-
- private:
-  static size_t maxSize(std::map<Instance, BroadcastCommit> const& commits) {
-    size_t max = 0;
-    for (auto const& [_, commit] : commits) {
-      if (max < commit.proposalSize()) {
-        max = commit.proposalSize();
+  /**
+   * @brief Remove in place all the commits for instances below `instance`.
+   *
+   */
+  void pruneBelow(Instance const instance) {
+    auto& buffer = rawBuffer();
+    size_t read = offsetof(Layout, commits);
+    size_t write = read;
+    size_t kept = 0;
+    for (size_t i = 0; i < nbBroadcastCommits(); i++) {
+      auto const& entry = *reinterpret_cast<BroadcastCommit::Layout const*>(
+          buffer.data() + read);
+      auto const entry_size = BroadcastCommit::size(entry.proposal_size);
+      if (entry.instance >= instance) {
+        if (write != read) {
+          std::memmove(buffer.data() + write, buffer.data() + read,
+                       entry_size);
+        }
+        write += entry_size;
+        kept++;
       }
+      read += entry_size;
     }
-    return max;
+    buffer.resize(write);
+    nbBroadcastCommits() = kept;
+  }
+
+  /**
+   * @brief Copy the state into a buffer of its actual size.
+   *
+   * Allocates the buffer on the heap.
+   *
+   */
+  SerializedState clone() const {
+    Buffer buffer(size());
+    std::copy(rawBuffer().cbegin(), rawBuffer().cend(), buffer.data());
+    return SerializedState(std::move(buffer));
   }
 };
 
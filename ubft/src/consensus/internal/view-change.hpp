@@ -2,8 +2,9 @@
 
 #include <cstddef>
 #include <map>
+#include <stdexcept>
 
-#include <hipony/enumerate.hpp>
+#include <dory/shared/branching.hpp>
 
 #include "../types.hpp"
 #include "messages.hpp"
@@ -23,22 +24,29 @@ class ViewChangeState {
 
   Buffer buildNewView(size_t const window, size_t const max_proposal_size,
                       size_t const quorum) {
-    Buffer buffer(
-        NewViewMessage::bufferSize(window, max_proposal_size, quorum));
+    size_t size = offsetof(NewViewMessage::Layout, vc_certificates);
+    for (auto const &[_, certificate] : vc_state_certificates) {
+      size += NewViewMessage::entrySize(certificate.rawBuffer().size());
+    }
+    auto const max_size =
+        NewViewMessage::bufferSize(window, max_proposal_size, quorum);
+    if (unlikely(size > max_size)) {
+      throw std::logic_error("NewView exceeds its maximum size.");
+    }
+    Buffer buffer(size);
     auto &nv = *reinterpret_cast<NewViewMessage::Layout *>(buffer.data());
     nv.kind = MessageKind::NewView;
     nv.new_view = view + 1;
-    for (auto &&[index, proc_certificate] :
-         hipony::enumerate(vc_state_certificates)) {
-      auto const &[proc_id, certificate] = proc_certificate;
+    size_t offset = offsetof(NewViewMessage::Layout, vc_certificates);
+    for (auto const &[proc_id, certificate] : vc_state_certificates) {
       auto &ce = *reinterpret_cast<NewViewMessage::VcCertificateEntry *>(
-          buffer.data() +
-          NewViewMessage::bufferSize(window, max_proposal_size, quorum, index));
+          buffer.data() + offset);
       ce.replica_id = proc_id;
       ce.certificate_size = certificate.rawBuffer().size();
       std::copy(certificate.rawBuffer().data(),
                 certificate.rawBuffer().data() + certificate.rawBuffer().size(),
                 &ce.certificate);
+      offset += NewViewMessage::entrySize(ce.certificate_size);
     }
     return buffer;
   }
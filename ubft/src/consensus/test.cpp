@@ -45,6 +45,7 @@ int main(int argc, char *argv[]) {
   bool fast_path = false;
   size_t credits = 1;
   std::optional<size_t> crash_at;
+  bool view_change_bench = false;
 
   cli.add_argument(lyra::help(get_help))
       .add_argument(lyra::opt(local_id, "id")
@@ -104,7 +105,12 @@ int main(int argc, char *argv[]) {
       .add_argument(lyra::opt(crash_at, "crash_at")
                         .name("-F")
                         .name("--crash-at")
-                        .help("Number of decisions before leader crash"));
+                        .help("Number of decisions before leader crash"))
+      .add_argument(lyra::opt(view_change_bench)
+                        .name("-V")
+                        .name("--view-change-bench")
+                        .help("Measure the view change latency upon a leader "
+                              "crash halfway through the proposals"));
 
   // Parse the program arguments.
   auto result = cli.parse({argc, argv});
@@ -119,6 +125,10 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+  if (view_change_bench && !crash_at) {
+    crash_at = nb_proposals / 2;
+  }
+
   //// Pinning to the isolated core ////
   if (pinned_core_id) {
     LOGGER_INFO(main_logger, "Pinning the main thread to core {}",
@@ -29,12 +29,23 @@ class Crypto {
     crypto_impl::publish_pub_key(fmt::format("{}-pubkey", local_id));
     store.barrier("public_keys_announced", all_ids.size());
 
+    for (auto id : all_ids) {
+      store.prefetch(fmt::format("{}-pubkey", id));
+    }
     for (auto id : all_ids) {
       public_keys.emplace(
           id, crypto_impl::get_public_key(fmt::format("{}-pubkey", id)));
     }
   }
 
+  /**
+   * @brief Publish our public key under another id, for processes that act as
+   *        several clients.
+   */
+  void publishPublicKeyAs(ProcId const alias) {
+    crypto_impl::publish_pub_key(fmt::format("{}-pubkey", alias));
+  }
+
   // WARNING: THIS IS NOT THREAD SAFE
   void fetchPublicKey(ProcId const id) {
     public_keys.emplace(
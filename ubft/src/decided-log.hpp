@@ -0,0 +1,237 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include <fmt/core.h>
+
+#include <dory/shared/branching.hpp>
+#include <dory/shared/logger.hpp>
+
+#include "consensus/types.hpp"
+#include "types.hpp"
+
+namespace dory::ubft {
+
+/**
+ * @brief On-disk format of the decided log: a header followed by entries
+ *        stored back to back, each one being immediately followed by its
+ *        payload.
+ *
+ * The header records the number of valid bytes so that the log can be read
+ * even if the recording process was killed without closing it.
+ */
+struct DecidedLog {
+  static uint64_t constexpr Magic = 0x474f4c4454464275;  // "uBFTDLOG"
+  static uint32_t constexpr Version = 1;
+
+#pragma pack(push, 1)
+  struct Header {
+    uint64_t magic;
+    uint32_t version;
+    uint64_t length;  // Valid bytes, including the header.
+  };
+
+  struct Entry {
+    consensus::Instance instance;
+    ProcId client_id;
+    RequestId request_id;
+    uint32_t size;
+    uint8_t payload;  // Fake field, start of the payload.
+  };
+#pragma pack(pop)
+
+  static size_t constexpr entrySize(size_t const payload_size) {
+    return offsetof(Entry, payload) + payload_size;
+  }
+};
+
+/**
+ * @brief Appends decided requests to a memory-mapped file.
+ *
+ * The file is grown geometrically and truncated to its valid length upon
+ * destruction.
+ */
+class DecidedLogWriter {
+ public:
+  DecidedLogWriter(std::string const &path,
+                   size_t const initial_capacity = 64 << 20)
+      : path{path} {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error(fmt::format("Could not open {}: {}", path,
+                                           std::strerror(errno)));
+    }
+    map(std::max(initial_capacity, sizeof(DecidedLog::Header)));
+    auto &h = header();
+    h.magic = DecidedLog::Magic;
+    h.version = DecidedLog::Version;
+    h.length = sizeof(DecidedLog::Header);
+  }
+
+  DecidedLogWriter(DecidedLogWriter const &) = delete;
+  DecidedLogWriter &operator=(DecidedLogWriter const &) = delete;
+  DecidedLogWriter(DecidedLogWriter &&) = delete;
+  DecidedLogWriter &operator=(DecidedLogWriter &&) = delete;
+
+  ~DecidedLogWriter() {
+    auto const length = header().length;
+    ::munmap(base, capacity);
+    if (::ftruncate(fd, static_cast<off_t>(length)) != 0) {
+      LOGGER_WARN(logger, "Could not truncate {}: {}", path,
+                  std::strerror(errno));
+    }
+    ::close(fd);
+  }
+
+  void append(consensus::Instance const instance, ProcId const client_id,
+              RequestId const request_id, uint8_t const *const payload,
+              size_t const size) {
+    auto const offset = header().length;
+    auto const entry_size = DecidedLog::entrySize(size);
+    if (unlikely(offset + entry_size > capacity)) {
+      grow(offset + entry_size);
+    }
+    auto &entry = *reinterpret_cast<DecidedLog::Entry *>(base + offset);
+    entry.instance = instance;
+    entry.client_id = client_id;
+    entry.request_id = request_id;
+    entry.size = static_cast<uint32_t>(size);
+    std::memcpy(&entry.payload, payload, size);
+    // Only published once fully written.
+    header().length = offset + entry_size;
+  }
+
+ private:
+  DecidedLog::Header &header() {
+    return *reinterpret_cast<DecidedLog::Header *>(base);
+  }
+
+  void map(size_t const new_capacity) {
+    if (::ftruncate(fd, static_cast<off_t>(new_capacity)) != 0) {
+      throw std::runtime_error(fmt::format("Could not resize {}: {}", path,
+                                           std::strerror(errno)));
+    }
+    auto *const addr = ::mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE,
+                              MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      throw std::runtime_error(
+          fmt::format("Could not map {}: {}", path, std::strerror(errno)));
+    }
+    base = reinterpret_cast<uint8_t *>(addr);
+    capacity = new_capacity;
+  }
+
+  void grow(size_t const min_capacity) {
+    auto new_capacity = capacity;
+    while (new_capacity < min_capacity) {
+      new_capacity *= 2;
+    }
+    ::munmap(base, capacity);
+    map(new_capacity);
+    LOGGER_DEBUG(logger, "Grew {} to {} bytes.", path, capacity);
+  }
+
+  std::string const path;
+  int fd;
+  uint8_t *base;
+  size_t capacity;
+
+  LOGGER_DECL_INIT(logger, "DecidedLogWriter");
+};
+
+/**
+ * @brief Reads back a decided log, entry by entry.
+ */
+class DecidedLogReader {
+ public:
+  struct Entry {
+    consensus::Instance instance;
+    ProcId client_id;
+    RequestId request_id;
+    uint8_t const *payload;
+    size_t size;
+  };
+
+  DecidedLogReader(std::string const &path) {
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error(fmt::format("Could not open {}: {}", path,
+                                           std::strerror(errno)));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      throw std::runtime_error(
+          fmt::format("Could not stat {}: {}", path, std::strerror(errno)));
+    }
+    file_size = static_cast<size_t>(st.st_size);
+    if (file_size < sizeof(DecidedLog::Header)) {
+      throw std::runtime_error(fmt::format("{} is not a decided log.", path));
+    }
+    auto *const addr =
+        ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      throw std::runtime_error(
+          fmt::format("Could not map {}: {}", path, std::strerror(errno)));
+    }
+    base = reinterpret_cast<uint8_t const *>(addr);
+    ::madvise(addr, file_size, MADV_SEQUENTIAL);
+
+    auto const &h = *reinterpret_cast<DecidedLog::Header const *>(base);
+    if (h.magic != DecidedLog::Magic || h.version != DecidedLog::Version ||
+        h.length > file_size) {
+      throw std::runtime_error(fmt::format("{} is not a decided log.", path));
+    }
+    length = h.length;
+    rewind();
+  }
+
+  DecidedLogReader(DecidedLogReader const &) = delete;
+  DecidedLogReader &operator=(DecidedLogReader const &) = delete;
+  DecidedLogReader(DecidedLogReader &&) = delete;
+  DecidedLogReader &operator=(DecidedLogReader &&) = delete;
+
+  ~DecidedLogReader() {
+    ::munmap(const_cast<uint8_t *>(base), file_size);
+    ::close(fd);
+  }
+
+  std::optional<Entry> next() {
+    if (offset + DecidedLog::entrySize(0) > length) {
+      return std::nullopt;
+    }
+    auto const &entry =
+        *reinterpret_cast<DecidedLog::Entry const *>(base + offset);
+    auto const entry_size = DecidedLog::entrySize(entry.size);
+    if (unlikely(offset + entry_size > length)) {
+      throw std::runtime_error("Truncated decided log entry.");
+    }
+    offset += entry_size;
+    return Entry{entry.instance, entry.client_id, entry.request_id,
+                 &entry.payload, entry.size};
+  }
+
+  void rewind() { offset = sizeof(DecidedLog::Header); }
+
+  size_t bytes() const { return length; }
+
+ private:
+  int fd;
+  uint8_t const *base;
+  size_t file_size;
+  size_t length;
+  size_t offset;
+};
+
+}  // namespace dory::ubft
@@ -2,8 +2,21 @@
 #include "latency.hpp"
 #include <chrono>
 
+#include <dory/shared/tsc.hpp>
+
 namespace hooks {
-  using Clock = std::chrono::steady_clock;
+  // Reads the TSC, which is cheaper than steady_clock on the hot path.
+  struct Clock {
+    struct time_point {
+      dory::TscClock::Ticks ticks = 0;
+
+      std::chrono::nanoseconds operator-(time_point const &other) const {
+        return dory::TscClock::toDuration(ticks - other.ticks);
+      }
+    };
+
+    static time_point now() { return {dory::TscClock::now()}; }
+  };
   using Timepoint = Clock::time_point;
 
   extern Timepoint smr_start;
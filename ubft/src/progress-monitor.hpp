@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+#include <dory/shared/branching.hpp>
+#include <dory/shared/logger.hpp>
+
+namespace dory::ubft {
+
+/**
+ * @brief Detects a lack of progress in the SMR and decides how to react.
+ *
+ * Each phase of the protocol is watched by a timer that starts when the phase
+ * has outstanding work and restarts whenever it makes progress. When a timer
+ * expires on the fast path, we fall back to the slow path (which tolerates
+ * slow or crashed followers). When the decision timer expires on the slow path,
+ * the leader is suspected and the view is changed. After a stable period on
+ * the slow path (i.e., without any timer expiring), we try the fast path again.
+ *
+ */
+class ProgressMonitor {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Duration = Clock::duration;
+  using TimePoint = Clock::time_point;
+
+  enum Phase {
+    Echo,        // Requests received by the leader but not echoed by all.
+    FastCommit,  // Instances prepared but not decided.
+    Decision,    // Requests accepted but not decided.
+    NbPhases
+  };
+
+  enum Action { None, SwitchToSlowPath, ChangeView, SwitchToFastPath };
+
+  struct Timeouts {
+    Duration echo = std::chrono::milliseconds(5);
+    Duration fast_commit = std::chrono::milliseconds(5);
+    Duration decision = std::chrono::milliseconds(50);
+    Duration stable = std::chrono::seconds(1);
+  };
+
+  ProgressMonitor(Timeouts const &timeouts)
+      : timeouts{{timeouts.echo, timeouts.fast_commit, timeouts.decision}},
+        stable{timeouts.stable} {}
+
+  /**
+   * @brief Report whether a phase has outstanding work. The phase's timer is
+   *        started when it becomes pending and stopped when it isn't anymore.
+   *
+   */
+  inline void pending(Phase const phase, bool const is_pending,
+                      TimePoint const now) {
+    auto &since = stalled_since[phase];
+    if (!is_pending) {
+      since.reset();
+    } else if (!since) {
+      since = now;
+    }
+  }
+
+  /**
+   * @brief Report that a phase made progress, restarting its timer if it still
+   *        has outstanding work.
+   *
+   */
+  inline void progressed(Phase const phase, TimePoint const now) {
+    auto &since = stalled_since[phase];
+    if (since) {
+      since = now;
+    }
+  }
+
+  /**
+   * @brief Check the timers and return the action to take, if any.
+   *        The caller is expected to apply the returned action.
+   *
+   * @param slow_path whether the slow path is currently enabled.
+   */
+  Action poll(bool const slow_path, TimePoint const now) {
+    if (likely(!slow_path)) {
+      for (size_t phase = 0; phase < NbPhases; phase++) {
+        if (unlikely(expired(static_cast<Phase>(phase), now))) {
+          LOGGER_WARN(logger, "Phase {} timed out on the fast path.", phase);
+          switchedPath(now);
+          return SwitchToSlowPath;
+        }
+      }
+      return None;
+    }
+
+    if (unlikely(expired(Decision, now))) {
+      LOGGER_WARN(logger, "No decision on the slow path, suspecting leader.");
+      switchedPath(now);
+      return ChangeView;
+    }
+
+    for (size_t phase = 0; phase < NbPhases; phase++) {
+      if (expired(static_cast<Phase>(phase), now)) {
+        last_expiry = now;
+      }
+    }
+    if (last_expiry + stable <= now) {
+      LOGGER_INFO(logger, "Stable on the slow path, back to the fast path.");
+      switchedPath(now);
+      return SwitchToFastPath;
+    }
+    return None;
+  }
+
+ private:
+  inline bool expired(Phase const phase, TimePoint const now) const {
+    auto const &since = stalled_since[phase];
+    return since && *since + timeouts[phase] <= now;
+  }
+
+  /**
+   * @brief Give a full timeout to the new path/view before reacting again.
+   *
+   */
+  void switchedPath(TimePoint const now) {
+    for (auto &since : stalled_since) {
+      if (since) {
+        since = now;
+      }
+    }
+    last_expiry = now;
+  }
+
+  std::array<Duration, NbPhases> timeouts;
+  Duration stable;
+  std::array<std::optional<TimePoint>, NbPhases> stalled_since;
+  TimePoint last_expiry;
+
+  LOGGER_DECL_INIT(logger, "ProgressMonitor");
+};
+
+}  // namespace dory::ubft
@@ -36,12 +36,16 @@ class Reader {
     void tick() {
       reader.tick();
       tryRelease();
-      pushToReader();
+      post();
+    }
+
+    void read(JobHandle handle, Index index, size_t count) {
+      queued_reads.push_back({handle, index, count});
     }
 
-    void read(JobHandle handle, Index index) {
-      queued_reads.emplace_back(handle, index);
+    void post() {
       pushToReader();
+      reader.post();
     }
 
     PollResult poll(JobHandle handle) {
@@ -63,13 +67,27 @@ class Reader {
         return;
       }
       // Otherwise, as it hasn't been scheduled yet, we can remove it from the
-      // queue.
+      // queue once all the handles of its range are released.
       auto const find_it =
           std::find_if(queued_reads.begin(), queued_reads.end(),
-                       [&handle](auto const &handle_index) {
-                         return handle_index.first == handle;
+                       [&handle](QueuedRead const &queued) {
+                         return queued.handle <= handle &&
+                                handle < queued.handle + queued.count;
                        });
-      queued_reads.erase(find_it);
+      if (find_it == queued_reads.end()) {
+        return;
+      }
+      released_early.insert(handle);
+      bool all_released = true;
+      for (size_t i = 0; i < find_it->count; i++) {
+        all_released &= released_early.count(find_it->handle + i) != 0;
+      }
+      if (all_released) {
+        for (size_t i = 0; i < find_it->count; i++) {
+          released_early.erase(find_it->handle + i);
+        }
+        queued_reads.erase(find_it);
+      }
     }
 
    private:
@@ -88,17 +106,31 @@ class Reader {
 
     void pushToReader() {
       while (!queued_reads.empty()) {
-        auto const &[replicated_handler, index] = queued_reads.front();
-        auto const opt_handle = reader.read(index);
+        auto const queued = queued_reads.front();
+        auto const opt_handle = reader.readRange(queued.index, queued.count);
         if (!opt_handle) {
           break;
         }
         queued_reads.pop_front();
-        scheduled_reads.try_emplace(replicated_handler, *opt_handle);
+        for (size_t i = 0; i < queued.count; i++) {
+          // Handles released while queued are released upon completion.
+          if (released_early.erase(queued.handle + i) != 0) {
+            to_release.insert(*opt_handle + i);
+          } else {
+            scheduled_reads.try_emplace(queued.handle + i, *opt_handle + i);
+          }
+        }
       }
     }
 
-    std::deque<std::pair<JobHandle, Index>> queued_reads;
+    struct QueuedRead {
+      JobHandle handle;
+      Index index;
+      size_t count;
+    };
+
+    std::deque<QueuedRead> queued_reads;
+    std::unordered_set<JobHandle> released_early;
     std::unordered_map<JobHandle, swmr::Reader::JobHandle> scheduled_reads;
     std::unordered_set<swmr::Reader::JobHandle> to_release;
     swmr::Reader reader;
@@ -124,13 +156,39 @@ class Reader {
    * @return JobHandle where the READ will place the data
    */
   JobHandle read(Index const index) {
-    auto const handle = next_handle++;
+    auto const handle = readRange(index, 1);
+    post();
+    return handle;
+  }
+
+  /**
+   * @brief Schedule a single READ of `count` consecutive registers per host
+   *
+   * The READs are only posted by the next call to `post` or `tick`.
+   *
+   * @param index of the first register in the register array
+   * @param count of registers to read
+   * @return JobHandle of the first register, the one of register `index + i`
+   *         is the returned handle + i
+   */
+  JobHandle readRange(Index const index, size_t const count) {
+    auto const handle = next_handle;
+    next_handle += count;
     for (auto &managed_reader : readers) {
-      managed_reader.read(handle, index);
+      managed_reader.read(handle, index, count);
     }
     return handle;
   }
 
+  /**
+   * @brief Post the scheduled READs, with a single doorbell per host.
+   */
+  void post() {
+    for (auto &managed_reader : readers) {
+      managed_reader.post();
+    }
+  }
+
   PollResult poll(JobHandle const handle) {
     size_t reads = 0;
     ManagedReader::PollResult highest_polled;
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
+#include <deque>
+#include <optional>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -25,6 +29,8 @@
 #include "../thread-pool/tail-thread-pool.hpp"
 #include "common.hpp"
 #include "internal/common.hpp"
+#include "internal/outstanding-requests.hpp"
+#include "internal/pending-request.hpp"
 #include "internal/request.hpp"
 #include "internal/response.hpp"
 
@@ -56,7 +62,7 @@ class Client {
         request_signing_pool{
             TailThreadPool::TaskQueue::maxOutstanding(window, thread_pool) + 1,
             max_full_request_size},
-        requests{window},
+        outstanding{window, server_ids.size()},
         signature_computation{thread_pool, window} {
     for (auto const server_id : server_ids) {
       if (!connect(server_id)) {
@@ -85,16 +91,20 @@ class Client {
    *        post.
    *
    * @param request_size
+   * @param read_only whether the request can be served by the replicas
+   *        without being ordered. If replicas do not agree on the response,
+   *        the request is transparently re-issued as an ordered one.
    * @return std::optional<uint8_t*> might be nullopt if no slot is available.
    */
-  std::optional<uint8_t*> getSlot(size_t const request_size) {
+  std::optional<uint8_t*> getSlot(size_t const request_size,
+                                  bool const read_only = false) {
     auto opt_buffer = request_pool.take(Request::bufferSize(request_size));
     if (!opt_buffer) {
       return std::nullopt;
     }
     auto& request = *reinterpret_cast<Request::Layout*>(opt_buffer->data());
     request.client_id = local_id;
-    request.id = next_request++;
+    request.id = outstanding.nextId(read_only);
     request.size = request_size;
 
     requests_being_written.push_back(std::move(*opt_buffer));
@@ -114,8 +124,7 @@ class Client {
         std::copy(raw_request.cbegin(), raw_request.cend(),
                   reinterpret_cast<uint8_t*>(slot));
       }
-      auto const req_id = request.id();
-      requests.tryEmplace(req_id, std::move(request), servers.size());
+      outstanding.issue(std::move(request));
     }
     // We post all requests at once.
     for (auto& server : servers) {
@@ -128,15 +137,21 @@ class Client {
     }
   }
 
+  /**
+   * @brief Poll the response to the oldest outstanding request. Responses are
+   *        returned in the order requests were posted, whether they were
+   *        read-only or not.
+   *
+   * @param dest where to copy the response
+   * @return std::optional<size_t> the size of the response, if any.
+   */
   std::optional<size_t> poll(uint8_t* dest) {
-    if (requests.empty()) {
-      return std::nullopt;
-    }
-    if (auto polled = requests.front().poll(dest)) {
-      requests.popFront();
-      return polled;
-    }
-    return std::nullopt;
+    return outstanding.poll(
+        dest,
+        [this](RequestId const request_id) {
+          requestFullResponses(request_id);
+        },
+        [this](Request const& request) { reissue(request); });
   }
 
   void toggleSlowPath(bool const enable) {
@@ -147,10 +162,50 @@ class Client {
   }
 
  private:
+  /**
+   * @brief Send again, to be ordered, a read-only request on which replicas
+   *        did not agree (e.g., some had not executed the latest writes yet).
+   *
+   */
+  void reissue(Request const& request) {
+    LOGGER_DEBUG(logger, "Read-only responses did not match, ordering it.");
+    auto const& raw_request = request.rawBuffer();
+    for (auto& server : servers) {
+      auto* const slot = server.sender.getSlot(
+          static_cast<tail_p2p::Size>(raw_request.size()));
+      std::copy(raw_request.cbegin(), raw_request.cend(),
+                reinterpret_cast<uint8_t*>(slot));
+      server.sender.send();
+    }
+    if (unlikely(slow_path)) {
+      offloadSignatureComputations();
+    }
+  }
+
+  /**
+   * @brief Ask all servers to resend their full response to a request for
+   *        which we only received digests, or digests that did not match.
+   *
+   */
+  void requestFullResponses(RequestId const request_id) {
+    LOGGER_DEBUG(logger, "Requesting full responses to request #{}.",
+                 request_id);
+    auto const size = static_cast<tail_p2p::Size>(Request::bufferSize(0));
+    for (auto& server : servers) {
+      auto& resend =
+          *reinterpret_cast<Request::Layout*>(server.sender.getSlot(size));
+      resend.client_id = local_id;
+      resend.id = request_id | Request::ResendBit;
+      resend.size = 0;
+      server.sender.send();
+    }
+  }
+
   void pollResponses() {
     for (auto&& [index, server] : hipony::enumerate(servers)) {
       // We only poll servers that haven't responded to all our requests.
-      if (server.next_response >= next_request) {
+      if (server.next_response >= outstanding.nextOrderedId() &&
+          !outstanding.expectsUnorderedResponses()) {
         continue;
       }
       auto opt_borrow = response_pool.borrowNext();
@@ -160,20 +215,33 @@ class Client {
       if (auto polled = server.receiver.poll(opt_borrow->get().data())) {
         auto response_ok = Response::tryFrom(*response_pool.take(*polled));
         match{response_ok}([](std::invalid_argument& error) { throw error; },
-                           [&server = server, this](Response& response) {
-                             server.next_response = response.requestId() + 1;
-                             auto it = requests.find(response.requestId());
+                           [&server = server, index = index,
+                            this](Response& response) {
+                             if (response.requestId() & Request::ReadOnlyBit) {
+                               auto* const data =
+                                   outstanding.find(response.requestId());
+                               if (data != nullptr) {
+                                 data->newResponse(index, std::move(response));
+                               }
+                               return;
+                             }
+                             // Resent responses can arrive out of order.
+                             server.next_response =
+                                 std::max(server.next_response,
+                                          response.requestId() + 1);
+                             auto* const data =
+                                 outstanding.find(response.requestId());
                              // std::vector<int>
                              // printable(response.stringView().begin(),
                              //                            response.stringView().end());
-                             if (it == requests.end()) {
+                             if (data == nullptr) {
                                // fmt::print(
                                //     "Could not find request {} (response of
                                //     size {}: {})\n", response.requestId(),
                                //     response.size(), printable);
                                return;
                              }
-                             it->second.newResponse(std::move(response));
+                             data->newResponse(index, std::move(response));
                            });
       }
     }
@@ -279,13 +347,15 @@ class Client {
   }
 
   void offloadSignatureComputations() {
-    if (requests.empty()) {
+    auto const first = outstanding.firstOrdered();
+    if (!first) {
       return;
     }
     // We jump over gaps
-    next_to_offload = std::max(next_to_offload, requests.begin()->first);
-    for (auto it = requests.find(next_to_offload); it != requests.end(); ++it) {
-      auto& request = it->second.request;
+    next_to_offload = std::max(next_to_offload, *first);
+    for (auto* data = outstanding.find(next_to_offload); data != nullptr;
+         data = outstanding.find(next_to_offload)) {
+      auto& request = data->request;
       auto const& raw_req = request.rawBuffer();
       auto opt_buffer = request_signing_pool.take(raw_req.size());
       if (unlikely(!opt_buffer)) {
@@ -359,7 +429,6 @@ class Client {
   size_t const max_full_request_size;
   size_t const max_full_signed_request_size;
   size_t const max_full_response_size;
-  RequestId next_request = 0;
   bool posted = false;
   bool slow_path = false;
   RequestId next_to_offload = 0;
@@ -373,41 +442,10 @@ class Client {
       ctrl::ControlBlock::LOCAL_READ | ctrl::ControlBlock::LOCAL_WRITE |
       ctrl::ControlBlock::REMOTE_READ | ctrl::ControlBlock::REMOTE_WRITE;
 
-  struct RequestData {
-    static size_t constexpr MaxNbServers = 5;
-    RequestData(Request&& request, size_t const nb_servers)
-        : request{std::move(request)}, quorum{(nb_servers / 2) + 1} {}
-
-    void newResponse(Response&& response) {
-      all_identical = !responses.front() ||
-                      (all_identical && response == *responses.front());
-      responses[nb_responses++].emplace(std::move(response));
-    }
-
-    std::optional<size_t> poll(uint8_t* dest) {
-      if (nb_responses < quorum) {
-        return std::nullopt;
-      }
-      if (all_identical) {
-        auto const& response = *responses.front();
-        std::copy(response.begin(), response.end(), dest);
-        return response.size();
-      }
-      // Slow path, we need to check if we got a majority.
-      throw std::logic_error("Byzantine behavior, responses did not match.");
-    }
-
-    Request request;
-    size_t const quorum;
-    size_t nb_responses = 0;
-    std::array<std::optional<Response>, MaxNbServers> responses;
-    bool all_identical = true;
-  };
-
   Pool request_pool;
   Pool response_pool;
   Pool request_signing_pool;
-  TailMap<RequestId, RequestData> requests;
+  internal::OutstandingRequests outstanding;
   std::deque<Request> requests_being_written;
 
   struct ComputedSignature {
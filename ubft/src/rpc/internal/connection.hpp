@@ -1,5 +1,11 @@
 #pragma once
 
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <dory/ctrl/block.hpp>
 
 #include <dory/conn/rc.hpp>
@@ -35,9 +41,9 @@ struct ConnectionData {
 
 struct Connection {
   // Use a shared pointer, otherwise the value is not preserved when altering
-  // connections. Because the DynamicConnections have two ping-pong set of
-  // connections, if the data of this struct is not a pointer, during copying
-  // (from ping to pong set of connections) the latest value may be lost.
+  // connections. Because the DynamicConnections publish copies of the
+  // connections, if the data of this struct is not a pointer, the latest value
+  // would be lost upon the next publication.
   std::shared_ptr<bool> active{std::make_shared<bool>(true)};
 
   std::shared_ptr<ConnectionData> data;
@@ -67,8 +73,6 @@ class Manager : public Handler::AbstractManager {
       std::string const uuid =
           fmt::format("rpc-mngr-p2p-receiver-{}-seq-{}", local_id, i);
 
-      available_memory.push_back(uuid);
-
       auto uuid_recv = fmt::format("{}-recv", uuid);
       cb.allocateBuffer(uuid_recv, Receiver::bufferSize(tail, max_recv_size),
                         64);
@@ -84,6 +88,8 @@ class Manager : public Handler::AbstractManager {
       cb.allocateBuffer(uuid_send, Sender::bufferSize(tail, max_send_size), 64);
       cb.registerMr(uuid_send, "standard", uuid_send, NoMemoryRights);
       cb.registerCq(uuid_send);
+
+      warm_slots.push_back(warmUp(uuid));
     }
   }
 
@@ -101,39 +107,22 @@ class Manager : public Handler::AbstractManager {
     LOGGER_DEBUG(logger, "Process {} sent ReliableConnection info: {}", proc_id,
                  rc_recv_info);
 
-    if (available_memory.empty()) {
+    recycleRetired();
+    if (warm_slots.empty()) {
       LOGGER_WARN(logger, "I have run out of memory!");
       return std::make_pair(false, "nothing");
     }
 
-    auto memory_uuid = available_memory.back();
-    available_memory.pop_back();
-    auto uuid_recv = fmt::format("{}-recv", memory_uuid);
-    auto uuid_sig_recv = fmt::format("{}-sig-recv", memory_uuid);
-    auto uuid_send = fmt::format("{}-send", memory_uuid);
+    // QPs were already created and initialized, we only need to move them to
+    // RTR/RTS.
+    auto slot = std::move(warm_slots.back());
+    warm_slots.pop_back();
+    auto &[memory_uuid, rc_recv, rc_sig_recv, rc_send] = slot;
 
-    conn::ReliableConnection rc_recv(cb);
-    rc_recv.bindToPd(pd_standard);
-    rc_recv.bindToMr(uuid_recv);
-    rc_recv.associateWithCq(cq_unused, cq_unused);
-    rc_recv.init(WriteMemoryRights);
     rc_recv.connect(conn::RemoteConnection::fromStr(rc_recv_info), proc_id);
-
-    conn::ReliableConnection rc_sig_recv(cb);
-    rc_sig_recv.bindToPd(pd_standard);
-    rc_sig_recv.bindToMr(uuid_sig_recv);
-    rc_sig_recv.associateWithCq(cq_unused, cq_unused);
-    rc_sig_recv.init(WriteMemoryRights);
     rc_sig_recv.connect(conn::RemoteConnection::fromStr(rc_sig_recv_info),
                         proc_id);
-
     // TODO: Do I need to zero memory again?
-
-    conn::ReliableConnection rc_send(cb);
-    rc_send.bindToPd(pd_standard);
-    rc_send.bindToMr(uuid_send);
-    rc_send.associateWithCq(uuid_send, uuid_send);
-    rc_send.init(NoMemoryRights);
     rc_send.connect(conn::RemoteConnection::fromStr(rc_send_info), proc_id);
 
     // Get the serialization info before moving
@@ -167,20 +156,22 @@ class Manager : public Handler::AbstractManager {
   void remove(ProcIdType proc_id) override {
     auto conn_it = conns.find(proc_id);
     if (conn_it != conns.end()) {
-      auto &memory_uuid = conn_it->second.data->memory_region;
-      available_memory.push_back(std::move(memory_uuid));
-
+      // The poller may still access the memory of the removed connection
+      // through older snapshots, so it is only reused once it picked up the
+      // one without it.
+      auto memory_uuid = conn_it->second.data->memory_region;
       conns.erase(conn_it);
+      auto const generation = dc.alterConnections(conns.begin(), conns.end());
+      retired_slots.emplace_back(generation, std::move(memory_uuid));
     }
+    recycleRetired();
   }
 
   DynamicConnections &connections() { return dc; }
 
   std::vector<ProcIdType> collectInactive() override {
     std::vector<ProcIdType> inactive_vec;
-    auto *inactive = dc.alterConnections(conns.begin(), conns.end());
-
-    for (auto &[proc_id, c] : *inactive) {
+    for (auto &[proc_id, c] : conns) {
       if (!*c.active) {
         inactive_vec.push_back(proc_id);
       }
@@ -195,12 +186,64 @@ class Manager : public Handler::AbstractManager {
   }
 
  private:
+  /**
+   * @brief Provision new QPs for the memory of removed connections whose grace
+   *        period is over, as their QPs may still be referenced by the poller.
+   */
+  void recycleRetired() {
+    while (!retired_slots.empty() &&
+           dc.released(retired_slots.front().first)) {
+      warm_slots.push_back(warmUp(retired_slots.front().second));
+      retired_slots.pop_front();
+    }
+  }
+
+  /**
+   * @brief Pre-provisioned QPs bound to preregistered memory, ready to be
+   *        connected to a client.
+   */
+  struct WarmSlot {
+    std::string memory_uuid;
+    conn::ReliableConnection rc_recv;
+    conn::ReliableConnection rc_sig_recv;
+    conn::ReliableConnection rc_send;
+  };
+
+  WarmSlot warmUp(std::string const &memory_uuid) {
+    auto uuid_recv = fmt::format("{}-recv", memory_uuid);
+    auto uuid_sig_recv = fmt::format("{}-sig-recv", memory_uuid);
+    auto uuid_send = fmt::format("{}-send", memory_uuid);
+
+    conn::ReliableConnection rc_recv(cb);
+    rc_recv.bindToPd(pd_standard);
+    rc_recv.bindToMr(uuid_recv);
+    rc_recv.associateWithCq(cq_unused, cq_unused);
+    rc_recv.init(WriteMemoryRights);
+
+    conn::ReliableConnection rc_sig_recv(cb);
+    rc_sig_recv.bindToPd(pd_standard);
+    rc_sig_recv.bindToMr(uuid_sig_recv);
+    rc_sig_recv.associateWithCq(cq_unused, cq_unused);
+    rc_sig_recv.init(WriteMemoryRights);
+
+    conn::ReliableConnection rc_send(cb);
+    rc_send.bindToPd(pd_standard);
+    rc_send.bindToMr(uuid_send);
+    rc_send.associateWithCq(uuid_send, uuid_send);
+    rc_send.init(NoMemoryRights);
+
+    return WarmSlot{memory_uuid, std::move(rc_recv), std::move(rc_sig_recv),
+                    std::move(rc_send)};
+  }
+
   dory::ctrl::ControlBlock &cb;
   size_t const tail;
   size_t const max_send_size;
   size_t const max_recv_size;
   size_t const max_sig_recv_size;
-  std::vector<std::string> available_memory;
+  std::vector<WarmSlot> warm_slots;
+  // Memory of removed connections, by the generation that removed them.
+  std::deque<std::pair<uint64_t, std::string>> retired_slots;
 
   ConnMap conns;
   DynamicConnections dc;
@@ -1,10 +1,28 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <vector>
 
+#include <dory/shared/branching.hpp>
+
 namespace dory::ubft::rpc::internal {
+
+/**
+ * @brief Publishes the list of connections from the thread that manages them
+ *        to the thread that polls them, RCU-style.
+ *
+ * Each alteration publishes a new immutable snapshot with a single release
+ * store. The polling thread picks it up with a single acquire load and never
+ * blocks. Snapshots are reclaimed by the managing thread once the polling
+ * thread acknowledged a newer one (i.e., after a grace period).
+ *
+ * IMPORTANT: References returned by `connections()` are only valid until its
+ * next call.
+ */
 template <typename Iterator>
 class DynamicConnections {
  public:
@@ -12,84 +30,74 @@ class DynamicConnections {
   using ConnectionList = typename std::vector<ValueType>;
 
   DynamicConnections() {
-    connections_[0] = &exported_connections;
-    connections_[1] = &pending_connections;
-
-    in_use = 0;
-
-    returned_connections = connections_[in_use];
-
-    select.store(in_use);
-    switched.store(false);
+    snapshots.push_back(std::make_unique<Snapshot>());
+    in_use = snapshots.back().get();
+    latest.store(in_use);
+    in_use_generation.store(in_use->generation);
   }
 
-  std::vector<ValueType> *alterConnections(Iterator first, Iterator last) {
-    int index;
-    {  // Lock scope
-      std::scoped_lock<std::mutex> lock(pending_connections_mtx);
-
-      // I have the mutex, so the other thread cannot change the select.
-      // `index` indicates the buffer is currently exported.
-      index = select.load();
-
-      // Get the pending buffer
-      index = (index + 1) % 2;
-
-      // Empty the pending buffer and write the new connections
-      connections_[index]->clear();
-      for (auto it = first; it != last; it++) {
-        connections_[index]->push_back(*it);
-      }
-
-      // Now tell the other thread that the connections changed
-      select.store(index);
-    }
-
-    // Now wait for the other thread to switch
-    while (!switched.load()) {
-    }
-    switched.store(false);
+  /**
+   * @brief Publish a new snapshot of the connections.
+   *
+   * @return the generation of the snapshot, see `released`.
+   */
+  uint64_t alterConnections(Iterator first, Iterator last) {
+    std::scoped_lock<std::mutex> lock(writers_mtx);
+
+    auto snapshot = std::make_unique<Snapshot>();
+    snapshot->generation = snapshots.back()->generation + 1;
+    snapshot->connections = ConnectionList(first, last);
+    latest.store(snapshot.get(), std::memory_order_release);
+    auto const generation = snapshot->generation;
+    snapshots.push_back(std::move(snapshot));
+
+    reclaim();
+    return generation;
+  }
 
-    // Now return the inactive connections
-    return connections_[(index + 1) % 2];
+  /**
+   * @brief Whether the polling thread stopped using the snapshots older than
+   *        `generation`, i.e., whether the grace period of the connections
+   *        removed by that generation is over.
+   */
+  bool released(uint64_t const generation) const {
+    return in_use_generation.load(std::memory_order_acquire) >= generation;
   }
 
-  std::vector<ValueType> &connections() {
-    checkPending();
-    return *returned_connections;
+  ConnectionList &connections() {
+    auto *const snapshot = latest.load(std::memory_order_acquire);
+    if (unlikely(snapshot != in_use)) {
+      in_use = snapshot;
+      in_use_generation.store(snapshot->generation, std::memory_order_release);
+    }
+    return in_use->connections;
   }
 
  private:
-  void checkPending() {
-    if (select.load() != in_use) {
-      // Connections have changed
-
-      // Ensure that the connections are not altered concurrently
-      std::scoped_lock<std::mutex> lock(pending_connections_mtx);
-
-      in_use = (in_use + 1) % 2;
-      returned_connections = connections_[in_use];
-
-      select.store(in_use);
-      switched.store(true);
+  struct Snapshot {
+    uint64_t generation = 0;
+    ConnectionList connections;
+  };
+
+  /**
+   * @brief Free the snapshots older than the one in use by the polling
+   *        thread, as it will never access them again.
+   */
+  void reclaim() {
+    auto const acked = in_use_generation.load(std::memory_order_acquire);
+    while (snapshots.front()->generation < acked) {
+      snapshots.pop_front();
     }
   }
 
-  std::vector<ValueType> *connections_[2];
-  int in_use;
-  int for_removal;
-
-  std::vector<ValueType> pending_connections;
-  std::vector<ValueType> exported_connections;
-
-  std::mutex pending_connections_mtx;
-
-  // alignas(64)
-  std::atomic<int> select;
+  // Owned by the managing thread.
+  std::deque<std::unique_ptr<Snapshot>> snapshots;
+  std::mutex writers_mtx;
 
-  // alignas(64)
-  std::atomic<bool> switched;
+  // Owned by the polling thread.
+  Snapshot *in_use;
 
-  std::vector<ValueType> *returned_connections;
+  alignas(64) std::atomic<Snapshot *> latest;
+  alignas(64) std::atomic<uint64_t> in_use_generation;
 };
 }  // namespace dory::ubft::rpc::internal
@@ -17,6 +17,7 @@
 #include "../../tail-map/tail-map.hpp"
 #include "../../tail-p2p/sender.hpp"
 #include "../../tail-queue/tail-queue.hpp"
+#include "../../tracing.hpp"
 #include "../../types.hpp"
 #include "common.hpp"
 #include "request.hpp"
@@ -332,13 +333,16 @@ class RequestIngress {
       #ifdef LATENCY_HOOKS
         hooks::sig_check_start = hooks::Clock::now();
       #endif
-      tq.enqueue([this, req = std::move(req)]() mutable {
+      tq.enqueue([this, req = std::move(req),
+                  enqueued = tracing::now()]() mutable {
         auto [raw_req, sig] = req.split();
         // auto const ts = std::chrono::steady_clock::now();
         auto const valid = crypto.verify(sig, raw_req.rawBuffer().data(),
                                          raw_req.rawBuffer().size(), id);
         // fmt::print("Checking the signature took: {}\n",
         // std::chrono::steady_clock::now() - ts);
+        tracing::record(tracing::Span::RpcSignatureCheck,
+                        static_cast<uint32_t>(id), raw_req.id(), enqueued);
         verified_signatures.enqueue({std::move(raw_req), sig, valid});
       });
     }
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+
+#include <dory/shared/branching.hpp>
+
+#include "../../tail-map/tail-map.hpp"
+#include "../../types.hpp"
+#include "pending-request.hpp"
+#include "request.hpp"
+
+namespace dory::ubft::rpc::internal {
+
+/**
+ * @brief Requests issued by a client that await their responses. Responses
+ *        are delivered in the order requests were issued, whether they were
+ *        read-only or not.
+ *
+ * A read-only request on which servers do not agree is re-issued as an
+ * ordered request with the next ordered id. Until delivered, it is kept aside
+ * from the other ordered requests: inserting it among them would break their
+ * FIFO order and could evict the oldest ones from the window.
+ *
+ * The transport is left to the client via callbacks.
+ */
+class OutstandingRequests {
+ public:
+  OutstandingRequests(size_t const window, size_t const nb_servers)
+      : nb_servers{nb_servers}, requests{window}, read_only_requests{window} {}
+
+  /**
+   * @brief Allocate the id of a new request.
+   */
+  RequestId nextId(bool const read_only) {
+    return read_only ? (next_read_only++ | Request::ReadOnlyBit)
+                     : next_request++;
+  }
+
+  /**
+   * @brief The id that the next ordered request will get.
+   */
+  RequestId nextOrderedId() const { return next_request; }
+
+  void issue(Request &&request) {
+    auto const req_id = request.id();
+    issued.push_back(req_id);
+    auto &map = request.readOnly() ? read_only_requests : requests;
+    map.tryEmplace(req_id, std::move(request), nb_servers);
+  }
+
+  bool empty() const { return issued.empty(); }
+
+  size_t size() const { return issued.size(); }
+
+  /**
+   * @brief Id of the request whose response is to be delivered next, as it
+   *        was issued.
+   */
+  RequestId front() const { return issued.front(); }
+
+  /**
+   * @brief Whether `request_id` is the request whose response is to be
+   *        delivered next, including once re-issued.
+   */
+  bool isNext(RequestId const request_id) const {
+    return !issued.empty() &&
+           (request_id == issued.front() ||
+            (fallback && request_id == fallback->request.id()));
+  }
+
+  /**
+   * @brief Whether responses may arrive other than in the order of the ordered
+   *        requests, i.e., to read-only requests or upon resends.
+   */
+  bool expectsUnorderedResponses() const {
+    return !read_only_requests.empty() || awaiting_full_responses != 0 ||
+           fallback;
+  }
+
+  /**
+   * @return the outstanding request with the given id, or nullptr.
+   */
+  PendingRequest *find(RequestId const request_id) {
+    if (unlikely(fallback && fallback->request.id() == request_id)) {
+      return &*fallback;
+    }
+    auto &map =
+        (request_id & Request::ReadOnlyBit) ? read_only_requests : requests;
+    auto it = map.find(request_id);
+    return it == map.end() ? nullptr : &it->second;
+  }
+
+  /**
+   * @return the smallest id of the outstanding ordered requests, if any.
+   */
+  std::optional<RequestId> firstOrdered() const {
+    std::optional<RequestId> first;
+    if (!requests.empty()) {
+      first = requests.begin()->first;
+    }
+    if (fallback) {
+      first = std::min(first.value_or(fallback->request.id()),
+                       fallback->request.id());
+    }
+    return first;
+  }
+
+  /**
+   * @brief Call `f(data)` on every outstanding request, in the order they
+   *        should be sent again: by issue order, but with the re-issued
+   *        read-only request last as it got the highest ordered id.
+   */
+  template <typename F>
+  void forEach(F &&f) {
+    for (auto const request_id : issued) {
+      if (auto *const data = find(request_id)) {
+        f(*data);
+      }
+    }
+    if (unlikely(fallback)) {
+      f(*fallback);
+    }
+  }
+
+  /**
+   * @brief Poll the response to the oldest outstanding request.
+   *
+   * @param dest where to copy the response.
+   * @param request_full called with a request for which full responses must
+   *        be asked to the servers.
+   * @param reissue called with a read-only request that was re-issued as an
+   *        ordered one and must be sent again to the servers.
+   * @return std::optional<size_t> the size of the response, if any.
+   */
+  template <typename RequestFull, typename Reissue>
+  std::optional<size_t> poll(uint8_t *const dest, RequestFull &&request_full,
+                             Reissue &&reissue) {
+    if (issued.empty()) {
+      return std::nullopt;
+    }
+    if (!(issued.front() & Request::ReadOnlyBit)) {
+      auto polled = pollOrdered(requests.front(), dest, request_full);
+      if (polled) {
+        popFront(requests);
+      }
+      return polled;
+    }
+    if (unlikely(fallback)) {
+      auto polled = pollOrdered(*fallback, dest, request_full);
+      if (polled) {
+        release(*fallback);
+        fallback.reset();
+        issued.pop_front();
+      }
+      return polled;
+    }
+
+    auto &data = read_only_requests.front();
+    if (data.nb_responses < data.quorum) {
+      return std::nullopt;
+    }
+    if (auto const *const response = data.agreed()) {
+      std::copy(response->begin(), response->end(), dest);
+      auto const size = response->size();
+      popFront(read_only_requests);
+      return size;
+    }
+    if (data.nb_full == 0) {
+      if (!data.full_requested) {
+        requestFull(data, request_full);
+      }
+      return std::nullopt;
+    }
+    // Replicas did not agree (e.g., some had not executed the latest writes
+    // yet), the request is re-issued to be ordered.
+    auto request = std::move(data.request);
+    release(data);
+    read_only_requests.popFront();
+    request.id() = next_request++;
+    fallback.emplace(std::move(request), nb_servers);
+    reissue(fallback->request);
+    return std::nullopt;
+  }
+
+ private:
+  template <typename RequestFull>
+  std::optional<size_t> pollOrdered(PendingRequest &data, uint8_t *const dest,
+                                    RequestFull &request_full) {
+    if (auto polled = data.poll(dest)) {
+      return polled;
+    }
+    if (unlikely(data.lacksFullResponse())) {
+      requestFull(data, request_full);
+    }
+    return std::nullopt;
+  }
+
+  template <typename RequestFull>
+  void requestFull(PendingRequest &data, RequestFull &request_full) {
+    data.full_requested = true;
+    awaiting_full_responses++;
+    request_full(data.request.id());
+  }
+
+  void release(PendingRequest const &data) {
+    if (data.full_requested) {
+      awaiting_full_responses--;
+    }
+  }
+
+  void popFront(TailMap<RequestId, PendingRequest> &map) {
+    release(map.front());
+    map.popFront();
+    issued.pop_front();
+  }
+
+  size_t const nb_servers;
+  RequestId next_request = 0;
+  RequestId next_read_only = 0;
+  size_t awaiting_full_responses = 0;
+  TailMap<RequestId, PendingRequest> requests;
+  TailMap<RequestId, PendingRequest> read_only_requests;
+  // Read-only request at the front of `issued` that was re-issued as ordered.
+  std::optional<PendingRequest> fallback;
+  std::deque<RequestId> issued;  // Ids of outstanding requests, in order.
+};
+
+}  // namespace dory::ubft::rpc::internal
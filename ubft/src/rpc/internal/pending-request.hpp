@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+
+#include "request.hpp"
+#include "response.hpp"
+
+namespace dory::ubft::rpc::internal {
+
+/**
+ * @brief A request awaiting a quorum of matching responses, either full or
+ *        as digests.
+ */
+struct PendingRequest {
+  static size_t constexpr MaxNbServers = 5;
+  PendingRequest(Request&& request, size_t const nb_servers)
+      : request{std::move(request)}, quorum{(nb_servers / 2) + 1} {}
+
+  /**
+   * @brief Record the response of a server. Servers may either send their
+   *        full response or only its digest, in which case the digest can
+   *        later be replaced by the full response (upon resend).
+   *
+   * @param server index of the server that responded.
+   */
+  void newResponse(size_t const server, Response&& response) {
+    auto& slot = responses.at(server);
+    if (slot && (response.isDigest() || !slot->isDigest())) {
+      return;
+    }
+    if (!slot) {
+      nb_responses++;
+    }
+    if (!response.isDigest()) {
+      nb_full++;
+    }
+    slot.emplace(std::move(response));
+  }
+
+  /**
+   * @brief Return a full response that a quorum of servers agreed on, if
+   *        any. Digests count towards the full response they match.
+   *
+   */
+  Response const* agreed() const {
+    if (nb_responses < quorum || nb_full == 0) {
+      return nullptr;
+    }
+    for (auto const& candidate : responses) {
+      if (!candidate || candidate->isDigest()) {
+        continue;
+      }
+      std::optional<Response::Hash> hash;
+      size_t matching = 0;
+      for (auto const& other : responses) {
+        if (!other) {
+          continue;
+        }
+        if (other->isDigest()) {
+          if (!hash) {
+            hash.emplace(candidate->payloadHash());
+          }
+          matching += other->digest() == *hash ? 1 : 0;
+        } else {
+          matching += *other == *candidate ? 1 : 0;
+        }
+      }
+      if (matching >= quorum) {
+        return &*candidate;
+      }
+    }
+    return nullptr;
+  }
+
+  std::optional<size_t> poll(uint8_t* dest) {
+    if (nb_responses < quorum) {
+      return std::nullopt;
+    }
+    if (auto const* const response = agreed()) {
+      std::copy(response->begin(), response->end(), dest);
+      return response->size();
+    }
+    if (nb_full == nb_responses) {
+      throw std::logic_error("Byzantine behavior, responses did not match.");
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Whether a quorum responded but we cannot decide without more
+   *        full responses. To be called when poll failed.
+   *
+   */
+  bool lacksFullResponse() const {
+    return !full_requested && nb_responses >= quorum &&
+           nb_full < nb_responses;
+  }
+
+  Request request;
+  size_t const quorum;
+  size_t nb_responses = 0;
+  size_t nb_full = 0;
+  bool full_requested = false;
+  std::array<std::optional<Response>, MaxNbServers> responses;
+};
+
+}  // namespace dory::ubft::rpc::internal
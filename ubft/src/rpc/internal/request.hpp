@@ -20,6 +20,13 @@ class Request : public Message {
  public:
   using Id = RequestId;
 
+  // Read-only requests are tagged by the highest bit of their id, and have
+  // their own sequence of ids as they are not ordered.
+  static Id constexpr ReadOnlyBit = Id(1) << (sizeof(Id) * 8 - 1);
+  // Requests tagged by this bit ask replicas to resend their full response to
+  // the request whose id is the rest of the id. They carry no payload.
+  static Id constexpr ResendBit = ReadOnlyBit >> 1;
+
   using Layout = consensus::Request::Layout;
 
   using Message::Message;
@@ -55,6 +62,10 @@ class Request : public Message {
     return const_cast<RequestId&>(std::as_const(*this).id());
   }
 
+  inline bool readOnly() const { return (id() & ReadOnlyBit) != 0; }
+
+  inline bool resend() const { return (id() & ResendBit) != 0; }
+
   inline size_t const& size() const {
     return reinterpret_cast<Layout const*>(rawBuffer().data())->size;
   }
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "../../types.hpp"
+#include "common.hpp"
+#include "request.hpp"
+
+namespace dory::ubft::rpc::internal {
+
+/**
+ * @brief Keeps the latest responses sent to a client so that they can be sent
+ *        again in full if the client only received digests.
+ *
+ * Entries are preallocated and overwritten in a round-robin fashion.
+ */
+class ResponseCache {
+ public:
+  ResponseCache(size_t const entries, size_t const max_response_size)
+      : cache(entries, {Request::ResendBit, {}}) {
+    for (auto &[id, response] : cache) {
+      response.reserve(max_response_size);
+    }
+  }
+
+  void insert(RequestId const request_id, uint8_t const *const response,
+              size_t const response_size) {
+    auto &[id, cached] = cache[next++ % cache.size()];
+    id = request_id;
+    cached.assign(response, response + response_size);
+  }
+
+  OptionalConstRef<std::vector<uint8_t>> find(
+      RequestId const request_id) const {
+    auto const it = std::find_if(
+        cache.begin(), cache.end(),
+        [request_id](auto const &entry) { return entry.first == request_id; });
+    if (it == cache.end()) {
+      return std::nullopt;
+    }
+    return std::cref(it->second);
+  }
+
+ private:
+  // Ids are initialized to a value no cached request can take.
+  std::vector<std::pair<RequestId, std::vector<uint8_t>>> cache;
+  size_t next = 0;
+};
+
+}  // namespace dory::ubft::rpc::internal
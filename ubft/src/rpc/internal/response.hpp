@@ -18,8 +18,13 @@ class Response : public Message {
   using Message::Message;
 
  public:
+  // A replica either sends the full response or only its digest.
+  enum Kind : uint8_t { Full, Digest };
+  using Hash = crypto::hash::Blake3Hash;
+
   struct Layout {
     Request::Id request_id;
+    Kind kind;
     uint8_t response;  // Fake field
   };
 
@@ -32,13 +37,38 @@ class Response : public Message {
     if (unlikely(buffer.size() < bufferSize(0))) {
       return std::invalid_argument("Buffer too small!");
     }
-    return Response(std::move(buffer));
+    auto response = Response(std::move(buffer));
+    if (unlikely(response.kind() != Full && response.kind() != Digest)) {
+      return std::invalid_argument("Unknown response kind!");
+    }
+    if (unlikely(response.isDigest() && response.size() != sizeof(Hash))) {
+      return std::invalid_argument("Digest of invalid size!");
+    }
+    return response;
   }
 
   Request::Id const& requestId() const {
     return reinterpret_cast<Layout const*>(rawBuffer().data())->request_id;
   }
 
+  Kind kind() const {
+    return reinterpret_cast<Layout const*>(rawBuffer().data())->kind;
+  }
+
+  bool isDigest() const { return kind() == Digest; }
+
+  /**
+   * @brief The digest carried by a Digest response.
+   *
+   */
+  Hash const& digest() const { return *reinterpret_cast<Hash const*>(begin()); }
+
+  /**
+   * @brief The digest of the payload of a Full response.
+   *
+   */
+  Hash payloadHash() const { return crypto::hash::blake3(begin(), end()); }
+
   uint8_t const* begin() const {
     return &reinterpret_cast<Layout const*>(rawBuffer().data())->response;
   }
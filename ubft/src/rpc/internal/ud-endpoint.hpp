@@ -0,0 +1,267 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <dory/conn/ud.hpp>
+#include <dory/ctrl/block.hpp>
+#include <dory/memstore/store.hpp>
+#include <dory/shared/branching.hpp>
+#include <dory/shared/logger.hpp>
+
+#include "../../types.hpp"
+
+namespace dory::ubft::rpc::internal {
+
+/**
+ * @brief A single UD QP used to exchange datagrams with any number of peers.
+ *
+ * Datagrams carry the id of their sender as immediate, so that a single QP
+ * (and a single pair of CQs) can serve thousands of clients. As the immediate
+ * can be forged, the id is only trusted if the datagram comes from the QP the
+ * peer announced, which `connect` binds it to. Messages are
+ * copied in/out of preregistered slots: `depth` slots to receive and `depth`
+ * slots to send, the latter being recycled upon completion.
+ */
+class UdEndpoint {
+  static size_t constexpr SlotAlignment = 64;
+
+ public:
+  // Datagrams cannot span more than a (path) MTU.
+  static size_t constexpr MaxMessageSize = 4096;
+  static size_t constexpr Depth =
+      static_cast<size_t>(conn::UnreliableDatagram::WrDepth);
+
+  UdEndpoint(ctrl::ControlBlock &cb, ProcId const local_id,
+             std::string const &identifier, size_t const max_message_size)
+      : cb{cb},
+        local_id{local_id},
+        ns{fmt::format("{}-ud", identifier)},
+        slot_size{roundUp(conn::UnreliableDatagram::UdGrhLength +
+                          max_message_size)},
+        max_message_size{max_message_size} {
+    if (max_message_size > MaxMessageSize) {
+      throw std::invalid_argument(
+          fmt::format("UD messages are limited to {}B, {}B requested.",
+                      MaxMessageSize, max_message_size));
+    }
+    auto const uuid = fmt::format("{}-{}", ns, local_id);
+    cb.allocateBuffer(uuid, 2 * Depth * slot_size, SlotAlignment);
+    cb.registerMr(uuid, PdStandard, uuid,
+                  ctrl::ControlBlock::LOCAL_READ |
+                      ctrl::ControlBlock::LOCAL_WRITE);
+    cb.registerCq(fmt::format("{}-send", uuid));
+    cb.registerCq(fmt::format("{}-recv", uuid));
+    ud = std::make_shared<conn::UnreliableDatagram>(
+        cb, PdStandard, uuid, fmt::format("{}-send", uuid),
+        fmt::format("{}-recv", uuid));
+    base = reinterpret_cast<uint8_t *>(cb.mr(uuid).addr);
+
+    for (size_t i = 0; i < Depth; i++) {
+      postRecv(i);
+    }
+    wcs.resize(Depth);
+  }
+
+  /**
+   * @brief Publish the address of the QP so that peers can `connect` to it.
+   *
+   */
+  void announce() {
+    memstore::MemoryStore::getInstance().set(key(local_id),
+                                             ud->info().serialize());
+  }
+
+  /**
+   * @brief Create an address handle to a peer that announced itself.
+   *
+   * @return false if the peer did not announce itself (yet).
+   */
+  bool connect(ProcId const remote_id) {
+    if (connected(remote_id)) {
+      return true;
+    }
+    std::string serialized;
+    if (!memstore::MemoryStore::getInstance().get(key(remote_id),
+                                                  serialized)) {
+      return false;
+    }
+    connect(remote_id, serialized);
+    return true;
+  }
+
+  /**
+   * @brief Create an address handle to a peer from the address it announced
+   *        under `key(remote_id)`, e.g., looked up asynchronously.
+   */
+  void connect(ProcId const remote_id, std::string const &serialized) {
+    if (connected(remote_id)) {
+      return;
+    }
+    auto const qpn =
+        conn::UnreliableDatagramInfo::fromSerialized(serialized).qpn;
+    peers.emplace(remote_id,
+                  Peer{conn::UnreliableDatagramConnection(cb, PdStandard, ud,
+                                                          serialized),
+                       qpn});
+    LOGGER_DEBUG(logger, "Connected to {} (QPN {}) over UD.", remote_id, qpn);
+  }
+
+  bool connected(ProcId const remote_id) const {
+    return peers.find(remote_id) != peers.end();
+  }
+
+  /**
+   * @return the memstore key under which `proc_id` announces its QP.
+   */
+  std::string key(ProcId const proc_id) const {
+    return fmt::format("{}-{}-qp", ns, proc_id);
+  }
+
+  /**
+   * @brief Return a slot where to write a message of at most
+   *        `max_message_size` bytes, to be sent via `send`.
+   *
+   */
+  uint8_t *getSendSlot() {
+    while (unlikely(outstanding_sends == Depth)) {
+      pollSendCompletions();
+    }
+    return sendSlot(next_send);
+  }
+
+  void send(ProcId const remote_id, size_t const size) {
+    auto peer_it = peers.find(remote_id);
+    if (unlikely(peer_it == peers.end())) {
+      throw std::logic_error(
+          fmt::format("Sending over UD to unknown peer {}.", remote_id));
+    }
+    if (unlikely(!peer_it->second.connection.postSend(
+            next_send, sendSlot(next_send), static_cast<uint32_t>(size),
+            static_cast<uint32_t>(local_id)))) {
+      throw std::runtime_error("Failed to post a UD send.");
+    }
+    next_send = (next_send + 1) % Depth;
+    outstanding_sends++;
+  }
+
+  /**
+   * @brief Poll received datagrams and call `handler(from, data, size)` for
+   *        each of them. The data is only valid during the call.
+   *
+   * Datagrams of peers that are not connected are dropped after calling
+   * `unknown(from)`, as their sender cannot be authenticated yet. Datagrams
+   * that do not come from the QP of the peer they claim to be sent by are
+   * dropped.
+   */
+  template <typename Handler, typename Unknown>
+  void poll(Handler &&handler, Unknown &&unknown) {
+    pollSendCompletions();
+    wcs.resize(Depth);
+    if (unlikely(!ud->pollCqIsOk<conn::UnreliableDatagram::RecvCQ>(wcs))) {
+      throw std::runtime_error("Error while polling the UD recv CQ.");
+    }
+    for (auto const &wc : wcs) {
+      auto const index = static_cast<size_t>(wc.wr_id);
+      if (likely(wc.status == IBV_WC_SUCCESS &&
+                 (wc.wc_flags & IBV_WC_WITH_IMM) != 0)) {
+        auto const from = static_cast<ProcId>(wc.imm_data);
+        auto const peer_it = peers.find(from);
+        if (unlikely(peer_it == peers.end())) {
+          unknown(from);
+        } else if (unlikely(peer_it->second.qpn != wc.src_qp)) {
+          LOGGER_WARN(logger,
+                      "Dropping a UD datagram claiming to be from {} sent by "
+                      "QPN {} instead of {}.",
+                      from, wc.src_qp, peer_it->second.qpn);
+        } else {
+          auto const size =
+              wc.byte_len - conn::UnreliableDatagram::UdGrhLength;
+          handler(from,
+                  recvSlot(index) + conn::UnreliableDatagram::UdGrhLength,
+                  static_cast<size_t>(size));
+        }
+      } else {
+        LOGGER_WARN(logger, "Dropping a UD datagram (status: {}).",
+                    ibv_wc_status_str(wc.status));
+      }
+      postRecv(index);
+    }
+  }
+
+  template <typename Handler>
+  void poll(Handler &&handler) {
+    poll(std::forward<Handler>(handler), [this](ProcId const from) {
+      LOGGER_WARN(logger, "Dropping a UD datagram from unknown peer {}.",
+                  from);
+    });
+  }
+
+ private:
+  void pollSendCompletions() {
+    if (outstanding_sends == 0) {
+      return;
+    }
+    wcs.resize(outstanding_sends);
+    if (unlikely(!ud->pollCqIsOk<conn::UnreliableDatagram::SendCQ>(wcs))) {
+      throw std::runtime_error("Error while polling the UD send CQ.");
+    }
+    for (auto const &wc : wcs) {
+      if (unlikely(wc.status != IBV_WC_SUCCESS)) {
+        LOGGER_WARN(logger, "UD send failed: {}.",
+                    ibv_wc_status_str(wc.status));
+      }
+    }
+    // Sends complete in order.
+    outstanding_sends -= wcs.size();
+  }
+
+  void postRecv(size_t const index) {
+    if (unlikely(!ud->postRecv(index, recvSlot(index),
+                               static_cast<uint32_t>(max_message_size)))) {
+      throw std::runtime_error("Failed to post a UD recv.");
+    }
+  }
+
+  uint8_t *recvSlot(size_t const index) { return base + index * slot_size; }
+
+  uint8_t *sendSlot(size_t const index) {
+    return base + (Depth + index) * slot_size;
+  }
+
+  static size_t constexpr roundUp(size_t const size) {
+    return (size + SlotAlignment - 1) / SlotAlignment * SlotAlignment;
+  }
+
+  ctrl::ControlBlock &cb;
+  ProcId const local_id;
+  std::string const ns;
+  size_t const slot_size;
+  size_t const max_message_size;
+
+  std::shared_ptr<conn::UnreliableDatagram> ud;
+  struct Peer {
+    conn::UnreliableDatagramConnection connection;
+    uint32_t qpn;  // The only QP its datagrams are accepted from.
+  };
+  std::unordered_map<ProcId, Peer> peers;
+  uint8_t *base;
+
+  size_t next_send = 0;
+  size_t outstanding_sends = 0;
+  std::vector<struct ibv_wc> wcs;
+
+  static auto constexpr PdStandard = "standard";
+
+  LOGGER_DECL_INIT(logger, "UdEndpoint");
+};
+
+}  // namespace dory::ubft::rpc::internal
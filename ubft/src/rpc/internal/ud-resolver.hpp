@@ -0,0 +1,123 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+
+#include <dory/memstore/store.hpp>
+#include <dory/shared/logger.hpp>
+#include <dory/third-party/sync/mpmc.hpp>
+
+#include "../../types.hpp"
+
+namespace dory::ubft::rpc::internal {
+
+/**
+ * @brief Looks up the UD addresses of peers on a background thread, so that
+ *        the first datagram of a peer does not stall the polling thread on a
+ *        round trip to the memstore.
+ *
+ * The thread uses its own MemoryStore instance as the singleton is not
+ * thread-safe.
+ */
+class UdResolver {
+ public:
+  struct Resolved {
+    ProcId id;
+    std::optional<std::string> serialized;  // Empty if not announced (yet).
+  };
+
+  UdResolver() : thread{[this] { run(); }} {}
+
+  // The thread holds a pointer to the resolver.
+  UdResolver(UdResolver const &) = delete;
+  UdResolver &operator=(UdResolver const &) = delete;
+  UdResolver(UdResolver &&) = delete;
+  UdResolver &operator=(UdResolver &&) = delete;
+
+  ~UdResolver() {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      stop = true;
+      condition.notify_all();
+    }
+    thread.join();
+  }
+
+  /**
+   * @brief Look up the address `id` announced under `key` unless a lookup is
+   *        already ongoing.
+   */
+  void resolve(ProcId const id, std::string key) {
+    if (!ongoing.insert(id).second) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    requests.emplace_back(id, std::move(key));
+    condition.notify_one();
+  }
+
+  /**
+   * @brief Poll the result of a lookup. A peer that was not found can be
+   *        looked up again.
+   */
+  std::optional<Resolved> poll() {
+    Resolved resolved;
+    if (!results.try_dequeue(resolved)) {
+      return std::nullopt;
+    }
+    ongoing.erase(resolved.id);
+    return resolved;
+  }
+
+ private:
+  void run() {
+    memstore::MemoryStore store("");
+    for (;;) {
+      ProcId id;
+      std::string key;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this] { return stop || !requests.empty(); });
+        if (stop) {
+          return;
+        }
+        std::tie(id, key) = std::move(requests.front());
+        requests.pop_front();
+      }
+      std::string serialized;
+      try {
+        if (store.get(key, serialized)) {
+          results.enqueue({id, std::move(serialized)});
+          continue;
+        }
+      } catch (std::exception const &e) {
+        LOGGER_WARN(logger, "Failed to look up {}: {}", id, e.what());
+      }
+      results.enqueue({id, std::nullopt});
+    }
+  }
+
+  // Accessed by the polling thread only.
+  std::unordered_set<ProcId> ongoing;
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<std::pair<ProcId, std::string>> requests;
+  bool stop = false;
+
+  third_party::sync::MpmcQueue<Resolved> results;
+  LOGGER_DECL_INIT(logger, "UdResolver");
+
+  // Started once all the other members are initialized.
+  std::thread thread;
+};
+
+}  // namespace dory::ubft::rpc::internal
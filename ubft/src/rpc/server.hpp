@@ -1,11 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <deque>
 #include <memory>
 #include <optional>
 
 #include <fmt/core.h>
 #include <hipony/enumerate.hpp>
 
+#include <dory/crypto/hash/blake3.hpp>
 #include <dory/ctrl/block.hpp>
 
 #include <dory/memstore/store.hpp>
@@ -28,7 +31,10 @@
 #include "internal/connection.hpp"
 #include "internal/ingress.hpp"
 #include "internal/request.hpp"
+#include "internal/response-cache.hpp"
 #include "internal/response.hpp"
+#include "internal/ud-endpoint.hpp"
+#include "internal/ud-resolver.hpp"
 
 #include "../tail-p2p/receiver-builder.hpp"
 #include "../tail-p2p/sender-builder.hpp"
@@ -54,6 +60,7 @@ class Server {
         store{dory::memstore::MemoryStore::getInstance()},
         local_id{local_id},
         ns{fmt::format("rpc-{}-S{}", identifier, local_id)},
+        identifier{identifier},
         min_client_id{min_client_id},
         window{window},
         max_request_size{max_request_size},
@@ -68,7 +75,9 @@ class Server {
         rpc_connection_server{buildRpcConnectionServer(
             cb, local_id, window, max_request_size, max_response_size,
             max_connections, dynamic_connections)},
-        request_pool{(max_client_id - min_client_id + 1) * (window + 1),
+        // Clients can have up to `window` ordered and `window` read-only
+        // requests outstanding.
+        request_pool{(max_client_id - min_client_id + 1) * (2 * window + 1),
                      Request::bufferSize(max_request_size)},
         signed_request_pool{
             (max_client_id - min_client_id + 1 + (server_ids.size() - 1)) *
@@ -79,14 +88,27 @@ class Server {
                   Request::bufferSize(max_request_size)},
         ingress{crypto,        thread_pool, min_client_id,
                 max_client_id, window,      server_ids.size()},
-        clients{static_cast<size_t>(max_client_id - min_client_id + 1)} {
+        clients{static_cast<size_t>(max_client_id - min_client_id + 1)},
+        response_caches{
+            static_cast<size_t>(max_client_id - min_client_id + 1)},
+        ud_clients{static_cast<size_t>(max_client_id - min_client_id + 1)},
+        queued_read_only(
+            static_cast<size_t>(max_client_id - min_client_id + 1)),
+        responder_ids{server_ids} {
+    std::sort(responder_ids.begin(), responder_ids.end());
+    // Digests are only worth it if the designated replica does respond.
+    if (responder_ids.size() > 1) {
+      responder_ids.erase(std::remove(responder_ids.begin(),
+                                      responder_ids.end(), SilentReplica),
+                          responder_ids.end());
+    }
     announcer.announceProcess(local_id, rpc_connection_server->port());
     connectServers(server_ids);
   }
 
   void tick() {
-    if ((ticks++ % (1 << 10)) == 0) {
-      updateConnections();
+    if (ud_endpoint) {
+      pollUdClientRequests();
     }
     if (likely(!slow_path)) {  // FAST PATH
       pollClientRequests();
@@ -102,6 +124,8 @@ class Server {
         }
       }
     } else {  // SLOW PATH
+      // Read-only requests are never signed as they are not ordered.
+      pollClientRequests();
       pollClientSignedRequests();
       ingress.tick();
       for (auto &server : servers) {
@@ -120,8 +144,45 @@ class Server {
 
   void toggleSlowPath(bool const enable) { slow_path = enable; }
 
+  ProcId minClientId() const { return min_client_id; }
+
+  size_t nbClients() const { return clients.size(); }
+
+  /**
+   * @brief Only send the full response when this replica is the designated
+   *        one for the request (rotating by request id), and only its digest
+   *        otherwise. Clients ask for full responses when needed.
+   *
+   */
+  void toggleDigestResponses(bool const enable) { digest_responses = enable; }
+
   void toggleOptimism(bool const optimism) { optimistic = optimism; }
 
+  /**
+   * @brief Also accept requests sent as datagrams over a single UD QP, so
+   *        that the number of clients is not bounded by the number of RC QPs
+   *        the NIC can cache.
+   *
+   * UD clients never send signed requests and requests that do not fit a
+   * datagram are rejected by their client. On the slow path, their ordered
+   * requests are received as is: they are proposed once echoed (or right
+   * away if optimistic).
+   *
+   * Clients are looked up in the memstore in the background the first time
+   * they send a datagram, which is dropped meanwhile: clients retransmit.
+   */
+  void acceptUdClients() {
+    if (ud_endpoint) {
+      return;
+    }
+    ud_endpoint.emplace(
+        cb, local_id, fmt::format("rpc-{}", identifier),
+        std::max(Request::bufferSize(max_request_size),
+                 Response::bufferSize(max_response_size)));
+    ud_endpoint->announce();
+    ud_resolver = std::make_unique<internal::UdResolver>();
+  }
+
   /**
    * @brief Return requests that where received from clients so that
    *        acceptRequest can be called on consensus.
@@ -141,6 +202,21 @@ class Server {
     return ingress.pollProposable(!slow_path, optimistic);
   }
 
+  /**
+   * @brief Return requests tagged as read-only by clients. They bypass the
+   *        ingress (i.e., they are neither echoed nor proposed) and are meant
+   *        to be executed right away against the latest executed state.
+   */
+  std::optional<Request> pollReadOnly() {
+    if (likely(read_only_requests.empty())) {
+      return std::nullopt;
+    }
+    auto request = std::move(read_only_requests.front());
+    read_only_requests.pop_front();
+    queued_read_only[request.clientId() - min_client_id]--;
+    return request;
+  }
+
   /**
    * @brief Called after a value is decided to respond to the client
    *
@@ -151,6 +227,11 @@ class Server {
    */
   void executed(ProcId const client_id, RequestId const request_id,
                 uint8_t const* const response, size_t const response_size) {
+    if (getUdClient(client_id)) {
+      ingress.executed(client_id, request_id);
+      respond(nullptr, client_id, request_id, response, response_size);
+      return;
+    }
     auto client = getClient(client_id);
     if (unlikely(!client || !client->active)) {
       LOGGER_WARN(logger,
@@ -160,20 +241,34 @@ class Server {
       return;
     }
     ingress.executed(client_id, request_id);
-    if (unlikely(local_id == 3)) {
-      // The last replica never replies, to simulate the real latency.
+    respond(&*client, client_id, request_id, response, response_size);
+  }
+
+  /**
+   * @brief Called after a read-only request is executed to respond to the
+   *        client.
+   *
+   * @param request
+   * @param response
+   * @param response_size
+   */
+  void executedReadOnly(Request const& request, uint8_t const* const response,
+                        size_t const response_size) {
+    if (getUdClient(request.clientId())) {
+      respond(nullptr, request.clientId(), request.id(), response,
+              response_size);
       return;
     }
-    auto &client_sender = client->data->sender;
-    auto const buffer_size =
-        static_cast<tail_p2p::Size>(Response::bufferSize(response_size));
-    auto &slot = *reinterpret_cast<Response::Layout *>(
-        client_sender.getSlot(buffer_size));
-    slot.request_id = request_id;
-    std::copy(response, response + response_size, &slot.response);
-    client_sender.send();
-    LOGGER_DEBUG(logger, "Replied to client #{} about request #{}.", client_id,
-                 request_id);
+    auto client = getClient(request.clientId());
+    if (unlikely(!client || !client->active)) {
+      LOGGER_WARN(logger,
+                  "Executed a read-only command from client {} which is not "
+                  "connected or not active.",
+                  request.clientId());
+      return;
+    }
+    respond(&*client, request.clientId(), request.id(), response,
+            response_size);
   }
 
   void setLeader(ProcId const new_leader) {
@@ -183,12 +278,100 @@ class Server {
   }
 
  private:
-  inline void updateConnections() {
-    connections.emplace(dynamic_connections->get().connections());
+  /**
+   * @param client the RC connection to the client, or nullptr if the client
+   *        uses UD.
+   */
+  void respond(Connection* client, ProcId const client_id,
+               RequestId const request_id, uint8_t const* const response,
+               size_t const response_size) {
+    if (unlikely(local_id == SilentReplica)) {
+      return;
+    }
+    // Datagrams can be lost, so UD clients may need the response again.
+    if (digest_responses || !client) {
+      getResponseCache(client_id).insert(request_id, response, response_size);
+    }
+    if (digest_responses && designatedReplica(request_id) != local_id) {
+      auto const digest =
+          crypto::hash::blake3(response, response + response_size);
+      send(client, client_id, request_id, Response::Digest, digest.data(),
+           digest.size());
+      return;
+    }
+    send(client, client_id, request_id, Response::Full, response,
+         response_size);
+  }
+
+  void resendResponse(Connection* client, ProcId const client_id,
+                      RequestId const request_id) {
+    if (unlikely(local_id == SilentReplica ||
+                 (!digest_responses && client))) {
+      return;
+    }
+    auto const cached = getResponseCache(client_id).find(request_id);
+    if (!cached) {
+      // Not executed yet (or too old), the response will be sent upon
+      // execution.
+      LOGGER_DEBUG(logger, "No response to resend for request #{}.",
+                   request_id);
+      return;
+    }
+    auto const& response = cached->get();
+    send(client, client_id, request_id, Response::Full, response.data(),
+         response.size());
+  }
+
+  void send(Connection* client, ProcId const client_id,
+            RequestId const request_id, Response::Kind const kind,
+            uint8_t const* const response, size_t const response_size) {
+    auto const buffer_size = Response::bufferSize(response_size);
+    auto *const raw_slot =
+        client ? client->data->sender.getSlot(
+                     static_cast<tail_p2p::Size>(buffer_size))
+               : ud_endpoint->getSendSlot();
+    auto &slot = *reinterpret_cast<Response::Layout *>(raw_slot);
+    slot.request_id = request_id;
+    slot.kind = kind;
+    std::copy(response, response + response_size, &slot.response);
+    if (client) {
+      client->data->sender.send();
+    } else {
+      ud_endpoint->send(client_id, buffer_size);
+    }
+    LOGGER_DEBUG(logger, "Replied to client about request #{}.", request_id);
+  }
+
+  /**
+   * @brief The replica that sends its full response to a request while the
+   *        others only send digests. It rotates among the responding
+   *        replicas to spread the load.
+   */
+  inline ProcId designatedReplica(RequestId const request_id) const {
+    auto const sequence = request_id & ~Request::ReadOnlyBit;
+    return responder_ids[sequence % responder_ids.size()];
+  }
+
+  internal::ResponseCache &getResponseCache(ProcId const client_id) {
+    auto &cache = response_caches[client_id - min_client_id];
+    if (unlikely(!cache)) {
+      // Ordered and read-only responses may be requested again.
+      cache.emplace(2 * window, max_response_size);
+    }
+    return *cache;
+  }
+
+  /**
+   * @brief The latest connections to clients. Picking them up never blocks, so
+   *        it can be done on every poll.
+   *
+   */
+  inline std::vector<DynamicConnections::ValueType> &clientConnections() {
+    return dynamic_connections->get().connections();
   }
 
   void pollClientRequests() {
-    for (auto &[proc_id, conn] : connections->get()) {
+    for (auto &[proc_id, conn] : clientConnections()) {
       auto &[active, client] = conn;
       if (!*active) {
         continue;
@@ -216,15 +399,127 @@ class Server {
       throw std::runtime_error(
           "Byzantine behavior, received a client request with invalid id.");
     }
-    ingress.fromClient(std::move(request));
     auto &client = getClient(from_id);
     if (!client) {
       client.emplace(conn);
     }
+    if (unlikely(request.resend())) {
+      resendResponse(&*client, from_id, request.id() & ~Request::ResendBit);
+      return;
+    }
+    if (request.readOnly()) {
+      queueReadOnly(std::move(request));
+      return;
+    }
+    // On the slow path, ordered requests are received signed.
+    if (unlikely(slow_path)) {
+      return;
+    }
+    ingress.fromClient(std::move(request));
+  }
+
+  /**
+   * @brief Each queued read-only request pins a buffer of the request pool, so
+   *        clients cannot have more than their window queued.
+   *
+   */
+  void queueReadOnly(Request &&request) {
+    auto &queued = queued_read_only[request.clientId() - min_client_id];
+    if (unlikely(queued >= window)) {
+      LOGGER_WARN(logger,
+                  "Dropping a read-only request of {} beyond its window.",
+                  request.clientId());
+      return;
+    }
+    queued++;
+    read_only_requests.push_back(std::move(request));
+  }
+
+  void pollUdClientRequests() {
+    while (auto resolved = ud_resolver->poll()) {
+      if (resolved->serialized) {
+        ud_endpoint->connect(resolved->id, *resolved->serialized);
+      } else {
+        LOGGER_WARN(logger, "UD client {} did not announce itself.",
+                    resolved->id);
+      }
+    }
+    ud_endpoint->poll(
+        [this](ProcId const from_id, uint8_t const *const data,
+               size_t const size) {
+          if (unlikely(size > Request::bufferSize(max_request_size))) {
+            LOGGER_WARN(logger, "Dropping a UD request of {}B from {}.", size,
+                        from_id);
+            return;
+          }
+          // Datagrams are not flow controlled: the pool may be exhausted by
+          // requests that are not consumed (fast enough).
+          auto opt_buffer = request_pool.take(size);
+          if (unlikely(!opt_buffer)) {
+            LOGGER_WARN(logger, "No buffer left for a UD request from {}.",
+                        from_id);
+            return;
+          }
+          auto &buffer = *opt_buffer;
+          std::copy(data, data + size, buffer.data());
+          auto request = Request::tryFrom(std::move(buffer));
+          match{request}(
+              [from_id, this](std::invalid_argument &err) {
+                LOGGER_WARN(logger, "Invalid UD request from {}: {}", from_id,
+                            err.what());
+              },
+              [from_id, this](Request &request) {
+                handleUdRequest(from_id, std::move(request));
+              });
+        },
+        [this](ProcId const from_id) {
+          if (unlikely(!isClient(from_id))) {
+            LOGGER_WARN(logger, "Dropping a UD request from unknown client {}.",
+                        from_id);
+            return;
+          }
+          ud_resolver->resolve(from_id, ud_endpoint->key(from_id));
+        });
+  }
+
+  /**
+   * @brief Datagrams may be lost, duplicated or (in theory) reordered, so
+   *        clients retransmit all their outstanding requests from the oldest
+   *        one (go-back-N) and we only let the next expected one through.
+   *
+   */
+  void handleUdRequest(ProcId const from_id, Request &&request) {
+    if (unlikely(from_id != request.clientId())) {
+      LOGGER_WARN(logger, "Dropping a UD request of {} sent by {}.",
+                  request.clientId(), from_id);
+      return;
+    }
+    auto &client = getUdClient(from_id);
+    if (unlikely(!client)) {
+      client.emplace();
+    }
+    if (unlikely(request.resend())) {
+      resendResponse(nullptr, from_id, request.id() & ~Request::ResendBit);
+      return;
+    }
+    if (request.readOnly()) {
+      queueReadOnly(std::move(request));
+      return;
+    }
+    if (request.id() < client->next_expected) {
+      // Already received: our response may have been lost.
+      resendResponse(nullptr, from_id, request.id());
+      return;
+    }
+    if (request.id() > client->next_expected) {
+      return;
+    }
+    client->next_expected++;
+    ingress.fromClient(std::move(request));
   }
 
   void pollClientSignedRequests() {
-    for (auto &[proc_id, conn] : connections->get()) {
+    for (auto &[proc_id, conn] : clientConnections()) {
       auto &[active, client] = conn;
       if (!*active) {
         continue;
@@ -421,6 +716,8 @@ class Server {
     std::vector<tail_p2p::ReceiverBuilder> request_receiver_builders;
     std::vector<tail_p2p::ReceiverBuilder> sig_request_receiver_builders;
     std::vector<tail_p2p::ReceiverBuilder> ack_receiver_builders;
+    // The qps are published together when entering the barrier.
+    store.beginBatch();
     for (auto const server_id : replica_ids) {
       if (server_id == local_id) {
         continue;
@@ -452,6 +749,7 @@ class Server {
     }
 
     store.barrier("server_group_qp_announced", replica_ids.size());
+    store.commitBatch();
 
     for (auto &builder : request_sender_builders) {
       builder.connectQps();
@@ -530,10 +828,24 @@ class Server {
     return clients[client_id - min_client_id];
   }
 
+  struct UdClient {
+    RequestId next_expected = 0;
+  };
+
+  inline bool isClient(ProcId const proc_id) const {
+    return proc_id >= min_client_id &&
+           static_cast<size_t>(proc_id - min_client_id) < ud_clients.size();
+  }
+
+  inline std::optional<UdClient> &getUdClient(ProcId const client_id) {
+    return ud_clients[client_id - min_client_id];
+  }
+
   ctrl::ControlBlock &cb;
   dory::memstore::MemoryStore &store;
   ProcId const local_id;
   std::string const ns;
+  std::string const identifier;
 
   ProcId const min_client_id;
   size_t const window;
@@ -545,17 +857,17 @@ class Server {
   size_t leader_index;
   bool slow_path = false;
   bool optimistic = false;
-  size_t ticks = 0;
+  bool digest_responses = false;
 
   memstore::ProcessAnnouncer announcer;
   DelayedRef<DynamicConnections> dynamic_connections;
-  DelayedRef<std::vector<DynamicConnections::ValueType>> connections;
   std::unique_ptr<RpcConnectionServer> rpc_connection_server;
 
   Pool request_pool;
   Pool signed_request_pool;
   Pool echo_pool;
   internal::RequestIngress ingress;
+  std::deque<Request> read_only_requests;
 
   struct OtherServer {
     using Ack = size_t;
@@ -586,6 +898,17 @@ class Server {
 
   std::vector<OtherServer> servers;
   std::vector<std::optional<Connection>> clients;
+  std::vector<std::optional<internal::ResponseCache>> response_caches;
+  std::optional<internal::UdEndpoint> ud_endpoint;
+  std::unique_ptr<internal::UdResolver> ud_resolver;
+  std::vector<std::optional<UdClient>> ud_clients;
+  // Read-only requests queued per client, bounded by the window.
+  std::vector<size_t> queued_read_only;
+  // Sorted replicas that respond to clients, the same on all replicas.
+  std::vector<ProcId> responder_ids;
+
+  // The last replica never replies, to simulate the real latency.
+  static ProcId constexpr SilentReplica = 3;
 
   LOGGER_DECL_INIT(logger, "ServerRpc");
 };
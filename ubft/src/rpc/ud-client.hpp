@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <dory/ctrl/block.hpp>
+
+#include <dory/shared/branching.hpp>
+#include <dory/shared/logger.hpp>
+#include <dory/shared/match.hpp>
+
+#include "../buffer.hpp"
+#include "../types.hpp"
+#include "internal/common.hpp"
+#include "internal/outstanding-requests.hpp"
+#include "internal/pending-request.hpp"
+#include "internal/request.hpp"
+#include "internal/response.hpp"
+#include "internal/ud-endpoint.hpp"
+
+namespace dory::ubft::rpc {
+
+/**
+ * @brief A client that talks to the servers via datagrams over a single UD QP
+ *        instead of one set of RC QPs per server. It exposes the same
+ *        interface as `Client`.
+ *
+ * Datagrams can be lost: when no response arrives for `retransmit_after`,
+ * all outstanding requests are sent again from the oldest one (go-back-N) to
+ * the servers that did not respond to them. Servers filter out duplicates and
+ * resend their cached response instead.
+ *
+ * UD clients only use the fast path (i.e., requests are never signed) and
+ * requests/responses must fit in a datagram.
+ */
+class UdClient {
+  using Request = internal::Request;
+  using Response = internal::Response;
+  using RequestData = internal::PendingRequest;
+  using Clock = std::chrono::steady_clock;
+
+ public:
+  UdClient(ctrl::ControlBlock& cb, ProcId const local_id,
+           std::vector<ProcId> const server_ids, std::string const& identifier,
+           size_t const window, size_t const max_request_size,
+           size_t const max_response_size,
+           std::chrono::microseconds const retransmit_after =
+               std::chrono::microseconds(500))
+      : local_id{local_id},
+        server_ids{server_ids},
+        max_full_request_size{Request::bufferSize(max_request_size)},
+        max_full_response_size{Response::bufferSize(max_response_size)},
+        retransmit_after{retransmit_after},
+        endpoint{cb, local_id, fmt::format("rpc-{}", identifier),
+                 std::max(max_full_request_size, max_full_response_size)},
+        request_pool{window + 1, max_full_request_size},
+        response_pool{2 * server_ids.size() * window, max_full_response_size},
+        outstanding{window, server_ids.size()} {
+    if (server_ids.size() > RequestData::MaxNbServers) {
+      throw std::invalid_argument(
+          fmt::format("At most {} servers are supported.",
+                      RequestData::MaxNbServers));
+    }
+    endpoint.announce();
+    for (auto const server_id : server_ids) {
+      if (!connect(server_id)) {
+        throw std::runtime_error(
+            fmt::format("Could not connect to server {} over UD.", server_id));
+      }
+    }
+  }
+
+  void tick() {
+    pollResponses();
+    if (!outstanding.empty() &&
+        Clock::now() - last_progress > retransmit_after) {
+      retransmit();
+    }
+  }
+
+  /**
+   * @brief Return a slot where to write a request and add it to the buffer to
+   *        post.
+   *
+   * @param request_size
+   * @param read_only see `Client::getSlot`.
+   * @return std::optional<uint8_t*> might be nullopt if no slot is available.
+   */
+  std::optional<uint8_t*> getSlot(size_t const request_size,
+                                  bool const read_only = false) {
+    if (unlikely(Request::bufferSize(request_size) > max_full_request_size)) {
+      throw std::invalid_argument(
+          fmt::format("Request of {}B does not fit a datagram.", request_size));
+    }
+    auto opt_buffer = request_pool.take(Request::bufferSize(request_size));
+    if (!opt_buffer) {
+      return std::nullopt;
+    }
+    auto& request = *reinterpret_cast<Request::Layout*>(opt_buffer->data());
+    request.client_id = local_id;
+    request.id = outstanding.nextId(read_only);
+    request.size = request_size;
+
+    requests_being_written.push_back(std::move(*opt_buffer));
+    return requests_being_written.back().payload();
+  }
+
+  /**
+   * @brief Post all requests that have been buffered via getSlot.
+   *
+   */
+  void post() {
+    if (outstanding.empty()) {
+      last_progress = Clock::now();
+    }
+    for (auto&& request : requests_being_written) {
+      for (auto const server_id : server_ids) {
+        sendRequest(server_id, request);
+      }
+      outstanding.issue(std::move(request));
+    }
+    requests_being_written.clear();
+  }
+
+  /**
+   * @brief Poll the response to the oldest outstanding request. Responses are
+   *        returned in the order requests were posted.
+   *
+   * @param dest where to copy the response
+   * @return std::optional<size_t> the size of the response, if any.
+   */
+  std::optional<size_t> poll(uint8_t* dest) {
+    return outstanding.poll(
+        dest,
+        [this](RequestId const request_id) {
+          requestFullResponses(request_id);
+        },
+        [this](Request const& request) { reissue(request); });
+  }
+
+  void toggleSlowPath(bool const enable) {
+    if (enable) {
+      LOGGER_WARN(logger, "UD clients do not support the slow path.");
+    }
+  }
+
+ private:
+  void reissue(Request const& request) {
+    LOGGER_DEBUG(logger, "Read-only responses did not match, ordering it.");
+    for (auto const server_id : server_ids) {
+      sendRequest(server_id, request);
+    }
+  }
+
+  void requestFullResponses(RequestId const request_id) {
+    LOGGER_DEBUG(logger, "Requesting full responses to request #{}.",
+                 request_id);
+    for (auto const server_id : server_ids) {
+      sendResend(server_id, request_id);
+    }
+  }
+
+  /**
+   * @brief Go-back-N: send again all outstanding requests, oldest first, to
+   *        the servers that did not respond to them.
+   *
+   */
+  void retransmit() {
+    LOGGER_DEBUG(logger, "Retransmitting {} requests from #{}.",
+                 outstanding.size(), outstanding.front());
+    outstanding.forEach([this](RequestData const& data) {
+      for (size_t index = 0; index < server_ids.size(); index++) {
+        auto const& response = data.responses[index];
+        if (!response) {
+          sendRequest(server_ids[index], data.request);
+        } else if (data.full_requested && response->isDigest()) {
+          sendResend(server_ids[index], data.request.id());
+        }
+      }
+    });
+    last_progress = Clock::now();
+  }
+
+  void sendRequest(ProcId const server_id, Request const& request) {
+    auto const& raw_request = request.rawBuffer();
+    std::copy(raw_request.cbegin(), raw_request.cend(),
+              endpoint.getSendSlot());
+    endpoint.send(server_id, raw_request.size());
+  }
+
+  void sendResend(ProcId const server_id, RequestId const request_id) {
+    auto& resend =
+        *reinterpret_cast<Request::Layout*>(endpoint.getSendSlot());
+    resend.client_id = local_id;
+    resend.id = request_id | Request::ResendBit;
+    resend.size = 0;
+    endpoint.send(server_id, Request::bufferSize(0));
+  }
+
+  void pollResponses() {
+    endpoint.poll([this](ProcId const from_id, uint8_t const* const data,
+                         size_t const size) {
+      auto const server_it =
+          std::find(server_ids.begin(), server_ids.end(), from_id);
+      if (unlikely(server_it == server_ids.end() ||
+                   size > max_full_response_size)) {
+        LOGGER_WARN(logger, "Dropping a datagram of {}B from {}.", size,
+                    from_id);
+        return;
+      }
+      auto const index =
+          static_cast<size_t>(server_it - server_ids.begin());
+      auto buffer = *response_pool.take(size);
+      std::copy(data, data + size, buffer.data());
+      auto response_ok = Response::tryFrom(std::move(buffer));
+      match{response_ok}([](std::invalid_argument& error) { throw error; },
+                         [index, this](Response& response) {
+                           handleResponse(index, std::move(response));
+                         });
+    });
+  }
+
+  void handleResponse(size_t const index, Response&& response) {
+    auto* const data = outstanding.find(response.requestId());
+    if (data == nullptr) {
+      // Duplicate response to a request that completed already.
+      return;
+    }
+    if (outstanding.isNext(response.requestId())) {
+      last_progress = Clock::now();
+    }
+    data->newResponse(index, std::move(response));
+  }
+
+  bool connect(ProcId const server_id) {
+    // Servers announce their QP once they start accepting UD clients.
+    for (size_t attempt = 0; attempt < ConnectAttempts; attempt++) {
+      if (endpoint.connect(server_id)) {
+        LOGGER_INFO(logger, "Connected to process {} over UD", server_id);
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return false;
+  }
+
+  ProcId const local_id;
+  std::vector<ProcId> const server_ids;
+  size_t const max_full_request_size;
+  size_t const max_full_response_size;
+  std::chrono::microseconds const retransmit_after;
+  Clock::time_point last_progress;
+
+  static size_t constexpr ConnectAttempts = 100;
+
+  internal::UdEndpoint endpoint;
+  Pool request_pool;
+  Pool response_pool;
+  internal::OutstandingRequests outstanding;
+  std::deque<Request> requests_being_written;
+
+  LOGGER_DECL_INIT(logger, "UdClientRpc");
+};
+}  // namespace dory::ubft::rpc
@@ -4,14 +4,23 @@
 #include <functional>
 #include <memory>
 #include <stdexcept>
+#include <string>
+#include <utility>
 
+#include <dory/crypto/hash/blake3.hpp>
 #include <dory/shared/branching.hpp>
 #include <dory/shared/logger.hpp>
+#include <dory/shared/metrics.hpp>
 
 #include "consensus/consensus.hpp"
 #include "rpc/server.hpp"
 
+#include "decided-log.hpp"
 #include "latency-hooks.hpp"
+#include "progress-monitor.hpp"
+#include "tick-profiler.hpp"
+#include "tracing.hpp"
+#include "undecided-requests.hpp"
 
 namespace dory::ubft {
 
@@ -23,6 +32,7 @@ class Server {
 
  public:
   using Request = consensus::Request;
+  using ReadOnlyRequest = rpc::Server::Request;
 
   Server(ProcId const local_id, std::vector<ProcId> const& server_ids,
          rpc::Server&& rpc_server, consensus::Consensus&& consensus,
@@ -44,17 +54,27 @@ class Server {
       throw std::runtime_error(
           "Cannot tick before having fully consummed last batch.");
     }
-    rpc_server.tick();
+    {
+      tick_profiler::Scope scope(tick_profiler::Phase::RpcServer);
+      rpc_server.tick();
+    }
     consensus.tick();
-    pollClientRequests();
+    {
+      tick_profiler::Scope scope(tick_profiler::Phase::ClientRequests);
+      updateLeader();
+      pollClientRequests();
+    }
     if (leader_id == local_id) {
+      tick_profiler::Scope scope(tick_profiler::Phase::Proposals);
       if (unlikely(should_repropose)) {
         repropose();
       } else {
         pollProposable();
       }
     }
-    // TODO: if no progress is made... change leader!
+    if (progress_monitor) {
+      checkProgress();
+    }
   }
 
   /**
@@ -73,34 +93,8 @@ class Server {
   std::optional<std::pair<Request, bool>> pollToExecute() {
     // If we are don't have a batch, we try to fetch a new one.
     if (!batch) {
-      if (auto const opt_decision = consensus.pollDecision()) {
-        #ifdef LATENCY_HOOKS
-          if (leader_id == local_id) {
-            hooks::smr_latency.addMeasurement(hooks::Clock::now() - hooks::smr_start);
-            if (hooks::smr_latency.measured() == 30000) {
-              fmt::print("SMR LATENCY REPORT\n");
-              hooks::smr_latency.reportOnce();
-              fmt::print("SWMR READ REPORT\n");
-              hooks::swmr_read_latency.reportOnce();
-              fmt::print("SWMR WRITE REPORT\n");
-              hooks::swmr_write_latency.reportOnce();
-              fmt::print("SIG COMPUTATION REPORT\n");
-              hooks::sig_computation_latency.reportOnce();
-              fmt::print("SIG CHECK REPORT\n");
-              hooks::sig_check_latency.reportOnce();
-            }
-          }
-        #endif
-        auto [instance, new_batch, checkpoint] = *opt_decision;
-        if (unlikely(next_expected_batch != instance)) {
-          throw std::logic_error(
-              "Missed a decision and state transfer not implemented.");
-        }
-        next_expected_batch = instance + 1;
-        if (unlikely(checkpoint)) {
-          waiting_for_checkpoint_after = instance;
-        }
-        batch.emplace(new_batch, std::nullopt);
+      if (auto const new_batch = pollDecision()) {
+        batch.emplace(*new_batch, std::nullopt);
         batch->second.emplace(batch->first.requests());
       } else {
         // If no batch could be fetched...
@@ -110,6 +104,10 @@ class Server {
     // There is a current batch, let's return a request.
     auto& request_it = *batch->second;
     auto request = *request_it;
+    if (decided_log) {
+      decided_log->append(next_expected_batch - 1, request.clientId(),
+                          request.id(), request.payload(), request.size());
+    }
     ++request_it;
     if (request_it.done()) {
       batch.reset();
@@ -119,6 +117,46 @@ class Server {
     return std::make_pair(request, waiting_for_checkpoint_after.has_value());
   }
 
+  /**
+   * @brief Optionally return a whole decided batch to execute, which spares
+   *        the per-request overhead of `pollToExecute`.
+   *
+   * The batch is only valid until the next poll or tick: all its requests must
+   * be executed (and responded to via `executed`) before then. The two polling
+   * methods must not be interleaved within a batch.
+   *
+   * @return std::optional<std::pair<consensus::Batch, bool>>
+   *         first: The batch to execute.
+   *         second: Whether tha app state should be checkpointed after it.
+   */
+  std::optional<std::pair<consensus::Batch, bool>> pollBatchToExecute() {
+    if (unlikely(batch)) {
+      throw std::logic_error(
+          "Cannot poll a batch before having fully consumed the last one.");
+    }
+    if (unlikely(waiting_for_checkpoint_after)) {
+      throw std::logic_error(
+          "Cannot poll a batch before having checkpointed the app state.");
+    }
+    auto const new_batch = pollDecision();
+    if (!new_batch) {
+      return std::nullopt;
+    }
+    size_t nb_requests = 0;
+    for (auto it = new_batch->requests(); !it.done(); ++it) {
+      if (decided_log) {
+        auto const request = *it;
+        decided_log->append(next_expected_batch - 1, request.clientId(),
+                            request.id(), request.payload(), request.size());
+      }
+      nb_requests++;
+    }
+    LOGGER_DEBUG(logger, "Polled a batch of {} requests to execute.",
+                 nb_requests);
+    return std::make_pair(*new_batch,
+                          waiting_for_checkpoint_after.has_value());
+  }
+
   /**
    * @brief Respond to the client.
    *
@@ -130,6 +168,37 @@ class Server {
                        size_t const response_size) {
     rpc_server.executed(request.clientId(), request.id(), response,
                         response_size);
+    if constexpr (tracing::Enabled) {
+      auto const client = static_cast<uint32_t>(request.clientId());
+      auto const now = tracing::now();
+      tracing::record(tracing::Span::Execution, client, request.id(),
+                      decided_at, now, next_expected_batch - 1);
+      request_starts.end(tracing::Span::Request, client, request.id(), now,
+                         next_expected_batch - 1);
+    }
+  }
+
+  /**
+   * @brief Optionally return a request that clients tagged as read-only.
+   *
+   * Such requests are not ordered: they are meant to be executed right away
+   * against the current state of the app, and must not modify it.
+   */
+  inline std::optional<ReadOnlyRequest> pollReadOnly() {
+    return rpc_server.pollReadOnly();
+  }
+
+  /**
+   * @brief Respond to the client about a read-only request.
+   *
+   * @param request
+   * @param response
+   * @param response_size
+   */
+  inline void executedReadOnly(ReadOnlyRequest const& request,
+                               uint8_t const* const response,
+                               size_t const response_size) {
+    rpc_server.executedReadOnly(request, response, response_size);
   }
 
   void checkpointAppState(uint8_t const* const state_begin,
@@ -143,24 +212,129 @@ class Server {
   }
 
   void toggleSlowPath(bool const enable) {
-    // slow_path_enabled = enable;
-    // rpc_server.toggleSlowPath(enable);
+    slow_path = enable;
     consensus.toggleSlowPath(enable);
     rpc_server.toggleSlowPath(enable);
   }
 
+  /**
+   * @brief Automatically switch paths and change the leader when no progress
+   *        is made within the given timeouts.
+   *
+   * @param timeouts
+   */
+  void monitorProgress(ProgressMonitor::Timeouts const& timeouts) {
+    progress_monitor.emplace(timeouts);
+    // The leader had a whole window of instances to propose a request.
+    undecided_requests.emplace(rpc_server.minClientId(),
+                               rpc_server.nbClients(),
+                               consensus.decisionWindow());
+  }
+
+  /**
+   * @brief Record all decided requests to a file, so that their execution can
+   *        later be replayed offline.
+   *
+   * @param path of the file, which is truncated.
+   */
+  void recordDecisions(std::string const& path) {
+    decided_log = std::make_unique<DecidedLogWriter>(path);
+  }
+
+  void toggleDigestResponses(bool const enable) {
+    rpc_server.toggleDigestResponses(enable);
+  }
+
+  void acceptUdClients() { rpc_server.acceptUdClients(); }
+
   void toggleRpcOptimism(bool const optimism) {
     optimistic_rpc = optimism;
     rpc_server.toggleOptimism(optimism);
   }
 
+  /**
+   * @brief Let the leader reference requests by digest in its proposals
+   *        whenever it makes them smaller. Followers resolve them against the
+   *        requests they received from the clients.
+   *
+   * @param enable
+   */
+  void toggleDigestProposals(bool const enable) { digest_proposals = enable; }
+
  private:
+  /**
+   * @brief Fetch the next decided batch, if any.
+   *
+   */
+  std::optional<consensus::Batch> pollDecision() {
+    auto const opt_decision = consensus.pollDecision();
+    if (!opt_decision) {
+      return std::nullopt;
+    }
+    #ifdef LATENCY_HOOKS
+      if (leader_id == local_id) {
+        hooks::smr_latency.addMeasurement(hooks::Clock::now() - hooks::smr_start);
+        if (hooks::smr_latency.measured() == 30000) {
+          fmt::print("SMR LATENCY REPORT\n");
+          hooks::smr_latency.reportOnce();
+          fmt::print("SWMR READ REPORT\n");
+          hooks::swmr_read_latency.reportOnce();
+          fmt::print("SWMR WRITE REPORT\n");
+          hooks::swmr_write_latency.reportOnce();
+          fmt::print("SIG COMPUTATION REPORT\n");
+          hooks::sig_computation_latency.reportOnce();
+          fmt::print("SIG CHECK REPORT\n");
+          hooks::sig_check_latency.reportOnce();
+        }
+      }
+    #endif
+    auto [instance, new_batch, checkpoint] = *opt_decision;
+    if (unlikely(next_expected_batch != instance)) {
+      throw std::logic_error(
+          "Missed a decision and state transfer not implemented.");
+    }
+    next_expected_batch = instance + 1;
+    tick_profiler::busy();
+    size_t batch_size = 0;
+    for (auto it = new_batch.requests(); !it.done(); ++it) {
+      batch_size++;
+    }
+    decisions.add();
+    decided_requests.add(batch_size);
+    last_batch_size.set(batch_size);
+    if (progress_monitor) {
+      for (auto it = new_batch.requests(); !it.done(); ++it) {
+        auto const request = *it;
+        undecided_requests->decided(request.clientId(), request.id(),
+                                    next_expected_batch);
+      }
+      undecided_requests->expire(next_expected_batch);
+      auto const now = ProgressMonitor::Clock::now();
+      progress_monitor->progressed(ProgressMonitor::FastCommit, now);
+      progress_monitor->progressed(ProgressMonitor::Decision, now);
+    }
+    if (unlikely(checkpoint)) {
+      waiting_for_checkpoint_after = instance;
+    }
+    if constexpr (tracing::Enabled) {
+      decided_at = tracing::now();
+      for (auto it = new_batch.requests(); !it.done(); ++it) {
+        auto const request = *it;
+        proposal_starts.end(tracing::Span::Consensus,
+                            static_cast<uint32_t>(request.clientId()),
+                            request.id(), decided_at, instance);
+      }
+    }
+    return new_batch;
+  }
+
   /**
    * @brief Poll requests received in RPC to participate on them in consensus.
    *
    */
   void pollClientRequests() {
     while (auto const opt_request = rpc_server.pollReceived()) {
+      tick_profiler::busy();
       auto const& request = opt_request->get();
       LOGGER_DEBUG(logger, "Will accept request {} from {}.", request.id(),
                    request.clientId());
@@ -170,7 +344,15 @@ class Server {
                     "Won't accept the new request {} from {} as it could drop "
                     "(undecided) promises.",
                     request.id(), request.clientId());
+        continue;
       }
+      request_starts.begin(static_cast<uint32_t>(request.clientId()),
+                           request.id());
+      if (progress_monitor) {
+        undecided_requests->accepted(request.clientId(), request.id(),
+                                     next_expected_batch);
+      }
+      unproposed_requests++;
     }
   }
 
@@ -186,26 +368,44 @@ class Server {
     if (!to_propose.empty()) {
       to_propose.clear();
     }
-    size_t batch_buffer_size = 0;
+    size_t batch_buffer_size = consensus::Batch::headerSize();
     while (to_propose.size() < to_propose.capacity()) {
       auto const opt_request = rpc_server.pollProposable();
       if (!opt_request) {
         break;
       }
       LOGGER_DEBUG(logger, "Will propose {}.", opt_request->get().id());
+      if (unproposed_requests > 0) {
+        unproposed_requests--;
+      }
       batch_buffer_size += Request::bufferSize(opt_request->get().size());
+      proposal_starts.begin(
+          static_cast<uint32_t>(opt_request->get().clientId()),
+          opt_request->get().id());
       to_propose.push_back(*opt_request);
     }
     if (!to_propose.empty()) {
+      tick_profiler::busy();
+      if (progress_monitor) {
+        progress_monitor->progressed(ProgressMonitor::Echo,
+                                     ProgressMonitor::Clock::now());
+      }
       #ifdef LATENCY_HOOKS
         hooks::smr_start = hooks::Clock::now();
       #endif
-      auto opt_batch =
-          consensus.getSlot(consensus::Consensus::Size(batch_buffer_size));
+      // Referencing requests by digest only pays off for large requests.
+      auto const digests_buffer_size =
+          consensus::Batch::digestsBufferSize(to_propose.size());
+      auto const use_digests =
+          digest_proposals && digests_buffer_size < batch_buffer_size;
+      auto opt_batch = consensus.getSlot(
+          consensus::Consensus::Size(use_digests ? digests_buffer_size
+                                                 : batch_buffer_size),
+          use_digests ? consensus::Batch::Digests : consensus::Batch::Inline);
       if (unlikely(!opt_batch)) {
         throw std::logic_error("Was checked just before, should not throw.");
       }
-      // We copy each request in the new batch to propose.
+      // We copy each request (or its digest) in the new batch to propose.
       auto& batch = *opt_batch;
       auto batch_it = batch.requests();
       for (auto const& request_ref : to_propose) {
@@ -217,7 +417,12 @@ class Server {
         batch_request.clientId() = request.clientId();
         batch_request.id() = request.id();
         batch_request.size() = request.size();
-        std::copy(request.begin(), request.end(), batch_request.begin());
+        if (use_digests) {
+          batch_request.digest() =
+              crypto::hash::blake3(request.begin(), request.end());
+        } else {
+          std::copy(request.begin(), request.end(), batch_request.begin());
+        }
         ++batch_it;
       }
       if (unlikely(!batch_it.done())) {
@@ -233,7 +438,63 @@ class Server {
    *        yielded a WaitCheckpoint last time.
    *
    */
-  void repropose() { propose(); }
+  void repropose() {
+    if (consensus.canPropose()) {
+      propose();
+    }
+  }
+
+  /**
+   * @brief Follow the leader of the view consensus is in, as views can be
+   *        changed by any replica.
+   *
+   */
+  void updateLeader() {
+    auto const current_leader = consensus.currentLeader();
+    if (likely(current_leader == leader_id)) {
+      return;
+    }
+    LOGGER_INFO(logger, "Leader changed from {} to {}.", leader_id,
+                current_leader);
+    leader_id = current_leader;
+    rpc_server.setLeader(leader_id);
+    should_repropose = false;
+    unproposed_requests = 0;
+    // The new leader is only accountable for the requests it receives: those
+    // the previous one never decided would otherwise keep changing views.
+    if (undecided_requests) {
+      undecided_requests->clear();
+    }
+  }
+
+  /**
+   * @brief Feed the progress monitor and apply its decision.
+   *
+   */
+  void checkProgress() {
+    auto& monitor = *progress_monitor;
+    auto const now = ProgressMonitor::Clock::now();
+    monitor.pending(ProgressMonitor::Echo,
+                    leader_id == local_id && unproposed_requests > 0, now);
+    monitor.pending(ProgressMonitor::FastCommit, consensus.awaitingDecision(),
+                    now);
+    monitor.pending(ProgressMonitor::Decision, !undecided_requests->empty(),
+                    now);
+    switch (monitor.poll(slow_path, now)) {
+      case ProgressMonitor::SwitchToSlowPath:
+        toggleSlowPath(true);
+        break;
+      case ProgressMonitor::ChangeView:
+        consensus.changeView();
+        updateLeader();
+        break;
+      case ProgressMonitor::SwitchToFastPath:
+        toggleSlowPath(false);
+        break;
+      default:
+        break;
+    }
+  }
 
   /**
    * @brief Propose prepared consensus slots and handle errors.
@@ -264,6 +525,16 @@ class Server {
       to_propose;  // Defined here to not allocate dynamically
 
   bool optimistic_rpc = false;
+  bool digest_proposals = false;
+  bool slow_path = false;
+
+  std::optional<ProgressMonitor> progress_monitor;
+  std::unique_ptr<DecidedLogWriter> decided_log;
+  // Requests accepted in the current view but not yet decided, only tracked
+  // along with the progress.
+  std::optional<UndecidedRequests> undecided_requests;
+  // Requests received (as the leader) but not yet proposable.
+  size_t unproposed_requests = 0;
 
   consensus::Instance next_expected_batch = 0;
   std::optional<consensus::Instance> waiting_for_checkpoint_after;
@@ -272,6 +543,21 @@ class Server {
   std::optional<
       std::pair<consensus::Batch, std::optional<consensus::Batch::Iterator>>>
       batch;
+
+  // Per-request tracing (only compiled in with TRACING).
+  static size_t constexpr TracedRequests = 1 << 12;
+  tracing::Starts request_starts{TracedRequests};
+  tracing::Starts proposal_starts{TracedRequests};
+  uint64_t decided_at = 0;
+
+  // decided_requests / decisions gives the average batch size.
+  metrics::Counter decisions =
+      metrics::Registry::instance().counter("smr.decisions");
+  metrics::Counter decided_requests =
+      metrics::Registry::instance().counter("smr.decided_requests");
+  metrics::Gauge last_batch_size =
+      metrics::Registry::instance().gauge("smr.batch_size");
+
   LOGGER_DECL_INIT(logger, "UbftServer");
 };
 
@@ -24,7 +24,8 @@ class HostBuilder : Builder<Host> {
   HostBuilder(dory::ctrl::ControlBlock &cb, ProcId const host_id,
               ProcId const owner_id, std::vector<ProcId> const &remote_ids,
               std::string const &identifier, size_t const nb_registers,
-              size_t const value_size)
+              size_t const value_size,
+              Layout const layout = Layout::DoubleSubslot)
       : owner_id{owner_id},
         remote_ids{remote_ids},
         uuid{
@@ -36,8 +37,9 @@ class HostBuilder : Builder<Host> {
         nb_registers(nb_registers),
         value_size(value_size) {
     // initialize memory
-    fmt::print("[DISAG. MEMORY ALLOCATED]: {}B\n", Host::bufferSize(nb_registers, value_size));
-    cb.allocateBuffer(uuid, Host::bufferSize(nb_registers, value_size), 64);
+    auto const buffer_size = Host::bufferSize(nb_registers, value_size, layout);
+    fmt::print("[DISAG. MEMORY ALLOCATED]: {}B\n", buffer_size);
+    cb.allocateBuffer(uuid, buffer_size, 64);
     cb.registerMr(uuid + "-read", "standard", uuid, ReadMemoryRights);
     cb.registerMr(uuid + "-write", "standard", uuid, WriteMemoryRights);
 
@@ -6,21 +6,73 @@
 
 namespace dory::ubft::swmr {
 
+/**
+ * @brief How registers are laid out in the memory of the host.
+ *
+ * DoubleSubslot: each register holds two subslots written alternately, each
+ * prefixed by a hashed Header. Readers READ both and keep the latest valid
+ * one, so a READ never needs to be retried.
+ *
+ * Seqlock: each register holds a single copy of the value fenced by its
+ * incarnation number at both ends, i.e., in its first and last cache lines.
+ * A READ is consistent iff both fences match: no hashing is needed, but a
+ * READ concurrent with a WRITE is torn and must be retried. It relies on the
+ * NIC placing (and reading) payloads in increasing address order at
+ * cache-line granularity, hence it is limited to registers of at most two
+ * cache lines.
+ */
+enum class Layout { DoubleSubslot, Seqlock };
+
 class Host {
  public:
+  using Fence = Header::Incarnation;
+  static size_t constexpr CacheLineSize = 64;
+  static size_t constexpr SeqlockMaxValueSize =
+      2 * CacheLineSize - 2 * sizeof(Fence);
+
   static size_t constexpr bufferSize(size_t const nb_registers,
-                                     size_t const value_size) {
-    return registerSize(value_size) * nb_registers;
+                                     size_t const value_size,
+                                     Layout const layout =
+                                         Layout::DoubleSubslot) {
+    return registerSize(value_size, layout) * nb_registers;
   }
 
-  static size_t constexpr registerSize(size_t const value_size) {
-    return subslotSize(value_size) * 2;
+  static size_t constexpr registerSize(size_t const value_size,
+                                       Layout const layout =
+                                           Layout::DoubleSubslot) {
+    return subslotSize(value_size, layout) * subslots(layout);
   }
 
-  static size_t constexpr subslotSize(size_t const value_size) {
+  static size_t constexpr subslotSize(size_t const value_size,
+                                      Layout const layout =
+                                          Layout::DoubleSubslot) {
+    if (layout == Layout::Seqlock) {
+      // Rounded up to whole cache lines so that the fences are in the first
+      // and last cache lines of the register.
+      return (value_size + 2 * sizeof(Fence) + CacheLineSize - 1) /
+             CacheLineSize * CacheLineSize;
+    }
     return sizeof(Header) + value_size;
   }
 
+  static size_t constexpr subslots(Layout const layout) {
+    return layout == Layout::Seqlock ? 1 : 2;
+  }
+
+  /**
+   * @brief Offset of the value within a subslot.
+   */
+  static size_t constexpr valueOffset(Layout const layout) {
+    return layout == Layout::Seqlock ? sizeof(Fence) : sizeof(Header);
+  }
+
+  /**
+   * @brief Offset of the trailing fence within a Seqlock register.
+   */
+  static size_t constexpr tailFenceOffset(size_t const value_size) {
+    return subslotSize(value_size, Layout::Seqlock) - sizeof(Fence);
+  }
+
   /**
    * @brief Useless for now as Hosts are totally passive. We could make them
    *        initialize memory in the future.
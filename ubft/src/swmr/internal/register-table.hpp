@@ -0,0 +1,169 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include <dory/shared/branching.hpp>
+
+#include "../header.hpp"
+
+namespace dory::ubft::swmr::internal {
+
+/**
+ * @brief Tracks the state of the registers of a Reader and the READs of
+ *        register ranges that are queued or outstanding, independently of
+ *        the RDMA connection.
+ *
+ * A register goes from Free to Reading when a READ of its range is queued,
+ * then to Completed once the READ was validated and back to Free when
+ * released. Each range is fetched by a single READ; only the last READ of
+ * each chain posted is signaled.
+ */
+class RegisterTable {
+ public:
+  using Index = size_t;
+  using Incarnation = Header::Incarnation;
+  using Clock = std::chrono::steady_clock;
+
+  struct Register {
+    enum State : uint8_t { Free, Reading, Completed };
+    State state = Free;
+    uint8_t subslot = 0;
+    Incarnation incarnation = 0;
+  };
+
+  struct Range {
+    Index index;
+    size_t count;
+  };
+
+  RegisterTable(size_t const nb_registers, size_t const max_outstanding)
+      : max_outstanding{max_outstanding}, registers(nb_registers) {}
+
+  Register const &operator[](Index const index) const {
+    return registers[index];
+  }
+
+  /**
+   * @brief Queue a single READ of `count` consecutive registers if none of
+   *        them is being read or waiting to be released.
+   *
+   * @return std::optional<Index> the first register of the range, if queued.
+   */
+  std::optional<Index> queue(Index const index, size_t const count) {
+    if (unlikely(count == 0 || index + count > registers.size())) {
+      throw std::invalid_argument(
+          fmt::format("Cannot read registers [{}, {}) out of {}.", index,
+                      index + count, registers.size()));
+    }
+    for (size_t i = index; i < index + count; i++) {
+      if (registers[i].state != Register::Free) {
+        return std::nullopt;
+      }
+    }
+    for (size_t i = index; i < index + count; i++) {
+      registers[i].state = Register::Reading;
+    }
+    queued.push_back({index, count});
+    return index;
+  }
+
+  /**
+   * @brief Queue the READ of a register again, e.g., because it was torn.
+   */
+  void retry(Index const index) { queued.push_back({index, 1}); }
+
+  void complete(Index const index, uint8_t const subslot,
+                Incarnation const incarnation) {
+    auto &reg = registers[index];
+    reg.state = Register::Completed;
+    reg.subslot = subslot;
+    reg.incarnation = incarnation;
+  }
+
+  void release(Index const index) {
+    auto &reg = registers[index];
+    if (reg.state != Register::Completed) {
+      throw std::runtime_error("Job not found in completed set.");
+    }
+    reg.state = Register::Free;
+  }
+
+  bool hasQueued() const { return !queued.empty(); }
+
+  size_t outstanding() const { return outstanding_reads.size(); }
+
+  /**
+   * @brief Move as many queued READs as possible to the outstanding ones,
+   *        calling `f(range)` for each of them. The last one is signaled.
+   *
+   * @return the number of READs dequeued.
+   */
+  template <typename F>
+  size_t dequeue(Clock::time_point const now, F &&f) {
+    size_t dequeued = 0;
+    while (outstanding_reads.size() < max_outstanding && !queued.empty()) {
+      auto const range = queued.front();
+      queued.pop_front();
+      f(range);
+      outstanding_reads.push_back({range, now, false});
+      dequeued++;
+    }
+    if (dequeued != 0) {
+      outstanding_reads.back().signaled = true;
+    }
+    return dequeued;
+  }
+
+  /**
+   * @brief Account for the signaled completion of the READ of the range that
+   *        starts at `index`, which implies the completion of the unsignaled
+   *        ones posted before it. Calls `validate(index, start)` for every
+   *        register they read.
+   */
+  template <typename F>
+  void completed(Index const index, F &&validate) {
+    while (true) {
+      if (outstanding_reads.empty()) {
+        throw std::runtime_error(fmt::format(
+            "Polling returned job_handle: {}, which was not outstanding",
+            index));
+      }
+      auto const read = outstanding_reads.front();
+      outstanding_reads.pop_front();
+      for (size_t i = 0; i < read.range.count; i++) {
+        validate(read.range.index + i, read.start);
+      }
+      if (read.signaled) {
+        if (index != read.range.index) {
+          throw std::runtime_error(fmt::format(
+              "Polling returned job_handle: {}, I was expecting job_handle:  "
+              "{}",
+              index, read.range.index));
+        }
+        return;
+      }
+    }
+  }
+
+ private:
+  struct OutstandingRead {
+    Range range;
+    Clock::time_point start;
+    bool signaled;
+  };
+
+  size_t const max_outstanding;
+  std::vector<Register> registers;
+  std::deque<Range> queued;
+  std::deque<OutstandingRead> outstanding_reads;
+};
+
+}  // namespace dory::ubft::swmr::internal
@@ -12,6 +12,7 @@
 #include <dory/memstore/store.hpp>
 
 #include "../builder.hpp"
+#include "../completion-dispatcher.hpp"
 #include "../types.hpp"
 #include "host.hpp"
 #include "internal/exchanger-role.hpp"
@@ -25,7 +26,8 @@ class ReaderBuilder : Builder<Reader> {
                 ProcId const owner_id, ProcId const host_id,
                 std::string const &identifier,
                 // params for Reader constructor
-                size_t const nb_registers, size_t const value_size)
+                size_t const nb_registers, size_t const value_size,
+                Layout const layout = Layout::DoubleSubslot)
       : host_id{host_id},
         uuid{fmt::format("swmr-reader-{}-H{}-O{}", identifier, host_id,
                          owner_id)},
@@ -34,13 +36,15 @@ class ReaderBuilder : Builder<Reader> {
         exchanger{
             local_id, {host_id}, cb, internal::READER_WRITER, internal::HOST},
         nb_registers(nb_registers),
-        value_size(value_size) {
+        value_size(value_size),
+        layout{layout} {
     // initialize memory
-    cb.allocateBuffer(uuid, Host::bufferSize(nb_registers, value_size), 64);
+    cb.allocateBuffer(uuid, Host::bufferSize(nb_registers, value_size, layout),
+                      64);
     cb.registerMr(uuid, "standard", uuid, LocalMemoryRights);
-    cb.registerCq(uuid);
+    auto const cq = completion_binding.registerCq(cb, uuid);
     // initialize qp
-    exchanger.configure(host_id, "standard", uuid, uuid, uuid);
+    exchanger.configure(host_id, "standard", uuid, cq, cq);
   }
 
   void announceQps() override {
@@ -55,7 +59,8 @@ class ReaderBuilder : Builder<Reader> {
 
   Reader build() override {
     building();
-    return Reader(nb_registers, value_size, exchanger.extract(host_id));
+    return Reader(nb_registers, value_size, exchanger.extract(host_id), layout,
+                  completion_binding.subscribe(CompletionKind::SwmrReader));
   }
 
  private:
@@ -69,6 +74,8 @@ class ReaderBuilder : Builder<Reader> {
 
   size_t const nb_registers;
   size_t const value_size;
+  Layout const layout;
+  CompletionBinding completion_binding;
 
   auto static constexpr LocalMemoryRights =
       dory::ctrl::ControlBlock::LOCAL_READ |
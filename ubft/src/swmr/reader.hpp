@@ -2,10 +2,10 @@
 
 #include <chrono>
 #include <cstdint>
-#include <deque>
+#include <cstring>
 #include <optional>
-#include <tuple>
-#include <unordered_map>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 #include <fmt/core.h>
@@ -13,13 +13,30 @@
 
 #include <dory/conn/rc.hpp>
 #include <dory/ctrl/block.hpp>
+#include <dory/shared/branching.hpp>
 
+#include "../completion-dispatcher.hpp"
 #include "constants.hpp"
 #include "header.hpp"
 #include "host.hpp"
+#include "internal/register-table.hpp"
 
 namespace dory::ubft::swmr {
 
+/**
+ * @brief Reads registers of a remote SWMR array.
+ *
+ * Each register is READ into its own local buffer (i.e., the local buffer of
+ * register i is at offset i * registerSize) so that consecutive registers can
+ * be fetched with a single READ. The state of each register is tracked in a
+ * fixed-size table indexed by the register index. A register cannot be read
+ * again before its previous read was released.
+ *
+ * READs are only queued by `read`/`readRange`, they are posted (as a single
+ * chain of WRs, i.e., with a single doorbell) by `post` or `tick`.
+ *
+ * With the Seqlock layout, torn READs are transparently retried.
+ */
 class Reader {
   static size_t constexpr MaxOutstandingReads =
       conn::ReliableConnection::WrDepth;
@@ -32,29 +49,38 @@ class Reader {
   using PollResult = std::optional<std::pair<void *, Incarnation>>;
 
   Reader(size_t const nb_registers, size_t const value_size,
-         conn::ReliableConnection &&rc)
+         conn::ReliableConnection &&rc,
+         Layout const layout = Layout::DoubleSubslot,
+         Completions completions = {})
       : nb_registers{nb_registers},
         value_size{value_size},
-        subslot_size{Host::subslotSize(value_size)},
-        register_size{Host::registerSize(value_size)},
-        rc{std::move(rc)} {
-    if (this->rc.remoteSize() < Host::bufferSize(nb_registers, value_size)) {
+        layout{layout},
+        subslot_size{Host::subslotSize(value_size, layout)},
+        register_size{Host::registerSize(value_size, layout)},
+        rc{std::move(rc)},
+        completions{completions},
+        table(nb_registers, MaxOutstandingReads) {
+    if (layout == Layout::Seqlock && value_size > Host::SeqlockMaxValueSize) {
+      throw std::invalid_argument(fmt::format(
+          "Seqlock registers hold at most {}B, {}B requested.",
+          Host::SeqlockMaxValueSize, value_size));
+    }
+    auto const buffer_size = Host::bufferSize(nb_registers, value_size, layout);
+    if (this->rc.remoteSize() < buffer_size) {
       throw std::runtime_error(fmt::format(
           "Remote MR too small to host {} registers: {} given, {} required.",
-          nb_registers, this->rc.remoteSize(),
-          Host::bufferSize(nb_registers, value_size)));
+          nb_registers, this->rc.remoteSize(), buffer_size));
     }
-
-    // Store the pointers to register starts in my local memory.
-    // Use these pointers as data destination for RDMA READs.
-    auto const nb_buffers = this->rc.getMr().size / register_size;
-    for (size_t i = 0; i < nb_buffers; i++) {
-      buffer_pool.emplace_back(this->rc.getMr().addr + i * register_size);
+    if (this->rc.getMr().size < buffer_size) {
+      throw std::runtime_error(fmt::format(
+          "Local MR too small to read {} registers: {} given, {} required.",
+          nb_registers, this->rc.getMr().size, buffer_size));
     }
 
     // Note: The available space for WCs may be less than WrDepth if
     // the CQ has many users (i.e., is shared among many QPs).
     wcs.reserve(MaxOutstandingReads);
+    ops.reserve(MaxOutstandingReads);
   }
 
   /**
@@ -62,52 +88,71 @@ class Reader {
    *
    * @param index of the register in the register array
    * @return std::optional<JobHandle> nullopt if was not possible to schedule
-   * the READ (due to lack local storage buffer for READs) or a handle of where
-   * the READ will place the data
+   * the READ (as the previous READ of the register was not released) or a
+   * handle to poll the READ
    */
   std::optional<JobHandle> read(Index const index) {
-    if (buffer_pool.empty()) {
-      return std::nullopt;
-    }
-    auto const buffer = buffer_pool.back();
-    buffer_pool.pop_back();
-    queued_reads.emplace_back(buffer, index);
-    pushToQp();
-    return buffer;
+    return readRange(index, 1);
+  }
+
+  /**
+   * @brief Schedule a single READ of `count` consecutive registers if possible.
+   *        Each register is validated (and then polled/released) on its own:
+   *        the handle of register `index + i` is the returned handle + i.
+   *
+   * @param index of the first register in the register array
+   * @param count of registers, the range must not wrap around the array
+   * @return std::optional<JobHandle> nullopt if one of the registers is still
+   *         being read or was not released
+   */
+  std::optional<JobHandle> readRange(Index const index, size_t const count) {
+    return table.queue(index, count);
   }
 
   PollResult poll(JobHandle const job_handle) {
-    auto const find_it = completed_reads.find(job_handle);
-    if (find_it == completed_reads.end()) {
+    auto const &reg = table[job_handle];
+    if (reg.state != Register::Completed) {
       return std::nullopt;
     }
-    return find_it->second;
+    return std::make_pair(
+        reinterpret_cast<void *>(localRegister(job_handle) +
+                                 subslot_size * reg.subslot +
+                                 Host::valueOffset(layout)),
+        reg.incarnation);
   }
 
-  void release(JobHandle job_handle) {
-    auto const find_it = completed_reads.find(job_handle);
-    if (find_it == completed_reads.end()) {
-      throw std::runtime_error("Job not found in completed set.");
-    }
-    buffer_pool.push_back(job_handle);
-    completed_reads.erase(find_it);
-  }
+  void release(JobHandle job_handle) { table.release(job_handle); }
+
+  /**
+   * @brief Post all the queued READs at once.
+   *
+   */
+  void post() { pushToQp(); }
 
   void tick() {
-    if (!outstanding_reads.empty()) {
+    if (table.outstanding() != 0) {
       pollCompletion();
-      pushToQp();
     }
+    pushToQp();
   }
 
   size_t nbRegisters() const { return nb_registers; }
 
   size_t valueSize() const { return value_size; }
 
+  Layout registerLayout() const { return layout; }
+
  private:
+  using RegisterTable = internal::RegisterTable;
+  using Register = RegisterTable::Register;
+
+  uintptr_t localRegister(Index const index) const {
+    return rc.getMr().addr + index * register_size;
+  }
+
   void pollCompletion() {
-    wcs.resize(outstanding_reads.size());
-    if (!rc.pollCqIsOk(conn::ReliableConnection::SendCq, wcs)) {
+    wcs.resize(table.outstanding());
+    if (!completions.poll(rc, wcs)) {
       throw std::runtime_error("Error while polling CQ.");
     }
     for (auto const &wc : wcs) {
@@ -117,94 +162,117 @@ class Reader {
             fmt::format("Error in RDMA READ: {}", wc.status));
       }
 
-      auto const job_handle = wc.wr_id;
-
-      auto const [expected_job_handle, index, start] =
-          outstanding_reads.front();
-      outstanding_reads.pop_front();
-
-      if (job_handle != expected_job_handle) {
-        throw std::runtime_error(fmt::format(
-            "Polling returned job_handle: {}, I was expecting job_handle:  {}",
-            job_handle, expected_job_handle));
-      }
+      // Only the last READ of each chain is signaled, its completion implies
+      // the completion of the previous ones.
+      table.completed(wc.wr_id,
+                      [this](Index const index,
+                             RegisterTable::Clock::time_point const start) {
+                        validate(index, start);
+                      });
+    }
+  }
 
-      // Check if at least one subslot is good.
-      // Return the most up-to-date subslot
-      // If both subslots are bad, we need to check the timestamp before
-      // declaring the writer as Byzantine.
-
-      std::optional<std::pair<Incarnation, size_t>> best_subslot;
-      for (size_t subslot = 0; subslot < 2; subslot++) {
-        auto const base_ptr = job_handle + subslot_size * subslot;
-        auto *const header = reinterpret_cast<Header *>(base_ptr);
-        // It's important that the data follows right after the Header, i.e.,
-        // the Header is packed.
-        if (header->hash ==
-            XXH3_64bits(&header->incarnation,
-                        sizeof(Header::incarnation) + value_size)) {
-          if (!best_subslot || best_subslot->first < header->incarnation) {
-            best_subslot.emplace(static_cast<Incarnation>(header->incarnation),
-                                 subslot);
-          }
+  void validate(Index const index,
+                std::chrono::steady_clock::time_point const start) {
+    if (layout == Layout::Seqlock) {
+      validateSeqlock(index);
+      return;
+    }
+    // Check if at least one subslot is good.
+    // Return the most up-to-date subslot
+    // If both subslots are bad, we need to check the timestamp before
+    // declaring the writer as Byzantine.
+    std::optional<std::pair<Incarnation, size_t>> best_subslot;
+    for (size_t subslot = 0; subslot < 2; subslot++) {
+      auto const base_ptr = localRegister(index) + subslot_size * subslot;
+      auto *const header = reinterpret_cast<Header *>(base_ptr);
+      // It's important that the data follows right after the Header, i.e.,
+      // the Header is packed.
+      if (header->hash ==
+          XXH3_64bits(&header->incarnation,
+                      sizeof(Header::incarnation) + value_size)) {
+        if (!best_subslot || best_subslot->first < header->incarnation) {
+          best_subslot.emplace(static_cast<Incarnation>(header->incarnation),
+                               subslot);
         }
       }
+    }
 
-      if (best_subslot) {
-        completed_reads.try_emplace(
-            job_handle,
-            reinterpret_cast<void *>(job_handle +
-                                     subslot_size * best_subslot->second +
-                                     sizeof(Header)),
-            best_subslot->first -
-                2);  // -2 is because of initialization in which we write twice
-        continue;
-      }
+    if (best_subslot) {
+      // -2 is because of initialization in which we write twice
+      table.complete(index, static_cast<uint8_t>(best_subslot->second),
+                     best_subslot->first - 2);
+      return;
+    }
 
-      if (start + constants::WriteCooldown < std::chrono::steady_clock::now()) {
-        // The read took too long, we need to reschedule it.
-        queued_reads.emplace_back(job_handle, index);
-      } else {
-        // TODO(Antoine): the guy is Byzantine.
-        throw std::runtime_error(
-            "Byzantine behavior detected, we should handle it.");
-      }
+    if (start + constants::WriteCooldown < std::chrono::steady_clock::now()) {
+      // The read took too long, we need to reschedule it.
+      table.retry(index);
+    } else {
+      // TODO(Antoine): the guy is Byzantine.
+      throw std::runtime_error(
+          "Byzantine behavior detected, we should handle it.");
+    }
+  }
+
+  void validateSeqlock(Index const index) {
+    auto const *const base =
+        reinterpret_cast<uint8_t const *>(localRegister(index));
+    Host::Fence head;
+    Host::Fence tail;
+    memcpy(&head, base, sizeof(head));
+    memcpy(&tail, base + Host::tailFenceOffset(value_size), sizeof(tail));
+
+    // Fences start at 0 and the writer initializes registers by writing them
+    // once, so 0 means that the register was not initialized yet: unlike an
+    // incarnation of UINT64_MAX, it is worth reading again.
+    if (likely(head == tail && head != 0)) {
+      // -1 is because of initialization in which we write once
+      table.complete(index, 0, head - 1);
+      return;
     }
+
+    // The READ overlapped a WRITE (or preceded the initialization), we retry
+    // it. A Byzantine writer can only delay the READs of its own registers
+    // this way.
+    table.retry(index);
   }
 
   void pushToQp() {
-    while (outstanding_reads.size() < MaxOutstandingReads &&
-           !queued_reads.empty()) {
-      auto const [job_handle, index] = queued_reads.front();
-      queued_reads.pop_front();
-      auto *const local_buffer = reinterpret_cast<void *>(job_handle);
-      auto const before_post = std::chrono::steady_clock::now();
-      auto const posted =
-          rc.postSendSingle(conn::ReliableConnection::RdmaReq::RdmaRead,
-                            reinterpret_cast<uint64_t>(job_handle),
-                            local_buffer, static_cast<uint32_t>(register_size),
-                            rc.remoteBuf() + index * register_size);
-      if (!posted) {
-        throw std::runtime_error(
-            "Failed to post read");  // Todo: consider as having failed.
-      }
-      outstanding_reads.emplace_back(job_handle, index, before_post);
+    if (likely(!table.hasQueued())) {
+      return;
+    }
+    ops.clear();
+    table.dequeue(RegisterTable::Clock::now(),
+                  [this](RegisterTable::Range const &range) {
+                    ops.push_back(
+                        {completions.wrId(range.index),
+                         reinterpret_cast<void *>(localRegister(range.index)),
+                         static_cast<uint32_t>(range.count * register_size),
+                         rc.remoteBuf() + range.index * register_size, false});
+                  });
+    if (ops.empty()) {
+      return;
+    }
+    ops.back().signaled = true;
+    if (!rc.postSendMany(conn::ReliableConnection::RdmaReq::RdmaRead,
+                         ops.data(), ops.size())) {
+      throw std::runtime_error(
+          "Failed to post read");  // Todo: consider as having failed.
     }
   }
 
   size_t const nb_registers;
   size_t const value_size;
+  Layout const layout;
   size_t const subslot_size;
   size_t const register_size;
   conn::ReliableConnection rc;
+  Completions completions;
 
-  std::vector<JobHandle> buffer_pool;
-  std::deque<std::pair<JobHandle, Index>> queued_reads;
-  std::deque<
-      std::tuple<JobHandle, Index, std::chrono::steady_clock::time_point>>
-      outstanding_reads;
-  std::unordered_map<JobHandle, std::pair<void *, Incarnation>> completed_reads;
+  RegisterTable table;
 
+  std::vector<conn::ReliableConnection::RdmaOp> ops;
   std::vector<struct ibv_wc> wcs;
 };
 
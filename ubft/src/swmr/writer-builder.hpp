@@ -12,6 +12,7 @@
 #include <dory/memstore/store.hpp>
 
 #include "../builder.hpp"
+#include "../completion-dispatcher.hpp"
 #include "../types.hpp"
 #include "host.hpp"
 #include "internal/exchanger-role.hpp"
@@ -25,7 +26,8 @@ class WriterBuilder : Builder<Writer> {
                 ProcId const host_id, std::string const &identifier,
                 // params for Writer constructor
                 size_t const nb_registers, size_t const value_size,
-                bool const allow_custom_incarnation = false)
+                bool const allow_custom_incarnation = false,
+                Layout const layout = Layout::DoubleSubslot)
       : host_id{host_id},
         uuid{fmt::format("swmr-writer-{}-H{}-O{}", identifier, host_id,
                          owner_id)},
@@ -35,13 +37,15 @@ class WriterBuilder : Builder<Writer> {
             owner_id, {host_id}, cb, internal::READER_WRITER, internal::HOST},
         nb_registers(nb_registers),
         value_size(value_size),
-        allow_custom_incarnation{allow_custom_incarnation} {
+        allow_custom_incarnation{allow_custom_incarnation},
+        layout{layout} {
     // initialize memory
-    cb.allocateBuffer(uuid, Host::bufferSize(nb_registers, value_size), 64);
+    cb.allocateBuffer(uuid, Host::bufferSize(nb_registers, value_size, layout),
+                      64);
     cb.registerMr(uuid, "standard", uuid, LocalMemoryRights);
-    cb.registerCq(uuid);
+    auto const cq = completion_binding.registerCq(cb, uuid);
     // initialize qp
-    exchanger.configure(host_id, "standard", uuid, uuid, uuid);
+    exchanger.configure(host_id, "standard", uuid, cq, cq);
   }
 
   void announceQps() override {
@@ -57,7 +61,8 @@ class WriterBuilder : Builder<Writer> {
   Writer build() override {
     building();
     return Writer(nb_registers, value_size, exchanger.extract(host_id),
-                  allow_custom_incarnation);
+                  allow_custom_incarnation, layout,
+                  completion_binding.subscribe(CompletionKind::SwmrWriter));
   }
 
  private:
@@ -71,6 +76,8 @@ class WriterBuilder : Builder<Writer> {
   size_t const nb_registers;
   size_t const value_size;
   bool const allow_custom_incarnation;
+  Layout const layout;
+  CompletionBinding completion_binding;
 
   auto static constexpr LocalMemoryRights =
       dory::ctrl::ControlBlock::LOCAL_READ |
@@ -2,8 +2,10 @@
 
 #include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <deque>
 #include <optional>
+#include <stdexcept>
 #include <tuple>
 #include <unordered_map>
 #include <vector>
@@ -15,6 +17,7 @@
 #include <dory/ctrl/block.hpp>
 #include <dory/shared/branching.hpp>
 
+#include "../completion-dispatcher.hpp"
 #include "../unsafe-at.hpp"
 #include "constants.hpp"
 #include "header.hpp"
@@ -24,36 +27,46 @@ namespace dory::ubft::swmr {
 
 class Writer {
   struct Register {
-    Register(uintptr_t const buffer) noexcept
+    Register(uintptr_t const buffer, Layout const layout) noexcept
         : raw_buffer{reinterpret_cast<void *>(buffer)},
-          content{reinterpret_cast<void *>(buffer + sizeof(Header))},
-          header{*reinterpret_cast<Header *>(buffer)} {
-      header.incarnation = 0;
+          content{reinterpret_cast<void *>(buffer +
+                                           Host::valueOffset(layout))},
+          header{*reinterpret_cast<Header *>(buffer)},
+          init_writes{static_cast<Header::Incarnation>(
+              Host::subslots(layout))} {
+      if (layout == Layout::DoubleSubslot) {
+        header.incarnation = 0;
+      }
     }
 
-    void incrementIncarnation() { ++header.incarnation; }
+    void incrementIncarnation() { ++incarnation; }
 
     void setIncarnation(Header::Incarnation const custom_incarnation) {
-      // The writer initializes the remote memory by writing twice to it, hence
-      // introducing an offset of 2 between the expected incarnation number and
-      // the underlying one.
-      auto const real_ci = custom_incarnation + 2;
-      if (unlikely(real_ci <= header.incarnation)) {
+      // The writer initializes the remote memory by writing once to each
+      // subslot, hence introducing an offset of `init_writes` between the
+      // expected incarnation number and the underlying one.
+      auto const real_ci = custom_incarnation + init_writes;
+      if (unlikely(real_ci <= incarnation)) {
         throw std::runtime_error(fmt::format(
             "Incarnation numbers must be monotonic; new: {}, previous: {}.",
-            custom_incarnation, header.incarnation - 2));
+            custom_incarnation, incarnation - init_writes));
       }
-      header.incarnation = real_ci;
+      incarnation = real_ci;
     }
 
-    void changeRemoteSubslot() { remote_subslot = (remote_subslot + 1) % 2; }
+    void changeRemoteSubslot() {
+      remote_subslot = (remote_subslot + 1) % init_writes;
+    }
 
     void *const raw_buffer;
     void *const content;
     bool scheduled = false;
     std::optional<std::chrono::steady_clock::time_point> last_write;
     std::size_t remote_subslot = 0;
+    // Only meaningful with the DoubleSubslot layout.
     Header &header;
+    Header::Incarnation const init_writes;
+    Header::Incarnation incarnation = 0;
   };
 
  public:
@@ -74,32 +87,42 @@ class Writer {
 
   Writer(size_t const nb_registers, size_t const value_size,
          conn::ReliableConnection &&rc,
-         bool const allow_custom_incarnation = false)
+         bool const allow_custom_incarnation = false,
+         Layout const layout = Layout::DoubleSubslot,
+         Completions completions = {})
       : nb_registers{nb_registers},
         value_size{value_size},
-        register_size{Host::subslotSize(value_size)},
-        remote_register_size{Host::registerSize(value_size)},
+        layout{layout},
+        register_size{Host::subslotSize(value_size, layout)},
+        remote_register_size{Host::registerSize(value_size, layout)},
         rc{std::move(rc)},
+        completions{completions},
         allow_custom_incarnation{allow_custom_incarnation} {
-    if (this->rc.remoteSize() < Host::bufferSize(nb_registers, value_size)) {
+    if (layout == Layout::Seqlock && value_size > Host::SeqlockMaxValueSize) {
+      throw std::invalid_argument(fmt::format(
+          "Seqlock registers hold at most {}B, {}B requested",
+          Host::SeqlockMaxValueSize, value_size));
+    }
+
+    auto const buffer_size = Host::bufferSize(nb_registers, value_size, layout);
+    if (this->rc.remoteSize() < buffer_size) {
       throw std::runtime_error(fmt::format(
           "Remote MR too small to host {} registers: {} given, {} required",
-          nb_registers, this->rc.remoteSize(),
-          Host::bufferSize(nb_registers, value_size)));
+          nb_registers, this->rc.remoteSize(), buffer_size));
     }
 
-    if (this->rc.getMr().size < Host::bufferSize(nb_registers, value_size)) {
+    if (this->rc.getMr().size < buffer_size) {
       throw std::runtime_error(fmt::format(
           "Local MR too small to host {} register buffers: {} given, {} "
           "required",
-          nb_registers, this->rc.getMr().size,
-          Host::bufferSize(nb_registers, value_size)));
+          nb_registers, this->rc.getMr().size, buffer_size));
     }
 
     // Store the pointers to register starts in my local memory.
     // Use these pointers as data source for RDMA WRITEs.
     for (size_t i = 0; i < nb_registers; i++) {
-      registers.emplace_back(this->rc.getMr().addr + i * register_size);
+      registers.emplace_back(this->rc.getMr().addr + i * register_size,
+                             layout);
     }
 
     // Note: The available space for WCs may be less than WrDepth if
@@ -131,8 +154,7 @@ class Writer {
       reg.incrementIncarnation();
     }
     reg.changeRemoteSubslot();
-    reg.header.hash = XXH3_64bits(&reg.header.incarnation,
-                                  sizeof(Header::incarnation) + value_size);
+    seal(reg);
     queued_writes.emplace_back(index);
     pushToQp();
   }
@@ -155,9 +177,25 @@ class Writer {
 
   bool customIncarnationAllowed() const { return allow_custom_incarnation; }
 
+  Layout registerLayout() const { return layout; }
+
  private:
+  void seal(Register &reg) const {
+    if (layout == Layout::Seqlock) {
+      // Fences are copied as they are not aligned for arbitrary value sizes.
+      auto *const base = reinterpret_cast<uint8_t *>(reg.raw_buffer);
+      memcpy(base, &reg.incarnation, sizeof(Host::Fence));
+      memcpy(base + Host::tailFenceOffset(value_size), &reg.incarnation,
+             sizeof(Host::Fence));
+      return;
+    }
+    reg.header.incarnation = reg.incarnation;
+    reg.header.hash = XXH3_64bits(&reg.header.incarnation,
+                                  sizeof(Header::incarnation) + value_size);
+  }
+
   void initializeRemoteRegisters() {
-    for (int subslot = 0; subslot < 2; ++subslot) {
+    for (size_t subslot = 0; subslot < Host::subslots(layout); ++subslot) {
       for (Index i = 0; i < registers.size(); ++i) {
         auto slot = getSlot(i);
         if (!slot) {
@@ -177,7 +215,7 @@ class Writer {
 
   void pollCompletion(bool const bypass_cooldown = false) {
     wcs.resize(outstanding_writes);
-    if (!rc.pollCqIsOk(conn::ReliableConnection::SendCq, wcs)) {
+    if (!completions.poll(rc, wcs)) {
       throw std::runtime_error("Error while polling CQ.");
     }
     for (auto const &wc : wcs) {
@@ -217,11 +255,11 @@ class Writer {
       }
 
       auto const posted =
-          rc.postSendSingle(conn::ReliableConnection::RdmaReq::RdmaWrite,
-                            reinterpret_cast<uint64_t>(index), reg.raw_buffer,
-                            static_cast<uint32_t>(register_size),
-                            rc.remoteBuf() + index * remote_register_size +
-                                reg.remote_subslot * register_size);
+          rc.stage(conn::ReliableConnection::RdmaReq::RdmaWrite,
+                   completions.wrId(index), reg.raw_buffer,
+                   static_cast<uint32_t>(register_size),
+                   rc.remoteBuf() + index * remote_register_size +
+                       reg.remote_subslot * register_size);
       if (!posted) {
         // TODO(Antoine): consider as having failed.
         throw std::runtime_error("Failed to post WRITE");
@@ -230,13 +268,19 @@ class Writer {
       queued_writes.pop_front();
       outstanding_writes++;
     }
+    // All the registers written during this tick share a single doorbell.
+    if (rc.staged() != 0 && !rc.postBatch()) {
+      throw std::runtime_error("Failed to post WRITE");
+    }
   }
 
   size_t const nb_registers;
   size_t const value_size;
+  Layout const layout;
   size_t const register_size;
   size_t const remote_register_size;
   conn::ReliableConnection rc;
+  Completions completions;
   bool const allow_custom_incarnation;
 
   std::vector<Register> registers;
@@ -17,6 +17,7 @@
 #include "../tail-p2p/sender.hpp"
 #include "../tail-queue/tail-queue.hpp"
 #include "../thread-pool/tail-thread-pool.hpp"
+#include "../tracing.hpp"
 #include "internal/signature-message.hpp"
 #include "message.hpp"
 
@@ -134,7 +135,8 @@ class Broadcaster {
         hooks::sig_computation_start = hooks::Clock::now();
       #endif
       auto const index = i;  // structured bindings cannot be captured
-      task_queue.enqueue([this, index, buffer = std::move(buffer)]() mutable {
+      task_queue.enqueue([this, index, buffer = std::move(buffer),
+                          enqueued = tracing::now()]() mutable {
         // The hash includes both the index and the message.
         // TODO(Ant.): also include the identifier of the broadcaster instance
         // to prevent replay attacks.
@@ -144,6 +146,8 @@ class Broadcaster {
         auto const hash = crypto::hash::blake3_final(acc);
         computed_signatures.enqueue(ComputedSignature{
             index, crypto.sign(hash.data(), hash.size()), std::move(buffer)});
+        tracing::record(tracing::Span::TcbSignature,
+                        static_cast<uint32_t>(crypto.myId()), index, enqueued);
       });
     }
     queued_signature_computations.clear();
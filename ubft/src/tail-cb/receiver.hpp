@@ -6,7 +6,9 @@
 #include <optional>
 #include <stdexcept>
 #include <unordered_set>
+#include <utility>
 #include <variant>
+#include <vector>
 
 #include <fmt/core.h>
 #include <fmt/ranges.h>
@@ -18,6 +20,7 @@
 #include <dory/shared/branching.hpp>
 #include <dory/shared/dynamic-bitset.hpp>
 #include <dory/shared/match.hpp>
+#include <dory/shared/metrics.hpp>
 #include <dory/shared/optimistic-find.hpp>
 #include <dory/shared/units.hpp>
 #include <dory/shared/unused-suppressor.hpp>
@@ -30,6 +33,7 @@
 #include "../tail-p2p/receiver.hpp"
 #include "../tail-p2p/sender.hpp"
 #include "../thread-pool/tail-thread-pool.hpp"
+#include "../tracing.hpp"
 #include "../types.hpp"
 #include "../unsafe-at.hpp"
 
@@ -43,6 +47,8 @@ class Receiver {
   auto static constexpr HashThreshold = units::kibibytes(8);
   using Hash = crypto::hash::Blake3Hash;
   auto static constexpr HashLength = crypto::hash::Blake3HashLength;
+  // Max number of consecutive registers fetched by a single slow-path READ.
+  size_t static constexpr MaxReadRange = 32;
 
  public:
   using Index = Message::Index;
@@ -84,6 +90,7 @@ class Receiver {
       : crypto{crypto},
         broadcaster_id{broadcaster_id},
         tail{tail},
+        slow_path_starts{tail},
         message_receiver(std::move(message_receiver)),
         signature_receiver(std::move(signature_receiver)),
         echo_senders{std::move(echo_senders)},
@@ -251,11 +258,18 @@ class Receiver {
           "Message dropped as it was received out of order (Byzantine).\n");
       return;
     }
+    // Messages skipped by the broadcaster (or overwritten in the p2p tail
+    // before we polled them) will never be delivered.
+    if (unlikely(index > next_expected_index)) {
+      holes.add(index - next_expected_index);
+    }
+    next_expected_index = index + 1;
     auto &msg_data =
         msg_tail.try_emplace(index, std::move(message), echo_receivers.size())
             .first->second;
     if (msg_tail.size() > tail) {
       msg_tail.erase(msg_tail.begin());
+      evictions.add();
     }
 
     // We replay all buffered echoes
@@ -388,6 +402,8 @@ class Receiver {
           #ifdef LATENCY_HOOKS
             hooks::swmr_write_start = hooks::Clock::now();
           #endif
+          slow_path_starts.begin(static_cast<uint32_t>(broadcaster_id),
+                                 index);
           if (!ok) {
             throw std::logic_error(fmt::format(
                 "Unimplemented: Byzantine broadcaster {} sent an invalid "
@@ -438,6 +454,7 @@ class Receiver {
   }
 
   void pollWriteCompletions() {
+    completed_writes.clear();
     // We iterate over the map of reads while removing its elements.
     for (auto it = outstanding_writes.cbegin(); it != outstanding_writes.cend();
          /* in body */) {
@@ -455,14 +472,44 @@ class Receiver {
       if (md_it == msg_tail.end()) {
         continue;
       }
-      // Otherwise, we enqueue READs.
-      auto &vec = outstanding_reads.try_emplace(index).first->second;
-      #ifdef LATENCY_HOOKS
-        hooks::swmr_read_start = hooks::Clock::now();
-      #endif
+      auto const written = tracing::now();
+      slow_path_starts.end(tracing::Span::TcbSwmrWrite,
+                           static_cast<uint32_t>(broadcaster_id), index,
+                           written);
+      slow_path_starts.begin(static_cast<uint32_t>(broadcaster_id), index,
+                             written);
+      completed_writes.emplace_back(swmr_index, index);
+    }
+    if (completed_writes.empty()) {
+      return;
+    }
+    slow_path_reads.add(completed_writes.size());
+
+    // Otherwise, we enqueue READs. As outstanding_writes is ordered, runs of
+    // consecutive registers are read with a single READ per replica.
+    #ifdef LATENCY_HOOKS
+      hooks::swmr_read_start = hooks::Clock::now();
+    #endif
+    for (size_t first = 0; first < completed_writes.size(); /* in body */) {
+      size_t count = 1;
+      while (first + count < completed_writes.size() && count < MaxReadRange &&
+             completed_writes[first + count].first ==
+                 completed_writes[first + count - 1].first + 1) {
+        count++;
+      }
       for (auto &reader : swmr_readers) {
-        vec.emplace_back(reader.read(swmr_index));
+        auto const handle =
+            reader.readRange(completed_writes[first].first, count);
+        for (size_t i = 0; i < count; i++) {
+          auto const index = completed_writes[first + i].second;
+          outstanding_reads.try_emplace(index).first->second.emplace_back(
+              handle + i);
+        }
       }
+      first += count;
+    }
+    for (auto &reader : swmr_readers) {
+      reader.post();
     }
   }
 
@@ -521,6 +568,8 @@ class Receiver {
         }
       }
       if (completed_reads == swmr_readers.size()) {
+        slow_path_starts.end(tracing::Span::TcbSwmrRead,
+                             static_cast<uint32_t>(broadcaster_id), index);
         it = outstanding_reads.erase(it);
         #ifdef LATENCY_HOOKS
           hooks::swmr_read_latency.addMeasurement(hooks::Clock::now() - hooks::swmr_read_start);
@@ -540,6 +589,8 @@ class Receiver {
   Crypto &crypto;
   ProcId const broadcaster_id;
   size_t const tail;
+  // Start of the WRITE or READ phase of the slow path of each message.
+  tracing::Starts slow_path_starts;
 
   // Receivers for messages and signature from the broadcaster
   tail_p2p::Receiver message_receiver;
@@ -669,6 +720,7 @@ class Receiver {
 
   std::map<Index, MessageData> msg_tail;
   std::optional<Index> latest_polled_message;
+  Index next_expected_index = 0;
   std::vector<std::deque<Message>> buffered_echoes;
 
   third_party::sync::MpmcQueue<VerifiedSignature>
@@ -676,6 +728,10 @@ class Receiver {
   // Map: Index to the register in the array of registers that I own -> The
   // index of the CB message (i.e., k).
   std::map<replicated_swmr::Writer::Index, Index> outstanding_writes;
+  // (Register index, CB message index) of the WRITEs that completed during
+  // the current tick, reused across ticks.
+  std::vector<std::pair<replicated_swmr::Writer::Index, Index>>
+      completed_writes;
 
   // Map: Index of the CB message -> The job handle for each register in the
   // register arrays owned from all the others. The job handle is optional to
@@ -686,6 +742,13 @@ class Receiver {
 
   TailThreadPool::TaskQueue recv_check_task_queue;
   std::vector<TailThreadPool::TaskQueue> read_check_task_queues;
+
+  // Shared by all the receivers of the process.
+  metrics::Counter holes = metrics::Registry::instance().counter("tcb.holes");
+  metrics::Counter evictions =
+      metrics::Registry::instance().counter("tcb.evictions");
+  metrics::Counter slow_path_reads =
+      metrics::Registry::instance().counter("tcb.slow_path_reads");
 };
 
 }  // namespace dory::ubft::tail_cb
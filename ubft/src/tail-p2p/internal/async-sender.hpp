@@ -12,6 +12,7 @@
 #include <dory/shared/branching.hpp>
 
 #include "../../buffer.hpp"
+#include "../../completion-dispatcher.hpp"
 #include "header.hpp"
 #include "lazy.hpp"
 #include "sync-sender.hpp"
@@ -43,9 +44,9 @@ class AsyncSender : public Lazy {
   }
 
   AsyncSender(size_t const tail, size_t const max_msg_size,
-              conn::ReliableConnection &&rc)
+              conn::ReliableConnection &&rc, Completions completions = {})
       : buffer_pool{tail, max_msg_size},
-        sender{tail, max_msg_size, std::move(rc)} {}
+        sender{tail, max_msg_size, std::move(rc), completions} {}
 
   /**
    * @brief Get a slot/buffer where to write a message.
@@ -14,6 +14,7 @@
 #include <dory/ctrl/block.hpp>
 #include <dory/shared/branching.hpp>
 
+#include "../../completion-dispatcher.hpp"
 #include "header.hpp"
 #include "lazy.hpp"
 
@@ -94,11 +95,12 @@ class SyncSender : public Lazy {
   }
 
   SyncSender(size_t const tail, size_t const max_msg_size,
-             conn::ReliableConnection &&rc)
+             conn::ReliableConnection &&rc, Completions completions = {})
       : tail{tail},
         slot_size{slotSize(max_msg_size)},  // todo: align
         buffer{tail, rc.getMr().addr, rc.getMr().size, slot_size},
-        rc{std::move(rc)} {
+        rc{std::move(rc)},
+        completions{completions} {
     if (this->rc.getMr().size < bufferSize(tail, max_msg_size)) {
       throw std::runtime_error(
           fmt::format("Buffer is not large enough to store the tail: {} "
@@ -119,7 +121,7 @@ class SyncSender : public Lazy {
     if (unlikely(outstanding_writes != 0)) {
       // poll
       wcs.resize(outstanding_writes);
-      if (unlikely(!rc.pollCqIsOk(conn::ReliableConnection::SendCq, wcs))) {
+      if (unlikely(!completions.poll(rc, wcs))) {
         throw std::runtime_error("Error while polling CQ.");
       }
       // release
@@ -185,9 +187,9 @@ class SyncSender : public Lazy {
       header->hash = XXH3_64bits(data, header->size);
       uint32_t const full_size =
           static_cast<uint32_t>(sizeof(Header)) + header->size;
-      if (!rc.postSendSingle(conn::ReliableConnection::RdmaWrite, 0, slot,
-                             full_size,
-                             rc.remoteBuf() + slot_size * (next_send % tail))) {
+      if (!rc.stage(conn::ReliableConnection::RdmaWrite, completions.wrId(0),
+                    slot, full_size,
+                    rc.remoteBuf() + slot_size * (next_send % tail))) {
         // TODO(Antoine): consider the guy as being dead or, for stubborness,
         // re-establish the QP and the WRITE.
         throw std::runtime_error("Error while posting RDMA write.");
@@ -196,6 +198,10 @@ class SyncSender : public Lazy {
       to_send.pop_front();
       next_send++;
     }
+    // All the slots of this call share a single doorbell.
+    if (rc.staged() != 0 && !rc.postBatch()) {
+      throw std::runtime_error("Error while posting RDMA writes.");
+    }
   }
 
   std::deque<void *> to_send;
@@ -208,6 +214,7 @@ class SyncSender : public Lazy {
   size_t const slot_size;
   CircularBuffer buffer;
   conn::ReliableConnection rc;
+  Completions completions;
 
   std::vector<struct ibv_wc> wcs;
 };
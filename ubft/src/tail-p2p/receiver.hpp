@@ -19,6 +19,7 @@
 
 #include <dory/conn/rc.hpp>
 #include <dory/shared/branching.hpp>
+#include <dory/shared/metrics.hpp>
 
 #include "../types.hpp"
 #include "internal/header.hpp"
@@ -144,6 +145,12 @@ class Receiver {
                               // overwritten.
       }
       if (hash == XXH3_64bits(buffer, size)) {
+        // Delivering on a falling edge: the messages in between were
+        // overwritten by the sender before we could poll them.
+        if (unlikely(scanning != best_to_deliver)) {
+          overwrites.add((scanning.first - best_to_deliver.first) * tail +
+                         scanning.second - best_to_deliver.second);
+        }
         // We compute the ID of the next message in the sequence of deliveries.
         // We hope to deliver it, but maybe there will be a gap and we will have
         // to deliver on a falling edge.
@@ -166,6 +173,9 @@ class Receiver {
   uintptr_t ptr_to_scan;
   MsgId best_to_deliver = FirstMsg;
 
+  metrics::Counter overwrites =
+      metrics::Registry::instance().counter("p2p.tail_overwrites");
+
   inline MsgId successor(MsgId const &old_id) const {
     auto new_id = old_id;
     if (++new_id.second >= tail) {
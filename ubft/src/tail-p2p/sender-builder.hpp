@@ -11,6 +11,7 @@
 #include <dory/memstore/store.hpp>
 
 #include "../builder.hpp"
+#include "../completion-dispatcher.hpp"
 #include "../types.hpp"
 #include "sender.hpp"
 
@@ -39,9 +40,9 @@ class SenderBuilder : private Builder<SenderVariant> {
     // Initialize Memory
     cb.allocateBuffer(uuid, Sender::bufferSize(tail, max_msg_size), 64);
     cb.registerMr(uuid, "standard", uuid, dory::ctrl::ControlBlock::LOCAL_READ);
-    cb.registerCq(uuid);
+    auto const cq = completion_binding.registerCq(cb, uuid);
     // Initialize QP
-    exchanger.configure(receiver_id, "standard", uuid, uuid, uuid);
+    exchanger.configure(receiver_id, "standard", uuid, cq, cq);
   }
 
   void announceQps() override {
@@ -56,7 +57,9 @@ class SenderBuilder : private Builder<SenderVariant> {
 
   SenderVariant build() override {
     Builder<SenderVariant>::building();
-    return SenderVariant(tail, max_msg_size, exchanger.extract(receiver_id));
+    return SenderVariant(
+        tail, max_msg_size, exchanger.extract(receiver_id),
+        completion_binding.subscribe(CompletionKind::P2pSender));
   }
 
  private:
@@ -68,6 +71,7 @@ class SenderBuilder : private Builder<SenderVariant> {
 
   size_t const tail;
   size_t const max_msg_size;
+  CompletionBinding completion_binding;
 };
 
 using SyncSenderBuilder = SenderBuilder<SyncSender>;
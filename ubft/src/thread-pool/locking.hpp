@@ -7,6 +7,7 @@
 #include <future>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <stdexcept>
 #include <thread>
@@ -16,6 +17,7 @@
 
 #include <dory/shared/assert.hpp>
 #include <dory/shared/branching.hpp>
+#include <dory/shared/metrics.hpp>
 #include <dory/shared/move-indicator.hpp>
 #include <dory/shared/pinning.hpp>
 
@@ -86,16 +88,18 @@ class LockingThreadPool {
      *
      * @param index
      * @param task
+     * @return whether a task was dropped.
      */
-    void enqueue(Index const index, Task &&task) {
+    bool enqueue(Index const index, Task &&task) {
       auto &[queue, tail] = uat(queues, index);
       queue.emplace_back(std::move(task));
       if (unlikely(queue.size() > tail)) {
         queue.pop_front();
-      } else {
-        tasks++;
-        queues_sizes.increment(index);
+        return true;
       }
+      tasks++;
+      queues_sizes.increment(index);
+      return false;
     }
 
     /**
@@ -126,6 +130,8 @@ class LockingThreadPool {
 
     bool empty() const { return tasks == 0; }
 
+    size_t size() const { return tasks; }
+
    private:
     std::vector<QueueTailPair> queues;
     // A priority queue that gives the index of the queue with the most tasks.
@@ -186,7 +192,11 @@ class LockingThreadPool {
   };
 
   LockingThreadPool(std::string const &name, size_t const threads,
-                    std::vector<int> const &proc_aff = {}) {
+                    std::vector<int> const &proc_aff = {})
+      : drops{metrics::Registry::instance().counter(
+            fmt::format("threadpool.{}.drops", name))},
+        queued{metrics::Registry::instance().gauge(
+            fmt::format("threadpool.{}.queued", name))} {
     for (size_t i = 0; i < threads; ++i) {
       workers.emplace_back([&] {
         for (;;) {
@@ -199,6 +209,7 @@ class LockingThreadPool {
               return std::nullopt;
             }
             auto id_task = tasks.pop();
+            queued.set(tasks.size());
             uat(running, id_task.first)++;
             return id_task;
           }();
@@ -258,7 +269,11 @@ class LockingThreadPool {
       if (unlikely(stop)) {
         throw std::runtime_error("enqueue on stopped ThreadPool");
       }
-      tasks.enqueue(tq_id, std::function<void()>([task]() { (*task)(); }));
+      if (unlikely(tasks.enqueue(
+              tq_id, std::function<void()>([task]() { (*task)(); })))) {
+        drops.add();
+      }
+      queued.set(tasks.size());
       if (!frozen) {
         condition.notify_one();
       }
@@ -271,6 +286,7 @@ class LockingThreadPool {
       std::unique_lock<std::mutex> lock(mutex);
       // Remove all queued tasks.
       tasks.clear(tq_id);
+      queued.set(tasks.size());
     }
     // Wait until all ongoing tasks are computed.
     while (uat(running, tq_id) != 0) {
@@ -311,6 +327,10 @@ class LockingThreadPool {
   std::condition_variable condition;
   bool stop = false;
   bool frozen = false;
+
+  // Tasks dropped as their queue grew beyond its tail, and queue depth.
+  metrics::Counter drops;
+  metrics::Gauge queued;
 };
 
 }  // namespace dory::ubft
@@ -0,0 +1,421 @@
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <fmt/core.h>
+
+#include <dory/shared/branching.hpp>
+#include <dory/shared/logger.hpp>
+#include <dory/shared/tsc.hpp>
+
+/**
+ * Tick-phase CPU budget profiler.
+ *
+ * Attributes the TSC cycles (and, optionally, hardware counters read in user
+ * space with rdpmc) spent in each phase of the replica's hot loop, and splits
+ * loop iterations between busy (some progress was made) and idle ones. A
+ * breakdown table is printed periodically.
+ *
+ * The profiler is meant for the thread that runs the hot loop: it is not
+ * thread-safe. It is only compiled in when TICK_PROFILING is defined.
+ * Otherwise, every function below is an empty inline function.
+ */
+namespace dory::ubft::tick_profiler {
+
+enum class Phase : uint8_t {
+  // rpc::Server::tick: polling client connections and signature checks.
+  RpcServer,
+  // Ticks of consensus' building blocks.
+  CbBroadcaster,
+  CbReceivers,
+  Certifiers,
+  P2pSenders,
+  // Consensus logic: handling cb-delivered messages and certificates.
+  ConsensusLogic,
+  FastCommits,
+  // Server logic: accepting client requests and proposing batches.
+  ClientRequests,
+  Proposals,
+  // Execution of decided (and read-only) requests by the application.
+  Execution,
+  NbPhases
+};
+
+static constexpr std::array<char const *, static_cast<size_t>(Phase::NbPhases)>
+    PhaseNames = {"rpc.server",      "cb.broadcaster",  "cb.receivers",
+                  "certifiers",      "p2p.senders",     "consensus.logic",
+                  "fast_commits",    "client_requests", "proposals",
+                  "execution"};
+
+#ifdef TICK_PROFILING
+static constexpr bool Enabled = true;
+#else
+static constexpr bool Enabled = false;
+#endif
+
+namespace internal {
+/**
+ * @brief Instructions, LLC misses and branch misses of the calling thread,
+ *        read with rdpmc from the perf mmap pages (no syscall).
+ */
+class HardwareCounters {
+ public:
+  static size_t constexpr NbCounters = 3;
+  using Values = std::array<uint64_t, NbCounters>;
+
+  HardwareCounters() = default;
+  HardwareCounters(HardwareCounters const &) = delete;
+  HardwareCounters &operator=(HardwareCounters const &) = delete;
+
+  ~HardwareCounters() { close(); }
+
+  /**
+   * @brief Open the counters for the calling thread.
+   *
+   * @return whether they can be read from user space.
+   */
+  bool open() {
+    std::array<uint64_t, NbCounters> const configs = {
+        PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES};
+    for (size_t i = 0; i < NbCounters; i++) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = configs[i];
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      auto const fd = static_cast<int>(
+          ::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+      if (fd < 0) {
+        close();
+        return false;
+      }
+      fds[i] = fd;
+      auto *const page = ::mmap(nullptr, static_cast<size_t>(getpagesize()),
+                                PROT_READ, MAP_SHARED, fd, 0);
+      if (page == MAP_FAILED) {
+        close();
+        return false;
+      }
+      pages[i] = reinterpret_cast<perf_event_mmap_page *>(page);
+      if (!pages[i]->cap_user_rdpmc) {
+        close();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  inline Values read() const {
+    Values values;
+    for (size_t i = 0; i < NbCounters; i++) {
+      values[i] = read(*pages[i]);
+    }
+    return values;
+  }
+
+ private:
+  static inline uint64_t read(perf_event_mmap_page const &page) {
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t seq;
+    uint64_t count;
+    do {
+      seq = page.lock;
+      __asm volatile("" ::: "memory");
+      auto const index = page.index;
+      count = static_cast<uint64_t>(page.offset);
+      if (likely(index != 0)) {
+        auto const width = page.pmc_width;
+        auto pmc = static_cast<int64_t>(__rdpmc(static_cast<int>(index - 1)));
+        // Sign-extend the `width`-bit counter.
+        auto const shift = 64 - width;
+        pmc = static_cast<int64_t>(static_cast<uint64_t>(pmc) << shift) >>
+              shift;
+        count += static_cast<uint64_t>(pmc);
+      }
+      __asm volatile("" ::: "memory");
+    } while (page.lock != seq);
+    return count;
+#else
+    (void)page;
+    return 0;
+#endif
+  }
+
+  void close() {
+    for (size_t i = 0; i < NbCounters; i++) {
+      if (pages[i] != nullptr) {
+        ::munmap(pages[i], static_cast<size_t>(getpagesize()));
+        pages[i] = nullptr;
+      }
+      if (fds[i] >= 0) {
+        ::close(fds[i]);
+        fds[i] = -1;
+      }
+    }
+  }
+
+  std::array<int, NbCounters> fds = {-1, -1, -1};
+  std::array<perf_event_mmap_page *, NbCounters> pages = {};
+};
+
+struct Sample {
+  uint64_t tsc;
+  HardwareCounters::Values hw;
+};
+
+struct Accumulator {
+  uint64_t calls;
+  uint64_t cycles;
+  HardwareCounters::Values hw;
+
+  inline void add(Sample const &begin, Sample const &end) {
+    calls++;
+    cycles += end.tsc - begin.tsc;
+    for (size_t i = 0; i < HardwareCounters::NbCounters; i++) {
+      hw[i] += end.hw[i] - begin.hw[i];
+    }
+  }
+};
+
+class Profiler {
+ public:
+  void enable(std::chrono::nanoseconds const report_every,
+              bool const hardware_counters) {
+    TscClock::calibrate();
+    report_period = static_cast<uint64_t>(
+        static_cast<double>(report_every.count()) *
+        TscClock::ticksPerNanosecond());
+    if (hardware_counters) {
+      hw_enabled = counters.open();
+      if (!hw_enabled) {
+        LOGGER_WARN(logger,
+                    "Hardware counters cannot be read from user space (check "
+                    "/proc/sys/kernel/perf_event_paranoid and "
+                    "/sys/devices/cpu/rdpmc), only reporting cycles.");
+      }
+    }
+    reset();
+    active = true;
+  }
+
+  inline bool isActive() const { return active; }
+
+  inline Sample sample() const {
+    Sample s{TscClock::now(), {}};
+    if (hw_enabled) {
+      s.hw = counters.read();
+    }
+    return s;
+  }
+
+  inline void add(Phase const phase, Sample const &begin, Sample const &end) {
+    phases[static_cast<size_t>(phase)].add(begin, end);
+  }
+
+  inline void markBusy() { busy = true; }
+
+  inline void endIteration(Sample const &begin) {
+    auto const end = sample();
+    (busy ? busy_iterations : idle_iterations).add(begin, end);
+    busy = false;
+    if (unlikely(end.tsc - period_start >= report_period)) {
+      report(end.tsc - period_start);
+      reset();
+    }
+  }
+
+ private:
+  void reset() {
+    phases = {};
+    busy_iterations = {};
+    idle_iterations = {};
+    busy = false;
+    period_start = TscClock::now();
+  }
+
+  void report(uint64_t const period) const {
+    auto const iterations = busy_iterations.calls + idle_iterations.calls;
+    auto const loop_cycles = busy_iterations.cycles + idle_iterations.cycles;
+    if (iterations == 0 || loop_cycles == 0) {
+      return;
+    }
+    auto const ns = [](double const cycles) {
+      return cycles / TscClock::ticksPerNanosecond();
+    };
+    auto const per = [](uint64_t const v, uint64_t const n) {
+      return n == 0 ? 0. : static_cast<double>(v) / static_cast<double>(n);
+    };
+
+    std::string table = fmt::format(
+        "[TickProfiler] {:.0f}ms, {} iterations ({:.1f}% busy), "
+        "{:.0f}ns/iteration (busy: {:.0f}ns, idle: {:.0f}ns), loop: {:.1f}% "
+        "of the time\n",
+        ns(static_cast<double>(period)) / 1e6, iterations,
+        100. * per(busy_iterations.calls, iterations),
+        ns(per(loop_cycles, iterations)),
+        ns(per(busy_iterations.cycles, busy_iterations.calls)),
+        ns(per(idle_iterations.cycles, idle_iterations.calls)),
+        100. * per(loop_cycles, period));
+    table += fmt::format("  {:<16} {:>9} {:>9} {:>7}", "phase", "calls/it",
+                         "ns/call", "share");
+    if (hw_enabled) {
+      table += fmt::format(" {:>9} {:>5} {:>9} {:>9}", "instr/call", "IPC",
+                           "llc/call", "br/call");
+    }
+    table += "\n";
+
+    auto const row = [&](char const *const name, Accumulator const &acc) {
+      table += fmt::format("  {:<16} {:>9.2f} {:>9.0f} {:>6.1f}%", name,
+                           per(acc.calls, iterations),
+                           ns(per(acc.cycles, acc.calls)),
+                           100. * per(acc.cycles, loop_cycles));
+      if (hw_enabled) {
+        table += fmt::format(
+            " {:>9.0f} {:>5.2f} {:>9.2f} {:>9.2f}", per(acc.hw[0], acc.calls),
+            per(acc.hw[0], acc.cycles), per(acc.hw[1], acc.calls),
+            per(acc.hw[2], acc.calls));
+      }
+      table += "\n";
+    };
+
+    Accumulator attributed{};
+    for (size_t p = 0; p < phases.size(); p++) {
+      auto const &acc = phases[p];
+      if (acc.calls == 0) {
+        continue;
+      }
+      row(PhaseNames[p], acc);
+      attributed.cycles += acc.cycles;
+      for (size_t i = 0; i < HardwareCounters::NbCounters; i++) {
+        attributed.hw[i] += acc.hw[i];
+      }
+    }
+    // Whatever the loop spent outside of the instrumented phases.
+    Accumulator other{iterations, 0, {}};
+    other.cycles = loop_cycles - std::min(loop_cycles, attributed.cycles);
+    for (size_t i = 0; i < HardwareCounters::NbCounters; i++) {
+      auto const total = busy_iterations.hw[i] + idle_iterations.hw[i];
+      other.hw[i] = total - std::min(total, attributed.hw[i]);
+    }
+    row("(other)", other);
+    fmt::print("{}", table);
+  }
+
+  bool active = false;
+  bool hw_enabled = false;
+  HardwareCounters counters;
+  uint64_t report_period = 0;
+  uint64_t period_start = 0;
+  std::array<Accumulator, static_cast<size_t>(Phase::NbPhases)> phases{};
+  Accumulator busy_iterations{};
+  Accumulator idle_iterations{};
+  bool busy = false;
+
+  LOGGER_DECL_INIT(logger, "TickProfiler");
+};
+
+inline Profiler &profiler() {
+  static Profiler instance;
+  return instance;
+}
+}  // namespace internal
+
+/**
+ * @brief Start profiling and reporting every `report_every`.
+ *
+ * @param hardware_counters whether to also count instructions, LLC misses and
+ *        branch misses (requires rdpmc to be allowed).
+ */
+inline void enable(std::chrono::nanoseconds const report_every,
+                   bool const hardware_counters) {
+  if constexpr (!Enabled) {
+    throw std::logic_error("Tick profiling was disabled at compilation.");
+  }
+  internal::profiler().enable(report_every, hardware_counters);
+}
+
+/**
+ * @brief Mark the current iteration as busy, i.e., it made some progress.
+ */
+inline void busy() {
+  if constexpr (Enabled) {
+    internal::profiler().markBusy();
+  }
+}
+
+/**
+ * @brief Attributes the lifetime of the object to a phase.
+ */
+class Scope {
+ public:
+  inline Scope(Phase const phase) : phase{phase} {
+    if constexpr (Enabled) {
+      if (internal::profiler().isActive()) {
+        begin = internal::profiler().sample();
+      }
+    }
+  }
+
+  inline ~Scope() {
+    if constexpr (Enabled) {
+      if (internal::profiler().isActive()) {
+        internal::profiler().add(phase, begin, internal::profiler().sample());
+      }
+    }
+  }
+
+  Scope(Scope const &) = delete;
+  Scope &operator=(Scope const &) = delete;
+
+ private:
+  Phase phase;
+  internal::Sample begin{};
+};
+
+/**
+ * @brief Wraps one iteration of the hot loop.
+ */
+class Iteration {
+ public:
+  inline Iteration() {
+    if constexpr (Enabled) {
+      if (internal::profiler().isActive()) {
+        begin = internal::profiler().sample();
+      }
+    }
+  }
+
+  inline ~Iteration() {
+    if constexpr (Enabled) {
+      if (internal::profiler().isActive()) {
+        internal::profiler().endIteration(begin);
+      }
+    }
+  }
+
+  Iteration(Iteration const &) = delete;
+  Iteration &operator=(Iteration const &) = delete;
+
+ private:
+  internal::Sample begin{};
+};
+
+}  // namespace dory::ubft::tick_profiler
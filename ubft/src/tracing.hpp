@@ -0,0 +1,296 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <fmt/core.h>
+
+#include <dory/shared/branching.hpp>
+
+/**
+ * Per-request tracing.
+ *
+ * Spans are keyed by (owner, id), e.g., (client id, request id) or
+ * (broadcaster id, message index), and optionally tagged with the consensus
+ * instance. Each thread records completed spans into its own ring buffer,
+ * which costs two TSC reads and a few stores per span. The rings are exported
+ * to the Chrome trace JSON format, which Perfetto (ui.perfetto.dev) and
+ * chrome://tracing load.
+ *
+ * Tracing is only compiled in when TRACING is defined. Otherwise, every
+ * function below is an empty inline function.
+ */
+namespace dory::ubft::tracing {
+
+enum class Span : uint8_t {
+  // Verification of a client signature, including queuing in the thread pool.
+  RpcSignatureCheck,
+  // From being accepted by the server to being responded to.
+  Request,
+  // From being proposed by the leader to being decided.
+  Consensus,
+  // From its batch being decided to being responded to.
+  Execution,
+  // Signature of a tail-cb message, including queuing in the thread pool.
+  TcbSignature,
+  // Slow path of tail-cb: WRITE of the signature to the local SWMR, and READ
+  // of the SWMRs of the other receivers.
+  TcbSwmrWrite,
+  TcbSwmrRead,
+  // Certifier share computation and verification, including queuing.
+  CertifierShare,
+  CertifierShareCheck,
+  NbSpans
+};
+
+static constexpr std::array<char const *, static_cast<size_t>(Span::NbSpans)>
+    SpanNames = {"rpc.signature_check", "smr.request",
+                 "smr.consensus",       "smr.execution",
+                 "tcb.signature",       "tcb.swmr_write",
+                 "tcb.swmr_read",       "certifier.share",
+                 "certifier.share_check"};
+
+static constexpr std::array<char const *, static_cast<size_t>(Span::NbSpans)>
+    SpanOwners = {"client",      "client",      "client",
+                  "client",      "broadcaster", "broadcaster",
+                  "broadcaster", "replica",     "replica"};
+
+static constexpr std::array<char const *, static_cast<size_t>(Span::NbSpans)>
+    SpanIds = {"request", "request", "request", "request", "index",
+               "index",   "index",   "index",   "index"};
+
+static constexpr uint64_t NoInstance = UINT64_MAX;
+
+#ifdef TRACING
+static constexpr bool Enabled = true;
+#else
+static constexpr bool Enabled = false;
+#endif
+
+/**
+ * @brief Current timestamp, in TSC ticks (or steady-clock nanoseconds on
+ *        architectures without a TSC).
+ */
+inline uint64_t now() {
+  if constexpr (!Enabled) {
+    return 0;
+  }
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return static_cast<uint64_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+namespace internal {
+struct Event {
+  uint64_t begin;
+  uint64_t end;
+  uint64_t id;
+  uint64_t instance;
+  uint32_t owner;
+  Span span;
+};
+
+/**
+ * @brief Single-producer ring of events. When full, the oldest events are
+ *        overwritten.
+ */
+class Ring {
+ public:
+  static size_t constexpr Capacity = 1 << 16;
+
+  Ring(size_t const thread_index) : events(Capacity) {
+    std::array<char, 16> buffer{};
+    pthread_getname_np(pthread_self(), buffer.data(), buffer.size());
+    name = fmt::format("{}-{}", buffer.data(), thread_index);
+  }
+
+  inline void push(Event const &event) {
+    auto const h = head.load(std::memory_order_relaxed);
+    events[h % Capacity] = event;
+    head.store(h + 1, std::memory_order_release);
+  }
+
+  std::vector<Event> events;
+  std::atomic<uint64_t> head{0};
+  std::string name;
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<Ring>> rings;
+
+  static Registry &instance() {
+    static Registry registry;
+    return registry;
+  }
+};
+
+inline Ring &localRing() {
+  thread_local Ring *ring = nullptr;
+  if (unlikely(ring == nullptr)) {
+    auto &registry = Registry::instance();
+    std::scoped_lock lock(registry.mutex);
+    registry.rings.emplace_back(
+        std::make_unique<Ring>(registry.rings.size()));
+    ring = registry.rings.back().get();
+  }
+  return *ring;
+}
+}  // namespace internal
+
+/**
+ * @brief Record a completed span in the ring of the calling thread.
+ */
+inline void record(Span const span, uint32_t const owner, uint64_t const id,
+                   uint64_t const begin, uint64_t const end = now(),
+                   uint64_t const instance = NoInstance) {
+  if constexpr (Enabled) {
+    internal::localRing().push({begin, end, id, instance, owner, span});
+  }
+}
+
+/**
+ * @brief Start timestamps of spans that begin and end in different places,
+ *        e.g., across ticks.
+ *
+ * Entries are direct-mapped on their id: a span whose entry was overwritten
+ * before it ended is dropped.
+ */
+class Starts {
+ public:
+  Starts(size_t const capacity) {
+    if constexpr (Enabled) {
+      size_t pow2 = 1;
+      while (pow2 < capacity) {
+        pow2 <<= 1;
+      }
+      entries.resize(pow2);
+    }
+  }
+
+  inline void begin(uint32_t const owner, uint64_t const id,
+                    uint64_t const at = now()) {
+    if constexpr (Enabled) {
+      entries[slot(owner, id)] = {at, id, owner, true};
+    }
+  }
+
+  inline void end(Span const span, uint32_t const owner, uint64_t const id,
+                  uint64_t const at = now(),
+                  uint64_t const instance = NoInstance) {
+    if constexpr (Enabled) {
+      auto &entry = entries[slot(owner, id)];
+      if (!entry.valid || entry.id != id || entry.owner != owner) {
+        return;
+      }
+      entry.valid = false;
+      record(span, owner, id, entry.at, at, instance);
+    }
+  }
+
+ private:
+  struct Entry {
+    uint64_t at;
+    uint64_t id;
+    uint32_t owner;
+    bool valid;
+  };
+
+  inline size_t slot(uint32_t const owner, uint64_t const id) const {
+    return (id ^ (static_cast<uint64_t>(owner) * 0x9E3779B97F4A7C15ULL)) &
+           (entries.size() - 1);
+  }
+
+  std::vector<Entry> entries;
+};
+
+/**
+ * @brief Write all the recorded spans to `path` in the Chrome trace format.
+ *
+ * Timestamps are converted to microseconds since the UNIX epoch so that the
+ * traces of different processes can be merged. Best-effort if threads are
+ * still recording.
+ *
+ * @param pid under which the spans appear, e.g., the id of the replica.
+ */
+inline void exportChromeTrace(std::string const &path, int const pid) {
+  if constexpr (!Enabled) {
+    throw std::logic_error("Tracing was disabled at compilation.");
+  }
+
+  // Calibrate the TSC against the system clock.
+  auto const tsc0 = now();
+  auto const sys0 = std::chrono::system_clock::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  auto const tsc1 = now();
+  auto const sys1 = std::chrono::system_clock::now();
+  auto const us_per_tick =
+      std::chrono::duration<double, std::micro>(sys1 - sys0).count() /
+      static_cast<double>(tsc1 - tsc0);
+  auto const us1 =
+      std::chrono::duration<double, std::micro>(sys1.time_since_epoch())
+          .count();
+  auto const to_us = [&](uint64_t const tsc) {
+    return us1 - static_cast<double>(static_cast<int64_t>(tsc1 - tsc)) *
+                     us_per_tick;
+  };
+
+  auto *const file = std::fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    throw std::runtime_error(fmt::format("Cannot open `{}`", path));
+  }
+  fmt::print(file, "{{\"traceEvents\":[\n");
+  bool first = true;
+  auto &registry = internal::Registry::instance();
+  std::scoped_lock lock(registry.mutex);
+  for (size_t tid = 0; tid < registry.rings.size(); tid++) {
+    auto const &ring = *registry.rings[tid];
+    fmt::print(file,
+               "{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":{},"
+               "\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+               first ? "" : ",\n", pid, tid, ring.name);
+    first = false;
+    auto const head = ring.head.load(std::memory_order_acquire);
+    auto const from = head > internal::Ring::Capacity
+                          ? head - internal::Ring::Capacity
+                          : 0;
+    for (auto i = from; i < head; i++) {
+      auto const &event = ring.events[i % internal::Ring::Capacity];
+      auto const span = static_cast<size_t>(event.span);
+      fmt::print(file,
+                 ",\n{{\"name\":\"{}\",\"cat\":\"ubft\",\"ph\":\"X\","
+                 "\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":{},\"tid\":{},"
+                 "\"args\":{{\"{}\":{},\"{}\":{}",
+                 SpanNames[span], to_us(event.begin),
+                 static_cast<double>(event.end - event.begin) * us_per_tick,
+                 pid, tid, SpanOwners[span], event.owner, SpanIds[span],
+                 event.id);
+      if (event.instance != NoInstance) {
+        fmt::print(file, ",\"instance\":{}", event.instance);
+      }
+      fmt::print(file, "}}}}");
+    }
+  }
+  fmt::print(file, "\n]}}\n");
+  std::fclose(file);
+}
+
+}  // namespace dory::ubft::tracing
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <dory/shared/branching.hpp>
+
+#include "consensus/types.hpp"
+#include "types.hpp"
+
+namespace dory::ubft {
+
+/**
+ * @brief Tracks whether requests were accepted but not decided, for the
+ *        progress monitor.
+ *
+ * As clients issue their ordered requests with consecutive ids, it suffices
+ * to track, per client, the ids below which requests were accepted and
+ * decided: all the state is preallocated. Clients with undecided requests are
+ * chained from the oldest to the most recent one to have been accepted or to
+ * have made progress, so that their requests can be expired in O(1) once the
+ * leader decided `expiry` instances without them: it will never propose them
+ * (e.g., it never received them).
+ */
+class UndecidedRequests {
+  using Instance = consensus::Instance;
+  static size_t constexpr None = SIZE_MAX;
+
+ public:
+  UndecidedRequests(ProcId const min_client_id, size_t const nb_clients,
+                    Instance const expiry)
+      : min_client_id{min_client_id}, expiry{expiry}, clients(nb_clients) {}
+
+  /**
+   * @param decided_instances the number of instances decided so far.
+   */
+  void accepted(ProcId const client_id, RequestId const request_id,
+                Instance const decided_instances) {
+    auto const index = static_cast<size_t>(client_id - min_client_id);
+    if (unlikely(index >= clients.size())) {
+      return;
+    }
+    auto &client = clients[index];
+    if (request_id < client.accepted_below) {
+      return;
+    }
+    client.accepted_below = request_id + 1;
+    if (client.decided_below >= client.accepted_below) {
+      return;
+    }
+    if (client.linked) {
+      unlink(index);
+    }
+    append(index, decided_instances);
+  }
+
+  void decided(ProcId const client_id, RequestId const request_id,
+               Instance const decided_instances) {
+    auto const index = static_cast<size_t>(client_id - min_client_id);
+    if (unlikely(index >= clients.size())) {
+      return;
+    }
+    auto &client = clients[index];
+    if (request_id < client.decided_below) {
+      return;
+    }
+    client.decided_below = request_id + 1;
+    if (!client.linked) {
+      return;
+    }
+    unlink(index);
+    if (client.decided_below < client.accepted_below) {
+      append(index, decided_instances);
+    }
+  }
+
+  /**
+   * @brief Forget the requests that were not decided within `expiry`
+   *        instances.
+   */
+  void expire(Instance const decided_instances) {
+    while (head != None &&
+           clients[head].since + expiry <= decided_instances) {
+      forget(head);
+    }
+  }
+
+  /**
+   * @brief Forget all the undecided requests, e.g., upon a leader change.
+   */
+  void clear() {
+    while (head != None) {
+      forget(head);
+    }
+  }
+
+  bool empty() const { return head == None; }
+
+ private:
+  struct Client {
+    RequestId accepted_below = 0;
+    RequestId decided_below = 0;
+    // When it was appended to the chain, in decided instances.
+    Instance since = 0;
+    size_t prev = None;
+    size_t next = None;
+    bool linked = false;  // Whether it has undecided requests.
+  };
+
+  void append(size_t const index, Instance const decided_instances) {
+    auto &client = clients[index];
+    client.since = decided_instances;
+    client.prev = tail;
+    client.next = None;
+    client.linked = true;
+    if (tail == None) {
+      head = index;
+    } else {
+      clients[tail].next = index;
+    }
+    tail = index;
+  }
+
+  void unlink(size_t const index) {
+    auto &client = clients[index];
+    if (client.prev == None) {
+      head = client.next;
+    } else {
+      clients[client.prev].next = client.next;
+    }
+    if (client.next == None) {
+      tail = client.prev;
+    } else {
+      clients[client.next].prev = client.prev;
+    }
+    client.linked = false;
+  }
+
+  void forget(size_t const index) {
+    unlink(index);
+    clients[index].decided_below = clients[index].accepted_below;
+  }
+
+  ProcId const min_client_id;
+  Instance const expiry;
+  std::vector<Client> clients;
+  size_t head = None;
+  size_t tail = None;
+};
+
+}  // namespace dory::ubft
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <dory/ubft/completion-dispatcher.hpp>
+
+using dory::ubft::CompletionKind;
+using dory::ubft::CompletionRouter;
+using Packer = CompletionRouter::Packer;
+
+static struct ibv_wc completion(CompletionKind const kind,
+                                uint16_t const owner, uint64_t const req_id) {
+  struct ibv_wc wc {};
+  wc.wr_id = Packer::pack(kind, owner, req_id);
+  wc.status = IBV_WC_SUCCESS;
+  return wc;
+}
+
+static std::vector<uint64_t> take(CompletionRouter &router,
+                                  uint16_t const owner, size_t const max) {
+  std::vector<struct ibv_wc> entries(max);
+  router.take(owner, entries);
+  std::vector<uint64_t> req_ids;
+  for (auto const &wc : entries) {
+    req_ids.push_back(wc.wr_id);
+  }
+  return req_ids;
+}
+
+TEST(CompletionRouter, RoutesToOwners) {
+  CompletionRouter router;
+  auto const reader = router.subscribe(CompletionKind::SwmrReader, 4);
+  auto const sender = router.subscribe(CompletionKind::P2pSender, 4);
+
+  router.route(completion(CompletionKind::SwmrReader, reader, 1));
+  router.route(completion(CompletionKind::P2pSender, sender, 2));
+  router.route(completion(CompletionKind::SwmrReader, reader, 3));
+
+  EXPECT_EQ(take(router, reader, 8), (std::vector<uint64_t>{1, 3}));
+  EXPECT_EQ(take(router, sender, 8), (std::vector<uint64_t>{2}));
+  EXPECT_EQ(take(router, sender, 8), (std::vector<uint64_t>{}));
+}
+
+TEST(CompletionRouter, InboxIsARing) {
+  CompletionRouter router;
+  auto const owner = router.subscribe(CompletionKind::SwmrWriter, 3);
+  uint64_t next = 0;
+  for (int round = 0; round < 4; round++) {
+    router.route(completion(CompletionKind::SwmrWriter, owner, next));
+    router.route(completion(CompletionKind::SwmrWriter, owner, next + 1));
+    EXPECT_EQ(take(router, owner, 1), (std::vector<uint64_t>{next}));
+    router.route(completion(CompletionKind::SwmrWriter, owner, next + 2));
+    EXPECT_EQ(take(router, owner, 8),
+              (std::vector<uint64_t>{next + 1, next + 2}));
+    next += 3;
+  }
+
+  // At most as many WCs as reserved can be outstanding.
+  for (uint64_t i = 0; i < 3; i++) {
+    router.route(completion(CompletionKind::SwmrWriter, owner, i));
+  }
+  EXPECT_THROW(router.route(completion(CompletionKind::SwmrWriter, owner, 3)),
+               std::runtime_error);
+}
+
+TEST(CompletionRouter, EpochGating) {
+  CompletionRouter router;
+  auto const a = router.subscribe(CompletionKind::P2pSender, 4);
+  auto const b = router.subscribe(CompletionKind::P2pSender, 4);
+  EXPECT_TRUE(router.needsPoll(a));
+  EXPECT_TRUE(router.needsPoll(b));
+
+  // `a` polls the CQ for everyone.
+  router.newEpoch();
+  router.route(completion(CompletionKind::P2pSender, a, 0));
+  EXPECT_EQ(take(router, a, 8), (std::vector<uint64_t>{0}));
+  EXPECT_TRUE(router.needsPoll(a));
+  // `b` did not look since the poll.
+  EXPECT_FALSE(router.needsPoll(b));
+  EXPECT_EQ(take(router, b, 8), (std::vector<uint64_t>{}));
+  EXPECT_TRUE(router.needsPoll(b));
+
+  // Non-empty inboxes are drained before polling again.
+  router.newEpoch();
+  router.route(completion(CompletionKind::P2pSender, b, 1));
+  take(router, a, 8);
+  EXPECT_FALSE(router.needsPoll(b));
+  take(router, b, 8);
+  EXPECT_TRUE(router.needsPoll(b));
+}
+
+TEST(CompletionRouter, RejectsUnroutable) {
+  CompletionRouter router;
+  auto const owner = router.subscribe(CompletionKind::SwmrReader, 4);
+  EXPECT_THROW(router.route(completion(CompletionKind::SwmrWriter, owner, 0)),
+               std::runtime_error);
+  EXPECT_THROW(router.route(completion(CompletionKind::SwmrReader,
+                                       static_cast<uint16_t>(owner + 1), 0)),
+               std::runtime_error);
+  EXPECT_EQ(take(router, owner, 8), (std::vector<uint64_t>{}));
+}
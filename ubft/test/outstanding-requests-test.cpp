@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <variant>
+#include <vector>
+
+#include <dory/ubft/buffer.hpp>
+#include <dory/ubft/rpc/internal/outstanding-requests.hpp>
+#include <dory/ubft/rpc/internal/request.hpp>
+#include <dory/ubft/rpc/internal/response.hpp>
+
+using dory::ubft::Buffer;
+using dory::ubft::RequestId;
+using dory::ubft::rpc::internal::OutstandingRequests;
+using dory::ubft::rpc::internal::Request;
+using dory::ubft::rpc::internal::Response;
+
+static size_t constexpr NbServers = 3;
+
+class OutstandingRequestsTest : public ::testing::Test {
+ protected:
+  OutstandingRequestsTest() : outstanding{2, NbServers} {}
+
+  RequestId issue(bool const read_only = false) {
+    Buffer buffer(Request::bufferSize(0));
+    auto &layout = *reinterpret_cast<Request::Layout *>(buffer.data());
+    layout.client_id = 0;
+    layout.id = outstanding.nextId(read_only);
+    layout.size = 0;
+    auto const id = layout.id;
+    outstanding.issue(Request(std::move(buffer)));
+    return id;
+  }
+
+  // Servers respond with the given byte, or not at all for std::nullopt.
+  void respond(RequestId const id,
+               std::array<std::optional<uint8_t>, NbServers> const &values) {
+    for (size_t server = 0; server < NbServers; server++) {
+      if (!values[server]) {
+        continue;
+      }
+      Buffer buffer(Response::bufferSize(1));
+      auto &layout = *reinterpret_cast<Response::Layout *>(buffer.data());
+      layout.request_id = id;
+      layout.kind = Response::Full;
+      layout.response = *values[server];
+      auto response = Response::tryFrom(std::move(buffer));
+      auto *const data = outstanding.find(id);
+      ASSERT_NE(data, nullptr);
+      data->newResponse(server, std::move(std::get<Response>(response)));
+    }
+  }
+
+  std::optional<uint8_t> poll() {
+    uint8_t dest = 0;
+    auto const polled = outstanding.poll(
+        &dest, [this](RequestId const id) { full_requested.push_back(id); },
+        [this](Request const &request) { reissued.push_back(request.id()); });
+    if (!polled) {
+      return std::nullopt;
+    }
+    EXPECT_EQ(*polled, 1);
+    return dest;
+  }
+
+  OutstandingRequests outstanding;
+  std::vector<RequestId> full_requested;
+  std::vector<RequestId> reissued;
+};
+
+TEST_F(OutstandingRequestsTest, OrderedInIssueOrder) {
+  auto const first = issue();
+  auto const second = issue();
+  respond(second, {2, 2, std::nullopt});
+  EXPECT_EQ(poll(), std::nullopt);
+  respond(first, {1, 1, 1});
+  EXPECT_EQ(poll(), 1);
+  EXPECT_EQ(poll(), 2);
+  EXPECT_TRUE(outstanding.empty());
+}
+
+TEST_F(OutstandingRequestsTest, ReadOnlyInIssueOrder) {
+  auto const read_only = issue(true);
+  auto const ordered = issue();
+  EXPECT_TRUE(read_only & Request::ReadOnlyBit);
+  EXPECT_EQ(ordered, 0);
+  respond(ordered, {2, 2, 2});
+  EXPECT_EQ(poll(), std::nullopt);
+  respond(read_only, {1, 1, std::nullopt});
+  EXPECT_EQ(poll(), 1);
+  EXPECT_EQ(poll(), 2);
+  EXPECT_TRUE(reissued.empty());
+}
+
+TEST_F(OutstandingRequestsTest, ReadOnlyFallbackKeepsOrderAndWindow) {
+  auto const read_only = issue(true);
+  auto const first = issue();
+  auto const second = issue();
+
+  // Servers disagree: the read-only request gets the next ordered id.
+  respond(read_only, {1, 2, 3});
+  EXPECT_EQ(poll(), std::nullopt);
+  ASSERT_EQ(reissued.size(), 1);
+  auto const fallback = reissued.front();
+  EXPECT_EQ(fallback, second + 1);
+  EXPECT_EQ(outstanding.nextOrderedId(), fallback + 1);
+  EXPECT_EQ(outstanding.firstOrdered(), first);
+  EXPECT_TRUE(outstanding.isNext(fallback));
+
+  // The ordered requests issued after it neither overtake it nor get evicted
+  // from the window.
+  respond(first, {4, 4, 4});
+  respond(second, {5, 5, 5});
+  EXPECT_EQ(poll(), std::nullopt);
+
+  respond(fallback, {7, 7, std::nullopt});
+  EXPECT_EQ(poll(), 7);
+  EXPECT_EQ(poll(), 4);
+  EXPECT_EQ(poll(), 5);
+  auto const third = issue();
+  EXPECT_EQ(third, fallback + 1);
+  respond(third, {6, 6, 6});
+  EXPECT_EQ(poll(), 6);
+  EXPECT_TRUE(outstanding.empty());
+  EXPECT_FALSE(outstanding.expectsUnorderedResponses());
+}
+
+TEST_F(OutstandingRequestsTest, FallbackIsSentAgainLast) {
+  auto const read_only = issue(true);
+  auto const first = issue();
+  respond(read_only, {1, 2, 3});
+  EXPECT_EQ(poll(), std::nullopt);
+  ASSERT_EQ(reissued.size(), 1);
+
+  std::vector<RequestId> order;
+  outstanding.forEach([&](auto const &data) {
+    order.push_back(data.request.id());
+  });
+  EXPECT_EQ(order, (std::vector<RequestId>{first, reissued.front()}));
+}
+
+TEST_F(OutstandingRequestsTest, FallbackAsksForFullResponses) {
+  auto const read_only = issue(true);
+  respond(read_only, {1, 2, 3});
+  EXPECT_EQ(poll(), std::nullopt);
+  auto const fallback = reissued.front();
+
+  // Digests alone cannot be checked: full responses are requested.
+  for (size_t server = 0; server < 2; server++) {
+    Buffer buffer(Response::bufferSize(sizeof(Response::Hash)));
+    auto &layout = *reinterpret_cast<Response::Layout *>(buffer.data());
+    layout.request_id = fallback;
+    layout.kind = Response::Digest;
+    outstanding.find(fallback)->newResponse(
+        server, std::get<Response>(Response::tryFrom(std::move(buffer))));
+  }
+  EXPECT_EQ(poll(), std::nullopt);
+  EXPECT_EQ(full_requested, std::vector<RequestId>{fallback});
+  EXPECT_TRUE(outstanding.expectsUnorderedResponses());
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <dory/ubft/swmr/internal/register-table.hpp>
+
+using dory::ubft::swmr::internal::RegisterTable;
+using Register = RegisterTable::Register;
+using Range = RegisterTable::Range;
+
+static size_t constexpr NbRegisters = 8;
+
+static std::vector<std::pair<size_t, size_t>> dequeue(RegisterTable &table) {
+  std::vector<std::pair<size_t, size_t>> ranges;
+  table.dequeue(RegisterTable::Clock::now(), [&](Range const &range) {
+    ranges.emplace_back(range.index, range.count);
+  });
+  return ranges;
+}
+
+static std::vector<size_t> complete(RegisterTable &table, size_t const index) {
+  std::vector<size_t> validated;
+  table.completed(index, [&](size_t const i, RegisterTable::Clock::time_point) {
+    validated.push_back(i);
+    table.complete(i, 1, 42);
+  });
+  return validated;
+}
+
+TEST(RegisterTable, StateTransitions) {
+  RegisterTable table(NbRegisters, 4);
+  EXPECT_EQ(table[3].state, Register::Free);
+  EXPECT_EQ(table.queue(3, 1), 3);
+  EXPECT_EQ(table[3].state, Register::Reading);
+  // A register cannot be read again before being released.
+  EXPECT_EQ(table.queue(3, 1), std::nullopt);
+  EXPECT_THROW(table.release(3), std::runtime_error);
+
+  EXPECT_EQ(dequeue(table), (std::vector<std::pair<size_t, size_t>>{{3, 1}}));
+  EXPECT_EQ(table[3].state, Register::Reading);
+  EXPECT_EQ(complete(table, 3), (std::vector<size_t>{3}));
+  EXPECT_EQ(table[3].state, Register::Completed);
+  EXPECT_EQ(table[3].subslot, 1);
+  EXPECT_EQ(table[3].incarnation, 42);
+  EXPECT_EQ(table.queue(3, 1), std::nullopt);
+
+  table.release(3);
+  EXPECT_EQ(table[3].state, Register::Free);
+  EXPECT_THROW(table.release(3), std::runtime_error);
+  EXPECT_EQ(table.queue(3, 1), 3);
+}
+
+TEST(RegisterTable, RangesAreReadAtOnce) {
+  RegisterTable table(NbRegisters, 4);
+  EXPECT_THROW(table.queue(6, 3), std::invalid_argument);
+  EXPECT_THROW(table.queue(0, 0), std::invalid_argument);
+
+  EXPECT_EQ(table.queue(0, 3), 0);
+  for (size_t i = 0; i < 3; i++) {
+    EXPECT_EQ(table[i].state, Register::Reading);
+  }
+  // Overlapping ranges are refused as a whole.
+  EXPECT_EQ(table.queue(2, 2), std::nullopt);
+  EXPECT_EQ(table[3].state, Register::Free);
+  EXPECT_EQ(table.queue(3, 2), 3);
+
+  // Each range is a single READ, all posted as one chain.
+  EXPECT_EQ(dequeue(table),
+            (std::vector<std::pair<size_t, size_t>>{{0, 3}, {3, 2}}));
+  EXPECT_EQ(table.outstanding(), 2);
+  EXPECT_FALSE(table.hasQueued());
+  EXPECT_EQ(dequeue(table), (std::vector<std::pair<size_t, size_t>>{}));
+
+  // Only the last READ of the chain is signaled: it completes the others.
+  EXPECT_EQ(complete(table, 3), (std::vector<size_t>{0, 1, 2, 3, 4}));
+  EXPECT_EQ(table.outstanding(), 0);
+  EXPECT_THROW(complete(table, 3), std::runtime_error);
+}
+
+TEST(RegisterTable, BoundedOutstanding) {
+  RegisterTable table(NbRegisters, 2);
+  for (size_t i = 0; i < 3; i++) {
+    table.queue(i, 1);
+  }
+  EXPECT_EQ(dequeue(table),
+            (std::vector<std::pair<size_t, size_t>>{{0, 1}, {1, 1}}));
+  EXPECT_TRUE(table.hasQueued());
+  EXPECT_EQ(dequeue(table), (std::vector<std::pair<size_t, size_t>>{}));
+
+  // The completion must match the signaled READ.
+  EXPECT_THROW(complete(table, 0), std::runtime_error);
+  EXPECT_EQ(dequeue(table), (std::vector<std::pair<size_t, size_t>>{{2, 1}}));
+  EXPECT_EQ(complete(table, 2), (std::vector<size_t>{2}));
+}
+
+TEST(RegisterTable, Retry) {
+  RegisterTable table(NbRegisters, 4);
+  table.queue(0, 2);
+  dequeue(table);
+  // The second register was torn.
+  table.completed(0, [&](size_t const i, RegisterTable::Clock::time_point) {
+    if (i == 0) {
+      table.complete(i, 0, 1);
+    } else {
+      table.retry(i);
+    }
+  });
+  EXPECT_EQ(table[0].state, Register::Completed);
+  EXPECT_EQ(table[1].state, Register::Reading);
+  EXPECT_EQ(dequeue(table), (std::vector<std::pair<size_t, size_t>>{{1, 1}}));
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <dory/ubft/undecided-requests.hpp>
+
+using dory::ubft::UndecidedRequests;
+
+static size_t constexpr Expiry = 4;
+
+TEST(UndecidedRequests, AcceptedThenDecided) {
+  UndecidedRequests undecided(100, 2, Expiry);
+  EXPECT_TRUE(undecided.empty());
+
+  undecided.accepted(100, 0, 0);
+  undecided.accepted(100, 1, 0);
+  undecided.accepted(101, 0, 0);
+  undecided.decided(100, 1, 1);
+  EXPECT_FALSE(undecided.empty());
+  undecided.decided(101, 0, 1);
+  EXPECT_TRUE(undecided.empty());
+
+  // Late or duplicate acceptances of decided requests are ignored.
+  undecided.accepted(100, 1, 1);
+  undecided.accepted(101, 0, 1);
+  EXPECT_TRUE(undecided.empty());
+}
+
+TEST(UndecidedRequests, DecidedBeforeAccepted) {
+  UndecidedRequests undecided(0, 1, Expiry);
+  undecided.decided(0, 0, 1);
+  undecided.accepted(0, 0, 1);
+  EXPECT_TRUE(undecided.empty());
+}
+
+TEST(UndecidedRequests, UnknownClients) {
+  UndecidedRequests undecided(1, 1, Expiry);
+  undecided.accepted(0, 0, 0);
+  undecided.accepted(2, 0, 0);
+  EXPECT_TRUE(undecided.empty());
+  undecided.decided(2, 0, 0);
+}
+
+TEST(UndecidedRequests, Expire) {
+  UndecidedRequests undecided(0, 3, Expiry);
+  undecided.accepted(0, 0, 0);
+  undecided.accepted(1, 0, 1);
+  undecided.accepted(2, 0, 2);
+
+  undecided.expire(Expiry - 1);
+  EXPECT_FALSE(undecided.empty());
+  // Client 0's request was never proposed within the window.
+  undecided.expire(Expiry);
+  undecided.decided(1, 0, Expiry);
+  undecided.decided(2, 0, Expiry);
+  EXPECT_TRUE(undecided.empty());
+
+  // A client that makes progress is not expired.
+  undecided.accepted(0, 1, Expiry);
+  undecided.accepted(0, 2, Expiry);
+  undecided.decided(0, 1, 2 * Expiry - 1);
+  undecided.expire(2 * Expiry);
+  EXPECT_FALSE(undecided.empty());
+  undecided.expire(3 * Expiry - 1);
+  EXPECT_TRUE(undecided.empty());
+
+  // Expired requests are not resurrected by their acceptance.
+  undecided.accepted(0, 2, 3 * Expiry);
+  EXPECT_TRUE(undecided.empty());
+}
+
+TEST(UndecidedRequests, Clear) {
+  UndecidedRequests undecided(0, 2, Expiry);
+  undecided.accepted(0, 0, 0);
+  undecided.accepted(1, 0, 0);
+  undecided.clear();
+  EXPECT_TRUE(undecided.empty());
+  undecided.accepted(1, 1, 0);
+  EXPECT_FALSE(undecided.empty());
+  undecided.decided(1, 1, 1);
+  EXPECT_TRUE(undecided.empty());
+}